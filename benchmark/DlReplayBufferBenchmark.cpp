@@ -0,0 +1,135 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include "funcapproximator/DlReplayBuffer.h"
+#include "funcapproximator/DlShardWriter.h"
+#include "lib/SgRandom.h"
+#include "platform/SgTimer.h"
+
+/** Positions per second of loading training shards into DlReplayBuffer
+    against the number of reader threads, and of sampling batches with
+    and without symmetry augmentation.
+    The shards are synthetic games written by DlShardWriter into a
+    temporary directory.
+    Usage: DlReplayBufferBenchmark [maxThreads [nuGames [batchSize]]] */
+
+namespace {
+
+const int GAME_LENGTH = 200;
+const int GAMES_PER_SHARD = 50;
+
+std::vector<std::string> WriteShards(const std::string &dir, int nuGames,
+                                     bool compress) {
+  DlShardWriter::Options options;
+  options.dir = dir;
+  options.prefix = compress ? "gz" : "raw";
+  options.compress = compress;
+  options.maxShardBytes = 1;
+  options.maxQueuedBytes = std::size_t(1) << 40;
+  SgRandom random;
+  DlTrainingExample example;
+  {
+    DlShardWriter writer(options);
+    std::vector<std::string> records;
+    for (int game = 0; game < nuGames; ++game) {
+      for (int move = GAME_LENGTH - 1; move >= 0; --move) {
+        std::memset(&example, 0, sizeof(example));
+        for (int i = 0; i < 40; ++i)
+          (&example.feature[0][0][0])[random.Int(FEATURE_SIZE)] = 1;
+        if (move == 0)
+          std::memset(example.feature[2], 0, 2 * BD_SIZE * BD_SIZE);
+        else
+          example.feature[2][0][0] = 1;
+        example.policy[random.Int(GO_MAX_MOVES)] = 1;
+        example.reward = game % 2 ? 1 : -1;
+        example.gameStart = move == 0 ? 1 : 0;
+        records.push_back(DlExampleCodec::Encode(example));
+      }
+      // Each AddGame() call fills one shard
+      if (game % GAMES_PER_SHARD == GAMES_PER_SHARD - 1
+          || game == nuGames - 1) {
+        writer.AddGame("", records);
+        records.clear();
+      }
+    }
+  }
+  std::vector<std::string> paths;
+  for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it)
+    if (it->path().filename().string().compare(0, options.prefix.size(),
+                                                 options.prefix) == 0)
+      paths.push_back(it->path().string());
+  return paths;
+}
+
+void BenchmarkLoad(const std::vector<std::string> &paths, const char *name,
+                   int maxThreads) {
+  for (int numThreads = 1; numThreads <= maxThreads; ++numThreads) {
+    DlReplayBuffer::Options options;
+    options.numThreads = numThreads;
+    DlReplayBuffer buffer(options);
+    SgTimer timer;
+    buffer.AddShards(paths);
+    const double time = timer.GetTime();
+    std::cout << std::left << std::setw(10) << name << std::right
+              << std::setw(8) << numThreads << std::setw(10)
+              << buffer.NuPositions() << std::setw(14) << std::fixed
+              << std::setprecision(0)
+              << buffer.NuPositions() / std::max(time, 1e-6) << '\n';
+  }
+}
+
+void BenchmarkSample(const std::vector<std::string> &paths, bool augment,
+                     int batchSize) {
+  DlReplayBuffer::Options options;
+  options.augment = augment;
+  DlReplayBuffer buffer(options);
+  buffer.AddShards(paths);
+  SgRandom random;
+  DlTrainingBatch batch;
+  const int nuBatches = 50;
+  SgTimer timer;
+  for (int i = 0; i < nuBatches; ++i)
+    buffer.SampleBatch(random, batchSize, batch);
+  const double time = timer.GetTime();
+  std::cout << std::left << std::setw(10)
+            << (augment ? "augment" : "identity") << std::right
+            << std::setw(8) << batchSize << std::setw(14) << std::fixed
+            << std::setprecision(0)
+            << nuBatches * batchSize / std::max(time, 1e-6) << '\n';
+}
+
+}
+
+int main(int argc, char **argv) {
+  const int maxThreads = argc > 1 ? std::atoi(argv[1])
+                                  : int(boost::thread::hardware_concurrency());
+  const int nuGames = argc > 2 ? std::atoi(argv[2]) : 500;
+  const int batchSize = argc > 3 ? std::atoi(argv[3]) : 256;
+  const boost::filesystem::path dir = boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path();
+  const std::vector<std::string> raw = WriteShards(dir.string(), nuGames,
+                                                   false);
+  const std::vector<std::string> gz = WriteShards(dir.string(), nuGames, true);
+  std::cout << std::left << std::setw(10) << "load" << std::right
+            << std::setw(8) << "threads" << std::setw(10) << "positions"
+            << std::setw(14) << "positions/s" << '\n';
+  BenchmarkLoad(raw, "tfrecords", maxThreads);
+  BenchmarkLoad(gz, "gzip", maxThreads);
+  std::cout << std::left << std::setw(10) << "sample" << std::right
+            << std::setw(8) << "batch" << std::setw(14) << "positions/s"
+            << '\n';
+  BenchmarkSample(raw, false, batchSize);
+  BenchmarkSample(raw, true, batchSize);
+  boost::filesystem::remove_all(dir);
+  return 0;
+}
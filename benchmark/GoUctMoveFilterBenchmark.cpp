@@ -0,0 +1,121 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "GoBoard.h"
+#include "GoBoardUtil.h"
+#include "GoInit.h"
+#include "GoUctDefaultMoveFilter.h"
+#include "SgInit.h"
+#include "lib/SgRandom.h"
+#include "platform/SgTimer.h"
+
+/** Cost of GoUctDefaultMoveFilter::Get() per node expansion.
+    Random positions are generated by random play; at each position the
+    filter is run for the position itself and for every sibling reached by
+    one legal move, as the tree filter does when a node and its siblings
+    are expanded. The ladder backends are compared with the same positions.
+    Usage: GoUctMoveFilterBenchmark [numPositions [boardSize [safety]]] */
+
+namespace {
+
+struct Config {
+  const char* m_name;
+  bool m_useLadderCache;
+  bool m_bitboardLadder;
+};
+
+const Config CONFIGS[] = {
+    {"GoLadder", false, false},
+    {"bitboard", false, true},
+    {"cache", true, false},
+    {"cache+bitboard", true, true}
+};
+
+bool IsRandomMove(const GoBoard& bd, GoPoint p) {
+  return bd.IsLegal(p) && !GoBoardUtil::IsCompletelySurrounded(bd, p);
+}
+
+void PlayRandom(GoBoard& bd, SgRandom& random, int numMoves) {
+  std::vector<GoPoint> moves;
+  for (int i = 0; i < numMoves; ++i) {
+    moves.clear();
+    for (GoBoard::Iterator it(bd); it; ++it)
+      if (IsRandomMove(bd, *it))
+        moves.push_back(*it);
+    if (moves.empty())
+      break;
+    bd.Play(moves[random.Int(moves.size())]);
+  }
+}
+
+void Run(const std::vector<std::vector<GoPoint> >& games, int boardSize,
+         bool checkSafety, const Config& config) {
+  GoUctDefaultMoveFilterParam param;
+  param.SetCheckSafety(checkSafety);
+  param.SetUseLadderCache(config.m_useLadderCache);
+  param.SetBitboardLadder(config.m_bitboardLadder);
+  GoBoard bd(boardSize);
+  GoUctDefaultMoveFilter filter(bd, param);
+  std::size_t numExpansions = 0;
+  std::size_t numFiltered = 0;
+  SgTimer timer;
+  for (std::size_t i = 0; i < games.size(); ++i) {
+    bd.Init(boardSize);
+    for (std::size_t j = 0; j < games[i].size(); ++j)
+      bd.Play(games[i][j]);
+    numFiltered += filter.Get().size();
+    ++numExpansions;
+    for (GoBoard::Iterator it(bd); it; ++it)
+      if (bd.IsLegal(*it)) {
+        bd.Play(*it);
+        numFiltered += filter.Get().size();
+        ++numExpansions;
+        bd.Undo();
+      }
+  }
+  const double time = timer.GetTime();
+  const GoLadderCache& cache = filter.LadderCache();
+  std::cout << std::left << std::setw(16) << config.m_name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(2)
+            << 1e6 * time / numExpansions << " us/expansion "
+            << std::setw(8) << numFiltered << " filtered "
+            << std::setw(8) << cache.NuLookups() << " lookups "
+            << std::setw(8) << cache.NuHits() << " hits "
+            << std::setw(8) << cache.NuBitboardReads() << " bitboard "
+            << std::setw(8) << cache.NuFullReads() << " full\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int numPositions = argc > 1 ? std::atoi(argv[1]) : 200;
+  const int boardSize = argc > 2 ? std::atoi(argv[2]) : GO_DEFAULT_SIZE;
+  const bool checkSafety = argc > 3 && std::atoi(argv[3]) != 0;
+  SgInit();
+  GoInit();
+  {
+    SgRandom::SetSeed(1);
+    SgRandom random;
+    std::vector<std::vector<GoPoint> > games;
+    GoBoard bd(boardSize);
+    for (int i = 0; i < numPositions; ++i) {
+      bd.Init(boardSize);
+      PlayRandom(bd, random, random.Int(boardSize * boardSize));
+      games.push_back(std::vector<GoPoint>());
+      for (int j = 0; j < bd.MoveNumber(); ++j)
+        games.back().push_back(bd.Move(j).Point());
+    }
+    std::cout << numPositions << " positions, " << boardSize << 'x'
+              << boardSize << ", safety " << checkSafety << '\n';
+    for (std::size_t i = 0; i < sizeof(CONFIGS) / sizeof(CONFIGS[0]); ++i)
+      Run(games, boardSize, checkSafety, CONFIGS[i]);
+  }
+  GoFinish();
+  SgFini();
+  return 0;
+}
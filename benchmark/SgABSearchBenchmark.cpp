@@ -0,0 +1,176 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "GoBoard.h"
+#include "GoInit.h"
+#include "GoSearch.h"
+#include "GoSetupUtil.h"
+#include "SgInit.h"
+#include "lib/SgConcurrentHashTable.h"
+#include "platform/SgTimer.h"
+
+/** Nodes per second and time to depth of the parallel SgABSearch against
+    the number of threads.
+    The search trees of SgSearchTest are too small to measure, so the
+    positions are small Go boards searched by a GoSearch with a simple
+    evaluation: stones and points surrounded by one color.
+    Usage: SgABSearchBenchmark [maxThreads [maxDepth [hashBits]]] */
+
+namespace {
+
+struct Position {
+  const char* m_name;
+  const char* m_diagram;
+};
+
+const Position POSITIONS[] = {
+    {"empty5",
+     ". . . . .\n"
+     ". . . . .\n"
+     ". . . . .\n"
+     ". . . . .\n"
+     ". . . . .\n"},
+    {"fight5",
+     ". . . . .\n"
+     ". X O . .\n"
+     ". X O . .\n"
+     ". . X O .\n"
+     ". . . . .\n"},
+    {"open6",
+     ". . . . . .\n"
+     ". . . . . .\n"
+     ". . X O . .\n"
+     ". . . . . .\n"
+     ". . . . . .\n"
+     ". . . . . .\n"}
+};
+
+/** Owns the board of BenchmarkSearch, which must exist before GoSearch. */
+struct BoardHolder {
+  GoBoard m_bd;
+};
+
+class BenchmarkSearch
+    : private BoardHolder,
+      public GoSearch {
+ public:
+  explicit BenchmarkSearch(const Position& position);
+
+  void Generate(SgVector<GoMove>* moves, int depth);
+  int Evaluate(bool* isExact, int depth);
+  SgABSearch* Clone() const;
+  void StartOfDepth(int depthLimit);
+
+  /** Time at which each depth was completed in the last search. */
+  std::vector<double> m_timeToDepth;
+
+ private:
+  const Position& m_position;
+  int m_startMove;
+  SgTimer m_timer;
+};
+
+BenchmarkSearch::BenchmarkSearch(const Position& position)
+    : GoSearch(m_bd, 0),
+      m_position(position) {
+  int boardSize;
+  GoSetup setup = GoSetupUtil::CreateSetupFromString(position.m_diagram,
+                                                     boardSize);
+  m_bd.Init(boardSize, setup);
+  m_startMove = m_bd.MoveNumber();
+}
+
+SgABSearch* BenchmarkSearch::Clone() const {
+  BenchmarkSearch* search = new BenchmarkSearch(m_position);
+  for (int i = m_startMove; i < m_bd.MoveNumber(); ++i)
+    search->m_bd.Play(m_bd.Move(i));
+  return search;
+}
+
+int BenchmarkSearch::Evaluate(bool* isExact, int depth) {
+  SuppressUnused(depth);
+  *isExact = false;
+  const SgBlackWhite toPlay = m_bd.ToPlay();
+  int value = 0;
+  for (GoBoard::Iterator it(m_bd); it; ++it) {
+    const SgBoardColor c = m_bd.GetColor(*it);
+    if (c == SG_EMPTY) {
+      if (m_bd.NumNeighbors(*it, toPlay) > 0
+          && m_bd.NumNeighbors(*it, SgOppBW(toPlay)) == 0)
+        ++value;
+      else if (m_bd.NumNeighbors(*it, SgOppBW(toPlay)) > 0
+               && m_bd.NumNeighbors(*it, toPlay) == 0)
+        --value;
+    } else
+      value += (c == toPlay ? 1 : -1);
+  }
+  return value;
+}
+
+void BenchmarkSearch::Generate(SgVector<GoMove>* moves, int depth) {
+  SuppressUnused(depth);
+  for (GoBoard::Iterator it(m_bd); it; ++it)
+    if (m_bd.IsEmpty(*it) && m_bd.IsLegal(*it))
+      moves->PushBack(*it);
+  moves->PushBack(GO_PASS);
+}
+
+void BenchmarkSearch::StartOfDepth(int depthLimit) {
+  GoSearch::StartOfDepth(depthLimit);
+  if (depthLimit <= 1) {
+    m_timeToDepth.clear();
+    m_timer.Start();
+  } else
+    m_timeToDepth.push_back(m_timer.GetTime());
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int maxThreads = argc > 1 ? std::atoi(argv[1])
+                                  : int(boost::thread::hardware_concurrency());
+  const int maxDepth = argc > 2 ? std::atoi(argv[2]) : 6;
+  const int hashBits = argc > 3 ? std::atoi(argv[3]) : 20;
+  SgInit();
+  GoInit();
+  {
+    SgSearchSharedHashTable hashTable(1 << hashBits);
+    std::cout << std::left << std::setw(8) << "position" << std::right
+              << std::setw(8) << "threads" << std::setw(12) << "nodes"
+              << std::setw(12) << "nodes/s" << std::setw(8) << "value"
+              << "  time to depth 1.." << maxDepth << '\n';
+    for (std::size_t i = 0; i < sizeof(POSITIONS) / sizeof(POSITIONS[0]);
+         ++i)
+      for (int numThreads = 1; numThreads <= maxThreads; ++numThreads) {
+        BenchmarkSearch search(POSITIONS[i]);
+        search.SetSharedHashTable(&hashTable);
+        search.SetNumThreads(numThreads);
+        SgVector<GoMove> sequence;
+        SgTimer timer;
+        const int value = search.IteratedSearch(1, maxDepth, -1000, 1000,
+                                                &sequence, true);
+        const double time = timer.GetTime();
+        search.m_timeToDepth.push_back(time);
+        const int nodes = search.Statistics().NumNodes()
+            + search.HelperStatistics().NumNodes();
+        std::cout << std::left << std::setw(8) << POSITIONS[i].m_name
+                  << std::right << std::setw(8) << numThreads
+                  << std::setw(12) << nodes << std::setw(12) << std::fixed
+                  << std::setprecision(0) << nodes / std::max(time, 1e-6)
+                  << std::setw(8) << value << ' ' << std::setprecision(3);
+        for (std::size_t d = 0; d < search.m_timeToDepth.size(); ++d)
+          std::cout << ' ' << search.m_timeToDepth[d];
+        std::cout << '\n';
+      }
+  }
+  GoFinish();
+  SgFini();
+  return 0;
+}
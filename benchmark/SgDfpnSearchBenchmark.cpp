@@ -0,0 +1,237 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/thread/thread.hpp>
+#include "GoBoard.h"
+#include "GoInit.h"
+#include "GoSetupUtil.h"
+#include "SgDfpnSearch.h"
+#include "SgInit.h"
+#include "platform/SgDebug.h"
+#include "platform/SgTimer.h"
+
+/** Solve time of the parallel DfpnSolver against the number of threads.
+    The positions are capture problems: the attacker to play tries to
+    capture the target block, the defender wins by getting enough
+    liberties, by two passes in a row or by surviving a number of moves.
+    Moves are restricted to the empty points near the target block.
+    Usage: SgDfpnSearchBenchmark [maxThreads [hashBits]] */
+
+namespace {
+
+using GoPointUtil::Pt;
+
+struct Problem {
+  const char* m_name;
+  const char* m_diagram;
+  int m_targetCol;
+  int m_targetRow;
+  /** Chebyshev distance of the region to the target block. */
+  int m_distance;
+  int m_safeLiberties;
+  int m_maxDepth;
+};
+
+const Problem PROBLEMS[] = {
+    {"ladder",
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". X O . . . . . .\n"
+     ". . X X . . . . .\n"
+     ". . . . . . . . .\n",
+     3, 3, 9, 3, 24},
+    {"net",
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . X . . . . . .\n"
+     ". . X O . . . . .\n"
+     ". . X O X . . . .\n"
+     ". . . X . . . . .\n"
+     ". . . . . . . . .\n",
+     4, 3, 3, 4, 16},
+    {"corner",
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     "X X X X . . . . .\n"
+     ". O O X . . . . .\n"
+     ". . O X . . . . .\n"
+     ". . . X . . . . .\n",
+     2, 3, 2, 5, 20},
+    {"cut",
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . X O X . . . .\n"
+     ". . O . O . . . .\n"
+     ". . . X . . . . .\n"
+     ". . . . . . . . .\n"
+     ". . . . . . . . .\n",
+     4, 5, 3, 4, 16}
+};
+
+/** Attacker to play captures the target block. */
+class CaptureSolver
+    : public DfpnSolver {
+ public:
+  CaptureSolver(const Problem& problem, SgBlackWhite attacker);
+
+  void GenerateChildren(std::vector<GoMove>& children) const;
+  void PlayMove(GoMove move);
+  void UndoMove();
+  bool TerminalState(SgBoardColor colorToPlay, SgEmptyBlackWhite& winner);
+  SgBoardColor GetColorToMove() const;
+  SgHashCode Hash() const;
+  void WriteMoveSequence(std::ostream& stream,
+                         const PointSequence& sequence) const;
+  DfpnSolver* Clone() const;
+
+ private:
+  const Problem& m_problem;
+  SgBlackWhite m_attacker;
+  GoBoard m_bd;
+  GoPoint m_target;
+  int m_startMove;
+  GoPointSet m_region;
+};
+
+CaptureSolver::CaptureSolver(const Problem& problem, SgBlackWhite attacker)
+    : m_problem(problem),
+      m_attacker(attacker) {
+  int boardSize;
+  GoSetup setup = GoSetupUtil::CreateSetupFromString(problem.m_diagram,
+                                                     boardSize);
+  setup.m_player = attacker;
+  m_bd.Init(boardSize, setup);
+  m_bd.SetKoModifiesHash(true);
+  m_target = Pt(problem.m_targetCol, problem.m_targetRow);
+  DBG_ASSERT(m_bd.GetColor(m_target) == SgOppBW(attacker));
+  m_startMove = m_bd.MoveNumber();
+  for (GoBoard::Iterator it(m_bd); it; ++it)
+    for (GoBoard::StoneIterator sit(m_bd, m_target); sit; ++sit)
+      if (m_bd.IsEmpty(*it)
+          && std::abs(GoPointUtil::Row(*it) - GoPointUtil::Row(*sit))
+              <= problem.m_distance
+          && std::abs(GoPointUtil::Col(*it) - GoPointUtil::Col(*sit))
+              <= problem.m_distance)
+        m_region.Include(*it);
+}
+
+DfpnSolver* CaptureSolver::Clone() const {
+  CaptureSolver* solver = new CaptureSolver(m_problem, m_attacker);
+  for (int i = m_startMove; i < m_bd.MoveNumber(); ++i)
+    solver->PlayMove(m_bd.Move(i).Point());
+  return solver;
+}
+
+void CaptureSolver::GenerateChildren(std::vector<GoMove>& children) const {
+  children.clear();
+  for (GoBoard::LibertyCopyIterator it(m_bd, m_target); it; ++it)
+    if (m_bd.IsLegal(*it))
+      children.push_back(*it);
+  for (SgSetIterator it(m_region); it; ++it)
+    if (m_bd.IsEmpty(*it)
+        && !m_bd.IsLibertyOfBlock(*it, m_bd.Anchor(m_target))
+        && m_bd.IsLegal(*it))
+      children.push_back(*it);
+  children.push_back(GO_PASS);
+}
+
+SgBoardColor CaptureSolver::GetColorToMove() const {
+  return m_bd.ToPlay();
+}
+
+SgHashCode CaptureSolver::Hash() const {
+  // The terminal state depends on the depth and on a previous pass
+  SgHashCode hash = m_bd.GetHashCodeInclToPlay();
+  const int depth = m_bd.MoveNumber() - m_startMove;
+  SgHashUtil::XorInteger(hash, 2 * depth + (m_bd.GetLastMove() == GO_PASS ? 2 : 1));
+  return hash;
+}
+
+void CaptureSolver::PlayMove(GoMove move) {
+  m_bd.Play(move);
+}
+
+bool CaptureSolver::TerminalState(SgBoardColor colorToPlay,
+                                  SgEmptyBlackWhite& winner) {
+  SuppressUnused(colorToPlay);
+  if (m_bd.GetColor(m_target) != SgOppBW(m_attacker)) {
+    winner = m_attacker;
+    return true;
+  }
+  if (m_bd.NumLiberties(m_target) >= m_problem.m_safeLiberties
+      || m_bd.MoveNumber() - m_startMove >= m_problem.m_maxDepth
+      || (m_bd.GetLastMove() == GO_PASS
+          && m_bd.Get2ndLastMove() == GO_PASS)) {
+    winner = SgOppBW(m_attacker);
+    return true;
+  }
+  return false;
+}
+
+void CaptureSolver::UndoMove() {
+  m_bd.Undo();
+}
+
+void CaptureSolver::WriteMoveSequence(std::ostream& stream,
+                                      const PointSequence& sequence) const {
+  for (std::size_t i = 0; i < sequence.size(); ++i)
+    stream << GoWritePoint(sequence[i]) << ' ';
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int maxThreads = argc > 1 ? std::atoi(argv[1])
+                                  : int(boost::thread::hardware_concurrency());
+  const int hashBits = argc > 2 ? std::atoi(argv[2]) : 22;
+  SgInit();
+  GoInit();
+  {
+    DfpnSharedHashTable hashTable(1 << hashBits);
+    std::cout << std::left << std::setw(8) << "problem" << std::right
+              << std::setw(8) << "threads" << std::setw(10) << "time"
+              << std::setw(8) << "speedup" << std::setw(12) << "MIDs"
+              << std::setw(8) << "winner\n";
+    for (std::size_t i = 0; i < sizeof(PROBLEMS) / sizeof(PROBLEMS[0]); ++i) {
+      double time1 = 0;
+      for (int numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        CaptureSolver solver(PROBLEMS[i], SG_BLACK);
+        solver.SetNumThreads(numThreads);
+        hashTable.Clear();
+        PointSequence pv;
+        SgTimer timer;
+        const SgEmptyBlackWhite winner = solver.StartSearch(hashTable, pv);
+        const double time = timer.GetTime();
+        if (numThreads == 1)
+          time1 = time;
+        std::cout << std::left << std::setw(8) << PROBLEMS[i].m_name
+                  << std::right << std::setw(8) << numThreads
+                  << std::setw(10) << std::fixed << std::setprecision(3)
+                  << time << std::setw(8) << std::setprecision(2)
+                  << time1 / time << std::setw(12)
+                  << solver.NumMIDcalls() << std::setw(7)
+                  << SgEBW(winner) << '\n';
+      }
+    }
+  }
+  GoFinish();
+  SgFini();
+  return 0;
+}
@@ -0,0 +1,102 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include "GoInit.h"
+#include "SgGameReader.h"
+#include "SgInit.h"
+#include "SgNode.h"
+#include "SgSgfCorpus.h"
+#include "lib/SgRandom.h"
+#include "platform/SgTimer.h"
+
+/** Games per second of SgSgfCorpus against the number of threads,
+    compared with SgGameReader.
+    Without files, a collection of random 19x19 games is written to a
+    temporary file.
+    Usage: SgSgfCorpusBenchmark [maxThreads [file.sgf...]] */
+
+namespace {
+
+const int NU_RANDOM_GAMES = 20000;
+const int GAME_LENGTH = 250;
+
+std::string WriteRandomGames() {
+  const boost::filesystem::path path =
+      boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%%%%%.sgf");
+  std::ofstream out(path.string().c_str());
+  SgRandom random;
+  for (int i = 0; i < NU_RANDOM_GAMES; ++i) {
+    out << "(;FF[4]GM[1]SZ[19]KM[7.5]RE[" << (i % 2 ? "B" : "W")
+        << "+R]PB[black]PW[white]\n";
+    for (int j = 0; j < GAME_LENGTH; ++j) {
+      out << ';' << (j % 2 ? 'W' : 'B') << '['
+          << char('a' + random.Int(19)) << char('a' + random.Int(19)) << ']';
+      if (j % 50 == 0)
+        out << "C[move " << j << "]\n";
+    }
+    out << ")\n";
+  }
+  return path.string();
+}
+
+void PrintResult(const char* name, int numThreads, std::size_t nuGames,
+                 double time) {
+  std::cout << std::left << std::setw(14) << name << std::right
+            << std::setw(8) << numThreads << std::setw(10) << nuGames
+            << std::setw(12) << std::fixed << std::setprecision(0)
+            << nuGames / std::max(time, 1e-6) << '\n';
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int maxThreads = argc > 1 ? std::atoi(argv[1])
+                                  : int(boost::thread::hardware_concurrency());
+  std::vector<std::string> files(argv + std::min(argc, 2), argv + argc);
+  const bool randomGames = files.empty();
+  if (randomGames)
+    files.push_back(WriteRandomGames());
+  SgInit();
+  GoInit();
+  std::cout << std::left << std::setw(14) << "loader" << std::right
+            << std::setw(8) << "threads" << std::setw(10) << "games"
+            << std::setw(12) << "games/s" << '\n';
+  {
+    SgTimer timer;
+    std::size_t nuGames = 0;
+    for (std::size_t i = 0; i < files.size(); ++i) {
+      std::ifstream in(files[i].c_str());
+      SgGameReader reader(in);
+      SgVectorOf<SgNode> roots;
+      reader.ReadGames(&roots);
+      nuGames += roots.Length();
+      for (int j = 0; j < roots.Length(); ++j)
+        roots[j]->DeleteTree();
+    }
+    PrintResult("SgGameReader", 1, nuGames, timer.GetTime());
+  }
+  for (int numThreads = 1; numThreads <= maxThreads; ++numThreads) {
+    SgSgfCorpus corpus;
+    SgTimer timer;
+    corpus.LoadFiles(files, numThreads);
+    PrintResult("SgSgfCorpus", numThreads, corpus.NuGames(),
+                timer.GetTime());
+  }
+  if (randomGames)
+    boost::filesystem::remove(files[0]);
+  GoFinish();
+  SgFini();
+  return 0;
+}
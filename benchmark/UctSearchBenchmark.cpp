@@ -0,0 +1,132 @@
+
+#include "platform/SgSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "GoBoard.h"
+#include "GoBoardUtil.h"
+#include "GoInit.h"
+#include "GoUctGlobalSearch.h"
+#include "GoUctPlayoutPolicy.h"
+#include "SgInit.h"
+#include "funcapproximator/DlConfig.h"
+#include "lib/SgRandom.h"
+
+/** Deep UCT search with the mock network of DlMockNetworkEvaluator, so
+    the cost of the search itself (tree, board, threads, batching) is
+    measured without a model.
+    Each search runs a fixed number of games from one of a fixed set of
+    positions, generated by random play with a fixed seed. For each number
+    of search threads, the benchmark reports games, tree nodes and network
+    evaluations per second, the mean number of positions per network
+    batch, the largest tree and the time the search threads waited for
+    the network.
+    Usage: UctSearchBenchmark [numPositions [games [maxThreads [latency]]]]
+    latency is the mock network time per batch in microseconds. */
+
+namespace {
+
+typedef GoUctGlobalSearch<GoUctPlayoutPolicy<GoUctBoard>,
+                          GoUctPlayoutPolicyFactory<GoUctBoard> > Search;
+
+const int BOARD_SIZE = GO_MAX_SIZE;
+
+bool IsRandomMove(const GoBoard& bd, GoPoint p) {
+  return bd.IsLegal(p) && !GoBoardUtil::IsCompletelySurrounded(bd, p);
+}
+
+std::vector<GoPoint> RandomGame(SgRandom& random, int numMoves) {
+  GoBoard bd(BOARD_SIZE);
+  std::vector<GoPoint> game;
+  std::vector<GoPoint> moves;
+  for (int i = 0; i < numMoves; ++i) {
+    moves.clear();
+    for (GoBoard::Iterator it(bd); it; ++it)
+      if (IsRandomMove(bd, *it))
+        moves.push_back(*it);
+    if (moves.empty())
+      break;
+    game.push_back(moves[random.Int(moves.size())]);
+    bd.Play(game.back());
+  }
+  return game;
+}
+
+void Run(const std::vector<std::vector<GoPoint> >& positions, int games,
+         int numThreads) {
+  GoBoard bd(BOARD_SIZE);
+  GoUctPlayoutPolicyParam policyParam;
+  GoUctDefaultMoveFilterParam filterParam;
+  Search search(bd, new GoUctPlayoutPolicyFactory<GoUctBoard>(policyParam),
+                policyParam, filterParam);
+  search.SetNumberThreads(numThreads);
+  double gamesPlayed = 0;
+  double nodes = 0;
+  double evaluations = 0;
+  double batches = 0;
+  double waitTime = 0;
+  std::size_t maxNodes = 0;
+  double time = 0;
+  for (const std::vector<GoPoint>& position : positions) {
+    bd.Init(BOARD_SIZE);
+    for (GoPoint p : position)
+      bd.Play(p);
+    search.SetToPlay(bd.ToPlay());
+    std::vector<GoMove> sequence;
+    std::vector<GoMove> rootFilter;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    search.StartDeepUCTSearchThread(games, 1e6, sequence, nullptr, nullptr, 1.0,
+                                    rootFilter, nullptr, nullptr, true);
+    time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const UctSearchStat& stat = search.Statistics();
+    gamesPlayed += search.GamesPlayed();
+    nodes += search.Tree().NuNodes();
+    maxNodes = std::max(maxNodes, search.Tree().NuNodes());
+    evaluations += stat.eval_positions;
+    batches += stat.eval_batches;
+    waitTime += stat.eval_wait_time;
+  }
+  std::cout << std::setw(3) << numThreads << " threads"
+            << std::fixed << std::setprecision(0)
+            << std::setw(10) << gamesPlayed / time << " games/s"
+            << std::setw(10) << nodes / time << " nodes/s"
+            << std::setw(10) << evaluations / time << " evals/s"
+            << std::setprecision(2)
+            << std::setw(7) << (batches > 0 ? evaluations / batches : 0) << " batch"
+            << std::setw(8) << maxNodes * sizeof(UctNode) / (1024.0 * 1024.0) << " MB tree"
+            << std::setprecision(1)
+            << std::setw(6) << 100 * waitTime / (numThreads * time) << "% wait\n";
+}
+
+}
+
+int main(int argc, char** argv) {
+  const int numPositions = argc > 1 ? std::atoi(argv[1]) : 20;
+  const int games = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const int maxThreads = argc > 3 ? std::atoi(argv[3]) : 4;
+  const int latency = argc > 4 ? std::atoi(argv[4]) : 1000;
+  SgInit();
+  GoInit();
+  DlConfig::GetInstance().set("nn_backend", "mock");
+  DlConfig::GetInstance().set("nn_mocklatency", std::to_string(latency));
+  {
+    SgRandom::SetSeed(1);
+    SgRandom random;
+    std::vector<std::vector<GoPoint> > positions;
+    for (int i = 0; i < numPositions; ++i)
+      positions.push_back(RandomGame(random, random.Int(200)));
+    std::cout << numPositions << " positions, " << games << " games, "
+              << latency << " us per batch\n";
+    for (int numThreads = 1; numThreads <= std::min(maxThreads, MAX_BATCHES);
+         numThreads *= 2)
+      Run(positions, games, numThreads);
+  }
+  GoFinish();
+  SgFini();
+  return 0;
+}
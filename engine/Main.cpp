@@ -1,4 +1,6 @@
+#include <csignal>
 #include <iostream>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/program_options/cmdline.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -8,6 +10,9 @@
 #include "SgInit.h"
 #include "platform/SgPlatform.h"
 #include "Version.h"
+#include "UctBoardEvaluator.h"
+#include "ZmqMpiSynchronizer.h"
+#include "funcapproximator/DlConfig.h"
 
 using boost::filesystem::path;
 using std::ostream;
@@ -38,32 +43,63 @@ void Help(po::options_description& desc, ostream& out) {
 struct CommandLineOptions {
   CommandLineOptions();
   bool m_allowHandicap;
+  bool m_asyncGenMove;
+  bool m_inferenceServer;
   bool m_quiet;
+  bool m_useBook;
   int m_fixedBoardSize;
   int m_maxGames;
   string m_config;
   const char* m_programPath;
   int m_srand;
+  int m_distRank;
+  int m_distSize;
+  string m_distEndpoint;
   vector<string> m_inputFiles;
 };
 
 CommandLineOptions::CommandLineOptions() : m_allowHandicap(false),
+                                           m_asyncGenMove(false),
+                                           m_inferenceServer(false),
                                            m_quiet(false),
+                                           m_useBook(true),
                                            m_fixedBoardSize(0),
                                            m_maxGames(-1),
                                            m_config(),
                                            m_programPath(nullptr),
-                                           m_srand(0) {}
+                                           m_srand(0),
+                                           m_distRank(0),
+                                           m_distSize(1),
+                                           m_distEndpoint() {}
 
 void ParseOptions(int argc, char** argv, struct CommandLineOptions& options) {
   po::options_description normalOptions("Options");
   normalOptions.add_options()
+      ("async-genmove",
+       "handle statistics commands like uct_stat_search while genmove searches")
+
       ("config",
        po::value<std::string>(&options.m_config)->default_value(""),
        "execute GTP commands from file before starting main command loop")
 
+      ("dist-endpoint",
+       po::value<std::string>(&options.m_distEndpoint)->default_value("ipc:///tmp/unrealgo-dist.ipc"),
+       "endpoint of the process with rank 0 for distributed search")
+
+      ("dist-rank",
+       po::value<int>(&options.m_distRank)->default_value(0),
+       "rank of this process in distributed search; 0 plays the moves")
+
+      ("dist-size",
+       po::value<int>(&options.m_distSize)->default_value(1),
+       "number of processes in distributed search; all get the same GTP commands")
+
       ("help", "Displays this help and exit")
 
+      ("inference-server",
+       "evaluate positions for the engines that name this server in the "
+       "inferenceserver key of the dl config, instead of playing")
+
       ("maxgames",
        po::value<int>(&options.m_maxGames)->default_value(-1),
        "make clear_board fail after n invocations")
@@ -101,10 +137,46 @@ void ParseOptions(int argc, char** argv, struct CommandLineOptions& options) {
   }
   if (vm.count("help"))
     Help(normalOptions, std::cout);
+  if (vm.count("async-genmove"))
+    options.m_asyncGenMove = true;
+  if (vm.count("nobook"))
+    options.m_useBook = false;
   if (vm.count("nohandicap"))
     options.m_allowHandicap = false;
   if (vm.count("quiet"))
     options.m_quiet = true;
+  if (vm.count("inference-server"))
+    options.m_inferenceServer = true;
+}
+
+UctInferenceServer* g_inferenceServer = nullptr;
+
+void StopInferenceServer(int) {
+  if (g_inferenceServer)
+    g_inferenceServer->Stop();
+}
+
+int RunInferenceServer() {
+  DlConfig& config = DlConfig::GetInstance();
+  const string name = config.get_inference_server();
+  if (name.empty()) {
+    SgDebug() << "inferenceserver is not set in the dl config\n";
+    return 1;
+  }
+  UctBoardEvaluator evaluator(false);
+  evaluator.LoadGraph(config.get_metagraph());
+  UctInferenceServer server(name,
+                            boost::bind(&UctBoardEvaluator::EvaluateState, &evaluator, _1, _2, _3, _4),
+                            boost::bind(&UctBoardEvaluator::UpdateCheckPoint, &evaluator, _1));
+  server.SetBatchWait(config.get_inference_batchwait());
+  g_inferenceServer = &server;
+  signal(SIGINT, StopInferenceServer);
+  signal(SIGTERM, StopInferenceServer);
+  server.Run();
+  g_inferenceServer = nullptr;
+  SgDebug() << "inference server: " << server.NuPositions() << " positions in "
+            << server.NuBatches() << " batches\n";
+  return 0;
 }
 
 void PrintStartupMessage() {
@@ -138,15 +210,27 @@ int main(int argc, char** argv) {
     GoInit();
 
     PrintStartupMessage();
+    if (options.m_inferenceServer)
+      return RunInferenceServer();
 
     SgRandom::SetSeed(options.m_srand);
     MainEngine engine(options.m_fixedBoardSize,
                       options.m_programPath,
                       !options.m_allowHandicap);
     GoGtpAssertionHandler assertionHandler(engine);
+    if (options.m_distSize > 1)
+      engine.SetDistributedSearch(ZmqMpiSynchronizer::Create(options.m_distEndpoint,
+                                                             options.m_distRank,
+                                                             options.m_distSize));
 
+    if (options.m_useBook)
+      engine.LoadBook(GetProgramDir(options.m_programPath));
     if (options.m_maxGames >= 0)
       engine.SetMaxClearBoard(options.m_maxGames);
+#if GTPENGINE_ASYNC
+    if (options.m_asyncGenMove)
+      engine.SetAsynchronousGenMove(true);
+#endif
     if (!options.m_config.empty())
       engine.ExecuteFile(options.m_config);
     if (!options.m_inputFiles.empty()) {
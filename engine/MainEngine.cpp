@@ -1,6 +1,8 @@
 
 #include "MainEngine.h"
 #include "GoGtpCommandUtil.h"
+#include <boost/filesystem.hpp>
+#include "platform/SgPlatform.h"
 #include "Version.h"
 
 MainEngine::MainEngine(int fixedBoardSize, const char *programPath, bool noHandicap)
@@ -39,3 +41,26 @@ void MainEngine::CmdName(GtpCommand &cmd) {
 void MainEngine::CmdVersion(GtpCommand &cmd) {
   cmd << UnrealGo::GetVersion();
 }
+
+void MainEngine::LoadBook(const boost::filesystem::path &programDir) {
+  auto *player = dynamic_cast<UctDeepPlayer *>(m_playerList[PT_DeepUctPlayer]);
+  if (player == nullptr)
+    return;
+  const std::string fileName = "book.dat";
+  const std::string files[] = {(programDir / fileName).string(),
+                               SgPlatform::GetDataFileNativePath(fileName)};
+  for (const auto &file : files)
+    if (boost::filesystem::exists(file) && player->OpeningBook().Open(file)) {
+      SgDebug() << "Loaded opening book " << file << " ("
+                << player->OpeningBook().NuPositions() << " positions)\n";
+      return;
+    }
+  SgDebug() << "No opening book loaded\n";
+}
+
+void MainEngine::SetDistributedSearch(const MpiSynchronizerHandle &handle) {
+  SetMpiSynchronizer(handle);
+  auto *player = dynamic_cast<UctDeepPlayer *>(m_playerList[PT_DeepUctPlayer]);
+  if (player != nullptr)
+    player->SetMpiSynchronizer(handle);
+}
@@ -14,6 +14,11 @@ public:
   void CmdLicense(GtpCommand &cmd);
   void CmdName(GtpCommand &cmd) final;
   void CmdVersion(GtpCommand &cmd) final;
+  /** Load book.dat from the program directory or the data directory into
+      the deep player. */
+  void LoadBook(const boost::filesystem::path &programDir);
+  /** Share the search of genmove with other processes through handle. */
+  void SetDistributedSearch(const MpiSynchronizerHandle &handle);
 
 private:
   GoUctCommands m_uctCommands;
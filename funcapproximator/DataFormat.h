@@ -19,6 +19,12 @@
 #ifndef UNREALGO_DATAFORMAT_H
 #define UNREALGO_DATAFORMAT_H
 
+#include "config/BoardStaticConfig.h"
+
+const int BD_SIZE = GO_DEFINE_MAX_SIZE;
+const int NUM_MAPS = 17;
+const int FEATURE_SIZE = BD_SIZE * BD_SIZE * NUM_MAPS;
+
 enum DataFormat {
   DF_HWC = 0,
   DF_CHW = 1
@@ -1,13 +1,17 @@
 
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <StringUtil.h>
 #include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
 #include "DlCheckPoint.h"
+#include "../network/AtomCache.h"
 #include "../network/AtomCurl.h"
 #include "../lib/FileUtil.h"
 #include "../network/AtomHash.h"
-#include "../network/AtomZIP.h"
+#include "../network/AtomZipStream.h"
 #include "../msg/MinioStub.h"
 #include "../network/AtomUNZIP.h"
 #include "platform/SgDebug.h"
@@ -82,6 +86,42 @@ static size_t CheckPointCB(char* data, size_t size, size_t nmemb, void* out_) {
   return size * nmemb;
 }
 
+static size_t AppendCB(char* data, size_t size, size_t nmemb, void* out_) {
+  static_cast<std::string*>(out_)->append(data, size * nmemb);
+  return size * nmemb;
+}
+
+/** Zip files and hash the archive while it is written. An existing archive
+    is kept and only hashed.
+    @return The sha1 of the archive, empty if it could not be written */
+static std::string zipFiles(const std::vector<std::string>& files, const std::string& zipPath) {
+  char sha1Buf[SHA1HEXLEN];
+  if (UnrealGo::FileExists(zipPath))
+    return UnrealGo::Hash::sha1(zipPath, sha1Buf) == 0 ? sha1Buf : "";
+  std::string tmpPath = zipPath + ".tmp";
+  int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd < 0)
+    return "";
+  UnrealGo::ZipStream::Output out(fd);
+  int ret = UnrealGo::ZipStream::WriteZip(files, out);
+  close(fd);
+  if (ret != Z_OK || rename(tmpPath.c_str(), zipPath.c_str()) != 0) {
+    remove(tmpPath.c_str());
+    return "";
+  }
+  return out.Sha1();
+}
+
+/** Download a zip into memory and unpack it into the working directory. */
+static bool downloadExtractZip(const std::string& url) {
+  AtomCurl atomCurl;
+  std::string zip;
+  if (!atomCurl.Get(url.c_str(), &zip, &AppendCB))
+    return false;
+  UnrealGo::ZipStream::Input in(zip.data(), zip.size(), false);
+  return UnrealGo::ZipStream::ExtractZip(in, ".") == Z_OK;
+}
+
 void DlCheckPoint::InitMetagraph() {
   std::string subpath = DlConfig::GetInstance().get_meta_subpath();
   std::string minio_path = DlConfig::GetInstance().get_minio_path();
@@ -89,15 +129,14 @@ void DlCheckPoint::InitMetagraph() {
   std::vector<std::string> fileList;
   std::string zipFilePath = absPath + ".zip";
   fileList.emplace_back(absPath);
-  UnrealGo::ZIP::compress_zip_files(fileList, zipFilePath);
+  zipFiles(fileList, zipFilePath);
   UnrealGo::MinioStub::SetObjPolicy(subpath, "readonly");
 }
 
 bool DlCheckPoint::DownloadMetagraph() {
   std::string url = DlConfig::GetInstance().get_metagraph_url() + ".zip";
   AtomCurl atomCurl;
-  int ret = atomCurl.DownloadExtractZip(url.c_str());
-  if (ret != CURLE_OK) {
+  if (!downloadExtractZip(url)) {
     url = DlConfig::GetInstance().get_metagraph_url();
     if (atomCurl.DownloadExtractZip(url.c_str()) != CURLE_OK) {
       url = DlConfig::GetInstance().get_default_graph();
@@ -116,15 +155,42 @@ bool DlCheckPoint::DownloadMetagraph() {
   return true;
 }
 
-static bool checkZipFile(DlCheckPoint::CheckPointInfo& info) {
-  std::string zipName = info.name + ".zip";
-  if (UnrealGo::FileExists(zipName)) {
-    char sha1Buf[SHA1HEXLEN];
-    UnrealGo::Hash::sha1(zipName, sha1Buf);
-    if (info.sha1 == sha1Buf)
-      return true;
+/** The sha1 of the zip file that the files of a checkpoint were extracted
+    from is kept next to them, so they are not extracted again. */
+static std::string extractedStampName(const DlCheckPoint::CheckPointInfo& info) {
+  return info.name + ".sha1";
+}
+
+static bool isExtracted(const DlCheckPoint::CheckPointInfo& info) {
+  std::vector<std::string> lines;
+  if (!UnrealGo::FileExists(info.name + ".index") || !UnrealGo::FileExists(extractedStampName(info)))
+    return false;
+  UnrealGo::ReadLines(extractedStampName(info), lines);
+  return !lines.empty() && lines[0] == info.sha1;
+}
+
+/** Unpack a checkpoint into the working directory in one read of the zip.
+    With verify, the zip is hashed on the way and the files are removed
+    again if its sha1 is not the one of the checkpoint. */
+static bool extractCheckPoint(const DlCheckPoint::CheckPointInfo& info, const std::string& zipPath, bool verify) {
+  if (isExtracted(info))
+    return true;
+  int fd = open(zipPath.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  UnrealGo::removeFilesStartWith(".", info.name);
+  UnrealGo::ZipStream::Input in(fd, verify);
+  std::vector<std::string> extracted;
+  int ret = UnrealGo::ZipStream::ExtractZip(in, ".", &extracted);
+  close(fd);
+  if (ret != Z_OK || (verify && in.Sha1() != info.sha1)) {
+    for (const std::string& file : extracted)
+      remove(file.c_str());
+    return false;
   }
-  return false;
+  std::vector<std::string> lines(1, info.sha1);
+  UnrealGo::WriteLines(extractedStampName(info), lines);
+  return true;
 }
 
 bool DlCheckPoint::CheckDefaultCheckPoint(CheckPointInfo& out_) {
@@ -144,13 +210,21 @@ bool DlCheckPoint::DownloadCheckPoint(const std::string& infoUrl, CheckPointInfo
     if (out_.sha1 != downloaded.sha1) {
       out_ = downloaded;
       if (!out_.name.empty()) {
-        if (checkZipFile(out_)) {
-          std::string zipname = out_.name + ".zip";
-          return UnrealGo::UNZIP::extract_zip_file(zipname.c_str()) == 0;
-        } else {
-          UnrealGo::removeFilesStartWith(".", out_.name);
-          return atomCurl.DownloadExtractZip(out_.url.c_str()) == 0;
-        }
+        if (isExtracted(out_))
+          return true;
+        if (UnrealGo::FileExists(out_.name + ".zip") && extractCheckPoint(out_, out_.name + ".zip", true))
+          return true;
+        // Checkpoints are cached by sha1, so switching back to one that was
+        // fetched before needs no download
+        DlConfig &config = DlConfig::GetInstance();
+        AtomCache cache(config.get_checkpointcache_dir(),
+                        config.get_checkpointcache_connections(),
+                        config.get_checkpointcache_maxentries(),
+                        std::uint64_t(config.get_checkpointcache_maxmb()) << 20);
+        std::string zipPath;
+        if (!cache.Fetch(out_.url, out_.sha1, zipPath))
+          return false;
+        return extractCheckPoint(out_, zipPath, false);
       }
       return false; // indicate update checkpoint for UctSearch
     } else
@@ -223,13 +297,11 @@ void DlCheckPoint::WriteCheckpointInfo(DlConfig& config,
 
   UnrealGo::ListFilesStartWith(checkParentDir, checkpointName, ckList, exList);
   std::string zipFilePath = UnrealGo::GetFullPathStr(checkParentDir, zipFileName);
-  UnrealGo::ZIP::compress_zip_files(ckList, zipFilePath);
+  // The archive is hashed while it is written, not read again
+  std::string sha1 = zipFiles(ckList, zipFilePath);
   UnrealGo::MinioStub::SetObjPolicy(UnrealGo::StringUtil::JoinPath(config.get_checkdata_subpath(), zipFileName),
                                     "readonly");
-
-  char sha1Buf[SHA1HEXLEN];
-  UnrealGo::Hash::sha1(zipFilePath, sha1Buf);
-  outFile << sha1Buf << std::endl;
+  outFile << sha1 << std::endl;
 
   std::string checkpointDataUrl = UnrealGo::StringUtil::JoinPath(config.get_base_url(),
                                                                  config.get_checkdata_subpath()); // + checkpointName + ".zip";
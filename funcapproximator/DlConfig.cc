@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <bits/ios_base.h>
 #include <ios>
 #include <fstream>
@@ -168,6 +169,12 @@ std::string DlConfig::get(const std::string& key) {
   return "";
 }
 
+void DlConfig::set(const std::string& key, const std::string& value) {
+  config_map[key] = value;
+  if (key == "value_transform")
+    valueTrans = TR_UNKNOWN;
+}
+
 std::string DlConfig::get(const std::string& key, const std::string& defaultValue) {
   std::string ret = get(key);
   if (ret.empty())
@@ -207,6 +214,82 @@ std::string DlConfig::get_deeptrainerlisten_socket() {
   return get("deeptrainernetworklistensocket", "tcp://*:5556");
 }
 
+std::string DlConfig::get_trainqueue_socket() {
+  return get("trainqueuesocket", "inproc://train-queue");
+}
+
+int DlConfig::get_trainqueue_size() {
+  return std::max(1, std::stoi(get("trainqueuesize", "2")));
+}
+
+std::string DlConfig::get_checkpointnotify_socket() {
+  return get("checkpointnotifysocket", "inproc://checkpoints");
+}
+
+std::string DlConfig::get_checkpointcache_dir() {
+  return get("checkpointcachedir", "checkpoint_cache");
+}
+
+int DlConfig::get_checkpointcache_connections() {
+  return std::max(1, std::stoi(get("checkpointcacheconnections", "4")));
+}
+
+int DlConfig::get_checkpointcache_maxentries() {
+  return std::max(0, std::stoi(get("checkpointcachemaxentries", "16")));
+}
+
+int DlConfig::get_checkpointcache_maxmb() {
+  return std::max(0, std::stoi(get("checkpointcachemaxmb", "0")));
+}
+
+std::string DlConfig::get_inference_server() {
+  return get("inferenceserver", "");
+}
+
+int DlConfig::get_inference_batchwait() {
+  return std::max(0, std::stoi(get("inferencebatchwait", "200")));
+}
+
+int DlConfig::get_gating_matches() {
+  return std::max(1, std::stoi(get("gatingmatches", "1")));
+}
+
+std::size_t DlConfig::get_max_memory() {
+  return std::stoull(get("max_memory", "0"));
+}
+
+std::string DlConfig::get_network_backend() {
+  return get("nn_backend", "tf");
+}
+
+int DlConfig::get_network_cputhreads() {
+  return std::max(1, std::stoi(get("nn_cputhreads", "1")));
+}
+
+std::string DlConfig::get_network_precision() {
+  return get("nn_precision", "fp32");
+}
+
+int DlConfig::get_mock_batchlatency() {
+  return std::max(0, std::stoi(get("nn_mocklatency", "0")));
+}
+
+int DlConfig::get_mock_positionlatency() {
+  return std::max(0, std::stoi(get("nn_mocklatencyposition", "0")));
+}
+
+std::string DlConfig::get_network_calibration() {
+  return get("nn_calibration", "");
+}
+
+bool DlConfig::get_graph_optimization() {
+  return get("nn_optimizegraph", "true") != "false";
+}
+
+std::string DlConfig::get_graphcache_dir() {
+  return get("nn_graphcache", "graph_cache");
+}
+
 std::string DlConfig::get_network_input() {
   return get("nn_input", "input");
 }
@@ -2,6 +2,7 @@
 #ifndef TFRECORD_GONET_DLCONFIG_H
 #define TFRECORD_GONET_DLCONFIG_H
 
+#include <cstddef>
 #include <map>
 #include <vector>
 
@@ -28,6 +29,8 @@ class DlConfig {
   void parse();
   std::string get(const std::string& key, const std::string& defaultValue);
   std::string get(const std::string& key);
+  /** Override a value of the file, for example in benchmarks. */
+  void set(const std::string& key, const std::string& value);
   std::string get_bestcheckpoint_fullpath();
   std::string get_bestcheckpointlist_subpath();
   std::string get_bestcheckpointhashlist_subpath();
@@ -57,6 +60,26 @@ class DlConfig {
   std::string get_evalstatslisten_socket();
   std::string get_evalstatconnect_socket();
   std::string get_deeptrainerlisten_socket();
+  std::string get_trainqueue_socket();
+  int get_trainqueue_size();
+  std::string get_checkpointnotify_socket();
+  std::string get_checkpointcache_dir();
+  int get_checkpointcache_connections();
+  /** Limits of the checkpoint cache, 0 for no limit. */
+  int get_checkpointcache_maxentries();
+  int get_checkpointcache_maxmb();
+  std::string get_inference_server();
+  int get_inference_batchwait();
+  int get_gating_matches();
+  std::size_t get_max_memory();
+  std::string get_network_backend();
+  int get_network_cputhreads();
+  std::string get_network_precision();
+  int get_mock_batchlatency();
+  int get_mock_positionlatency();
+  std::string get_network_calibration();
+  bool get_graph_optimization();
+  std::string get_graphcache_dir();
   std::string get_network_input();
   void get_network_outputs(std::vector<std::string>& outputs);
   bool reuse_search_tree();
@@ -0,0 +1,821 @@
+
+#include "DlCpuNetworkEvaluator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "DlConfig.h"
+
+namespace {
+
+const char MAGIC[4] = {'U', 'G', 'N', 'W'};
+const int32_t VERSION = 1;
+const int NUM_POINTS = BD_SIZE * BD_SIZE;
+/** Pixels rounded up to the 16 int32 of an AVX-512 register. */
+const int PADDED_POINTS = (NUM_POINTS + 15) / 16 * 16;
+
+bool ReadInt(std::istream &in, int &value) {
+  int32_t v;
+  if (!in.read(reinterpret_cast<char *>(&v), sizeof(v)))
+    return false;
+  value = v;
+  return true;
+}
+
+bool ReadFloats(std::istream &in, std::vector<float> &values) {
+  if (values.empty())
+    return true;
+  return static_cast<bool>(in.read(reinterpret_cast<char *>(&values[0]),
+                                   values.size() * sizeof(float)));
+}
+
+void WriteInt(std::ostream &out, int value) {
+  int32_t v = value;
+  out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+void WriteFloats(std::ostream &out, const std::vector<float> &values) {
+  if (!values.empty())
+    out.write(reinterpret_cast<const char *>(&values[0]),
+              values.size() * sizeof(float));
+}
+
+uint16_t FloatToHalf(float f) {
+#ifdef __F16C__
+  return _cvtss_sh(f, 0);
+#else
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  const uint32_t sign = (x >> 16) & 0x8000;
+  const int exponent = static_cast<int>((x >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = x & 0x7fffff;
+  if (exponent <= 0) {
+    if (exponent < -10)
+      return static_cast<uint16_t>(sign);
+    mantissa |= 0x800000;
+    const int shift = 14 - exponent;
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1)
+      ++half;
+    return static_cast<uint16_t>(sign | half);
+  }
+  if (exponent >= 31)
+    return static_cast<uint16_t>(sign | 0x7c00);
+  uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+  // A carry out of the mantissa correctly increments the exponent
+  if (mantissa & 0x1000)
+    ++half;
+  return static_cast<uint16_t>(half);
+#endif
+}
+
+float HalfToFloat(uint16_t h) {
+#ifdef __F16C__
+  return _cvtsh_ss(h);
+#else
+  const int exponent = (h >> 10) & 0x1f;
+  const uint32_t mantissa = h & 0x3ff;
+  float f;
+  if (exponent == 0)
+    f = std::ldexp(static_cast<float>(mantissa), -24);
+  else if (exponent == 31)
+    f = mantissa != 0 ? NAN : INFINITY;
+  else {
+    const uint32_t x = (static_cast<uint32_t>(exponent + 112) << 23) | (mantissa << 13);
+    std::memcpy(&f, &x, sizeof(f));
+  }
+  return (h & 0x8000) != 0 ? -f : f;
+#endif
+}
+
+inline float WeightValue(float w) {
+  return w;
+}
+
+inline float WeightValue(uint16_t w) {
+  return HalfToFloat(w);
+}
+
+/** out[r][p] = bias[r] + sum_j weights[r][j] * columns[j][p], p < NUM_POINTS.
+    Four rows at a time, so each row of columns is loaded once for four
+    outputs; the loop over the pixels is vectorized by the compiler. */
+template <typename W>
+void MatrixProduct(const W *weights, const float *bias, int rows,
+                   int depth, const float *columns, float *out) {
+  int r = 0;
+  for (; r + 4 <= rows; r += 4) {
+    float *o0 = out + r * NUM_POINTS;
+    float *o1 = o0 + NUM_POINTS;
+    float *o2 = o1 + NUM_POINTS;
+    float *o3 = o2 + NUM_POINTS;
+    std::fill(o0, o0 + NUM_POINTS, bias[r]);
+    std::fill(o1, o1 + NUM_POINTS, bias[r + 1]);
+    std::fill(o2, o2 + NUM_POINTS, bias[r + 2]);
+    std::fill(o3, o3 + NUM_POINTS, bias[r + 3]);
+    const W *w = weights + r * depth;
+    for (int j = 0; j < depth; ++j) {
+      const float w0 = WeightValue(w[j]);
+      const float w1 = WeightValue(w[depth + j]);
+      const float w2 = WeightValue(w[2 * depth + j]);
+      const float w3 = WeightValue(w[3 * depth + j]);
+      const float *c = columns + j * NUM_POINTS;
+      for (int p = 0; p < NUM_POINTS; ++p) {
+        const float v = c[p];
+        o0[p] += w0 * v;
+        o1[p] += w1 * v;
+        o2[p] += w2 * v;
+        o3[p] += w3 * v;
+      }
+    }
+  }
+  for (; r < rows; ++r) {
+    float *o = out + r * NUM_POINTS;
+    std::fill(o, o + NUM_POINTS, bias[r]);
+    const W *w = weights + r * depth;
+    for (int j = 0; j < depth; ++j) {
+      const float wj = WeightValue(w[j]);
+      const float *c = columns + j * NUM_POINTS;
+      for (int p = 0; p < NUM_POINTS; ++p)
+        o[p] += wj * c[p];
+    }
+  }
+}
+
+/** Sums of ROWS rows of int8 weights times the packed uint8 columns of
+    PackColumns(), for all PADDED_POINTS pixels. With AVX-512 VNNI or AVX2
+    one instruction multiplies and adds 4 inputs of 16 or 8 pixels. */
+template <int ROWS>
+void MatrixProductInt8Rows(const int8_t *weights, int paddedDepth,
+                           const uint8_t *packed, int32_t *out) {
+  const int quads = paddedDepth / 4;
+#if defined(__AVX512VNNI__) && defined(__AVX512F__)
+  for (int p = 0; p < PADDED_POINTS; p += 16) {
+    __m512i sums[ROWS];
+    for (int r = 0; r < ROWS; ++r)
+      sums[r] = _mm512_setzero_si512();
+    for (int q = 0; q < quads; ++q) {
+      const __m512i c = _mm512_loadu_si512(packed + (q * PADDED_POINTS + p) * 4);
+      for (int r = 0; r < ROWS; ++r) {
+        int32_t w;
+        std::memcpy(&w, weights + r * paddedDepth + 4 * q, sizeof(w));
+        sums[r] = _mm512_dpbusd_epi32(sums[r], c, _mm512_set1_epi32(w));
+      }
+    }
+    for (int r = 0; r < ROWS; ++r)
+      _mm512_storeu_si512(out + r * PADDED_POINTS + p, sums[r]);
+  }
+#elif defined(__AVX2__)
+  // maddubs does not saturate because the inputs are at most 127
+  const __m256i ones = _mm256_set1_epi16(1);
+  for (int p = 0; p < PADDED_POINTS; p += 8) {
+    __m256i sums[ROWS];
+    for (int r = 0; r < ROWS; ++r)
+      sums[r] = _mm256_setzero_si256();
+    for (int q = 0; q < quads; ++q) {
+      const __m256i c = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(packed + (q * PADDED_POINTS + p) * 4));
+      for (int r = 0; r < ROWS; ++r) {
+        int32_t w;
+        std::memcpy(&w, weights + r * paddedDepth + 4 * q, sizeof(w));
+        const __m256i products = _mm256_maddubs_epi16(c, _mm256_set1_epi32(w));
+        sums[r] = _mm256_add_epi32(sums[r], _mm256_madd_epi16(products, ones));
+      }
+    }
+    for (int r = 0; r < ROWS; ++r)
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + r * PADDED_POINTS + p), sums[r]);
+  }
+#else
+  for (int r = 0; r < ROWS; ++r)
+    std::fill(out + r * PADDED_POINTS, out + (r + 1) * PADDED_POINTS, 0);
+  for (int q = 0; q < quads; ++q)
+    for (int r = 0; r < ROWS; ++r) {
+      const int8_t *w = weights + r * paddedDepth + 4 * q;
+      const uint8_t *c = packed + q * PADDED_POINTS * 4;
+      int32_t *o = out + r * PADDED_POINTS;
+      for (int p = 0; p < PADDED_POINTS; ++p)
+        o[p] += w[0] * c[4 * p] + w[1] * c[4 * p + 1]
+                + w[2] * c[4 * p + 2] + w[3] * c[4 * p + 3];
+    }
+#endif
+}
+
+/** out[r][p] = sum_j weights[r][j] * column j of pixel p, four rows at a
+    time. Rows of out are PADDED_POINTS long. */
+void MatrixProductInt8(const int8_t *weights, int rows, int paddedDepth,
+                       const uint8_t *packed, int32_t *out) {
+  int r = 0;
+  for (; r + 4 <= rows; r += 4)
+    MatrixProductInt8Rows<4>(weights + r * paddedDepth, paddedDepth, packed,
+                             out + r * PADDED_POINTS);
+  for (; r < rows; ++r)
+    MatrixProductInt8Rows<1>(weights + r * paddedDepth, paddedDepth, packed,
+                             out + r * PADDED_POINTS);
+}
+
+/** The kernel x kernel patches of uint8 planes, as
+    packed[j / 4][pixel][j % 4] for the column j of a patch, so the 4
+    inputs that an instruction adds are adjacent. Zero outside the board
+    and in the padding. */
+void PackColumns(const uint8_t *in, int channels, int kernel, int paddedDepth,
+                 uint8_t *packed) {
+  std::fill(packed, packed + paddedDepth * PADDED_POINTS, 0);
+  const int half = kernel / 2;
+  for (int c = 0; c < channels; ++c) {
+    const uint8_t *plane = in + c * NUM_POINTS;
+    for (int ky = 0; ky < kernel; ++ky)
+      for (int kx = 0; kx < kernel; ++kx) {
+        const int j = (c * kernel + ky) * kernel + kx;
+        uint8_t *dst = packed + (j / 4) * PADDED_POINTS * 4 + j % 4;
+        for (int y = 0; y < BD_SIZE; ++y) {
+          const int sy = y + ky - half;
+          if (sy < 0 || sy >= BD_SIZE)
+            continue;
+          for (int x = 0; x < BD_SIZE; ++x) {
+            const int sx = x + kx - half;
+            if (sx >= 0 && sx < BD_SIZE)
+              dst[(y * BD_SIZE + x) * 4] = plane[sy * BD_SIZE + sx];
+          }
+        }
+      }
+  }
+}
+
+/** Rows of the 3x3 patches of all channels, zero outside the board. */
+void Im2Col3x3(const float *in, int channels, float *columns) {
+  for (int c = 0; c < channels; ++c) {
+    const float *plane = in + c * NUM_POINTS;
+    for (int ky = 0; ky < 3; ++ky)
+      for (int kx = 0; kx < 3; ++kx) {
+        float *row = columns + ((c * 3 + ky) * 3 + kx) * NUM_POINTS;
+        for (int y = 0; y < BD_SIZE; ++y) {
+          const int sy = y + ky - 1;
+          float *dst = row + y * BD_SIZE;
+          if (sy < 0 || sy >= BD_SIZE) {
+            std::fill(dst, dst + BD_SIZE, 0.0f);
+            continue;
+          }
+          const float *src = plane + sy * BD_SIZE;
+          for (int x = 0; x < BD_SIZE; ++x) {
+            const int sx = x + kx - 1;
+            dst[x] = (sx < 0 || sx >= BD_SIZE) ? 0.0f : src[sx];
+          }
+        }
+      }
+  }
+}
+
+int ArgMax(const double *values, int n) {
+  return static_cast<int>(std::max_element(values, values + n) - values);
+}
+
+float Dot(const float *a, const float *b, int n) {
+  float sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+}
+
+void DlCpuNetworkWeights::Conv::Resize(int in, int out, int kernel) {
+  m_in = in;
+  m_out = out;
+  m_kernel = kernel;
+  m_weights.assign(out * in * kernel * kernel, 0.0f);
+  m_bias.assign(out, 0.0f);
+  m_mean.assign(out, 0.0f);
+  m_variance.assign(out, 1.0f);
+  m_gamma.assign(out, 1.0f);
+  m_beta.assign(out, 0.0f);
+}
+
+DlCpuNetworkWeights::DlCpuNetworkWeights() :
+    m_boardSize(BD_SIZE),
+    m_inputPlanes(NUM_MAPS),
+    m_filters(0),
+    m_blocks(0),
+    m_policyFilters(0),
+    m_valueFilters(0),
+    m_valueHidden(0),
+    m_bnEpsilon(1e-5f),
+    m_valueBias2(0) {}
+
+void DlCpuNetworkWeights::Resize(int filters, int blocks, int policyFilters,
+                                 int valueFilters, int valueHidden) {
+  m_filters = filters;
+  m_blocks = blocks;
+  m_policyFilters = policyFilters;
+  m_valueFilters = valueFilters;
+  m_valueHidden = valueHidden;
+  const int points = m_boardSize * m_boardSize;
+  m_convs.resize(2 * blocks + 3);
+  m_convs[0].Resize(m_inputPlanes, filters, 3);
+  for (int i = 1; i <= 2 * blocks; ++i)
+    m_convs[i].Resize(filters, filters, 3);
+  m_convs[2 * blocks + 1].Resize(filters, policyFilters, 1);
+  m_convs[2 * blocks + 2].Resize(filters, valueFilters, 1);
+  m_policyWeights.assign(GO_MAX_MOVES * policyFilters * points, 0.0f);
+  m_policyBias.assign(GO_MAX_MOVES, 0.0f);
+  m_valueWeights1.assign(valueHidden * valueFilters * points, 0.0f);
+  m_valueBias1.assign(valueHidden, 0.0f);
+  m_valueWeights2.assign(valueHidden, 0.0f);
+  m_valueBias2 = 0;
+}
+
+const DlCpuNetworkWeights::Conv &DlCpuNetworkWeights::PolicyConv() const {
+  return m_convs[2 * m_blocks + 1];
+}
+
+const DlCpuNetworkWeights::Conv &DlCpuNetworkWeights::ValueConv() const {
+  return m_convs[2 * m_blocks + 2];
+}
+
+bool DlCpuNetworkWeights::Read(const std::string &path) {
+  std::ifstream in(path.c_str(), std::ios::binary);
+  char magic[4];
+  int version;
+  if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(magic)) != 0
+      || !ReadInt(in, version) || version != VERSION)
+    return false;
+  int filters, blocks, policyFilters, valueFilters, valueHidden;
+  if (!ReadInt(in, m_boardSize) || !ReadInt(in, m_inputPlanes)
+      || !ReadInt(in, filters) || !ReadInt(in, blocks)
+      || !ReadInt(in, policyFilters) || !ReadInt(in, valueFilters)
+      || !ReadInt(in, valueHidden)
+      || !in.read(reinterpret_cast<char *>(&m_bnEpsilon), sizeof(float)))
+    return false;
+  if (m_boardSize < 1 || m_inputPlanes < 1 || filters < 1 || blocks < 0
+      || policyFilters < 1 || valueFilters < 1 || valueHidden < 1
+      || m_boardSize * m_boardSize + 1 != GO_MAX_MOVES)
+    return false;
+  Resize(filters, blocks, policyFilters, valueFilters, valueHidden);
+  for (Conv &conv : m_convs)
+    if (!ReadFloats(in, conv.m_weights) || !ReadFloats(in, conv.m_bias)
+        || !ReadFloats(in, conv.m_mean) || !ReadFloats(in, conv.m_variance)
+        || !ReadFloats(in, conv.m_gamma) || !ReadFloats(in, conv.m_beta))
+      return false;
+  if (!ReadFloats(in, m_policyWeights) || !ReadFloats(in, m_policyBias)
+      || !ReadFloats(in, m_valueWeights1) || !ReadFloats(in, m_valueBias1)
+      || !ReadFloats(in, m_valueWeights2)
+      || !in.read(reinterpret_cast<char *>(&m_valueBias2), sizeof(float)))
+    return false;
+  // A longer file is an export of another shape
+  return in.peek() == std::char_traits<char>::eof();
+}
+
+bool DlCpuNetworkWeights::Write(const std::string &path) const {
+  std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(MAGIC, sizeof(MAGIC));
+  WriteInt(out, VERSION);
+  WriteInt(out, m_boardSize);
+  WriteInt(out, m_inputPlanes);
+  WriteInt(out, m_filters);
+  WriteInt(out, m_blocks);
+  WriteInt(out, m_policyFilters);
+  WriteInt(out, m_valueFilters);
+  WriteInt(out, m_valueHidden);
+  out.write(reinterpret_cast<const char *>(&m_bnEpsilon), sizeof(float));
+  for (const Conv &conv : m_convs) {
+    WriteFloats(out, conv.m_weights);
+    WriteFloats(out, conv.m_bias);
+    WriteFloats(out, conv.m_mean);
+    WriteFloats(out, conv.m_variance);
+    WriteFloats(out, conv.m_gamma);
+    WriteFloats(out, conv.m_beta);
+  }
+  WriteFloats(out, m_policyWeights);
+  WriteFloats(out, m_policyBias);
+  WriteFloats(out, m_valueWeights1);
+  WriteFloats(out, m_valueBias1);
+  WriteFloats(out, m_valueWeights2);
+  out.write(reinterpret_cast<const char *>(&m_valueBias2), sizeof(float));
+  return static_cast<bool>(out.flush());
+}
+
+DlAccuracyReport::DlAccuracyReport() :
+    m_positions(0),
+    m_policyTop1Agreement(0),
+    m_valueMse(0),
+    m_fp32Seconds(0),
+    m_seconds(0) {}
+
+std::ostream &operator<<(std::ostream &out, const DlAccuracyReport &report) {
+  out << "positions " << report.m_positions
+      << " policy top-1 agreement " << report.m_policyTop1Agreement
+      << " value MSE " << report.m_valueMse;
+  if (report.m_seconds > 0)
+    out << " speedup " << report.m_fp32Seconds / report.m_seconds;
+  return out;
+}
+
+DlCpuNetworkEvaluator::Scratch::Scratch() :
+    m_layerMax(nullptr) {}
+
+DlCpuNetworkEvaluator::DlCpuNetworkEvaluator(int numThreads, Precision precision) :
+    m_numThreads(std::max(1, std::min(numThreads, MAX_BATCHES))),
+    m_precision(precision),
+    m_graphLoaded(false),
+    m_inputPlanes(0),
+    m_filters(0),
+    m_blocks(0),
+    m_valueHidden(0),
+    m_valueBias2(0),
+    m_scratch(m_numThreads),
+    m_jobFeature(nullptr),
+    m_jobActions(nullptr),
+    m_jobValue(nullptr),
+    m_jobBatches(0),
+    m_jobThreads(0),
+    m_quit(false),
+    m_startWork(static_cast<unsigned int>(m_numThreads)),
+    m_workFinished(static_cast<unsigned int>(m_numThreads)) {
+  for (int t = 1; t < m_numThreads; ++t)
+    m_workers.create_thread(boost::bind(&DlCpuNetworkEvaluator::WorkerLoop, this, t));
+}
+
+DlCpuNetworkEvaluator::~DlCpuNetworkEvaluator() {
+  if (m_numThreads > 1) {
+    m_quit = true;
+    m_startWork.wait();
+    m_workers.join_all();
+  }
+}
+
+void DlCpuNetworkEvaluator::SetWeights(const DlCpuNetworkWeights &weights) {
+  m_inputPlanes = weights.m_inputPlanes;
+  m_filters = weights.m_filters;
+  m_blocks = weights.m_blocks;
+  m_valueHidden = weights.m_valueHidden;
+  // y = gamma * (conv + bias - mean) / sqrt(variance + eps) + beta
+  m_layers.resize(weights.m_convs.size());
+  for (size_t i = 0; i < weights.m_convs.size(); ++i) {
+    const DlCpuNetworkWeights::Conv &conv = weights.m_convs[i];
+    Layer &layer = m_layers[i];
+    layer.m_in = conv.m_in;
+    layer.m_out = conv.m_out;
+    layer.m_kernel = conv.m_kernel;
+    layer.m_weights = conv.m_weights;
+    layer.m_bias.resize(conv.m_out);
+    layer.m_inputScale = 0;
+    layer.m_paddedDepth = 0;
+    const int depth = conv.m_in * conv.m_kernel * conv.m_kernel;
+    for (int o = 0; o < conv.m_out; ++o) {
+      const float scale = conv.m_gamma[o]
+                          / std::sqrt(conv.m_variance[o] + weights.m_bnEpsilon);
+      for (int j = 0; j < depth; ++j)
+        layer.m_weights[o * depth + j] *= scale;
+      layer.m_bias[o] = (conv.m_bias[o] - conv.m_mean[o]) * scale + conv.m_beta[o];
+    }
+  }
+  m_policyWeights = weights.m_policyWeights;
+  m_policyBias = weights.m_policyBias;
+  m_valueWeights1 = weights.m_valueWeights1;
+  m_valueBias1 = weights.m_valueBias1;
+  m_valueWeights2 = weights.m_valueWeights2;
+  m_valueBias2 = weights.m_valueBias2;
+  Quantize();
+  m_graphLoaded = true;
+}
+
+bool DlCpuNetworkEvaluator::HasWeights() const {
+  return !m_layers.empty();
+}
+
+DlCpuNetworkEvaluator::Precision DlCpuNetworkEvaluator::GetPrecision() const {
+  return m_precision;
+}
+
+void DlCpuNetworkEvaluator::SetPrecision(Precision precision) {
+  m_precision = precision;
+  Quantize();
+}
+
+bool DlCpuNetworkEvaluator::ParsePrecision(const std::string &name, Precision &precision) {
+  if (name == "fp32")
+    precision = PRECISION_FP32;
+  else if (name == "fp16")
+    precision = PRECISION_FP16;
+  else if (name == "int8")
+    precision = PRECISION_INT8;
+  else
+    return false;
+  return true;
+}
+
+void DlCpuNetworkEvaluator::Quantize() {
+  for (Layer &layer : m_layers) {
+    layer.m_halfWeights.clear();
+    layer.m_int8Weights.clear();
+    layer.m_weightScales.clear();
+    if (m_precision == PRECISION_FP16) {
+      layer.m_halfWeights.resize(layer.m_weights.size());
+      std::transform(layer.m_weights.begin(), layer.m_weights.end(),
+                     layer.m_halfWeights.begin(), FloatToHalf);
+    } else if (m_precision == PRECISION_INT8) {
+      // Symmetric, one scale per output channel, rows padded to a
+      // multiple of 4
+      const int depth = layer.m_in * layer.m_kernel * layer.m_kernel;
+      layer.m_paddedDepth = (depth + 3) / 4 * 4;
+      layer.m_int8Weights.assign(layer.m_out * layer.m_paddedDepth, 0);
+      layer.m_weightScales.resize(layer.m_out);
+      for (int o = 0; o < layer.m_out; ++o) {
+        const float *w = &layer.m_weights[o * depth];
+        float maxAbs = 0;
+        for (int j = 0; j < depth; ++j)
+          maxAbs = std::max(maxAbs, std::fabs(w[j]));
+        const float scale = maxAbs > 0 ? maxAbs / 127 : 1;
+        layer.m_weightScales[o] = scale;
+        for (int j = 0; j < depth; ++j)
+          layer.m_int8Weights[o * layer.m_paddedDepth + j] =
+              static_cast<int8_t>(std::max(-127.0f, std::min(127.0f, std::round(w[j] / scale))));
+      }
+    }
+  }
+}
+
+void DlCpuNetworkEvaluator::SetCalibrationSamples(const std::vector<DlTrainingExample> &samples) {
+  m_calibration = samples;
+}
+
+bool DlCpuNetworkEvaluator::ReadCalibrationSamples(const std::string &shard,
+                                                   std::size_t maxPositions,
+                                                   std::vector<DlTrainingExample> &samples) {
+  DlShardReader reader(shard);
+  if (!reader.IsOpen())
+    return false;
+  const char *data;
+  std::size_t size;
+  DlTrainingExample example;
+  while (samples.size() < maxPositions && reader.Next(data, size))
+    if (DlExampleCodec::Decode(data, size, example))
+      samples.push_back(example);
+  return !samples.empty();
+}
+
+void DlCpuNetworkEvaluator::Calibrate(const std::vector<DlTrainingExample> &samples) {
+  if (!HasWeights() || samples.empty())
+    return;
+  std::vector<float> maxima(m_layers.size(), 0.0f);
+  Scratch &scratch = m_scratch[0];
+  scratch.m_layerMax = &maxima;
+  double policy[GO_MAX_MOVES];
+  double value;
+  for (const DlTrainingExample &sample : samples)
+    Forward(sample.feature, policy, value, PRECISION_FP32, scratch);
+  scratch.m_layerMax = nullptr;
+  for (size_t i = 0; i < m_layers.size(); ++i)
+    m_layers[i].m_inputScale = maxima[i] > 0 ? maxima[i] / 127 : 0;
+}
+
+DlAccuracyReport DlCpuNetworkEvaluator::AccuracyReport(const std::vector<DlTrainingExample> &samples) {
+  typedef std::chrono::steady_clock Clock;
+  DlAccuracyReport report;
+  if (!HasWeights())
+    return report;
+  Scratch &scratch = m_scratch[0];
+  double referencePolicy[GO_MAX_MOVES];
+  double policy[GO_MAX_MOVES];
+  double referenceValue;
+  double value;
+  int agree = 0;
+  for (const DlTrainingExample &sample : samples) {
+    const Clock::time_point start = Clock::now();
+    Forward(sample.feature, referencePolicy, referenceValue, PRECISION_FP32, scratch);
+    const Clock::time_point middle = Clock::now();
+    Forward(sample.feature, policy, value, m_precision, scratch);
+    const Clock::time_point end = Clock::now();
+    report.m_fp32Seconds += std::chrono::duration<double>(middle - start).count();
+    report.m_seconds += std::chrono::duration<double>(end - middle).count();
+    if (ArgMax(referencePolicy, GO_MAX_MOVES) == ArgMax(policy, GO_MAX_MOVES))
+      ++agree;
+    report.m_valueMse += (value - referenceValue) * (value - referenceValue);
+    ++report.m_positions;
+  }
+  if (report.m_positions > 0) {
+    report.m_policyTop1Agreement = static_cast<double>(agree) / report.m_positions;
+    report.m_valueMse /= report.m_positions;
+  }
+  return report;
+}
+
+std::string DlCpuNetworkEvaluator::WeightsPath(const std::string &checkpointPath) {
+  const std::string suffix = ".ugw";
+  if (checkpointPath.size() >= suffix.size()
+      && checkpointPath.compare(checkpointPath.size() - suffix.size(),
+                                suffix.size(), suffix) == 0)
+    return checkpointPath;
+  return checkpointPath + suffix;
+}
+
+bool DlCpuNetworkEvaluator::LoadGraph(const std::string &) {
+  m_graphLoaded = true;
+  return true;
+}
+
+bool DlCpuNetworkEvaluator::UpdateCheckPoint(const std::string &checkpointPath) {
+  DlCpuNetworkWeights weights;
+  const std::string path = WeightsPath(checkpointPath);
+  if (!weights.Read(path)) {
+    std::cerr << "DlCpuNetworkEvaluator: cannot read weights " << path << '\n';
+    return false;
+  }
+  if (weights.m_boardSize != BD_SIZE || weights.m_inputPlanes != NUM_MAPS) {
+    std::cerr << "DlCpuNetworkEvaluator: weights " << path
+              << " are for another board size or input\n";
+    return false;
+  }
+  SetWeights(weights);
+  if (m_precision != PRECISION_FP32 && !m_calibration.empty()) {
+    if (m_precision == PRECISION_INT8)
+      Calibrate(m_calibration);
+    std::cerr << "DlCpuNetworkEvaluator: " << (m_precision == PRECISION_INT8 ? "int8" : "fp16")
+              << " against fp32: " << AccuracyReport(m_calibration) << '\n';
+  }
+  return true;
+}
+
+bool DlCpuNetworkEvaluator::MetaGraphLoaded() {
+  return m_graphLoaded;
+}
+
+void DlCpuNetworkEvaluator::Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                                     double actions_[][GO_MAX_MOVES],
+                                     double value_[], int numBatches) {
+  if (!HasWeights())
+    throw std::runtime_error("DlCpuNetworkEvaluator: no weights loaded");
+  m_jobFeature = feature;
+  m_jobActions = actions_;
+  m_jobValue = value_;
+  m_jobBatches = numBatches;
+  m_jobThreads = std::min(m_numThreads, numBatches);
+  if (m_jobThreads <= 1)
+    EvaluateSlice(0);
+  else {
+    m_startWork.wait();
+    EvaluateSlice(0);
+    m_workFinished.wait();
+  }
+  switch (DlConfig::GetInstance().get_value_transform()) {
+    case TR_FLIP_SIGN:
+      for (int i = 0; i < numBatches; ++i)
+        value_[i] = -value_[i];
+      break;
+    case TR_FLIP_PROB:
+      for (int i = 0; i < numBatches; ++i)
+        value_[i] = 1 - value_[i];
+      break;
+    default:
+      break;
+  }
+}
+
+void DlCpuNetworkEvaluator::WorkerLoop(int threadId) {
+  while (true) {
+    m_startWork.wait();
+    if (m_quit)
+      break;
+    EvaluateSlice(threadId);
+    m_workFinished.wait();
+  }
+}
+
+void DlCpuNetworkEvaluator::EvaluateSlice(int threadId) {
+  if (threadId >= m_jobThreads)
+    return;
+  const int begin = m_jobBatches * threadId / m_jobThreads;
+  const int end = m_jobBatches * (threadId + 1) / m_jobThreads;
+  EvaluateRange(m_jobFeature, m_jobActions, m_jobValue, begin, end,
+                m_precision, m_scratch[threadId]);
+}
+
+void DlCpuNetworkEvaluator::EvaluateRange(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                                          double actions_[][GO_MAX_MOVES],
+                                          double value_[], int begin, int end,
+                                          Precision precision, Scratch &scratch) const {
+  for (int i = begin; i < end; ++i)
+    Forward(feature[i], actions_[i], value_[i], precision, scratch);
+}
+
+void DlCpuNetworkEvaluator::Forward(const char feature[NUM_MAPS][BD_SIZE][BD_SIZE],
+                                    double actions_[GO_MAX_MOVES], double &value,
+                                    Precision precision, Scratch &scratch) const {
+  const int channels = std::max(m_inputPlanes, m_filters);
+  scratch.m_input.resize(m_inputPlanes * NUM_POINTS);
+  scratch.m_columns.resize(channels * 9 * NUM_POINTS);
+  scratch.m_a.resize(channels * NUM_POINTS);
+  scratch.m_b.resize(channels * NUM_POINTS);
+  scratch.m_c.resize(channels * NUM_POINTS);
+
+  float *input = &scratch.m_input[0];
+  for (int c = 0; c < m_inputPlanes; ++c)
+    for (int y = 0; y < BD_SIZE; ++y)
+      for (int x = 0; x < BD_SIZE; ++x)
+        input[(c * BD_SIZE + y) * BD_SIZE + x] = feature[c][y][x] != 0 ? 1.0f : 0.0f;
+
+  float *a = &scratch.m_a[0];
+  float *b = &scratch.m_b[0];
+  float *c = &scratch.m_c[0];
+  Convolve(m_layers[0], input, a, nullptr, precision, scratch);
+  for (int i = 0; i < m_blocks; ++i) {
+    Convolve(m_layers[2 * i + 1], a, b, nullptr, precision, scratch);
+    Convolve(m_layers[2 * i + 2], b, c, a, precision, scratch);
+    std::swap(a, c);
+  }
+
+  const Layer &policy = m_layers[2 * m_blocks + 1];
+  Convolve(policy, a, b, nullptr, precision, scratch);
+  const int policySize = policy.m_out * NUM_POINTS;
+  double maxLogit = -1e30;
+  for (int m = 0; m < GO_MAX_MOVES; ++m) {
+    actions_[m] = m_policyBias[m] + Dot(&m_policyWeights[m * policySize], b, policySize);
+    maxLogit = std::max(maxLogit, actions_[m]);
+  }
+  double sum = 0;
+  for (int m = 0; m < GO_MAX_MOVES; ++m) {
+    actions_[m] = std::exp(actions_[m] - maxLogit);
+    sum += actions_[m];
+  }
+  for (int m = 0; m < GO_MAX_MOVES; ++m)
+    actions_[m] /= sum;
+
+  const Layer &valueLayer = m_layers[2 * m_blocks + 2];
+  Convolve(valueLayer, a, b, nullptr, precision, scratch);
+  const int valueSize = valueLayer.m_out * NUM_POINTS;
+  float out = m_valueBias2;
+  for (int h = 0; h < m_valueHidden; ++h) {
+    const float hidden = m_valueBias1[h] + Dot(&m_valueWeights1[h * valueSize], b, valueSize);
+    out += m_valueWeights2[h] * std::max(hidden, 0.0f);
+  }
+  value = std::tanh(out);
+}
+
+void DlCpuNetworkEvaluator::Convolve(const Layer &layer, const float *in, float *out,
+                                     const float *residual, Precision precision,
+                                     Scratch &scratch) const {
+  const int inSize = layer.m_in * NUM_POINTS;
+  if (scratch.m_layerMax) {
+    float &maximum = (*scratch.m_layerMax)[&layer - &m_layers[0]];
+    maximum = std::max(maximum, *std::max_element(in, in + inSize));
+  }
+  const int depth = layer.m_in * layer.m_kernel * layer.m_kernel;
+  if (precision == PRECISION_INT8 && !layer.m_int8Weights.empty())
+    ConvolveInt8(layer, in, out, scratch);
+  else {
+    const float *columns = in;
+    if (layer.m_kernel == 3) {
+      Im2Col3x3(in, layer.m_in, &scratch.m_columns[0]);
+      columns = &scratch.m_columns[0];
+    }
+    if (precision == PRECISION_FP16 && !layer.m_halfWeights.empty())
+      MatrixProduct(&layer.m_halfWeights[0], &layer.m_bias[0], layer.m_out,
+                    depth, columns, out);
+    else
+      MatrixProduct(&layer.m_weights[0], &layer.m_bias[0], layer.m_out,
+                    depth, columns, out);
+  }
+  const int size = layer.m_out * NUM_POINTS;
+  if (residual)
+    for (int i = 0; i < size; ++i)
+      out[i] = std::max(out[i] + residual[i], 0.0f);
+  else
+    for (int i = 0; i < size; ++i)
+      out[i] = std::max(out[i], 0.0f);
+}
+
+void DlCpuNetworkEvaluator::ConvolveInt8(const Layer &layer, const float *in, float *out,
+                                         Scratch &scratch) const {
+  // All inputs are features or outputs of a ReLU, so they are quantized to
+  // 0..127, which keeps the pairwise sums of AVX2 in int16
+  const int inSize = layer.m_in * NUM_POINTS;
+  float scale = layer.m_inputScale;
+  if (scale <= 0) {
+    const float maximum = *std::max_element(in, in + inSize);
+    scale = maximum > 0 ? maximum / 127 : 1;
+  }
+  const float inverse = 1 / scale;
+  scratch.m_quantInput.resize(inSize);
+  for (int i = 0; i < inSize; ++i)
+    scratch.m_quantInput[i] = static_cast<uint8_t>(std::min(127.0f, in[i] * inverse + 0.5f));
+  scratch.m_quantColumns.resize(layer.m_paddedDepth * PADDED_POINTS);
+  PackColumns(&scratch.m_quantInput[0], layer.m_in, layer.m_kernel,
+              layer.m_paddedDepth, &scratch.m_quantColumns[0]);
+  scratch.m_accumulators.resize(layer.m_out * PADDED_POINTS);
+  int32_t *sums = &scratch.m_accumulators[0];
+  MatrixProductInt8(&layer.m_int8Weights[0], layer.m_out, layer.m_paddedDepth,
+                    &scratch.m_quantColumns[0], sums);
+  for (int o = 0; o < layer.m_out; ++o) {
+    const float factor = layer.m_weightScales[o] * scale;
+    const float bias = layer.m_bias[o];
+    for (int p = 0; p < NUM_POINTS; ++p)
+      out[o * NUM_POINTS + p] = sums[o * PADDED_POINTS + p] * factor + bias;
+  }
+}
@@ -0,0 +1,242 @@
+
+#ifndef DL_CPU_NETWORKEVALUATOR_H
+#define DL_CPU_NETWORKEVALUATOR_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+#include "funcapproximator/DlNetworkEvaluator.h"
+#include "funcapproximator/DlReplayBuffer.h"
+
+/** Weights of the residual policy and value network.
+    The tower is a 3x3 convolution of the input planes followed by residual
+    blocks of two 3x3 convolutions; every convolution is followed by batch
+    normalization and ReLU, the second one of a block adds the input of the
+    block before the ReLU. The policy head is a 1x1 convolution, batch
+    normalization, ReLU and a fully connected layer to GO_MAX_MOVES logits.
+    The value head is a 1x1 convolution, batch normalization, ReLU, a fully
+    connected hidden layer with ReLU and a fully connected layer to one
+    output with tanh.
+
+    Binary export, all numbers little endian, int32 or float32:
+    @verbatim
+    "UGNW" version=1
+    boardSize inputPlanes filters blocks policyFilters valueFilters valueHidden
+    bnEpsilon
+    convolution layers: input, the two of each block, policy, value
+        weights[out][in][k][k] bias[out] mean[out] variance[out] gamma[out] beta[out]
+    policy fc: weights[GO_MAX_MOVES][policyFilters * boardSize^2] bias[GO_MAX_MOVES]
+    value fc1: weights[valueHidden][valueFilters * boardSize^2] bias[valueHidden]
+    value fc2: weights[valueHidden] bias[1]
+    @endverbatim
+    The order of the pixels of the fully connected layers is channel, row,
+    column. Batch normalization is folded into the convolution weights at
+    load time. */
+struct DlCpuNetworkWeights {
+  /** Convolution with its batch normalization, as exported. */
+  struct Conv {
+    int m_in;
+    int m_out;
+    int m_kernel;
+    std::vector<float> m_weights;
+    std::vector<float> m_bias;
+    std::vector<float> m_mean;
+    std::vector<float> m_variance;
+    std::vector<float> m_gamma;
+    std::vector<float> m_beta;
+
+    void Resize(int in, int out, int kernel);
+  };
+
+  int m_boardSize;
+  int m_inputPlanes;
+  int m_filters;
+  int m_blocks;
+  int m_policyFilters;
+  int m_valueFilters;
+  int m_valueHidden;
+  float m_bnEpsilon;
+  /** Input convolution, then two per block, then policy and value. */
+  std::vector<Conv> m_convs;
+  std::vector<float> m_policyWeights;
+  std::vector<float> m_policyBias;
+  std::vector<float> m_valueWeights1;
+  std::vector<float> m_valueBias1;
+  std::vector<float> m_valueWeights2;
+  float m_valueBias2;
+
+  DlCpuNetworkWeights();
+  /** Allocate all layers for the given shape. */
+  void Resize(int filters, int blocks, int policyFilters = 2,
+              int valueFilters = 1, int valueHidden = 256);
+  const Conv &PolicyConv() const;
+  const Conv &ValueConv() const;
+  bool Read(const std::string &path);
+  bool Write(const std::string &path) const;
+};
+
+/** Agreement of a quantized network with the FP32 network on the same
+    positions. */
+struct DlAccuracyReport {
+  DlAccuracyReport();
+  int m_positions;
+  /** Fraction of positions where both choose the same most probable move. */
+  double m_policyTop1Agreement;
+  double m_valueMse;
+  double m_fp32Seconds;
+  double m_seconds;
+};
+
+std::ostream &operator<<(std::ostream &out, const DlAccuracyReport &report);
+
+/** Evaluates the network of DlCpuNetworkWeights on the CPU, without
+    TensorFlow.
+    Convolutions are im2col followed by a matrix product over the pixels,
+    with batch normalization folded into the weights and biases. The
+    positions of a batch are split over the calling thread and
+    numThreads - 1 worker threads, which live as long as the evaluator.
+    The convolutions can run with quantized weights: FP16 stores the
+    weights as half floats (converted with F16C where the compiler targets
+    it), INT8 stores them as int8 with a scale per output channel and
+    quantizes the inputs of each convolution to 0..127, multiplied with
+    AVX-512 VNNI or AVX2 where the compiler targets them. The scales of the
+    inputs come from Calibrate(); without calibration they are computed
+    for each position. The fully connected layers of the heads stay
+    FP32. */
+class DlCpuNetworkEvaluator : public DlNetworkEvaluator {
+ public:
+  enum Precision {
+    PRECISION_FP32,
+    PRECISION_FP16,
+    PRECISION_INT8
+  };
+
+  explicit DlCpuNetworkEvaluator(int numThreads = 1,
+                                 Precision precision = PRECISION_FP32);
+  virtual ~DlCpuNetworkEvaluator();
+
+  void SetWeights(const DlCpuNetworkWeights &weights);
+  bool HasWeights() const;
+
+  Precision GetPrecision() const;
+  void SetPrecision(Precision precision);
+  /** "fp32", "fp16" or "int8"; false for anything else. */
+  static bool ParsePrecision(const std::string &name, Precision &precision);
+
+  /** Positions that UpdateCheckPoint() calibrates the INT8 network with and
+      compares a quantized network with the FP32 one on. The report is
+      written to std::cerr. */
+  void SetCalibrationSamples(const std::vector<DlTrainingExample> &samples);
+  /** Read up to maxPositions positions of a TFRecord shard of self-play
+      games. */
+  static bool ReadCalibrationSamples(const std::string &shard,
+                                     std::size_t maxPositions,
+                                     std::vector<DlTrainingExample> &samples);
+  /** Set the input scales of the INT8 convolutions to the largest inputs
+      of the FP32 network on the samples. */
+  void Calibrate(const std::vector<DlTrainingExample> &samples);
+  /** Compare the current precision with FP32 on the samples. Not
+      concurrently with Evaluate(). */
+  DlAccuracyReport AccuracyReport(const std::vector<DlTrainingExample> &samples);
+
+  /** Throws std::runtime_error if no weights are set. Not concurrently
+      with itself. */
+  virtual void Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                        double actions_[][GO_MAX_MOVES],
+                        double value_[],
+                        int numBatches = MAX_BATCHES);
+  /** Nothing to do, the network is described by the weights. */
+  virtual bool LoadGraph(const std::string &graphPath);
+  /** Load the weights of checkpointPath + ".ugw", or of checkpointPath if it
+      already ends in ".ugw". */
+  virtual bool UpdateCheckPoint(const std::string &checkpointPath);
+  virtual bool MetaGraphLoaded();
+
+  static std::string WeightsPath(const std::string &checkpointPath);
+
+ private:
+  /** Folded convolution: weights[out][in * k * k] and bias[out], and the
+      weights of the quantized precisions. */
+  struct Layer {
+    int m_in;
+    int m_out;
+    int m_kernel;
+    std::vector<float> m_weights;
+    std::vector<float> m_bias;
+    std::vector<uint16_t> m_halfWeights;
+    /** Rows of m_paddedDepth int8 weights. */
+    std::vector<int8_t> m_int8Weights;
+    int m_paddedDepth;
+    /** Scale of the int8 weights of each output channel. */
+    std::vector<float> m_weightScales;
+    /** Scale of the uint8 inputs, 0 if not calibrated. */
+    float m_inputScale;
+  };
+
+  /** Buffers of one thread. */
+  struct Scratch {
+    Scratch();
+    std::vector<float> m_input;
+    std::vector<float> m_columns;
+    std::vector<float> m_a;
+    std::vector<float> m_b;
+    std::vector<float> m_c;
+    std::vector<uint8_t> m_quantInput;
+    std::vector<uint8_t> m_quantColumns;
+    std::vector<int32_t> m_accumulators;
+    /** Largest input of each convolution, while calibrating. */
+    std::vector<float> *m_layerMax;
+  };
+
+  int m_numThreads;
+  Precision m_precision;
+  bool m_graphLoaded;
+  int m_inputPlanes;
+  int m_filters;
+  int m_blocks;
+  int m_valueHidden;
+  std::vector<Layer> m_layers;
+  std::vector<float> m_policyWeights;
+  std::vector<float> m_policyBias;
+  std::vector<float> m_valueWeights1;
+  std::vector<float> m_valueBias1;
+  std::vector<float> m_valueWeights2;
+  float m_valueBias2;
+  std::vector<Scratch> m_scratch;
+  std::vector<DlTrainingExample> m_calibration;
+
+  /** Batch that the workers evaluate, set by Evaluate(). */
+  char (*m_jobFeature)[NUM_MAPS][BD_SIZE][BD_SIZE];
+  double (*m_jobActions)[GO_MAX_MOVES];
+  double *m_jobValue;
+  int m_jobBatches;
+  int m_jobThreads;
+  bool m_quit;
+  boost::barrier m_startWork;
+  boost::barrier m_workFinished;
+  boost::thread_group m_workers;
+
+  void WorkerLoop(int threadId);
+  /** Positions of the batch of the current job that thread threadId
+      evaluates. */
+  void EvaluateSlice(int threadId);
+
+  void Quantize();
+  void EvaluateRange(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                     double actions_[][GO_MAX_MOVES], double value_[],
+                     int begin, int end, Precision precision,
+                     Scratch &scratch) const;
+  void Forward(const char feature[NUM_MAPS][BD_SIZE][BD_SIZE],
+               double actions_[GO_MAX_MOVES], double &value,
+               Precision precision, Scratch &scratch) const;
+  void Convolve(const Layer &layer, const float *in, float *out,
+                const float *residual, Precision precision,
+                Scratch &scratch) const;
+  void ConvolveInt8(const Layer &layer, const float *in, float *out,
+                    Scratch &scratch) const;
+};
+
+#endif //DL_CPU_NETWORKEVALUATOR_H
@@ -5,6 +5,12 @@
 #include <tensorflow/core/graph/graph_def_builder.h>
 #include <deque>
 #include <tensorflow/core/graph/algorithm.h>
+#include <tensorflow/core/framework/tensor.h>
+#include <tensorflow/core/public/session.h>
+#include <cmath>
+#include <map>
+#include <set>
+#include <unordered_map>
 #include "DlGraphUtil.h"
 
 using namespace tensorflow;
@@ -451,4 +457,382 @@ void ChangeDevice(const GraphDef& graphDef, const std::string& match, const std:
   }
 }
 
+namespace {
+
+/** Input of a NodeDef: "node", "node:slot" or "^node" for a control
+    dependency. */
+struct InputRef {
+  std::string node;
+  int slot;
+  bool control;
+};
+
+InputRef ParseInput(const std::string& input) {
+  InputRef ref;
+  ref.control = !input.empty() && input[0] == '^';
+  ref.node = ref.control ? input.substr(1) : input;
+  ref.slot = 0;
+  const std::string::size_type colon = ref.node.rfind(':');
+  if (colon != std::string::npos && colon + 1 < ref.node.size()
+      && ref.node.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+    ref.slot = std::stoi(ref.node.substr(colon + 1));
+    ref.node.resize(colon);
+  }
+  return ref;
+}
+
+std::string TensorName(const std::string& node, int slot) {
+  return slot == 0 ? node : node + ":" + std::to_string(slot);
+}
+
+bool GetConstant(const NodeDef* node, Tensor& value) {
+  if (!node || node->op() != "Const" || node->attr().count("value") == 0)
+    return false;
+  return value.FromProto(node->attr().at("value").tensor()) && value.dtype() == DT_FLOAT;
+}
+
+void SetConstant(NodeDef& node, const std::string& name, const Tensor& value) {
+  node.Clear();
+  node.set_name(name);
+  node.set_op("Const");
+  (*node.mutable_attr())["dtype"].set_type(value.dtype());
+  value.AsProtoTensorContent((*node.mutable_attr())["value"].mutable_tensor());
+}
+
+void RemoveNodes(GraphDef& graphDef, const std::set<std::string>& names) {
+  GraphDef kept;
+  for (const NodeDef& node : graphDef.node())
+    if (names.count(node.name()) == 0)
+      *kept.add_node() = node;
+  graphDef.mutable_node()->Swap(kept.mutable_node());
+}
+
+}
+
+bool FreezeGraph(Session& session, const GraphDef& graphDef, const std::string& inputName,
+                 const std::vector<std::string>& outputNames, GraphDef& frozen) {
+  std::unordered_map<std::string, const NodeDef*> nodes;
+  std::unordered_map<std::string, std::vector<std::string>> consumers;
+  for (const NodeDef& node : graphDef.node()) {
+    nodes[node.name()] = &node;
+    for (const std::string& input : node.input()) {
+      const InputRef ref = ParseInput(input);
+      if (!ref.control)
+        consumers[ref.node].push_back(node.name());
+    }
+  }
+  if (nodes.count(inputName) == 0) {
+    LOG(WARNING) << "FreezeGraph: no input node " << inputName;
+    return false;
+  }
+
+  std::set<std::string> dependent;
+  std::vector<std::string> stack({inputName});
+  while (!stack.empty()) {
+    const std::string name = stack.back();
+    stack.pop_back();
+    if (dependent.insert(name).second)
+      for (const std::string& consumer : consumers[name])
+        stack.push_back(consumer);
+  }
+
+  // Nodes that depend on the input and that the outputs need. The inputs of
+  // the input node are not needed, it is fed.
+  std::set<std::string> needed;
+  for (const std::string& output : outputNames) {
+    const std::string name = ParseInput(output).node;
+    if (dependent.count(name) == 0) {
+      LOG(WARNING) << "FreezeGraph: output " << output << " does not depend on " << inputName;
+      return false;
+    }
+    stack.push_back(name);
+  }
+  while (!stack.empty()) {
+    const std::string name = stack.back();
+    stack.pop_back();
+    if (!needed.insert(name).second || name == inputName)
+      continue;
+    for (const std::string& input : nodes[name]->input()) {
+      const InputRef ref = ParseInput(input);
+      if (!ref.control && dependent.count(ref.node) > 0)
+        stack.push_back(ref.node);
+    }
+  }
+
+  std::set<std::pair<std::string, int>> constants;
+  for (const std::string& name : needed) {
+    if (name == inputName)
+      continue;
+    for (const std::string& input : nodes[name]->input()) {
+      const InputRef ref = ParseInput(input);
+      if (!ref.control && dependent.count(ref.node) == 0)
+        constants.insert(std::make_pair(ref.node, ref.slot));
+    }
+  }
+  std::vector<std::string> fetches;
+  for (const auto& constant : constants)
+    fetches.push_back(TensorName(constant.first, constant.second));
+  std::vector<Tensor> values;
+  if (!fetches.empty()) {
+    const Status status = session.Run({}, fetches, {}, &values);
+    if (!status.ok()) {
+      LOG(WARNING) << "FreezeGraph: " << status;
+      return false;
+    }
+  }
+
+  frozen.Clear();
+  *frozen.mutable_versions() = graphDef.versions();
+  *frozen.mutable_library() = graphDef.library();
+  std::map<std::string, std::string> renamed;
+  std::size_t i = 0;
+  for (const auto& constant : constants) {
+    const Tensor& value = values[i++];
+    if (value.dtype() == DT_RESOURCE || value.dtype() == DT_VARIANT) {
+      LOG(WARNING) << "FreezeGraph: cannot freeze " << fetches[i - 1];
+      return false;
+    }
+    // Other output slots than 0 need their own node
+    std::string name = constant.first;
+    if (constant.second != 0) {
+      name += "_" + std::to_string(constant.second) + "/frozen";
+      renamed[fetches[i - 1]] = name;
+    }
+    SetConstant(*frozen.add_node(), name, value);
+    frozen.mutable_node(frozen.node_size() - 1)->set_device(nodes[constant.first]->device());
+  }
+  for (const NodeDef& node : graphDef.node()) {
+    if (needed.count(node.name()) == 0)
+      continue;
+    NodeDef* copy = frozen.add_node();
+    *copy = node;
+    copy->clear_input();
+    copy->mutable_attr()->erase("_output_shapes");
+    if (node.name() == inputName)
+      continue;
+    for (const std::string& input : node.input()) {
+      const InputRef ref = ParseInput(input);
+      if (ref.control)
+        continue;
+      auto it = renamed.find(TensorName(ref.node, ref.slot));
+      copy->add_input(it == renamed.end() ? input : it->second);
+    }
+  }
+  return true;
+}
+
+int RemoveIdentityNodes(GraphDef& graphDef, const std::vector<std::string>& keepNames) {
+  std::set<std::string> keep;
+  for (const std::string& name : keepNames)
+    keep.insert(ParseInput(name).node);
+  std::map<std::string, std::string> bypass;
+  for (const NodeDef& node : graphDef.node()) {
+    const std::string& op = node.op();
+    if ((op == "Identity" || op == "StopGradient" || op == "Snapshot" || op == "CheckNumerics")
+        && node.input_size() == 1 && !ParseInput(node.input(0)).control && keep.count(node.name()) == 0)
+      bypass[node.name()] = node.input(0);
+  }
+  std::set<std::string> removed;
+  for (const auto& entry : bypass)
+    removed.insert(entry.first);
+  for (NodeDef& node : *graphDef.mutable_node()) {
+    if (removed.count(node.name()) > 0)
+      continue;
+    for (std::string& input : *node.mutable_input()) {
+      InputRef ref = ParseInput(input);
+      while (!ref.control && ref.slot == 0 && bypass.count(ref.node) > 0) {
+        input = bypass[ref.node];
+        ref = ParseInput(input);
+      }
+    }
+  }
+  RemoveNodes(graphDef, removed);
+  return static_cast<int>(removed.size());
+}
+
+int FoldBatchNorm(GraphDef& graphDef) {
+  std::unordered_map<std::string, NodeDef*> nodes;
+  std::unordered_map<std::string, int> numConsumers;
+  std::set<std::string> otherSlotsUsed;
+  for (NodeDef& node : *graphDef.mutable_node()) {
+    nodes[node.name()] = &node;
+    for (const std::string& input : node.input()) {
+      const InputRef ref = ParseInput(input);
+      ++numConsumers[ref.node];
+      if (ref.slot != 0)
+        otherSlotsUsed.insert(ref.node);
+    }
+  }
+  auto node = [&nodes](const std::string& input) -> NodeDef* {
+    auto it = nodes.find(ParseInput(input).node);
+    return it == nodes.end() ? nullptr : it->second;
+  };
+
+  int folded = 0;
+  std::set<std::string> removed;
+  std::vector<NodeDef> biases;
+  for (NodeDef& bn : *graphDef.mutable_node()) {
+    // bn(x) = x * scale + offset for each output channel
+    std::string x;
+    Tensor scale;
+    Tensor offset;
+    NodeDef* mul = nullptr;
+    bool channelsLastOnly = false;
+    if (bn.op() == "FusedBatchNorm" || bn.op() == "FusedBatchNormV2" || bn.op() == "FusedBatchNormV3") {
+      Tensor gamma, beta, mean, variance;
+      if (bn.input_size() < 5 || otherSlotsUsed.count(bn.name()) > 0
+          || (bn.attr().count("is_training") > 0 && bn.attr().at("is_training").b())
+          || !GetConstant(node(bn.input(1)), gamma) || !GetConstant(node(bn.input(2)), beta)
+          || !GetConstant(node(bn.input(3)), mean) || !GetConstant(node(bn.input(4)), variance))
+        continue;
+      const float epsilon = bn.attr().count("epsilon") > 0 ? bn.attr().at("epsilon").f() : 0.001f;
+      const int64 channels = gamma.NumElements();
+      if (beta.NumElements() != channels || mean.NumElements() != channels
+          || variance.NumElements() != channels)
+        continue;
+      scale = Tensor(DT_FLOAT, TensorShape({channels}));
+      offset = Tensor(DT_FLOAT, TensorShape({channels}));
+      for (int64 c = 0; c < channels; ++c) {
+        scale.flat<float>()(c) = gamma.flat<float>()(c) / std::sqrt(variance.flat<float>()(c) + epsilon);
+        offset.flat<float>()(c) = beta.flat<float>()(c) - mean.flat<float>()(c) * scale.flat<float>()(c);
+      }
+      x = bn.input(0);
+    } else if (bn.op() == "Add" || bn.op() == "AddV2") {
+      // Unfused batch normalization: Add(Mul(x, scale), offset), the
+      // constants broadcast over the last dimension
+      for (int i = 0; i < 2 && !mul; ++i) {
+        NodeDef* candidate = node(bn.input(i));
+        if (candidate && candidate->op() == "Mul" && numConsumers[candidate->name()] == 1
+            && GetConstant(node(bn.input(1 - i)), offset))
+          mul = candidate;
+      }
+      if (!mul || mul->input_size() != 2)
+        continue;
+      for (int i = 0; i < 2 && x.empty(); ++i)
+        if (GetConstant(node(mul->input(1 - i)), scale))
+          x = mul->input(i);
+      if (x.empty() || scale.NumElements() != offset.NumElements())
+        continue;
+      channelsLastOnly = true;
+    } else
+      continue;
+
+    // x is Conv2D, optionally followed by BiasAdd, and not used elsewhere
+    NodeDef* conv = node(x);
+    NodeDef* biasAdd = nullptr;
+    Tensor bias;
+    if (conv && conv->op() == "BiasAdd" && numConsumers[conv->name()] == 1
+        && GetConstant(node(conv->input(1)), bias)) {
+      biasAdd = conv;
+      conv = node(conv->input(0));
+    }
+    if (!conv || conv->op() != "Conv2D" || numConsumers[conv->name()] != 1
+        || otherSlotsUsed.count(conv->name()) > 0)
+      continue;
+    const std::string dataFormat = conv->attr().count("data_format") > 0
+                                   ? conv->attr().at("data_format").s() : "NHWC";
+    if (channelsLastOnly && dataFormat != "NHWC")
+      continue;
+    NodeDef* weightsNode = node(conv->input(1));
+    Tensor weights;
+    if (!GetConstant(weightsNode, weights) || weights.dims() != 4
+        || weights.dim_size(3) != scale.NumElements()
+        || (biasAdd && bias.NumElements() != scale.NumElements()))
+      continue;
+
+    // Filters are [height][width][in][out]
+    const int64 channels = scale.NumElements();
+    auto w = weights.flat<float>();
+    for (int64 i = 0; i < w.size(); ++i)
+      w(i) *= scale.flat<float>()(i % channels);
+    std::string weightsName = weightsNode->name();
+    if (numConsumers[weightsName] == 1)
+      weights.AsProtoTensorContent((*weightsNode->mutable_attr())["value"].mutable_tensor());
+    else {
+      weightsName = bn.name() + "/folded_weights";
+      biases.emplace_back();
+      SetConstant(biases.back(), weightsName, weights);
+      biases.back().set_device(weightsNode->device());
+    }
+    for (int64 c = 0; c < channels; ++c) {
+      const float b = biasAdd ? bias.flat<float>()(c) : 0;
+      offset.flat<float>()(c) += b * scale.flat<float>()(c);
+    }
+    biases.emplace_back();
+    SetConstant(biases.back(), bn.name() + "/folded_bias", offset);
+    biases.back().set_device(bn.device());
+
+    *conv->mutable_input(1) = weightsName;
+    if (biasAdd)
+      removed.insert(biasAdd->name());
+    if (mul)
+      removed.insert(mul->name());
+    // Keep the name, so the consumers need no change
+    const std::string device = bn.device();
+    const std::string name = bn.name();
+    bn.Clear();
+    bn.set_name(name);
+    bn.set_op("BiasAdd");
+    bn.set_device(device);
+    bn.add_input(conv->name());
+    bn.add_input(name + "/folded_bias");
+    (*bn.mutable_attr())["T"].set_type(DT_FLOAT);
+    (*bn.mutable_attr())["data_format"].set_s(dataFormat);
+    ++folded;
+  }
+  for (NodeDef& bias : biases)
+    graphDef.add_node()->Swap(&bias);
+
+  // Constants of the batch normalizations that nothing uses any more
+  if (folded > 0) {
+    std::set<std::string> used;
+    for (const NodeDef& n : graphDef.node())
+      if (removed.count(n.name()) == 0)
+        for (const std::string& input : n.input())
+          used.insert(ParseInput(input).node);
+    for (const NodeDef& n : graphDef.node())
+      if (n.op() == "Const" && used.count(n.name()) == 0)
+        removed.insert(n.name());
+  }
+  RemoveNodes(graphDef, removed);
+  return folded;
+}
+
+bool SetInputShape(GraphDef& graphDef, const std::string& inputName, const std::vector<int64>& dims) {
+  NodeDef* input = GetNode(graphDef, inputName);
+  if (!input)
+    return false;
+  DataType dtype = DT_FLOAT;
+  if (input->attr().count("dtype") > 0)
+    dtype = input->attr().at("dtype").type();
+  else if (input->attr().count("T") > 0)
+    dtype = input->attr().at("T").type();
+  input->set_op("Placeholder");
+  input->clear_input();
+  input->clear_attr();
+  (*input->mutable_attr())["dtype"].set_type(dtype);
+  TensorShapeProto* shape = (*input->mutable_attr())["shape"].mutable_shape();
+  for (int64 dim : dims)
+    shape->add_dim()->set_size(dim);
+  return true;
+}
+
+bool OptimizeForInference(Session& session, const GraphDef& graphDef, const std::string& inputName,
+                          const std::vector<std::string>& outputNames, const std::vector<int64>& inputDims,
+                          GraphDef& optimized) {
+  if (!FreezeGraph(session, graphDef, inputName, outputNames, optimized))
+    return false;
+  const int frozenSize = optimized.node_size();
+  std::vector<std::string> keep(outputNames);
+  keep.push_back(inputName);
+  const int identities = RemoveIdentityNodes(optimized, keep);
+  const int batchNorms = FoldBatchNorm(optimized);
+  if (!SetInputShape(optimized, inputName, inputDims))
+    return false;
+  LOG(INFO) << "OptimizeForInference: " << graphDef.node_size() << " nodes, "
+            << frozenSize << " frozen, " << identities << " identities removed, "
+            << batchNorms << " batch normalizations folded, " << optimized.node_size() << " left";
+  return true;
+}
+
 }
@@ -35,6 +35,28 @@ void PrintGraphNodeInfo(const GraphDef& graphDef);
 void PrintGraphNodeInfo(const GraphDef& graphDef, const std::string& filter);
 void PrintNodeInfo(const GraphDef& graphDef, const std::string& name);
 void ChangeDevice(const GraphDef& graphDef, const std::string& match, const std::string& replacement);
+
+/** Inference graph of the outputs: the nodes that do not depend on the
+    input, which includes the variables, are replaced by constants with
+    their values in the session, so constant subgraphs are folded and the
+    training nodes and control dependencies dropped. The input node becomes
+    a source. */
+bool FreezeGraph(Session& session, const GraphDef& graphDef, const std::string& inputName,
+                 const std::vector<std::string>& outputNames, GraphDef& frozen);
+/** Bypass Identity, StopGradient, Snapshot and CheckNumerics nodes. Returns
+    the number of nodes removed. */
+int RemoveIdentityNodes(GraphDef& graphDef, const std::vector<std::string>& keepNames);
+/** Fold batch normalization with constant parameters after a Conv2D, fused
+    or as Mul and Add, into the convolution weights and a BiasAdd. Returns
+    the number of batch normalizations folded. */
+int FoldBatchNorm(GraphDef& graphDef);
+/** Make the input a Placeholder of the given shape, -1 for a dimension
+    that is not fixed. */
+bool SetInputShape(GraphDef& graphDef, const std::string& inputName, const std::vector<int64>& dims);
+/** FreezeGraph, RemoveIdentityNodes, FoldBatchNorm and SetInputShape. */
+bool OptimizeForInference(Session& session, const GraphDef& graphDef, const std::string& inputName,
+                          const std::vector<std::string>& outputNames, const std::vector<int64>& inputDims,
+                          GraphDef& optimized);
 }
 
 #endif //TFRECORD_GONET_DLGRAPHUTIL_H
@@ -0,0 +1,83 @@
+
+#include "DlMockNetworkEvaluator.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+uint64_t Hash(const char *data, std::size_t size, uint64_t hash) {
+  for (std::size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/** splitmix64, the same numbers on every platform. */
+uint64_t Next(uint64_t &state) {
+  uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/** Uniform in [0, 1). */
+double NextDouble(uint64_t &state) {
+  return (Next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+}
+
+DlMockNetworkEvaluator::DlMockNetworkEvaluator(int batchLatency, int positionLatency) :
+    m_batchLatency(batchLatency),
+    m_positionLatency(positionLatency),
+    m_seed(FNV_OFFSET) {}
+
+void DlMockNetworkEvaluator::SetLatency(int batchLatency, int positionLatency) {
+  m_batchLatency = batchLatency;
+  m_positionLatency = positionLatency;
+}
+
+void DlMockNetworkEvaluator::Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                                      double actions_[][GO_MAX_MOVES],
+                                      double value_[], int numBatches) {
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now()
+      + std::chrono::microseconds(m_batchLatency + m_positionLatency * numBatches);
+  for (int i = 0; i < numBatches; ++i)
+    Evaluate(feature[i], m_seed, actions_[i], value_[i]);
+  std::this_thread::sleep_until(end);
+}
+
+void DlMockNetworkEvaluator::Evaluate(const char feature[NUM_MAPS][BD_SIZE][BD_SIZE],
+                                      uint64_t seed, double actions_[GO_MAX_MOVES],
+                                      double &value) {
+  uint64_t state = Hash(&feature[0][0][0], NUM_MAPS * BD_SIZE * BD_SIZE, seed);
+  // The fourth power makes a few moves much more likely than the others,
+  // as in a trained network
+  double sum = 0;
+  for (int m = 0; m < GO_MAX_MOVES; ++m) {
+    const double r = NextDouble(state);
+    actions_[m] = r * r * r * r;
+    sum += actions_[m];
+  }
+  for (int m = 0; m < GO_MAX_MOVES; ++m)
+    actions_[m] /= sum;
+  value = 2 * NextDouble(state) - 1;
+}
+
+bool DlMockNetworkEvaluator::LoadGraph(const std::string &) {
+  return true;
+}
+
+bool DlMockNetworkEvaluator::UpdateCheckPoint(const std::string &checkpointPath) {
+  m_seed = Hash(checkpointPath.data(), checkpointPath.size(), FNV_OFFSET);
+  return true;
+}
+
+bool DlMockNetworkEvaluator::MetaGraphLoaded() {
+  return true;
+}
@@ -0,0 +1,43 @@
+
+#ifndef DL_MOCK_NETWORKEVALUATOR_H
+#define DL_MOCK_NETWORKEVALUATOR_H
+
+#include <cstdint>
+#include <string>
+#include "funcapproximator/DlNetworkEvaluator.h"
+
+/** Network that needs no model, for benchmarks and tests of the search.
+    The policy and value of a position are pseudo-random numbers seeded
+    with a hash of its features and of the checkpoint name, so the same
+    position always gets the same evaluation. Each batch takes a
+    configurable time, like a real network. */
+class DlMockNetworkEvaluator : public DlNetworkEvaluator {
+ public:
+  /** @param batchLatency Microseconds per batch
+      @param positionLatency Additional microseconds per position */
+  explicit DlMockNetworkEvaluator(int batchLatency = 0, int positionLatency = 0);
+
+  void SetLatency(int batchLatency, int positionLatency);
+
+  virtual void Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                        double actions_[][GO_MAX_MOVES],
+                        double value_[],
+                        int numBatches = MAX_BATCHES);
+  virtual bool LoadGraph(const std::string &graphPath);
+  /** Changes the seed, so each checkpoint is a different network. */
+  virtual bool UpdateCheckPoint(const std::string &checkpointPath);
+  virtual bool MetaGraphLoaded();
+
+  /** Evaluation of one position. The policy sums to 1, the value is in
+      [-1, 1]. */
+  static void Evaluate(const char feature[NUM_MAPS][BD_SIZE][BD_SIZE],
+                       uint64_t seed, double actions_[GO_MAX_MOVES],
+                       double &value);
+
+ private:
+  int m_batchLatency;
+  int m_positionLatency;
+  uint64_t m_seed;
+};
+
+#endif //DL_MOCK_NETWORKEVALUATOR_H
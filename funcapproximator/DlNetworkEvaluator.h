@@ -0,0 +1,31 @@
+
+#ifndef DL_NETWORKEVALUATOR_H
+#define DL_NETWORKEVALUATOR_H
+
+#include <string>
+#include "config/BoardStaticConfig.h"
+#include "funcapproximator/DataFormat.h"
+
+const int MAX_BATCHES = 16; // fixed for tf metagraph
+
+/** Policy and value network that the search evaluates positions with.
+    Implementations: DlTFNetworkEvaluator, which runs a TensorFlow graph,
+    DlCpuNetworkEvaluator, which needs no TensorFlow, and
+    DlMockNetworkEvaluator, which needs no model. */
+class DlNetworkEvaluator {
+ public:
+  virtual ~DlNetworkEvaluator() {}
+
+  /** Features of numBatches positions in, for each position the
+      probabilities of the moves and the value out. */
+  virtual void Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+                        double actions_[][GO_MAX_MOVES],
+                        double value_[],
+                        int numBatches = MAX_BATCHES) = 0;
+  virtual bool LoadGraph(const std::string& graphPath) = 0;
+  /** Load the model parameters. */
+  virtual bool UpdateCheckPoint(const std::string& checkpointPath) = 0;
+  virtual bool MetaGraphLoaded() = 0;
+};
+
+#endif //DL_NETWORKEVALUATOR_H
@@ -0,0 +1,606 @@
+
+#include "platform/SgSystem.h"
+#include "DlReplayBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "DlShardWriter.h"
+#include "lib/SgRandom.h"
+
+namespace {
+
+/** Protocol buffer wire types. */
+const int WIRE_VARINT = 0;
+const int WIRE_64BIT = 1;
+const int WIRE_BYTES = 2;
+const int WIRE_32BIT = 5;
+
+/** Field numbers of tf.train.Example, Features, Feature and the lists. */
+const int EXAMPLE_FEATURES = 1;
+const int FEATURES_FEATURE = 1;
+const int MAP_KEY = 1;
+const int MAP_VALUE = 2;
+const int FEATURE_BYTES_LIST = 1;
+const int FEATURE_FLOAT_LIST = 2;
+const int FEATURE_INT64_LIST = 3;
+const int LIST_VALUE = 1;
+
+const std::size_t POLICY_SIZE = GO_MAX_MOVES;
+
+/** Reads the fields of one protocol buffer message. */
+class WireReader {
+ public:
+  WireReader(const char *data, std::size_t size)
+      : m_pos(reinterpret_cast<const unsigned char *>(data)),
+        m_end(m_pos + size),
+        m_ok(true) {}
+
+  bool Ok() const {
+    return m_ok;
+  }
+
+  bool AtEnd() const {
+    return m_pos == m_end;
+  }
+
+  /** @return false at the end of the message or at an error */
+  bool NextField(int &field, int &wireType) {
+    if (m_pos == m_end || !m_ok)
+      return false;
+    std::uint64_t tag;
+    if (!ReadVarint(tag))
+      return false;
+    field = static_cast<int>(tag >> 3);
+    wireType = static_cast<int>(tag & 7);
+    return true;
+  }
+
+  bool ReadBytes(const char *&data, std::size_t &size) {
+    std::uint64_t length;
+    if (!ReadVarint(length) || length > std::uint64_t(m_end - m_pos))
+      return Fail();
+    data = reinterpret_cast<const char *>(m_pos);
+    size = static_cast<std::size_t>(length);
+    m_pos += size;
+    return true;
+  }
+
+  bool ReadFloat(float &value) {
+    if (m_end - m_pos < 4)
+      return Fail();
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i)
+      bits |= std::uint32_t(m_pos[i]) << (8 * i);
+    std::memcpy(&value, &bits, 4);
+    m_pos += 4;
+    return true;
+  }
+
+  bool ReadVarint(std::uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && m_pos != m_end; shift += 7) {
+      const unsigned char b = *m_pos++;
+      value |= std::uint64_t(b & 0x7f) << shift;
+      if ((b & 0x80) == 0)
+        return true;
+    }
+    return Fail();
+  }
+
+  bool Skip(int wireType) {
+    std::uint64_t value;
+    const char *data;
+    std::size_t size;
+    switch (wireType) {
+      case WIRE_VARINT:
+        return ReadVarint(value);
+      case WIRE_64BIT:
+        return Advance(8);
+      case WIRE_BYTES:
+        return ReadBytes(data, size);
+      case WIRE_32BIT:
+        return Advance(4);
+      default:
+        return Fail();
+    }
+  }
+
+ private:
+  const unsigned char *m_pos;
+  const unsigned char *m_end;
+  bool m_ok;
+
+  bool Fail() {
+    m_ok = false;
+    return false;
+  }
+
+  bool Advance(std::size_t n) {
+    if (std::size_t(m_end - m_pos) < n)
+      return Fail();
+    m_pos += n;
+    return true;
+  }
+};
+
+void WriteVarint(std::string &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+void WriteBytes(std::string &out, int field, const std::string &bytes) {
+  WriteVarint(out, (std::uint64_t(field) << 3) | WIRE_BYTES);
+  WriteVarint(out, bytes.size());
+  out += bytes;
+}
+
+std::string PackedFloats(const float *values, std::size_t size) {
+  std::string packed;
+  for (std::size_t i = 0; i < size; ++i) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &values[i], 4);
+    for (int j = 0; j < 4; ++j)
+      packed.push_back(static_cast<char>((bits >> (8 * j)) & 0xff));
+  }
+  std::string list;
+  WriteBytes(list, LIST_VALUE, packed);
+  std::string feature;
+  WriteBytes(feature, FEATURE_FLOAT_LIST, list);
+  return feature;
+}
+
+std::string Int64Feature(std::int64_t value) {
+  std::string packed;
+  WriteVarint(packed, static_cast<std::uint64_t>(value));
+  std::string list;
+  WriteBytes(list, LIST_VALUE, packed);
+  std::string feature;
+  WriteBytes(feature, FEATURE_INT64_LIST, list);
+  return feature;
+}
+
+std::string MapEntry(const std::string &key, const std::string &feature) {
+  std::string entry;
+  WriteBytes(entry, MAP_KEY, key);
+  WriteBytes(entry, MAP_VALUE, feature);
+  return entry;
+}
+
+/** Read a FloatList, packed or not, of exactly size values. */
+bool DecodeFloatList(const char *data, std::size_t size, float *values,
+                     std::size_t expected) {
+  WireReader reader(data, size);
+  std::size_t n = 0;
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    if (field != LIST_VALUE) {
+      if (!reader.Skip(wireType))
+        return false;
+    } else if (wireType == WIRE_32BIT) {
+      float value;
+      if (n == expected || !reader.ReadFloat(value))
+        return false;
+      values[n++] = value;
+    } else if (wireType == WIRE_BYTES) {
+      const char *packed;
+      std::size_t packedSize;
+      if (!reader.ReadBytes(packed, packedSize) || packedSize % 4 != 0
+          || n + packedSize / 4 > expected)
+        return false;
+      WireReader floats(packed, packedSize);
+      for (std::size_t i = 0; i < packedSize / 4; ++i)
+        floats.ReadFloat(values[n++]);
+    } else
+      return false;
+  }
+  return reader.Ok() && n == expected;
+}
+
+/** Read an Int64List, packed or not, with exactly one value. */
+bool DecodeInt64(const char *data, std::size_t size, std::int64_t &value) {
+  WireReader reader(data, size);
+  int n = 0;
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    std::uint64_t v;
+    if (field != LIST_VALUE) {
+      if (!reader.Skip(wireType))
+        return false;
+    } else if (wireType == WIRE_VARINT) {
+      if (!reader.ReadVarint(v))
+        return false;
+      value = static_cast<std::int64_t>(v);
+      ++n;
+    } else if (wireType == WIRE_BYTES) {
+      const char *packed;
+      std::size_t packedSize;
+      if (!reader.ReadBytes(packed, packedSize))
+        return false;
+      WireReader values(packed, packedSize);
+      while (!values.AtEnd()) {
+        if (!values.ReadVarint(v))
+          return false;
+        value = static_cast<std::int64_t>(v);
+        ++n;
+      }
+    } else
+      return false;
+  }
+  return reader.Ok() && n == 1;
+}
+
+/** Read a BytesList with one value of exactly size bytes. */
+bool DecodeBytesList(const char *data, std::size_t size, char *bytes,
+                     std::size_t expected) {
+  WireReader reader(data, size);
+  bool found = false;
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    if (field == LIST_VALUE && wireType == WIRE_BYTES && !found) {
+      const char *value;
+      std::size_t valueSize;
+      if (!reader.ReadBytes(value, valueSize) || valueSize != expected)
+        return false;
+      std::memcpy(bytes, value, expected);
+      found = true;
+    } else if (!reader.Skip(wireType))
+      return false;
+  }
+  return reader.Ok() && found;
+}
+
+/** Find the list of a Feature message. */
+bool FeatureList(const char *data, std::size_t size, int kind,
+                 const char *&list, std::size_t &listSize) {
+  WireReader reader(data, size);
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    if (field == kind && wireType == WIRE_BYTES)
+      return reader.ReadBytes(list, listSize);
+    if (!reader.Skip(wireType))
+      return false;
+  }
+  return false;
+}
+
+bool DecodeEntry(const char *data, std::size_t size,
+                 DlTrainingExample &example, int &found) {
+  WireReader reader(data, size);
+  std::string key;
+  const char *value = 0;
+  std::size_t valueSize = 0;
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    const char *bytes;
+    std::size_t bytesSize;
+    if (wireType == WIRE_BYTES && (field == MAP_KEY || field == MAP_VALUE)) {
+      if (!reader.ReadBytes(bytes, bytesSize))
+        return false;
+      if (field == MAP_KEY)
+        key.assign(bytes, bytesSize);
+      else {
+        value = bytes;
+        valueSize = bytesSize;
+      }
+    } else if (!reader.Skip(wireType))
+      return false;
+  }
+  if (!reader.Ok() || !value)
+    return false;
+  const char *list;
+  std::size_t listSize;
+  if (key == "feature") {
+    if (!FeatureList(value, valueSize, FEATURE_BYTES_LIST, list, listSize)
+        || !DecodeBytesList(list, listSize, &example.feature[0][0][0],
+                            sizeof(example.feature)))
+      return false;
+    found |= 1;
+  } else if (key == "policy") {
+    if (!FeatureList(value, valueSize, FEATURE_FLOAT_LIST, list, listSize)
+        || !DecodeFloatList(list, listSize, example.policy, POLICY_SIZE))
+      return false;
+    found |= 2;
+  } else if (key == "reward") {
+    if (!FeatureList(value, valueSize, FEATURE_FLOAT_LIST, list, listSize)
+        || !DecodeFloatList(list, listSize, &example.reward, 1))
+      return false;
+    found |= 4;
+  } else if (key == "game_start") {
+    std::int64_t gameStart;
+    if (!FeatureList(value, valueSize, FEATURE_INT64_LIST, list, listSize)
+        || !DecodeInt64(list, listSize, gameStart))
+      return false;
+    example.gameStart = gameStart != 0 ? 1 : 0;
+  }
+  return true;
+}
+
+std::uint64_t ReadLittleEndian(const char *data, int bytes) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value |= std::uint64_t(static_cast<unsigned char>(data[i])) << (8 * i);
+  return value;
+}
+
+/** Point (row, col) of the board transformed by one of the 8 symmetries. */
+inline void Transform(int symmetry, int row, int col, int &r, int &c) {
+  if (symmetry & 4)
+    std::swap(row, col);
+  r = (symmetry & 1) ? BD_SIZE - 1 - row : row;
+  c = (symmetry & 2) ? BD_SIZE - 1 - col : col;
+}
+
+}
+
+std::string DlExampleCodec::Encode(const DlTrainingExample &example) {
+  std::string bytesList;
+  WriteBytes(bytesList, LIST_VALUE,
+             std::string(&example.feature[0][0][0], sizeof(example.feature)));
+  std::string feature;
+  WriteBytes(feature, FEATURE_BYTES_LIST, bytesList);
+  std::string features;
+  WriteBytes(features, FEATURES_FEATURE, MapEntry("feature", feature));
+  WriteBytes(features, FEATURES_FEATURE,
+             MapEntry("policy", PackedFloats(example.policy, POLICY_SIZE)));
+  WriteBytes(features, FEATURES_FEATURE,
+             MapEntry("reward", PackedFloats(&example.reward, 1)));
+  if (example.gameStart >= 0)
+    WriteBytes(features, FEATURES_FEATURE,
+               MapEntry("game_start", Int64Feature(example.gameStart)));
+  std::string result;
+  WriteBytes(result, EXAMPLE_FEATURES, features);
+  return result;
+}
+
+bool DlExampleCodec::Decode(const char *data, std::size_t size,
+                            DlTrainingExample &example) {
+  WireReader reader(data, size);
+  example.gameStart = -1;
+  int found = 0;
+  int field, wireType;
+  while (reader.NextField(field, wireType)) {
+    if (field != EXAMPLE_FEATURES || wireType != WIRE_BYTES) {
+      if (!reader.Skip(wireType))
+        return false;
+      continue;
+    }
+    const char *features;
+    std::size_t featuresSize;
+    if (!reader.ReadBytes(features, featuresSize))
+      return false;
+    WireReader entries(features, featuresSize);
+    while (entries.NextField(field, wireType)) {
+      if (field == FEATURES_FEATURE && wireType == WIRE_BYTES) {
+        const char *entry;
+        std::size_t entrySize;
+        if (!entries.ReadBytes(entry, entrySize)
+            || !DecodeEntry(entry, entrySize, example, found))
+          return false;
+      } else if (!entries.Skip(wireType))
+        return false;
+    }
+    if (!entries.Ok())
+      return false;
+  }
+  return reader.Ok() && found == 7;
+}
+
+bool DlExampleCodec::IsFirstPosition(const DlTrainingExample &example) {
+  if (example.gameStart >= 0)
+    return example.gameStart != 0;
+  const char *previous = &example.feature[2][0][0];
+  for (int i = 0; i < 2 * BD_SIZE * BD_SIZE; ++i)
+    if (previous[i] != 0)
+      return false;
+  return true;
+}
+
+DlShardReader::DlShardReader(const std::string &path)
+    : m_data(0),
+      m_size(0),
+      m_pos(0),
+      m_mapped(false) {
+  if (boost::algorithm::ends_with(path, ".gz")) {
+    gzFile in = gzopen(path.c_str(), "rb");
+    if (!in)
+      return;
+    char buffer[1 << 16];
+    int n;
+    while ((n = gzread(in, buffer, sizeof(buffer))) > 0)
+      m_buffer.append(buffer, n);
+    gzclose(in);
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return;
+  }
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, st.st_size, MADV_SEQUENTIAL);
+      m_data = static_cast<const char *>(data);
+      m_size = st.st_size;
+      m_mapped = true;
+    }
+  } else
+    m_data = m_buffer.data();
+  close(fd);
+}
+
+DlShardReader::~DlShardReader() {
+  if (m_mapped)
+    munmap(const_cast<char *>(m_data), m_size);
+}
+
+bool DlShardReader::IsOpen() const {
+  return m_data != 0;
+}
+
+bool DlShardReader::Next(const char *&data, std::size_t &size) {
+  if (m_size - m_pos < 16)
+    return false;
+  const char *header = m_data + m_pos;
+  const std::uint64_t length = ReadLittleEndian(header, 8);
+  if (ReadLittleEndian(header + 8, 4) != DlShardWriter::MaskedCrc32c(header, 8)
+      || length > m_size - m_pos - 16)
+    return false;
+  data = header + 12;
+  size = static_cast<std::size_t>(length);
+  if (ReadLittleEndian(data + size, 4)
+      != DlShardWriter::MaskedCrc32c(data, size))
+    return false;
+  m_pos += 16 + size;
+  return true;
+}
+
+DlReplayBuffer::Options::Options()
+    : maxGames(500000),
+      numThreads(4),
+      sampling(SAMPLE_UNIFORM),
+      halfLife(100000),
+      augment(true) {}
+
+DlReplayBuffer::DlReplayBuffer(const Options &options)
+    : m_options(options),
+      m_nuPositions(0) {}
+
+void DlReplayBuffer::ReadShards(
+    const std::vector<std::string> &paths, std::size_t first,
+    std::size_t step, std::vector<std::vector<std::shared_ptr<Game> > > &games) {
+  for (std::size_t i = first; i < paths.size(); i += step) {
+    DlShardReader reader(paths[i]);
+    std::shared_ptr<Game> game(new Game);
+    const char *data;
+    std::size_t size;
+    while (reader.Next(data, size)) {
+      game->push_back(DlTrainingExample());
+      if (!DlExampleCodec::Decode(data, size, game->back())) {
+        game->pop_back();
+        continue;
+      }
+      if (DlExampleCodec::IsFirstPosition(game->back())) {
+        games[i].push_back(game);
+        game.reset(new Game);
+      }
+    }
+    // A shard holds whole games, this only happens with corrupt shards
+    if (!game->empty())
+      games[i].push_back(game);
+  }
+}
+
+std::size_t DlReplayBuffer::AddShards(const std::vector<std::string> &paths) {
+  std::vector<std::vector<std::shared_ptr<Game> > > games(paths.size());
+  const std::size_t numThreads =
+      std::min(paths.size(), std::size_t(std::max(m_options.numThreads, 1)));
+  boost::thread_group threads;
+  for (std::size_t i = 1; i < numThreads; ++i)
+    threads.create_thread(boost::bind(&DlReplayBuffer::ReadShards,
+                                      boost::cref(paths), i, numThreads,
+                                      boost::ref(games)));
+  if (numThreads > 0)
+    ReadShards(paths, 0, numThreads, games);
+  threads.join_all();
+
+  std::size_t nuRead = 0;
+  boost::mutex::scoped_lock lock(m_mutex);
+  for (std::size_t i = 0; i < games.size(); ++i)
+    for (std::size_t j = 0; j < games[i].size(); ++j) {
+      m_games.push_back(games[i][j]);
+      ++nuRead;
+    }
+  while (m_games.size() > m_options.maxGames)
+    m_games.pop_front();
+  m_offset.resize(m_games.size());
+  m_nuPositions = 0;
+  for (std::size_t i = 0; i < m_games.size(); ++i) {
+    m_offset[i] = m_nuPositions;
+    m_nuPositions += m_games[i]->size();
+  }
+  return nuRead;
+}
+
+std::size_t DlReplayBuffer::NuGames() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_games.size();
+}
+
+std::size_t DlReplayBuffer::NuPositions() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuPositions;
+}
+
+std::size_t DlReplayBuffer::SampleGame(SgRandom &random) const {
+  if (m_options.sampling == SAMPLE_RECENT) {
+    // Age in games from the newest, geometric with the given half-life
+    const double u = std::max(double(random.Float_01()), 1e-12);
+    const double age = std::floor(-m_options.halfLife * std::log(u)
+                                  / std::log(2.0));
+    if (age < double(m_games.size()))
+      return m_games.size() - 1 - static_cast<std::size_t>(age);
+    return random.Int(m_games.size());
+  }
+  const std::size_t position = random.Int(m_nuPositions);
+  return std::upper_bound(m_offset.begin(), m_offset.end(), position)
+      - m_offset.begin() - 1;
+}
+
+void DlReplayBuffer::SampleBatch(SgRandom &random, int batchSize,
+                                 DlTrainingBatch &batch) const {
+  batch.size = 0;
+  batch.features.resize(std::size_t(batchSize) * FEATURE_SIZE);
+  batch.policies.resize(std::size_t(batchSize) * POLICY_SIZE);
+  batch.rewards.resize(batchSize);
+  std::vector<std::pair<std::shared_ptr<const Game>, int> > samples;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_nuPositions == 0)
+      return;
+    for (int i = 0; i < batchSize; ++i) {
+      const std::shared_ptr<const Game> &game = m_games[SampleGame(random)];
+      samples.push_back(std::make_pair(
+          game, static_cast<int>(random.Int(game->size()))));
+    }
+  }
+  // The games are shared, so the copying runs without the lock
+  for (int i = 0; i < batchSize; ++i)
+    AddToBatch((*samples[i].first)[samples[i].second],
+               m_options.augment ? random.Int(8) : 0, batch, i);
+  batch.size = batchSize;
+}
+
+void DlReplayBuffer::AddToBatch(const DlTrainingExample &example,
+                                int symmetry, DlTrainingBatch &batch,
+                                int index) {
+  float *features = &batch.features[std::size_t(index) * FEATURE_SIZE];
+  float *policy = &batch.policies[std::size_t(index) * POLICY_SIZE];
+  for (int row = 0; row < BD_SIZE; ++row)
+    for (int col = 0; col < BD_SIZE; ++col) {
+      int r, c;
+      Transform(symmetry, row, col, r, c);
+      const int to = r * BD_SIZE + c;
+      for (int plane = 0; plane < NUM_MAPS; ++plane)
+        features[plane * BD_SIZE * BD_SIZE + to] =
+            example.feature[plane][row][col];
+      policy[to] = example.policy[row * BD_SIZE + col];
+    }
+  for (std::size_t i = BD_SIZE * BD_SIZE; i < POLICY_SIZE; ++i)
+    policy[i] = example.policy[i];
+  batch.rewards[index] = example.reward;
+}
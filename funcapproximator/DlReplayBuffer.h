@@ -0,0 +1,131 @@
+
+#ifndef UNREALGO_DLREPLAYBUFFER_H
+#define UNREALGO_DLREPLAYBUFFER_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "funcapproximator/DataFormat.h"
+
+class SgRandom;
+
+/** One training position, as written by UctDeepPlayer::WriteTFRecord. */
+struct DlTrainingExample {
+  char feature[NUM_MAPS][BD_SIZE][BD_SIZE];
+  float policy[GO_MAX_MOVES];
+  float reward;
+  /** 1 for the first position of a game, 0 for the others, -1 if the
+      record has no "game_start" feature. */
+  int gameStart;
+};
+
+/** Batch of training positions in the NUM_MAPS x BD_SIZE x BD_SIZE
+    layout of the network input, as floats. */
+struct DlTrainingBatch {
+  int size;
+  std::vector<float> features;
+  std::vector<float> policies;
+  std::vector<float> rewards;
+};
+
+/** The tf.train.Example protocol buffer of a training position, coded
+    without the TensorFlow library. */
+namespace DlExampleCodec {
+
+std::string Encode(const DlTrainingExample &example);
+
+/** @return false if the record is not an Example with the features
+    "feature", "policy" and "reward" of the right sizes. The feature
+    "game_start" is optional. */
+bool Decode(const char *data, std::size_t size, DlTrainingExample &example);
+
+/** UctDeepPlayer writes the positions of a game from the last to the
+    first, so the position marked as game start ends a game. Records
+    without the marker end a game at a position whose previous board is
+    empty, which also matches the position after a first move pass. */
+bool IsFirstPosition(const DlTrainingExample &example);
+
+}
+
+/** Reads the records of a TFRecord shard. Uncompressed shards are
+    memory-mapped, shards ending in ".gz" are decompressed into memory. */
+class DlShardReader {
+ public:
+  explicit DlShardReader(const std::string &path);
+  ~DlShardReader();
+  bool IsOpen() const;
+
+  /** @return false at the end of the shard or at a corrupt record */
+  bool Next(const char *&data, std::size_t &size);
+
+ private:
+  const char *m_data;
+  std::size_t m_size;
+  std::size_t m_pos;
+  bool m_mapped;
+  std::string m_buffer;
+  DlShardReader(const DlShardReader &);
+  DlShardReader &operator=(const DlShardReader &);
+};
+
+/** Sliding window of the most recent self-play games, sampled into
+    training batches. Shards are read by several threads. Adding shards
+    and sampling can run in different threads. */
+class DlReplayBuffer {
+ public:
+  enum Sampling {
+    /** Every position in the window is equally likely. */
+    SAMPLE_UNIFORM,
+    /** The weight of a game halves every halfLife newer games. */
+    SAMPLE_RECENT
+  };
+
+  struct Options {
+    Options();
+    std::size_t maxGames;
+    int numThreads;
+    Sampling sampling;
+    double halfLife;
+    /** Apply one of the 8 board symmetries to each sampled position. */
+    bool augment;
+  };
+
+  explicit DlReplayBuffer(const Options &options);
+
+  /** Add the games of the shards, oldest shard first.
+      @return The number of games read */
+  std::size_t AddShards(const std::vector<std::string> &paths);
+
+  std::size_t NuGames() const;
+  std::size_t NuPositions() const;
+
+  /** Sample batchSize positions. Each thread uses its own random
+      generator. */
+  void SampleBatch(SgRandom &random, int batchSize,
+                   DlTrainingBatch &batch) const;
+
+  /** Copy example into the batch, transformed by one of the 8
+      symmetries of the square. */
+  static void AddToBatch(const DlTrainingExample &example, int symmetry,
+                         DlTrainingBatch &batch, int index);
+
+ private:
+  typedef std::vector<DlTrainingExample> Game;
+
+  const Options m_options;
+  mutable boost::mutex m_mutex;
+  std::deque<std::shared_ptr<const Game> > m_games;
+  /** Number of positions in m_games before each game. */
+  std::vector<std::size_t> m_offset;
+  std::size_t m_nuPositions;
+
+  static void ReadShards(const std::vector<std::string> &paths,
+                         std::size_t first, std::size_t step,
+                         std::vector<std::vector<std::shared_ptr<Game> > >
+                         &games);
+  std::size_t SampleGame(SgRandom &random) const;
+};
+
+#endif //UNREALGO_DLREPLAYBUFFER_H
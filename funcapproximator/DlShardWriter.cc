@@ -0,0 +1,357 @@
+
+#include "DlShardWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <sstream>
+#include <unistd.h>
+#include <zlib.h>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/filesystem.hpp>
+
+namespace {
+
+double Now() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** CRC32C (Castagnoli), the checksum of the TFRecord format. */
+class Crc32c {
+ public:
+  Crc32c() {
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t crc = i;
+      for (int j = 0; j < 8; ++j)
+        crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+      m_table[i] = crc;
+    }
+  }
+
+  std::uint32_t Compute(const char *data, std::size_t size) const {
+    std::uint32_t crc = 0xffffffff;
+    for (std::size_t i = 0; i < size; ++i)
+      crc = m_table[(crc ^ static_cast<unsigned char>(data[i])) & 0xff]
+          ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+  }
+
+ private:
+  std::uint32_t m_table[256];
+};
+
+void AppendLittleEndian(std::string &buffer, std::uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+}
+
+DlShardWriter::Options::Options()
+    : dir("."),
+      prefix("shard"),
+      maxShardBytes(64 << 20),
+      maxShardSeconds(600),
+      fsync(FSYNC_ON_CLOSE),
+      compress(true),
+      maxQueuedBytes(256 << 20),
+      maxRetries(5),
+      retryDelay(1),
+      failedRetryInterval(300) {}
+
+DlShardWriter::DlShardWriter(const Options &options, const Uploader &uploader)
+    : m_options(options),
+      m_uploader(uploader),
+      m_queuedBytes(0),
+      m_flushRequests(0),
+      m_nuBusy(0),
+      m_quit(false),
+      m_nuGames(0),
+      m_nuDropped(0),
+      m_nuShards(0),
+      m_nuUploadFailures(0),
+      m_file(0),
+      m_currentBytes(0),
+      m_currentStart(0),
+      m_shardIndex(0) {
+  boost::filesystem::create_directories(m_options.dir);
+  m_writeThread = boost::thread(boost::bind(&DlShardWriter::WriteLoop, this));
+  m_uploadThread = boost::thread(boost::bind(&DlShardWriter::UploadLoop, this));
+}
+
+DlShardWriter::~DlShardWriter() {
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_quit = true;
+  }
+  m_writeCondition.notify_all();
+  m_writeThread.join();
+  m_uploadCondition.notify_all();
+  m_uploadThread.join();
+}
+
+bool DlShardWriter::AddGame(const std::string &group,
+                            std::vector<std::string> &records) {
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < records.size(); ++i)
+    bytes += records[i].size() + 16;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_queuedBytes + bytes > m_options.maxQueuedBytes) {
+      ++m_nuDropped;
+      return false;
+    }
+    m_games.push_back(Game());
+    m_games.back().group = group;
+    m_games.back().records.swap(records);
+    m_games.back().bytes = bytes;
+    m_queuedBytes += bytes;
+  }
+  m_writeCondition.notify_one();
+  return true;
+}
+
+void DlShardWriter::Flush() {
+  boost::mutex::scoped_lock lock(m_mutex);
+  ++m_flushRequests;
+  m_writeCondition.notify_one();
+  m_idleCondition.wait(lock, boost::bind(&DlShardWriter::IsIdle, this));
+}
+
+bool DlShardWriter::IsIdle() const {
+  return m_flushRequests == 0 && m_games.empty() && m_shards.empty()
+      && m_nuBusy == 0;
+}
+
+std::size_t DlShardWriter::NuGames() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuGames;
+}
+
+std::size_t DlShardWriter::NuDroppedGames() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuDropped;
+}
+
+std::size_t DlShardWriter::NuShards() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuShards;
+}
+
+std::size_t DlShardWriter::NuUploadFailures() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuUploadFailures;
+}
+
+unsigned int DlShardWriter::MaskedCrc32c(const char *data, std::size_t size) {
+  static const Crc32c s_crc;
+  const std::uint32_t crc = s_crc.Compute(data, size);
+  return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
+}
+
+void DlShardWriter::AppendRecord(std::string &buffer,
+                                 const std::string &record) {
+  std::string length;
+  AppendLittleEndian(length, record.size(), 8);
+  buffer += length;
+  AppendLittleEndian(buffer, MaskedCrc32c(length.data(), length.size()), 4);
+  buffer += record;
+  AppendLittleEndian(buffer, MaskedCrc32c(record.data(), record.size()), 4);
+}
+
+void DlShardWriter::WriteLoop() {
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (true) {
+    if (m_games.empty() && m_flushRequests == 0 && !m_quit) {
+      if (m_file) {
+        const double left = m_currentStart + m_options.maxShardSeconds - Now();
+        if (left > 0)
+          m_writeCondition.timed_wait(
+              lock, boost::posix_time::milliseconds(
+                  static_cast<long>(left * 1000) + 1));
+      } else
+        m_writeCondition.wait(lock);
+    }
+    std::deque<Game> games;
+    games.swap(m_games);
+    const int flushRequests = m_flushRequests;
+    const bool quit = m_quit;
+    ++m_nuBusy;
+    lock.unlock();
+
+    std::size_t nuWritten = 0;
+    for (std::size_t i = 0; i < games.size(); ++i)
+      if (WriteGame(games[i]))
+        ++nuWritten;
+    if (m_file && (flushRequests > 0 || quit
+                   || Now() - m_currentStart >= m_options.maxShardSeconds))
+      CloseShard();
+
+    lock.lock();
+    for (std::size_t i = 0; i < games.size(); ++i)
+      m_queuedBytes -= games[i].bytes;
+    m_nuGames += nuWritten;
+    m_nuDropped += games.size() - nuWritten;
+    m_flushRequests -= flushRequests;
+    --m_nuBusy;
+    m_idleCondition.notify_all();
+    if (quit && m_games.empty())
+      break;
+  }
+}
+
+bool DlShardWriter::WriteGame(const Game &game) {
+  if (m_file && game.group != m_currentGroup)
+    CloseShard();
+  if (!m_file) {
+    OpenShard(game.group);
+    if (!m_file)
+      return false;
+  }
+  std::string buffer;
+  for (std::size_t i = 0; i < game.records.size(); ++i)
+    AppendRecord(buffer, game.records[i]);
+  if (std::fwrite(buffer.data(), 1, buffer.size(), m_file) != buffer.size()) {
+    // Cut off the partial frame, a reader would take it for a corrupt shard
+    std::fflush(m_file);
+    std::clearerr(m_file);
+    if (ftruncate(fileno(m_file), static_cast<off_t>(m_currentBytes)) != 0
+        || std::fseek(m_file, static_cast<long>(m_currentBytes), SEEK_SET)
+            != 0)
+      DiscardShard();
+    return false;
+  }
+  if (m_options.fsync == FSYNC_EVERY_GAME) {
+    std::fflush(m_file);
+    fsync(fileno(m_file));
+  }
+  m_currentBytes += buffer.size();
+  if (m_currentBytes >= m_options.maxShardBytes)
+    CloseShard();
+  return true;
+}
+
+void DlShardWriter::OpenShard(const std::string &group) {
+  std::ostringstream name;
+  name << m_options.prefix << '_' << getpid() << '_'
+       << static_cast<long>(std::time(0)) << '_' << m_shardIndex++
+       << ".tfrecords";
+  m_current.path = (boost::filesystem::path(m_options.dir) / name.str())
+      .string();
+  m_current.objectName = group.empty() ? name.str() : group + "/" + name.str();
+  m_current.isCompressed = false;
+  m_current.retryTime = 0;
+  m_currentGroup = group;
+  m_currentBytes = 0;
+  m_currentStart = Now();
+  m_file = std::fopen(m_current.path.c_str(), "wb");
+}
+
+void DlShardWriter::CloseShard() {
+  if (m_options.fsync != FSYNC_NEVER) {
+    std::fflush(m_file);
+    fsync(fileno(m_file));
+  }
+  std::fclose(m_file);
+  m_file = 0;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_shards.push_back(m_current);
+    ++m_nuShards;
+  }
+  m_uploadCondition.notify_one();
+}
+
+void DlShardWriter::DiscardShard() {
+  std::fclose(m_file);
+  m_file = 0;
+  boost::system::error_code ec;
+  boost::filesystem::remove(m_current.path, ec);
+}
+
+void DlShardWriter::UploadLoop() {
+  boost::mutex::scoped_lock lock(m_mutex);
+  while (true) {
+    while (m_shards.empty() && !(m_quit && m_nuBusy == 0 && m_games.empty())) {
+      if (!m_failedShards.empty()
+          && m_failedShards.front().retryTime <= Now()) {
+        m_shards.push_back(m_failedShards.front());
+        m_failedShards.pop_front();
+        break;
+      }
+      m_uploadCondition.timed_wait(lock, boost::posix_time::milliseconds(100));
+    }
+    if (m_shards.empty())
+      break;
+    Shard shard = m_shards.front();
+    m_shards.pop_front();
+    ++m_nuBusy;
+    lock.unlock();
+    const bool uploaded = Upload(shard);
+    lock.lock();
+    if (!uploaded) {
+      // Keep the shard on disk, it is uploaded later or by hand
+      ++m_nuUploadFailures;
+      if (m_uploader) {
+        shard.retryTime = Now() + m_options.failedRetryInterval;
+        m_failedShards.push_back(shard);
+      }
+    }
+    --m_nuBusy;
+    m_idleCondition.notify_all();
+  }
+}
+
+std::string DlShardWriter::Compress(const std::string &path) {
+  const std::string gzPath = path + ".gz";
+  std::FILE *in = std::fopen(path.c_str(), "rb");
+  gzFile out = gzopen(gzPath.c_str(), "wb");
+  bool ok = in && out;
+  if (ok) {
+    char buffer[1 << 16];
+    std::size_t n;
+    while (ok && (n = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+      ok = gzwrite(out, buffer, static_cast<unsigned>(n)) == int(n);
+  }
+  if (in)
+    std::fclose(in);
+  if (out)
+    ok = gzclose(out) == Z_OK && ok;
+  boost::system::error_code ec;
+  if (!ok) {
+    boost::filesystem::remove(gzPath, ec);
+    return path;
+  }
+  boost::filesystem::remove(path, ec);
+  return gzPath;
+}
+
+bool DlShardWriter::Upload(Shard &shard) {
+  if (m_options.compress && !shard.isCompressed) {
+    const std::string path = Compress(shard.path);
+    if (path != shard.path) {
+      shard.path = path;
+      shard.objectName += ".gz";
+    }
+    shard.isCompressed = true;
+  }
+  if (!m_uploader)
+    return true;
+  double delay = m_options.retryDelay;
+  for (int attempt = 0; attempt <= m_options.maxRetries; ++attempt) {
+    if (m_uploader(shard.path, shard.objectName)) {
+      boost::system::error_code ec;
+      boost::filesystem::remove(shard.path, ec);
+      return true;
+    }
+    if (attempt < m_options.maxRetries) {
+      boost::this_thread::sleep(
+          boost::posix_time::milliseconds(static_cast<long>(delay * 1000)));
+      delay *= 2;
+    }
+  }
+  return false;
+}
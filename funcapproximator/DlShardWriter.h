@@ -0,0 +1,146 @@
+
+#ifndef UNREALGO_DLSHARDWRITER_H
+#define UNREALGO_DLSHARDWRITER_H
+
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+/** Collects the training records of self-play games into TFRecord shards.
+    AddGame() only queues the records and returns, so the callers never
+    wait for the disk or the network. A writer thread appends the games to
+    the current shard and starts a new shard when it reaches a size or an
+    age, or when the group of the games changes. An upload thread
+    compresses each finished shard with gzip, which TensorFlow reads as
+    compression type "GZIP", and passes it to the uploader with retries.
+    A shard that still fails is kept and tried again after
+    failedRetryInterval seconds.
+    Thread-safe, one instance can take the games of all self-play threads
+    of a process. */
+class DlShardWriter {
+ public:
+  enum FsyncPolicy {
+    FSYNC_NEVER,
+    FSYNC_ON_CLOSE,
+    FSYNC_EVERY_GAME
+  };
+
+  struct Options {
+    Options();
+    /** Directory of the shard files. */
+    std::string dir;
+    std::string prefix;
+    std::size_t maxShardBytes;
+    double maxShardSeconds;
+    FsyncPolicy fsync;
+    bool compress;
+    /** Games queued beyond this number of bytes are dropped. */
+    std::size_t maxQueuedBytes;
+    int maxRetries;
+    double retryDelay;
+    /** Seconds until the next attempt of a shard whose retries failed. */
+    double failedRetryInterval;
+  };
+
+  /** Uploads a finished shard.
+      @param localPath The shard file
+      @param objectName group/file name of the shard
+      @return Whether the upload succeeded */
+  typedef std::function<bool(const std::string &localPath,
+                             const std::string &objectName)> Uploader;
+
+  /** Without an uploader, finished shards stay in options.dir. */
+  explicit DlShardWriter(const Options &options,
+                         const Uploader &uploader = Uploader());
+
+  /** Writes the queued games and waits for the pending uploads. */
+  ~DlShardWriter();
+
+  /** Queue the serialized records of one game.
+      @param group Games of different groups, for instance the checkpoint
+      that played them, go into different shards
+      @return false if the queue was full and the game was dropped */
+  bool AddGame(const std::string &group, std::vector<std::string> &records);
+
+  /** Close the current shard and wait until all queued games are written
+      and all finished shards are uploaded or failed their retries. */
+  void Flush();
+
+  std::size_t NuGames() const;
+  std::size_t NuDroppedGames() const;
+  std::size_t NuShards() const;
+  /** Number of times a shard failed all retries. */
+  std::size_t NuUploadFailures() const;
+
+  /** Append one TFRecord frame: length, masked CRC32C of the length,
+      data, masked CRC32C of the data. */
+  static void AppendRecord(std::string &buffer, const std::string &record);
+
+  static unsigned int MaskedCrc32c(const char *data, std::size_t size);
+
+ private:
+  struct Game {
+    std::string group;
+    std::vector<std::string> records;
+    std::size_t bytes;
+  };
+
+  struct Shard {
+    std::string path;
+    std::string objectName;
+    bool isCompressed;
+    /** Time of the next attempt of a failed shard. */
+    double retryTime;
+  };
+
+  const Options m_options;
+  Uploader m_uploader;
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_writeCondition;
+  boost::condition_variable m_uploadCondition;
+  boost::condition_variable m_idleCondition;
+  std::deque<Game> m_games;
+  std::deque<Shard> m_shards;
+  /** Shards that failed their retries, oldest first. */
+  std::deque<Shard> m_failedShards;
+  std::size_t m_queuedBytes;
+  /** Number of Flush() calls waiting for the writer thread. */
+  int m_flushRequests;
+  /** Games and shards taken from the queues but not finished yet. */
+  int m_nuBusy;
+  bool m_quit;
+  std::size_t m_nuGames;
+  std::size_t m_nuDropped;
+  std::size_t m_nuShards;
+  std::size_t m_nuUploadFailures;
+
+  /** Only used by the writer thread. */
+  std::FILE *m_file;
+  Shard m_current;
+  std::string m_currentGroup;
+  std::size_t m_currentBytes;
+  double m_currentStart;
+  int m_shardIndex;
+
+  boost::thread m_writeThread;
+  boost::thread m_uploadThread;
+
+  void WriteLoop();
+  void UploadLoop();
+  bool WriteGame(const Game &game);
+  void OpenShard(const std::string &group);
+  void CloseShard();
+  void DiscardShard();
+  bool IsIdle() const;
+  std::string Compress(const std::string &path);
+  bool Upload(Shard &shard);
+  DlShardWriter(const DlShardWriter &);
+  DlShardWriter &operator=(const DlShardWriter &);
+};
+
+#endif //UNREALGO_DLSHARDWRITER_H
@@ -8,6 +8,14 @@
 #include <tensorflow/c/c_api_internal.h>
 #include <tensorflow/core/graph/graph_def_builder.h>
 #include <tensorflow/cc/ops/const_op.h>
+#include <tensorflow/core/lib/hash/hash.h>
+#include <tensorflow/core/lib/io/path.h>
+#include <tensorflow/core/platform/env.h>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
 #include "tensorflow/cc/saved_model/tag_constants.h"
 #include "tensorflow/cc/saved_model/loader.h"
 #include "DlTFNetworkEvaluator.h"
@@ -23,6 +31,17 @@ using namespace tensorflow::gtl;
 template class DlTFNetworkEvaluator<bool>;
 template class DlTFNetworkEvaluator<float>;
 
+namespace {
+
+/** Part of the key of cached optimized graphs, change it with the
+    optimizations. */
+const int GRAPH_OPTIMIZATION_VERSION = 2;
+
+/** Largest difference of an output of the optimized graph. */
+const float OPTIMIZED_GRAPH_TOLERANCE = 1e-3f;
+
+}
+
 template <typename T>
 DlTFNetworkEvaluator<T>::DlTFNetworkEvaluator(const string& graphPath, DataFormat _df) :
     m_dataFormat(_df),
@@ -31,6 +50,7 @@ DlTFNetworkEvaluator<T>::DlTFNetworkEvaluator(const string& graphPath, DataForma
     graph_type(GT_UNKNOWN),
     checkpoint_path("bootstrap-ckpt"),
     input_name("feature_input"),
+    m_optimizeGraph(false),
     m_outputs({"resnet/tower_0/policy_head/policy_predict",
                "resnet/tower_0/value_head/reward_predict"}) {
 //  m_outputs.emplace_back("policy_head/policy");
@@ -48,6 +68,7 @@ DlTFNetworkEvaluator<T>::DlTFNetworkEvaluator(const string& graphPath, const str
     graph_type(GT_UNKNOWN),
     checkpoint_path("bootstrap-ckpt"),
     input_name(feature_input),
+    m_optimizeGraph(false),
     m_outputs(outputs) {
   LoadGraph(graphPath);
 }
@@ -63,6 +84,14 @@ void DlTFNetworkEvaluator<T>::SetNetworkOutput(std::vector<std::string>& output)
   m_outputs = output;
 }
 
+template <typename T>
+void DlTFNetworkEvaluator<T>::SetGraphOptimization(bool optimize, const std::string& cacheDir) {
+  m_optimizeGraph = optimize;
+  m_graphCacheDir = cacheDir;
+  if (!optimize)
+    m_optimizedSession.reset();
+}
+
 template <typename T>
 DlTFNetworkEvaluator<T>::~DlTFNetworkEvaluator() {
   m_session->Close();
@@ -75,6 +104,8 @@ void DlTFNetworkEvaluator<T>::WritePbText(const std::string& path) {
 
 template <typename T>
 bool DlTFNetworkEvaluator<T>::LoadGraph(const string& graphPath) {
+  m_optimizedSession.reset();
+  graph_path = graphPath;
   if (tensorflow::StringPiece(graphPath).ends_with(".meta"))
     return LoadMetaGraph(graphPath);
   else if (tensorflow::StringPiece(graphPath).ends_with(".pb"))
@@ -82,6 +113,16 @@ bool DlTFNetworkEvaluator<T>::LoadGraph(const string& graphPath) {
   return false;
 }
 
+template <typename T>
+Session* DlTFNetworkEvaluator<T>::CreateSession() {
+  auto sessOpt = SessionOptions();
+  sessOpt.config.set_allow_soft_placement(true);
+  auto* gpuOptions = new GPUOptions();
+  gpuOptions->set_allow_growth(allow_growth);
+  sessOpt.config.set_allocated_gpu_options(gpuOptions);
+  return NewSession(sessOpt);
+}
+
 template <typename T>
 bool DlTFNetworkEvaluator<T>::LoadPbGraph(const string& graphPath) {
   graph_type = GT_PB;
@@ -93,12 +134,7 @@ bool DlTFNetworkEvaluator<T>::LoadPbGraph(const string& graphPath) {
 
   DlGraphUtil::WriteToFile(graph_def, "graph.txt");
 
-  auto sessOpt = SessionOptions();
-  sessOpt.config.set_allow_soft_placement(true);
-  auto* gpuOptions = new GPUOptions();
-  gpuOptions->set_allow_growth(allow_growth);
-  sessOpt.config.set_allocated_gpu_options(gpuOptions);
-  m_session.reset(NewSession(sessOpt));
+  m_session.reset(CreateSession());
   if (m_session == nullptr) {
     throw runtime_error("Could not create Tensorflow session.");
   }
@@ -115,12 +151,7 @@ template <typename T>
 bool DlTFNetworkEvaluator<T>::LoadMetaGraph(const string& metaGraphPath) {
   graph_type = GT_META;
 
-  auto sessOpt = SessionOptions();
-  sessOpt.config.set_allow_soft_placement(true);
-  auto* gpuOptions = new GPUOptions();
-  gpuOptions->set_allow_growth(allow_growth);
-  sessOpt.config.set_allocated_gpu_options(gpuOptions);
-  m_session.reset(NewSession(sessOpt));
+  m_session.reset(CreateSession());
   if (m_session == nullptr) {
     throw runtime_error("Could not create Tensorflow session.");
   }
@@ -228,11 +259,106 @@ bool DlTFNetworkEvaluator<T>::UpdateCheckPointForPbGraph(const string& checkpoin
 
 template <typename T>
 bool DlTFNetworkEvaluator<T>::UpdateCheckPoint(const string& checkpointPath) {
+  bool updated = false;
   if (graph_type == GT_META)
-    return UpdateCheckPointForMetaGraph(checkpointPath);
+    updated = UpdateCheckPointForMetaGraph(checkpointPath);
   else if (graph_type == GT_PB)
-    return UpdateCheckPointForPbGraph(checkpointPath);
-  return false;
+    updated = UpdateCheckPointForPbGraph(checkpointPath);
+  m_optimizedSession.reset();
+  if (updated && m_optimizeGraph)
+    OptimizeGraph(graph_type == GT_META ? checkpoint_path : checkpointPath);
+  return updated;
+}
+
+template <typename T>
+std::string DlTFNetworkEvaluator<T>::OptimizedGraphKey(const string& checkpointPath) {
+  uint64 hash = Hash64(input_name + ":" + std::to_string(m_dataFormat)
+                       + ":" + std::to_string(GRAPH_OPTIMIZATION_VERSION));
+  for (const std::string& output : m_outputs)
+    hash = Hash64(output.data(), output.size(), hash);
+  // The index of a checkpoint has the checksums of its variables
+  std::string checkpointFile = checkpointPath + ".index";
+  if (!Env::Default()->FileExists(checkpointFile).ok())
+    checkpointFile = checkpointPath;
+  for (const std::string& path : {graph_path, checkpointFile}) {
+    std::string content;
+    if (!ReadFileToString(Env::Default(), path, &content).ok())
+      return "";
+    hash = Hash64(content.data(), content.size(), hash);
+  }
+  std::ostringstream key;
+  key << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return key.str();
+}
+
+template <typename T>
+bool DlTFNetworkEvaluator<T>::OptimizeGraph(const string& checkpointPath) {
+  const std::string key = OptimizedGraphKey(checkpointPath);
+  const std::string cachePath = m_graphCacheDir.empty() || key.empty()
+                                ? "" : io::JoinPath(m_graphCacheDir, key + ".pb");
+  GraphDef optimized;
+  const bool cached = !cachePath.empty() && ReadBinaryProto(Env::Default(), cachePath, &optimized).ok();
+  if (!cached) {
+    // The batch size stays open, the search evaluates partial batches
+    std::vector<int64> inputDims({-1, BD_SIZE, BD_SIZE, NUM_MAPS});
+    if (m_dataFormat == DF_CHW)
+      inputDims = {-1, NUM_MAPS, BD_SIZE, BD_SIZE};
+    const GraphDef& graph = graph_type == GT_META ? meta_graph_def.graph_def() : graph_def;
+    if (!DlGraphUtil::OptimizeForInference(*m_session, graph, input_name, m_outputs, inputDims, optimized)) {
+      LOG(WARNING) << "DlTFNetworkEvaluator: could not optimize the graph";
+      return false;
+    }
+  }
+  std::unique_ptr<Session> session(CreateSession());
+  Status status = session->Create(optimized);
+  if (!status.ok()) {
+    LOG(WARNING) << "DlTFNetworkEvaluator: optimized graph: " << status;
+    return false;
+  }
+  if (!CheckOptimizedGraph(*session)) {
+    LOG(WARNING) << "DlTFNetworkEvaluator: optimized graph differs, using the graph as exported";
+    return false;
+  }
+  if (!cached && !cachePath.empty()) {
+    status = Env::Default()->RecursivelyCreateDir(m_graphCacheDir);
+    if (status.ok())
+      status = WriteBinaryProto(Env::Default(), cachePath, optimized);
+    if (!status.ok())
+      LOG(WARNING) << "DlTFNetworkEvaluator: could not cache the optimized graph: " << status;
+  }
+  m_optimizedSession = std::move(session);
+  return true;
+}
+
+template <typename T>
+bool DlTFNetworkEvaluator<T>::CheckOptimizedGraph(Session& optimized) {
+  Tensor input(DataTypeToEnum<T>::v(), m_dataFormat == DF_CHW
+                                       ? TensorShape({MAX_BATCHES, NUM_MAPS, BD_SIZE, BD_SIZE})
+                                       : TensorShape({MAX_BATCHES, BD_SIZE, BD_SIZE, NUM_MAPS}));
+  std::mt19937 random(1);
+  auto data = input.flat<T>();
+  for (int64 i = 0; i < data.size(); ++i)
+    data(i) = (T)(random() % 4 == 0);
+  std::vector<Tensor> expected;
+  std::vector<Tensor> actual;
+  Status status = m_session->Run({{input_name, input}}, m_outputs, {}, &expected);
+  if (status.ok())
+    status = optimized.Run({{input_name, input}}, m_outputs, {}, &actual);
+  if (!status.ok()) {
+    LOG(WARNING) << "DlTFNetworkEvaluator: checking the optimized graph: " << status;
+    return false;
+  }
+  float maxError = 0;
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    if (i >= actual.size() || actual[i].NumElements() != expected[i].NumElements())
+      return false;
+    auto e = expected[i].flat<float>();
+    auto a = actual[i].flat<float>();
+    for (int64 j = 0; j < e.size(); ++j)
+      maxError = std::max(maxError, std::fabs(e(j) - a(j)));
+  }
+  LOG(INFO) << "DlTFNetworkEvaluator: optimized graph, largest difference " << maxError;
+  return maxError <= OPTIMIZED_GRAPH_TOLERANCE;
 }
 
 template <typename T>
@@ -292,7 +418,8 @@ void DlTFNetworkEvaluator<T>::Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE
   TransformFeature(feature, numBatches);
   std::vector<Tensor> outputs;
   string input_layer = input_name;
-  Status run_status = m_session->Run({{input_layer, m_input_tensors[numBatches - 1]}}, m_outputs, {}, &outputs);
+  Session* session = m_optimizedSession ? m_optimizedSession.get() : m_session.get();
+  Status run_status = session->Run({{input_layer, m_input_tensors[numBatches - 1]}}, m_outputs, {}, &outputs);
 
   if (run_status.ok() && outputs.size() >= 2) {
     DlTensorUtil<float>::GetValue(outputs[0], policies_[0], GO_MAX_MOVES * numBatches);
@@ -326,7 +453,8 @@ void DlTFNetworkEvaluator<T>::Evaluate(char feature[][BD_SIZE][BD_SIZE][NUM_MAPS
   TransformFeature(feature, numBatches);
   std::vector<Tensor> outputs;
   string input_layer = input_name;
-  Status run_status = m_session->Run({{input_layer, m_input_tensors[numBatches - 1]}}, m_outputs, {}, &outputs);
+  Session* session = m_optimizedSession ? m_optimizedSession.get() : m_session.get();
+  Status run_status = session->Run({{input_layer, m_input_tensors[numBatches - 1]}}, m_outputs, {}, &outputs);
 
   if (run_status.ok() && outputs.size() >= 2) {
     DlTensorUtil<float>::GetValue(outputs[0], policies_[0], GO_MAX_MOVES * numBatches);
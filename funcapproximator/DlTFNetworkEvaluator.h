@@ -8,11 +8,7 @@
 
 #include "config/BoardStaticConfig.h"
 #include "funcapproximator/DataFormat.h"
-
-const int BD_SIZE = GO_DEFINE_MAX_SIZE;
-const int NUM_MAPS = 17;
-const int FEATURE_SIZE = BD_SIZE * BD_SIZE * NUM_MAPS;
-const int MAX_BATCHES = 16; // fixed for tf metagraph
+#include "funcapproximator/DlNetworkEvaluator.h"
 
 struct TF_Tensor;
 namespace tensorflow {
@@ -30,14 +26,14 @@ using namespace tensorflow;
 using namespace std;
 
 template <typename T>
-class DlTFNetworkEvaluator {
+class DlTFNetworkEvaluator : public DlNetworkEvaluator {
  public:
   explicit DlTFNetworkEvaluator(const string& graphPath, DataFormat _df=DF_HWC);
   DlTFNetworkEvaluator(const string& graphPath, const string& feature_input,
                         const vector<string>& outputs, DataFormat _df=DF_HWC);
-  ~DlTFNetworkEvaluator();
+  virtual ~DlTFNetworkEvaluator();
   void CreateTensor(int batches);
-  void Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
+  virtual void Evaluate(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE],
                 double actions_[][GO_MAX_MOVES],
                 double value_[],
                 int numBatches = MAX_BATCHES);
@@ -53,31 +49,45 @@ class DlTFNetworkEvaluator {
   void TransformFeature(char feature[][NUM_MAPS][BD_SIZE][BD_SIZE], int numBatches = MAX_BATCHES);
   void TransformFeature(char feature[][BD_SIZE][BD_SIZE][NUM_MAPS], int numBatches = MAX_BATCHES);
   void WritePbText(const std::string& path);
-  bool LoadGraph(const string& graphPath);
-  bool UpdateCheckPoint(const string& checkpointPath); // load the checkpoint, model parameters
+  virtual bool LoadGraph(const string& graphPath);
+  virtual bool UpdateCheckPoint(const string& checkpointPath); // load the checkpoint, model parameters
 
-  bool MetaGraphLoaded();
+  virtual bool MetaGraphLoaded();
   tensorflow::MetaGraphDef& GetMetaGraph();
 
   void SetNetworkInput(std::string input);
   void SetNetworkOutput(std::vector<std::string>& output);
+  /** Evaluate with an inference graph built by DlGraphUtil::OptimizeForInference
+      after each checkpoint. The
+      graph is used only if it computes the same outputs on sample
+      positions. Optimized graphs are cached in cacheDir, keyed by a hash of
+      the graph and checkpoint files; no cache if cacheDir is empty. */
+  void SetGraphOptimization(bool optimize, const std::string& cacheDir);
 
  protected:
   bool LoadPbGraph(const string& graphPath); // load graph
   bool LoadMetaGraph(const string& metaGraphPath); // load graph
   bool UpdateCheckPointForMetaGraph(const string& checkpointPath);
   bool UpdateCheckPointForPbGraph(const string& checkpointPath);
+  Session* CreateSession();
+  bool OptimizeGraph(const string& checkpointPath);
+  std::string OptimizedGraphKey(const string& checkpointPath);
+  bool CheckOptimizedGraph(Session& optimized);
 
  protected:
   DataFormat m_dataFormat;
   bool allow_growth;
   bool graph_loaded;
   GraphType graph_type;
+  std::string graph_path;
   std::string checkpoint_path;
   std::string input_name;
   tensorflow::GraphDef graph_def;
   tensorflow::MetaGraphDef meta_graph_def;
   std::unique_ptr<Session> m_session;
+  bool m_optimizeGraph;
+  std::string m_graphCacheDir;
+  std::unique_ptr<Session> m_optimizedSession;
   std::vector<std::string> m_outputs;
   Tensor m_input_tensors[MAX_BATCHES];
 };
@@ -56,7 +56,16 @@ DlTFRecordWriter::AddFloatList(Features& features, Feature& feature, const strin
       google::protobuf::Map<::std::string, ::tensorflow::Feature>::value_type(key, feature));
 }
 
-int DlTFRecordWriter::WriteExample(char* feature17, size_t f_len, float* policy, size_t p_size, float reward) {
+void DlTFRecordWriter::AddInt64List(Features& features, Feature& feature, const string& key, int value) {
+  auto* int64List = new Int64List;
+  int64List->add_value(value);
+  feature.set_allocated_int64_list(int64List);
+  features.mutable_feature()->insert(
+      google::protobuf::Map<::std::string, ::tensorflow::Feature>::value_type(key, feature));
+}
+
+string DlTFRecordWriter::SerializeExample(char* feature17, size_t f_len, float* policy, size_t p_size, float reward,
+                                          int gameStart) {
   Example example;
   auto* features = new Features;
   Feature feature;
@@ -69,12 +78,24 @@ int DlTFRecordWriter::WriteExample(char* feature17, size_t f_len, float* policy,
   AddFloatList(*features, feature, "reward", &reward, 1);
   feature.clear_float_list();
 
+  if (gameStart >= 0) {
+    AddInt64List(*features, feature, "game_start", gameStart);
+    feature.clear_int64_list();
+  }
+
   example.set_allocated_features(features);
-  m_recordWriter->WriteRecord(example.SerializeAsString());
+  return example.SerializeAsString();
+}
 
+int DlTFRecordWriter::WriteExample(char* feature17, size_t f_len, float* policy, size_t p_size, float reward) {
+  WriteRecord(SerializeExample(feature17, f_len, policy, p_size, reward));
   return 0;
 }
 
+void DlTFRecordWriter::WriteRecord(const string& record) {
+  m_recordWriter->WriteRecord(record);
+}
+
 int DlTFRecordWriter::WriteExample(
     const string& feature_name, char* feature17, size_t f_len,
     const string& policy_name, float* policy, size_t p_size,
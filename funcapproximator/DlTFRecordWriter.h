@@ -16,14 +16,21 @@ class DlTFRecordWriter {
   int WriteExample(const string& feature_name, char* feature17, size_t f_len,
                    const string& policy_name, float* policy, size_t p_size,
                    const string& reward_name, float reward);
+  void WriteRecord(const string& record);
+  /** Serialized Example of WriteExample, for writers of their own.
+      @param gameStart Value of the int64 feature "game_start", 1 for the
+      first position of a game; a negative value leaves it out */
+  static string SerializeExample(char* feature17, size_t f_len, float* policy, size_t p_size, float reward,
+                                 int gameStart = -1);
   explicit DlTFRecordWriter(const string& filename);
   ~DlTFRecordWriter();
   void Flush();
 
  protected:
 
-  void AddByteList(Features& features, Feature& feature, const string& key, char* bytes, size_t len);
-  void AddFloatList(Features& features, Feature& feature, const string& key, float* floats, size_t len);
+  static void AddByteList(Features& features, Feature& feature, const string& key, char* bytes, size_t len);
+  static void AddFloatList(Features& features, Feature& feature, const string& key, float* floats, size_t len);
+  static void AddInt64List(Features& features, Feature& feature, const string& key, int value);
   tensorflow::io::PyRecordWriter* m_recordWriter;
 };
 }
@@ -0,0 +1,240 @@
+
+#include "platform/SgSystem.h"
+#include "funcapproximator/DlCpuNetworkEvaluator.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+
+namespace {
+
+const int POINTS = BD_SIZE * BD_SIZE;
+
+struct Batch {
+  char m_feature[MAX_BATCHES][NUM_MAPS][BD_SIZE][BD_SIZE];
+  double m_policy[MAX_BATCHES][GO_MAX_MOVES];
+  double m_value[MAX_BATCHES];
+};
+
+void Randomize(std::vector<float> &values, std::mt19937 &random, float low, float high) {
+  std::uniform_real_distribution<float> distribution(low, high);
+  for (float &v : values)
+    v = distribution(random);
+}
+
+/** Small network with random weights and batch normalization. 5 filters, so
+    the matrix product has a remainder after its blocks of four rows. */
+DlCpuNetworkWeights RandomWeights() {
+  std::mt19937 random(42);
+  DlCpuNetworkWeights weights;
+  weights.Resize(5, 2, 2, 1, 4);
+  for (DlCpuNetworkWeights::Conv &conv : weights.m_convs) {
+    Randomize(conv.m_weights, random, -0.3f, 0.3f);
+    Randomize(conv.m_bias, random, -0.1f, 0.1f);
+    Randomize(conv.m_mean, random, -0.2f, 0.2f);
+    Randomize(conv.m_variance, random, 0.5f, 2.0f);
+    Randomize(conv.m_gamma, random, 0.5f, 1.5f);
+    Randomize(conv.m_beta, random, -0.1f, 0.1f);
+  }
+  Randomize(weights.m_policyWeights, random, -0.1f, 0.1f);
+  Randomize(weights.m_policyBias, random, -0.1f, 0.1f);
+  Randomize(weights.m_valueWeights1, random, -0.1f, 0.1f);
+  Randomize(weights.m_valueBias1, random, -0.1f, 0.1f);
+  Randomize(weights.m_valueWeights2, random, -1.0f, 1.0f);
+  weights.m_valueBias2 = 0.1f;
+  return weights;
+}
+
+/** Direct convolution followed by unfolded batch normalization and ReLU. */
+std::vector<float> Reference(const DlCpuNetworkWeights::Conv &conv, float epsilon,
+                             const std::vector<float> &in,
+                             const std::vector<float> *residual) {
+  std::vector<float> out(conv.m_out * POINTS);
+  const int k = conv.m_kernel;
+  for (int o = 0; o < conv.m_out; ++o)
+    for (int y = 0; y < BD_SIZE; ++y)
+      for (int x = 0; x < BD_SIZE; ++x) {
+        double sum = conv.m_bias[o];
+        for (int c = 0; c < conv.m_in; ++c)
+          for (int ky = 0; ky < k; ++ky)
+            for (int kx = 0; kx < k; ++kx) {
+              const int sy = y + ky - k / 2;
+              const int sx = x + kx - k / 2;
+              if (sy < 0 || sy >= BD_SIZE || sx < 0 || sx >= BD_SIZE)
+                continue;
+              sum += conv.m_weights[((o * conv.m_in + c) * k + ky) * k + kx]
+                     * in[(c * BD_SIZE + sy) * BD_SIZE + sx];
+            }
+        const int i = (o * BD_SIZE + y) * BD_SIZE + x;
+        double v = (sum - conv.m_mean[o]) / std::sqrt(conv.m_variance[o] + epsilon)
+                   * conv.m_gamma[o] + conv.m_beta[o];
+        if (residual)
+          v += (*residual)[i];
+        out[i] = static_cast<float>(std::max(v, 0.0));
+      }
+  return out;
+}
+
+void ReferenceForward(const DlCpuNetworkWeights &w,
+                      char feature[NUM_MAPS][BD_SIZE][BD_SIZE],
+                      std::vector<double> &policy, double &value) {
+  std::vector<float> x(NUM_MAPS * POINTS);
+  for (int c = 0; c < NUM_MAPS; ++c)
+    for (int i = 0; i < POINTS; ++i)
+      x[c * POINTS + i] = feature[c][i / BD_SIZE][i % BD_SIZE];
+  x = Reference(w.m_convs[0], w.m_bnEpsilon, x, nullptr);
+  for (int b = 0; b < w.m_blocks; ++b) {
+    std::vector<float> y = Reference(w.m_convs[2 * b + 1], w.m_bnEpsilon, x, nullptr);
+    x = Reference(w.m_convs[2 * b + 2], w.m_bnEpsilon, y, &x);
+  }
+  std::vector<float> p = Reference(w.PolicyConv(), w.m_bnEpsilon, x, nullptr);
+  policy.assign(GO_MAX_MOVES, 0);
+  double sum = 0;
+  for (int m = 0; m < GO_MAX_MOVES; ++m) {
+    double logit = w.m_policyBias[m];
+    for (size_t j = 0; j < p.size(); ++j)
+      logit += w.m_policyWeights[m * p.size() + j] * p[j];
+    policy[m] = std::exp(logit);
+    sum += policy[m];
+  }
+  for (double &v : policy)
+    v /= sum;
+  std::vector<float> v = Reference(w.ValueConv(), w.m_bnEpsilon, x, nullptr);
+  double out = w.m_valueBias2;
+  for (int h = 0; h < w.m_valueHidden; ++h) {
+    double hidden = w.m_valueBias1[h];
+    for (size_t j = 0; j < v.size(); ++j)
+      hidden += w.m_valueWeights1[h * v.size() + j] * v[j];
+    out += w.m_valueWeights2[h] * std::max(hidden, 0.0);
+  }
+  value = std::tanh(out);
+}
+
+void RandomFeatures(Batch &batch, int numBatches) {
+  std::mt19937 random(7);
+  for (int i = 0; i < numBatches; ++i)
+    for (int c = 0; c < NUM_MAPS; ++c)
+      for (int y = 0; y < BD_SIZE; ++y)
+        for (int x = 0; x < BD_SIZE; ++x)
+          batch.m_feature[i][c][y][x] = (random() % 3 == 0) ? 1 : 0;
+}
+
+void CheckAgainstReference(const DlCpuNetworkWeights &weights,
+                           DlCpuNetworkEvaluator &evaluator, int numBatches,
+                           double valueTolerance = 1e-4,
+                           double policyTolerance = 1e-5) {
+  std::unique_ptr<Batch> batch(new Batch());
+  RandomFeatures(*batch, numBatches);
+  evaluator.Evaluate(batch->m_feature, batch->m_policy, batch->m_value, numBatches);
+  for (int i = 0; i < numBatches; ++i) {
+    std::vector<double> policy;
+    double value;
+    ReferenceForward(weights, batch->m_feature[i], policy, value);
+    BOOST_CHECK_SMALL(batch->m_value[i] - value, valueTolerance);
+    double sum = 0;
+    for (int m = 0; m < GO_MAX_MOVES; ++m) {
+      BOOST_CHECK_SMALL(batch->m_policy[i][m] - policy[m], policyTolerance);
+      sum += batch->m_policy[i][m];
+    }
+    BOOST_CHECK_CLOSE(sum, 1.0, 1e-6);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_MatchesReference) {
+  const DlCpuNetworkWeights weights = RandomWeights();
+  DlCpuNetworkEvaluator evaluator;
+  evaluator.SetWeights(weights);
+  CheckAgainstReference(weights, evaluator, 3);
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_Threads) {
+  const DlCpuNetworkWeights weights = RandomWeights();
+  DlCpuNetworkEvaluator evaluator(3);
+  evaluator.SetWeights(weights);
+  CheckAgainstReference(weights, evaluator, 5);
+  // The workers are reused, also when the batch has fewer positions
+  CheckAgainstReference(weights, evaluator, 2);
+  CheckAgainstReference(weights, evaluator, 4);
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_ParsePrecision) {
+  DlCpuNetworkEvaluator::Precision precision;
+  BOOST_CHECK(DlCpuNetworkEvaluator::ParsePrecision("int8", precision));
+  BOOST_CHECK_EQUAL(precision, DlCpuNetworkEvaluator::PRECISION_INT8);
+  BOOST_CHECK(DlCpuNetworkEvaluator::ParsePrecision("fp32", precision));
+  BOOST_CHECK_EQUAL(precision, DlCpuNetworkEvaluator::PRECISION_FP32);
+  BOOST_CHECK(!DlCpuNetworkEvaluator::ParsePrecision("FP16", precision));
+  BOOST_CHECK(!DlCpuNetworkEvaluator::ParsePrecision("", precision));
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_NoWeights) {
+  DlCpuNetworkEvaluator evaluator(2);
+  std::unique_ptr<Batch> batch(new Batch());
+  BOOST_CHECK_THROW(evaluator.Evaluate(batch->m_feature, batch->m_policy,
+                                       batch->m_value, 2),
+                    std::runtime_error);
+}
+
+std::vector<DlTrainingExample> RandomSamples(int count) {
+  std::unique_ptr<Batch> batch(new Batch());
+  RandomFeatures(*batch, count);
+  std::vector<DlTrainingExample> samples(count);
+  for (int i = 0; i < count; ++i)
+    std::memcpy(samples[i].feature, batch->m_feature[i], sizeof(samples[i].feature));
+  return samples;
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_Fp16) {
+  const DlCpuNetworkWeights weights = RandomWeights();
+  DlCpuNetworkEvaluator evaluator(1, DlCpuNetworkEvaluator::PRECISION_FP16);
+  evaluator.SetWeights(weights);
+  CheckAgainstReference(weights, evaluator, 2, 1e-3, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_Int8) {
+  const DlCpuNetworkWeights weights = RandomWeights();
+  DlCpuNetworkEvaluator evaluator(1, DlCpuNetworkEvaluator::PRECISION_INT8);
+  evaluator.SetWeights(weights);
+  const std::vector<DlTrainingExample> samples = RandomSamples(MAX_BATCHES);
+  evaluator.Calibrate(samples);
+  CheckAgainstReference(weights, evaluator, 2, 2e-2, 1e-3);
+  const DlAccuracyReport report = evaluator.AccuracyReport(samples);
+  BOOST_CHECK_EQUAL(report.m_positions, MAX_BATCHES);
+  BOOST_CHECK_GE(report.m_policyTop1Agreement, 0.75);
+  BOOST_CHECK_LT(report.m_valueMse, 1e-3);
+
+  // The same weights in FP32 agree exactly
+  evaluator.SetPrecision(DlCpuNetworkEvaluator::PRECISION_FP32);
+  const DlAccuracyReport exact = evaluator.AccuracyReport(samples);
+  BOOST_CHECK_EQUAL(exact.m_policyTop1Agreement, 1.0);
+  BOOST_CHECK_EQUAL(exact.m_valueMse, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(DlCpuNetworkEvaluatorTest_ReadWrite) {
+  const std::string checkpoint = (boost::filesystem::temp_directory_path()
+                                  / boost::filesystem::unique_path()).string();
+  const std::string path = DlCpuNetworkEvaluator::WeightsPath(checkpoint);
+  BOOST_CHECK_EQUAL(DlCpuNetworkEvaluator::WeightsPath(path), path);
+  const DlCpuNetworkWeights weights = RandomWeights();
+  BOOST_REQUIRE(weights.Write(path));
+  DlCpuNetworkEvaluator evaluator;
+  BOOST_CHECK(!evaluator.HasWeights());
+  BOOST_CHECK(evaluator.UpdateCheckPoint(checkpoint));
+  BOOST_CHECK(evaluator.MetaGraphLoaded());
+  CheckAgainstReference(weights, evaluator, 1);
+
+  // Truncated export
+  boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 4);
+  DlCpuNetworkWeights truncated;
+  BOOST_CHECK(!truncated.Read(path));
+  boost::filesystem::remove(path);
+  BOOST_CHECK(!evaluator.UpdateCheckPoint(checkpoint));
+}
+
+}
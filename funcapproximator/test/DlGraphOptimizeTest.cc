@@ -0,0 +1,141 @@
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/session.h"
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <DlGraphUtil.h>
+
+using tensorflow::Tensor;
+using tensorflow::Status;
+using namespace tensorflow;
+using namespace tensorflow::ops;
+using namespace std;
+
+namespace {
+
+const int SIZE = 3;
+const int CHANNELS = 2;
+const int FILTERS = 3;
+
+/** input -> Identity -> Conv2D with variable weights -> FusedBatchNorm
+    -> Relu -> Conv2D -> Mul -> Add -> output. */
+GraphDef BuildGraph() {
+  Scope root = Scope::NewRootScope();
+  auto input = Placeholder(root.WithOpName("input"), DT_FLOAT);
+  auto x = Identity(root.WithOpName("input/identity"), input);
+  auto weights = Variable(root.WithOpName("weights"), PartialTensorShape({1, 1, CHANNELS, FILTERS}), DT_FLOAT);
+  Assign(root.WithOpName("assign_weights"), weights,
+         Const(root, {0.5f, -1.f, 2.f, 1.5f, 0.25f, -0.5f}, TensorShape({1, 1, CHANNELS, FILTERS})));
+  auto read = Identity(root.WithOpName("weights/read"), weights);
+  auto conv1 = Conv2D(root.WithOpName("conv1"), x, read, {1, 1, 1, 1}, "SAME");
+  auto bn1 = FusedBatchNorm(root.WithOpName("bn1"), conv1,
+                            Const(root, {1.f, 2.f, 0.5f}), Const(root, {0.1f, -0.2f, 0.3f}),
+                            Const(root, {0.2f, 0.f, -1.f}), Const(root, {1.f, 4.f, 0.25f}),
+                            FusedBatchNorm::IsTraining(false));
+  auto relu = Relu(root.WithOpName("relu"), bn1.y);
+  auto conv2 = Conv2D(root.WithOpName("conv2"), relu,
+                      Const(root, {1.f, -1.f, 0.5f, 2.f, 0.f, 1.f, -0.5f, 1.f, 0.25f},
+                            TensorShape({1, 1, FILTERS, FILTERS})),
+                      {1, 1, 1, 1}, "SAME");
+  auto mul = Mul(root.WithOpName("bn2/mul"), conv2, Const(root, {2.f, 0.5f, -1.f}));
+  auto add = Add(root.WithOpName("bn2"), mul, Const(root, {0.f, 1.f, -0.5f}));
+  Identity(root.WithOpName("output"), add);
+  GraphDef graphDef;
+  TF_CHECK_OK(root.ToGraphDef(&graphDef));
+  return graphDef;
+}
+
+Tensor RandomInput(int batches) {
+  Tensor input(DT_FLOAT, TensorShape({batches, SIZE, SIZE, CHANNELS}));
+  std::mt19937 random(batches);
+  std::uniform_real_distribution<float> uniform(-1, 1);
+  auto data = input.flat<float>();
+  for (int64 i = 0; i < data.size(); ++i)
+    data(i) = uniform(random);
+  return input;
+}
+
+Tensor Run(Session& session, const Tensor& input) {
+  std::vector<Tensor> outputs;
+  TF_CHECK_OK(session.Run({{"input", input}}, {"output"}, {}, &outputs));
+  CHECK_EQ(outputs.size(), 1u);
+  return outputs[0];
+}
+
+std::unique_ptr<Session> CreateSession(const GraphDef& graphDef) {
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_CHECK_OK(session->Create(graphDef));
+  return session;
+}
+
+void CheckSameOutput(Session& expected, const GraphDef& graphDef, int batches) {
+  std::unique_ptr<Session> session = CreateSession(graphDef);
+  const Tensor input = RandomInput(batches);
+  const Tensor e = Run(expected, input);
+  const Tensor a = Run(*session, input);
+  CHECK_EQ(e.NumElements(), a.NumElements());
+  for (int64 i = 0; i < e.NumElements(); ++i)
+    CHECK_LE(std::fabs(e.flat<float>()(i) - a.flat<float>()(i)), 1e-5);
+}
+
+int CountOps(const GraphDef& graphDef, const std::string& op) {
+  int count = 0;
+  for (const NodeDef& node : graphDef.node())
+    if (node.op() == op)
+      ++count;
+  return count;
+}
+
+void Test() {
+  const GraphDef graphDef = BuildGraph();
+  std::unique_ptr<Session> session = CreateSession(graphDef);
+  TF_CHECK_OK(session->Run({}, {}, {"assign_weights"}, nullptr));
+
+  // The variable, its assignment and the training nodes are gone
+  GraphDef frozen;
+  CHECK(DlGraphUtil::FreezeGraph(*session, graphDef, "input", {"output"}, frozen));
+  CHECK_EQ(CountOps(frozen, "VariableV2"), 0);
+  CHECK_EQ(CountOps(frozen, "Assign"), 0);
+  CHECK(DlGraphUtil::GetNode(frozen, "assign_weights") == nullptr);
+  CHECK_EQ(DlGraphUtil::GetNode(frozen, "weights/read")->op(), "Const");
+  CheckSameOutput(*session, frozen, 2);
+  GraphDef unused;
+  CHECK(!DlGraphUtil::FreezeGraph(*session, graphDef, "no_input", {"output"}, unused));
+
+  // The identity after the input goes, the output is kept
+  CHECK_EQ(DlGraphUtil::RemoveIdentityNodes(frozen, {"input", "output"}), 1);
+  CHECK(DlGraphUtil::GetNode(frozen, "input/identity") == nullptr);
+  CHECK_EQ(DlGraphUtil::GetNode(frozen, "output")->op(), "Identity");
+  CHECK_EQ(DlGraphUtil::GetNode(frozen, "conv1")->input(0), "input");
+  CheckSameOutput(*session, frozen, 2);
+
+  // The fused and the unfused batch normalization
+  CHECK_EQ(DlGraphUtil::FoldBatchNorm(frozen), 2);
+  CHECK_EQ(CountOps(frozen, "FusedBatchNorm"), 0);
+  CHECK_EQ(CountOps(frozen, "Mul"), 0);
+  CHECK_EQ(DlGraphUtil::GetNode(frozen, "bn1")->op(), "BiasAdd");
+  CHECK_EQ(DlGraphUtil::GetNode(frozen, "bn2")->op(), "BiasAdd");
+  CheckSameOutput(*session, frozen, 2);
+  CHECK_EQ(DlGraphUtil::FoldBatchNorm(frozen), 0);
+
+  // An open batch size evaluates any batch
+  GraphDef optimized;
+  CHECK(DlGraphUtil::OptimizeForInference(*session, graphDef, "input", {"output"},
+                                          {-1, SIZE, SIZE, CHANNELS}, optimized));
+  for (int batches : {1, 3, 8})
+    CheckSameOutput(*session, optimized, batches);
+}
+
+}
+
+int main(int argc, char** argv) {
+  Test();
+  std::cout << "ok" << std::endl;
+  return 0;
+}
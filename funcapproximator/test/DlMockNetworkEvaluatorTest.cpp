@@ -0,0 +1,63 @@
+
+#include "platform/SgSystem.h"
+#include "funcapproximator/DlMockNetworkEvaluator.h"
+
+#include <chrono>
+#include <memory>
+#include <boost/test/auto_unit_test.hpp>
+
+namespace {
+
+struct Batch {
+  char m_feature[MAX_BATCHES][NUM_MAPS][BD_SIZE][BD_SIZE];
+  double m_policy[MAX_BATCHES][GO_MAX_MOVES];
+  double m_value[MAX_BATCHES];
+};
+
+std::unique_ptr<Batch> NewBatch() {
+  std::unique_ptr<Batch> batch(new Batch());
+  for (int i = 0; i < MAX_BATCHES; ++i)
+    for (int c = 0; c < NUM_MAPS; ++c)
+      for (int y = 0; y < BD_SIZE; ++y)
+        for (int x = 0; x < BD_SIZE; ++x)
+          batch->m_feature[i][c][y][x] = ((i + c + y * x) % 5 == 0) ? 1 : 0;
+  return batch;
+}
+
+BOOST_AUTO_TEST_CASE(DlMockNetworkEvaluatorTest_Deterministic) {
+  std::unique_ptr<Batch> batch = NewBatch();
+  std::unique_ptr<Batch> other = NewBatch();
+  DlMockNetworkEvaluator evaluator;
+  BOOST_CHECK(evaluator.MetaGraphLoaded());
+  evaluator.Evaluate(batch->m_feature, batch->m_policy, batch->m_value, 3);
+  evaluator.Evaluate(other->m_feature, other->m_policy, other->m_value, 3);
+  for (int i = 0; i < 3; ++i) {
+    BOOST_CHECK_EQUAL(batch->m_value[i], other->m_value[i]);
+    BOOST_CHECK_GE(batch->m_value[i], -1.0);
+    BOOST_CHECK_LE(batch->m_value[i], 1.0);
+    double sum = 0;
+    for (int m = 0; m < GO_MAX_MOVES; ++m) {
+      BOOST_CHECK_EQUAL(batch->m_policy[i][m], other->m_policy[i][m]);
+      BOOST_CHECK_GE(batch->m_policy[i][m], 0.0);
+      sum += batch->m_policy[i][m];
+    }
+    BOOST_CHECK_CLOSE(sum, 1.0, 1e-6);
+  }
+  BOOST_CHECK(batch->m_value[0] != batch->m_value[1]);
+
+  // Another checkpoint is another network
+  BOOST_CHECK(evaluator.UpdateCheckPoint("checkpoint-2"));
+  evaluator.Evaluate(other->m_feature, other->m_policy, other->m_value, 1);
+  BOOST_CHECK(batch->m_value[0] != other->m_value[0]);
+}
+
+BOOST_AUTO_TEST_CASE(DlMockNetworkEvaluatorTest_Latency) {
+  std::unique_ptr<Batch> batch = NewBatch();
+  DlMockNetworkEvaluator evaluator(2000, 500);
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  evaluator.Evaluate(batch->m_feature, batch->m_policy, batch->m_value, 4);
+  const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+  BOOST_CHECK_GE(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count(), 4000);
+}
+
+}
@@ -0,0 +1,219 @@
+
+
+#include "platform/SgSystem.h"
+#include "funcapproximator/DlReplayBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include "funcapproximator/DlShardWriter.h"
+#include "lib/SgRandom.h"
+
+namespace {
+
+struct TempDir {
+  TempDir()
+      : path((boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path()).string()) {}
+
+  ~TempDir() {
+    boost::filesystem::remove_all(path);
+  }
+
+  std::string path;
+};
+
+/** Position number move of the game, in the order of UctDeepPlayer::CollectExamples:
+    only the first position has an empty previous board and is marked as
+    game start. The game number is stored in the reward, the move number
+    in the policy of pass. */
+DlTrainingExample Position(int game, int move) {
+  DlTrainingExample example;
+  std::memset(&example, 0, sizeof(example));
+  example.feature[0][move % BD_SIZE][0] = 1;
+  if (move > 0)
+    example.feature[2][0][move % BD_SIZE] = 1;
+  example.policy[1] = 0.5f;
+  example.policy[GO_MAX_MOVES - 1] = float(move);
+  example.reward = float(game);
+  example.gameStart = move == 0 ? 1 : 0;
+  return example;
+}
+
+/** Write the games [first, first + nuGames) into shards of dir. */
+std::vector<std::string> WriteShards(const std::string &dir, int first,
+                                     int nuGames, int gameLength,
+                                     bool compress) {
+  DlShardWriter::Options options;
+  options.dir = dir;
+  options.prefix = std::to_string(first);
+  options.compress = compress;
+  {
+    DlShardWriter writer(options);
+    for (int game = first; game < first + nuGames; ++game) {
+      std::vector<std::string> records;
+      for (int move = gameLength - 1; move >= 0; --move)
+        records.push_back(DlExampleCodec::Encode(Position(game, move)));
+      writer.AddGame("", records);
+    }
+  }
+  std::vector<std::string> paths;
+  for (boost::filesystem::directory_iterator it(dir), end; it != end; ++it)
+    if (it->path().filename().string().compare(0, options.prefix.size() + 1,
+                                                 options.prefix + "_") == 0)
+      paths.push_back(it->path().string());
+  return paths;
+}
+
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_Codec) {
+  DlTrainingExample example = Position(3, 7);
+  example.policy[100] = -0.25f;
+  const std::string record = DlExampleCodec::Encode(example);
+  DlTrainingExample decoded;
+  BOOST_REQUIRE(DlExampleCodec::Decode(record.data(), record.size(),
+                                       decoded));
+  BOOST_CHECK(std::memcmp(&example, &decoded, sizeof(example)) == 0);
+  BOOST_CHECK(!DlExampleCodec::IsFirstPosition(decoded));
+  BOOST_CHECK(DlExampleCodec::IsFirstPosition(Position(3, 0)));
+  // Records without the marker
+  example.gameStart = -1;
+  const std::string unmarked = DlExampleCodec::Encode(example);
+  BOOST_REQUIRE(DlExampleCodec::Decode(unmarked.data(), unmarked.size(),
+                                       decoded));
+  BOOST_CHECK_EQUAL(decoded.gameStart, -1);
+  BOOST_CHECK(!DlExampleCodec::IsFirstPosition(decoded));
+  example.feature[2][0][7] = 0;
+  BOOST_CHECK(DlExampleCodec::IsFirstPosition(example));
+  BOOST_CHECK(!DlExampleCodec::Decode(record.data(), record.size() - 1,
+                                      decoded));
+}
+
+/** A game whose first move is a pass has two positions with an empty
+    previous board, only the marked one ends the game. */
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_FirstMovePass) {
+  TempDir dir;
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.compress = false;
+  {
+    DlShardWriter writer(options);
+    for (int game = 0; game < 2; ++game) {
+      std::vector<std::string> records;
+      for (int move = 2; move >= 0; --move) {
+        DlTrainingExample example = Position(game, move);
+        if (move == 1)
+          example.feature[2][0][1] = 0;
+        records.push_back(DlExampleCodec::Encode(example));
+      }
+      writer.AddGame("", records);
+    }
+  }
+  std::vector<std::string> paths;
+  for (boost::filesystem::directory_iterator it(dir.path), end; it != end;
+       ++it)
+    paths.push_back(it->path().string());
+  DlReplayBuffer buffer((DlReplayBuffer::Options()));
+  BOOST_CHECK_EQUAL(buffer.AddShards(paths), 2u);
+  BOOST_CHECK_EQUAL(buffer.NuGames(), 2u);
+  BOOST_CHECK_EQUAL(buffer.NuPositions(), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_ShardReader) {
+  TempDir dir;
+  const std::vector<std::string> paths =
+      WriteShards(dir.path, 0, 2, 3, false);
+  BOOST_REQUIRE_EQUAL(paths.size(), 1u);
+  DlShardReader reader(paths[0]);
+  BOOST_REQUIRE(reader.IsOpen());
+  const char *data;
+  std::size_t size;
+  int nuRecords = 0;
+  while (reader.Next(data, size)) {
+    DlTrainingExample example;
+    BOOST_CHECK(DlExampleCodec::Decode(data, size, example));
+    ++nuRecords;
+  }
+  BOOST_CHECK_EQUAL(nuRecords, 6);
+  BOOST_CHECK(!DlShardReader(dir.path + "/missing").IsOpen());
+}
+
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_Window) {
+  TempDir dir;
+  std::vector<std::string> paths = WriteShards(dir.path, 0, 5, 4, true);
+  const std::vector<std::string> newer = WriteShards(dir.path, 5, 3, 4, false);
+  paths.insert(paths.end(), newer.begin(), newer.end());
+  DlReplayBuffer::Options options;
+  options.maxGames = 6;
+  options.numThreads = 2;
+  options.augment = false;
+  DlReplayBuffer buffer(options);
+  BOOST_CHECK_EQUAL(buffer.AddShards(paths), 8u);
+  BOOST_CHECK_EQUAL(buffer.NuGames(), 6u);
+  BOOST_CHECK_EQUAL(buffer.NuPositions(), 24u);
+
+  SgRandom random;
+  DlTrainingBatch batch;
+  buffer.SampleBatch(random, 200, batch);
+  BOOST_REQUIRE_EQUAL(batch.size, 200);
+  BOOST_CHECK_EQUAL(batch.features.size(), 200u * FEATURE_SIZE);
+  BOOST_CHECK_EQUAL(batch.policies.size(), 200u * GO_MAX_MOVES);
+  for (int i = 0; i < batch.size; ++i) {
+    // The two oldest games were evicted
+    BOOST_CHECK_GE(batch.rewards[i], 2.0f);
+    BOOST_CHECK_LE(batch.rewards[i], 7.0f);
+    const int move = int(batch.policies[(i + 1) * GO_MAX_MOVES - 1]);
+    BOOST_CHECK_EQUAL(batch.features[i * FEATURE_SIZE + move * BD_SIZE], 1.0f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_Recent) {
+  TempDir dir;
+  DlReplayBuffer::Options options;
+  options.sampling = DlReplayBuffer::SAMPLE_RECENT;
+  options.halfLife = 1;
+  DlReplayBuffer buffer(options);
+  buffer.AddShards(WriteShards(dir.path, 0, 20, 2, false));
+  SgRandom random;
+  DlTrainingBatch batch;
+  buffer.SampleBatch(random, 1000, batch);
+  int newest = 0;
+  for (int i = 0; i < batch.size; ++i)
+    if (batch.rewards[i] == 19.0f)
+      ++newest;
+  BOOST_CHECK_GT(newest, 400);
+  BOOST_CHECK_LT(newest, 600);
+}
+
+BOOST_AUTO_TEST_CASE(DlReplayBufferTest_Symmetry) {
+  DlTrainingExample example = Position(0, 0);
+  example.feature[5][2][3] = 1;
+  example.policy[2 * BD_SIZE + 3] = 1;
+  DlTrainingBatch batch;
+  batch.features.resize(8 * FEATURE_SIZE);
+  batch.policies.resize(8 * GO_MAX_MOVES);
+  batch.rewards.resize(8);
+  std::vector<int> points;
+  for (int symmetry = 0; symmetry < 8; ++symmetry) {
+    DlReplayBuffer::AddToBatch(example, symmetry, batch, symmetry);
+    const float *features = &batch.features[symmetry * FEATURE_SIZE];
+    const float *policy = &batch.policies[symmetry * GO_MAX_MOVES];
+    int point = -1;
+    for (int i = 0; i < BD_SIZE * BD_SIZE; ++i)
+      if (features[5 * BD_SIZE * BD_SIZE + i] == 1) {
+        BOOST_CHECK_EQUAL(point, -1);
+        point = i;
+      }
+    // Stones and policy are transformed together, pass is unchanged
+    BOOST_CHECK_EQUAL(policy[point], 1.0f);
+    BOOST_CHECK_EQUAL(policy[GO_MAX_MOVES - 1], 0.0f);
+    points.push_back(point);
+  }
+  BOOST_CHECK_EQUAL(points[0], 2 * BD_SIZE + 3);
+  std::sort(points.begin(), points.end());
+  BOOST_CHECK(std::unique(points.begin(), points.end()) == points.end());
+}
+
+}
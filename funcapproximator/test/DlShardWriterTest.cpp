@@ -0,0 +1,183 @@
+
+
+#include "platform/SgSystem.h"
+#include "funcapproximator/DlShardWriter.h"
+
+#include <string>
+#include <vector>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+/** Temporary directory, removed with its shards. */
+struct TempDir {
+  TempDir()
+      : path((boost::filesystem::temp_directory_path()
+              / boost::filesystem::unique_path()).string()) {}
+
+  ~TempDir() {
+    boost::filesystem::remove_all(path);
+  }
+
+  std::string path;
+};
+
+/** Uploader that fails a number of times before it succeeds. */
+struct TestUploader {
+  TestUploader(int failures)
+      : m_failures(failures),
+        m_nuCalls(0) {}
+
+  bool operator()(const std::string &localPath, const std::string &name) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    ++m_nuCalls;
+    if (m_failures != 0) {
+      if (m_failures > 0)
+        --m_failures;
+      return false;
+    }
+    BOOST_CHECK(boost::filesystem::exists(localPath));
+    m_names.push_back(name);
+    return true;
+  }
+
+  boost::mutex m_mutex;
+  /** Negative: fail forever. */
+  int m_failures;
+  int m_nuCalls;
+  std::vector<std::string> m_names;
+};
+
+std::vector<std::string> Game(int nuRecords, std::size_t size) {
+  return std::vector<std::string>(nuRecords, std::string(size, 'x'));
+}
+
+DlShardWriter::Uploader Bind(TestUploader &uploader) {
+  return [&uploader](const std::string &path, const std::string &name) {
+    return uploader(path, name);
+  };
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_AppendRecord) {
+  // CRC32C of "123456789" is 0xe3069283
+  BOOST_CHECK_EQUAL(DlShardWriter::MaskedCrc32c("123456789", 9), 0xc78ab0e5u);
+  std::string buffer;
+  DlShardWriter::AppendRecord(buffer, "abc");
+  BOOST_REQUIRE_EQUAL(buffer.size(), 8u + 4u + 3u + 4u);
+  BOOST_CHECK_EQUAL(buffer[0], 3);
+  for (int i = 1; i < 8; ++i)
+    BOOST_CHECK_EQUAL(buffer[i], 0);
+  BOOST_CHECK_EQUAL(buffer.substr(12, 3), "abc");
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_Rotate) {
+  TempDir dir;
+  TestUploader uploader(0);
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.maxShardBytes = 2500;
+  {
+    DlShardWriter writer(options, Bind(uploader));
+    for (int i = 0; i < 6; ++i) {
+      std::vector<std::string> records = Game(10, 84);
+      BOOST_CHECK(writer.AddGame(i < 4 ? "a" : "b", records));
+      BOOST_CHECK(records.empty());
+    }
+    writer.Flush();
+    // 1000 bytes per game: a shard is full after 3 games, and "b" starts
+    // a new shard
+    BOOST_CHECK_EQUAL(writer.NuGames(), 6u);
+    BOOST_CHECK_EQUAL(writer.NuShards(), 3u);
+    BOOST_CHECK_EQUAL(writer.NuUploadFailures(), 0u);
+  }
+  BOOST_REQUIRE_EQUAL(uploader.m_names.size(), 3u);
+  BOOST_CHECK_EQUAL(uploader.m_names[0].substr(0, 2), "a/");
+  BOOST_CHECK_EQUAL(uploader.m_names[1].substr(0, 2), "a/");
+  BOOST_CHECK_EQUAL(uploader.m_names[2].substr(0, 2), "b/");
+  BOOST_CHECK(boost::algorithm::ends_with(uploader.m_names[0],
+                                          ".tfrecords.gz"));
+  // Uploaded shards are removed
+  BOOST_CHECK(boost::filesystem::is_empty(dir.path));
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_Retry) {
+  TempDir dir;
+  TestUploader uploader(2);
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.compress = false;
+  options.retryDelay = 0.001;
+  DlShardWriter writer(options, Bind(uploader));
+  std::vector<std::string> records = Game(2, 10);
+  writer.AddGame("", records);
+  writer.Flush();
+  BOOST_CHECK_EQUAL(uploader.m_nuCalls, 3);
+  BOOST_CHECK_EQUAL(uploader.m_names.size(), 1u);
+  BOOST_CHECK_EQUAL(writer.NuUploadFailures(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_UploadFailure) {
+  TempDir dir;
+  TestUploader uploader(-1);
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.maxRetries = 2;
+  options.retryDelay = 0.001;
+  DlShardWriter writer(options, Bind(uploader));
+  std::vector<std::string> records = Game(2, 10);
+  writer.AddGame("", records);
+  writer.Flush();
+  BOOST_CHECK_EQUAL(uploader.m_nuCalls, 3);
+  BOOST_CHECK_EQUAL(writer.NuUploadFailures(), 1u);
+  // The shard is kept for a later upload
+  BOOST_CHECK(!boost::filesystem::is_empty(dir.path));
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_RetryFailed) {
+  TempDir dir;
+  TestUploader uploader(3);
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.maxRetries = 1;
+  options.retryDelay = 0.001;
+  options.failedRetryInterval = 0.01;
+  DlShardWriter writer(options, Bind(uploader));
+  std::vector<std::string> records = Game(2, 10);
+  writer.AddGame("", records);
+  writer.Flush();
+  BOOST_CHECK_EQUAL(writer.NuUploadFailures(), 1u);
+  // The failed shard is tried again, it fails once more and then succeeds
+  for (int i = 0; i < 500; ++i) {
+    {
+      boost::mutex::scoped_lock lock(uploader.m_mutex);
+      if (!uploader.m_names.empty())
+        break;
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  boost::mutex::scoped_lock lock(uploader.m_mutex);
+  BOOST_CHECK_EQUAL(uploader.m_nuCalls, 4);
+  BOOST_CHECK_EQUAL(uploader.m_names.size(), 1u);
+  BOOST_CHECK(boost::algorithm::ends_with(uploader.m_names[0],
+                                          ".tfrecords.gz"));
+}
+
+BOOST_AUTO_TEST_CASE(DlShardWriterTest_Drop) {
+  TempDir dir;
+  DlShardWriter::Options options;
+  options.dir = dir.path;
+  options.maxQueuedBytes = 100;
+  DlShardWriter writer(options);
+  std::vector<std::string> records = Game(2, 100);
+  BOOST_CHECK(!writer.AddGame("", records));
+  BOOST_CHECK_EQUAL(records.size(), 2u);
+  BOOST_CHECK_EQUAL(writer.NuDroppedGames(), 1u);
+  writer.Flush();
+  BOOST_CHECK_EQUAL(writer.NuShards(), 0u);
+}
+
+}
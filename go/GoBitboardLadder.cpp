@@ -0,0 +1,258 @@
+
+
+#include "platform/SgSystem.h"
+#include "GoBitboardLadder.h"
+
+#include <algorithm>
+#include "GoBoard.h"
+#include "GoBoardUtil.h"
+#include "board/GoNbIterator.h"
+
+namespace {
+
+const int GOOD_FOR_PREY = 1000;
+const int GOOD_FOR_HUNTER = -1000;
+
+}
+
+GoBitboardLadder::GoBitboardLadder()
+    : m_maxDepth(0),
+      m_abort(false),
+      m_preyColor(SG_BLACK),
+      m_hunterColor(SG_WHITE) {}
+
+inline int GoBitboardLadder::NumEmptyNeighbors(GoPoint p) const {
+  int n = 0;
+  for (SgNb4Iterator it(p); it; ++it)
+    if (m_empty[*it])
+      ++n;
+  return n;
+}
+
+inline int GoBitboardLadder::NumLiberties(const GoPointSet& block) const {
+  return (block.BorderNoClip() & m_empty).Size();
+}
+
+inline void GoBitboardLadder::Play(GoPoint p, SgBlackWhite c) {
+  DBG_ASSERT(m_empty[p]);
+  m_stones[c].Include(p);
+  m_empty.Exclude(p);
+  m_played.Include(p);
+}
+
+inline void GoBitboardLadder::Undo(GoPoint p, SgBlackWhite c) {
+  DBG_ASSERT(m_stones[c][p]);
+  m_stones[c].Exclude(p);
+  m_empty.Include(p);
+}
+
+bool GoBitboardLadder::CapturesNeighbor(GoPoint p, SgBlackWhite opp) const {
+  DBG_ASSERT(m_empty[p]);
+  const GoPointSet& stones = m_stones[opp];
+  for (SgNb4Iterator it(p); it; ++it)
+    if (stones[*it] && NumEmptyNeighbors(*it) == 1
+        && NumLiberties(stones.ConnComp(*it)) == 1)
+      return true;
+  return false;
+}
+
+bool GoBitboardLadder::HunterInAtariNextToPrey() const {
+  const GoPointSet& hunter = m_stones[m_hunterColor];
+  GoPointSet adj = m_prey.BorderNoClip() & hunter;
+  while (adj.NonEmpty()) {
+    const GoPoint p = adj.PointOf();
+    if (NumEmptyNeighbors(p) > 1) {
+      adj.Exclude(p);
+      continue;
+    }
+    const GoPointSet block = hunter.ConnComp(p);
+    if (NumLiberties(block) == 1)
+      return true;
+    adj -= block;
+  }
+  return false;
+}
+
+int GoBitboardLadder::PlayHunterMove(int depth, GoPoint move, GoPoint lib1,
+                                     GoPoint lib2,
+                                     SgVector<GoPoint>* sequence) {
+  DBG_ASSERT(move == lib1 || move == lib2);
+  if (CapturesNeighbor(move, m_preyColor)) {
+    m_abort = true;
+    return 0;
+  }
+  Play(move, m_hunterColor);
+  if (NumEmptyNeighbors(move) < 2) {
+    const int nuLibs =
+        NumLiberties(m_stones[m_hunterColor].ConnComp(move));
+    if (nuLibs == 0) {
+      Undo(move, m_hunterColor);
+      if (sequence)
+        sequence->Clear();
+      return GOOD_FOR_PREY - depth;
+    }
+    if (nuLibs == 1) {
+      Undo(move, m_hunterColor);
+      m_abort = true;
+      return 0;
+    }
+  }
+  if (move == lib1)
+    lib1 = lib2;
+  int result = PreyLadder(depth + 1, lib1, sequence);
+  if (sequence)
+    sequence->PushBack(move);
+  Undo(move, m_hunterColor);
+  return result;
+}
+
+int GoBitboardLadder::PreyLadder(int depth, GoPoint lib1,
+                                 SgVector<GoPoint>* sequence) {
+  if (depth >= m_maxDepth)
+    return GOOD_FOR_PREY;
+  if (CapturesNeighbor(lib1, m_hunterColor)) {
+    m_abort = true;
+    return 0;
+  }
+  const GoPointSet oldPrey = m_prey;
+  bool merge = false;
+  for (SgNb4Iterator it(lib1); it; ++it)
+    if (m_stones[m_preyColor][*it] && !m_prey[*it])
+      merge = true;
+  Play(lib1, m_preyColor);
+  if (merge)
+    m_prey = m_stones[m_preyColor].ConnComp(lib1);
+  else
+    m_prey.Include(lib1);
+  const GoPointSet libs = m_prey.BorderNoClip() & m_empty;
+  const int nuLibs = libs.Size();
+  int result = 0;
+  if (nuLibs == 0) {
+    if (sequence)
+      sequence->Clear();
+    result = GOOD_FOR_HUNTER + depth;
+  } else if (nuLibs == 1)
+    result = HunterLadder(depth + 1, libs.PointOf(), sequence);
+  else if (nuLibs == 2) {
+    // GoLadder takes the new liberties in neighbor order first, then the
+    // liberties of merged blocks in GoBoard liberty list order, which is
+    // not known here
+    GoArrayList<GoPoint, 2> order;
+    for (SgNb4Iterator it(lib1); it; ++it)
+      if (m_empty[*it])
+        order.PushBack(*it);
+    if (order.Length() == 1) {
+      GoPointSet other = libs;
+      order.PushBack(other.Exclude(order[0]).PointOf());
+    }
+    if (order.Length() < 2 || HunterInAtariNextToPrey())
+      m_abort = true;
+    else
+      result = HunterLadder(depth + 1, order[0], order[1], sequence);
+  } else {
+    if (sequence)
+      sequence->Clear();
+    result = GOOD_FOR_PREY - (depth + 1);
+  }
+  if (sequence && nuLibs > 0)
+    sequence->PushBack(lib1);
+  Undo(lib1, m_preyColor);
+  m_prey = oldPrey;
+  return result;
+}
+
+int GoBitboardLadder::HunterLadder(int depth, GoPoint lib1,
+                                   SgVector<GoPoint>* sequence) {
+  if (depth >= m_maxDepth)
+    return GOOD_FOR_PREY;
+  if (sequence)
+    sequence->SetTo(lib1);
+  return GOOD_FOR_HUNTER + depth;
+}
+
+int GoBitboardLadder::HunterLadder(int depth, GoPoint lib1, GoPoint lib2,
+                                   SgVector<GoPoint>* sequence) {
+  if (depth >= m_maxDepth)
+    return GOOD_FOR_PREY;
+  int result = 0;
+  if (NumEmptyNeighbors(lib1) < NumEmptyNeighbors(lib2))
+    std::swap(lib1, lib2);
+  if (NumEmptyNeighbors(lib1) == 3
+      && !GoPointUtil::AreAdjacent(lib1, lib2)) {
+    Play(lib1, m_hunterColor);
+    result = PreyLadder(depth + 1, lib2, sequence);
+    if (sequence)
+      sequence->PushBack(lib1);
+    Undo(lib1, m_hunterColor);
+  } else {
+    result = PlayHunterMove(depth, lib1, lib1, lib2, sequence);
+    if (0 <= result && !m_abort) {
+      if (sequence) {
+        SgVector<GoPoint> seq2;
+        int result2 = PlayHunterMove(depth, lib2, lib1, lib2, &seq2);
+        if (result2 < result) {
+          result = result2;
+          sequence->SwapWith(&seq2);
+        }
+      } else {
+        int result2 = PlayHunterMove(depth, lib2, lib1, lib2, 0);
+        if (result2 < result)
+          result = result2;
+      }
+    }
+  }
+  return result;
+}
+
+bool GoBitboardLadder::Ladder(const GoBoard& bd, GoPoint prey,
+                              SgBlackWhite toPlay,
+                              SgVector<GoPoint>* sequence, int& result) {
+  if (sequence)
+    sequence->Clear();
+  m_played.Clear();
+  if (!bd.Occupied(prey))
+    return false;
+  const int RESERVE = 5;
+  m_maxDepth = std::min(bd.MoveNumber() + MAX_LADDER_MOVES,
+                        GO_MAX_NUM_MOVES - RESERVE) - bd.MoveNumber();
+  if (m_maxDepth <= 0)
+    return false;
+  const int numLib = bd.NumLiberties(prey);
+  if (2 < numLib) {
+    result = GOOD_FOR_PREY;
+    return true;
+  }
+  m_preyColor = bd.GetStone(prey);
+  m_hunterColor = SgOppBW(m_preyColor);
+  // Snapbacks, two-liberty escapes and captures of adjacent blocks are
+  // left to GoLadder
+  if ((toPlay == m_preyColor) != (numLib == 1))
+    return false;
+  GoAdjBlockIterator<GoBoard> adjIt(bd, prey, 1);
+  if (adjIt)
+    return false;
+  m_stones[SG_BLACK] = bd.All(SG_BLACK);
+  m_stones[SG_WHITE] = bd.All(SG_WHITE);
+  m_empty = bd.AllPoints();
+  m_empty -= m_stones.Both();
+  m_prey.Clear();
+  for (GoBoard::StoneIterator it(bd, prey); it; ++it)
+    m_prey.Include(*it);
+  m_abort = false;
+  GoBoard::LibertyIterator libit(bd, prey);
+  const GoPoint lib1 = *libit;
+  if (toPlay == m_preyColor)
+    result = PreyLadder(0, lib1, sequence);
+  else {
+    ++libit;
+    result = HunterLadder(0, lib1, *libit, sequence);
+  }
+  if (m_abort) {
+    if (sequence)
+      sequence->Clear();
+    return false;
+  }
+  if (sequence)
+    sequence->Reverse();
+  return true;
+}
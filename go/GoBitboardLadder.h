@@ -0,0 +1,61 @@
+
+
+#ifndef GO_BITBOARDLADDER_H
+#define GO_BITBOARDLADDER_H
+
+#include "board/GoBWSet.h"
+#include "board/GoBlackWhite.h"
+#include "board/GoPoint.h"
+#include "board/GoPointSet.h"
+#include "lib/SgVector.h"
+
+class GoBoard;
+
+/** Ladder tracer working on point set bitboards instead of GoBoard.
+    Follows the same reading order as GoLadder and returns the same
+    result and sequence, but never calls GoBoard::Play/Undo.
+    Only plain ladders are traced: as soon as a capture, a hunter block in
+    atari next to the prey or an ambiguous liberty order comes up, the
+    tracer gives up and the caller has to fall back to GoLadder. */
+class GoBitboardLadder {
+ public:
+  GoBitboardLadder();
+
+  /** Trace the ladder like GoLadder::Ladder with twoLibIsEscape = false.
+      @return false if the position needs full reading by GoLadder;
+      result and sequence are only valid if true is returned. */
+  bool Ladder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+              SgVector<GoPoint>* sequence, int& result);
+
+  /** Points played while tracing the last Ladder() call. */
+  const GoPointSet& PlayedPoints() const;
+
+ private:
+  static const int MAX_LADDER_MOVES = 200;
+  int m_maxDepth;
+  bool m_abort;
+  GoBWSet m_stones;
+  GoPointSet m_empty;
+  GoPointSet m_prey;
+  GoPointSet m_played;
+  SgBlackWhite m_preyColor;
+  SgBlackWhite m_hunterColor;
+  int NumEmptyNeighbors(GoPoint p) const;
+  int NumLiberties(const GoPointSet& block) const;
+  bool CapturesNeighbor(GoPoint p, SgBlackWhite opp) const;
+  bool HunterInAtariNextToPrey() const;
+  void Play(GoPoint p, SgBlackWhite c);
+  void Undo(GoPoint p, SgBlackWhite c);
+  int PreyLadder(int depth, GoPoint lib1, SgVector<GoPoint>* sequence);
+  int HunterLadder(int depth, GoPoint lib1, SgVector<GoPoint>* sequence);
+  int HunterLadder(int depth, GoPoint lib1, GoPoint lib2,
+                   SgVector<GoPoint>* sequence);
+  int PlayHunterMove(int depth, GoPoint move, GoPoint lib1, GoPoint lib2,
+                     SgVector<GoPoint>* sequence);
+};
+
+inline const GoPointSet& GoBitboardLadder::PlayedPoints() const {
+  return m_played;
+}
+
+#endif
@@ -1476,6 +1476,17 @@ void GoGtpEngine::Interrupt() {
 
 #endif
 
+#if GTPENGINE_ASYNC
+
+void GoGtpEngine::SetAsynchronousGenMove(bool enable) {
+  SetAsynchronous("genmove", enable);
+  SetAsynchronous("kgs-genmove_cleanup", enable);
+  SetAsynchronous("reg_genmove", enable);
+  SetAsynchronous("reg_genmove_toplay", enable);
+}
+
+#endif
+
 void GoGtpEngine::SetMpiSynchronizer(const MpiSynchronizerHandle& handle) {
   m_mpiSynchronizer = MpiSynchronizerHandle(handle);
 }
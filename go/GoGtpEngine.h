@@ -107,6 +107,15 @@ class GoGtpEngine
 
   void Interrupt();
 
+#endif
+
+#if GTPENGINE_ASYNC
+
+  /** Run the move generation commands asynchronously in MainLoop(), so
+      that concurrent commands like uct_stat_search can monitor the
+      search. */
+  void SetAsynchronousGenMove(bool enable);
+
 #endif
 
   void SetMpiSynchronizer(const MpiSynchronizerHandle& m_handle);
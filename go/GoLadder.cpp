@@ -23,6 +23,13 @@ const int GOOD_FOR_HUNTER = -1000;
 
 GoLadder::GoLadder() {}
 
+inline bool GoLadder::PlayIfLegal(GoPoint p, SgBlackWhite player) {
+  if (!GoBoardUtil::PlayIfLegal(*m_bd, p, player))
+    return false;
+  m_played.Include(p);
+  return true;
+}
+
 inline bool GoLadder::CheckMoveOverflow() const {
   return m_bd->MoveNumber() >= m_maxMoveNumber;
 }
@@ -78,7 +85,7 @@ int GoLadder::PlayHunterMove(int depth, GoPoint move, GoPoint lib1,
                              SgVector<GoPoint>* sequence) {
   DBG_ASSERT(move == lib1 || move == lib2);
   int result = 0;
-  if (PlayIfLegal(*m_bd, move, m_hunterColor)) {
+  if (PlayIfLegal(move, m_hunterColor)) {
     GoPointList newAdj;
     if (m_bd->InAtari(move))
       newAdj.PushBack(move);
@@ -126,7 +133,7 @@ int GoLadder::PlayPreyMove(int depth, GoPoint move, GoPoint lib1,
     }
     m_partOfPrey.Include(move);
   }
-  if (PlayIfLegal(*m_bd, move, m_preyColor)) {
+  if (PlayIfLegal(move, m_preyColor)) {
     if (move == lib1) {
       NeighborsOfColor(*m_bd, move, SG_EMPTY, &neighbors);
       for (SgVectorIterator<GoPoint> iter(newLib); iter; ++iter) {
@@ -236,6 +243,7 @@ int GoLadder::HunterLadder(int depth, GoPoint lib1, GoPoint lib2,
   if (m_bd->NumEmptyNeighbors(lib1) == 3
       && !GoPointUtil::AreAdjacent(lib1, lib2)) {
     m_bd->Play(lib1, m_hunterColor);
+    m_played.Include(lib1);
     result = PreyLadder(depth + 1, lib2, adjBlk, sequence);
     if (sequence)
       sequence->PushBack(lib1);
@@ -289,6 +297,12 @@ void GoLadder::ReduceToBlocks(GoPointList& stones) {
 
 int GoLadder::Ladder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
                      SgVector<GoPoint>* sequence, bool twoLibIsEscape) {
+  m_played.Clear();
+  return ReadLadder(bd, prey, toPlay, sequence, twoLibIsEscape);
+}
+
+int GoLadder::ReadLadder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+                         SgVector<GoPoint>* sequence, bool twoLibIsEscape) {
   GoModBoard modBoard(bd);
   m_bd = &modBoard.Board();
   InitMaxMoveNumber();
@@ -340,8 +354,8 @@ int GoLadder::Ladder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
         NeighborsOfColor(*m_bd, lib2, SG_EMPTY, &neighbors);
         movesToTry.Concat(&neighbors);
         for (SgVectorIterator<GoPoint> it(movesToTry); it; ++it) {
-          if (PlayIfLegal(*m_bd, *it, m_preyColor)) {
-            if (Ladder(bd, prey, m_hunterColor, 0, twoLibIsEscape)
+          if (PlayIfLegal(*it, m_preyColor)) {
+            if (ReadLadder(bd, prey, m_hunterColor, 0, twoLibIsEscape)
                 > 0) {
               if (sequence)
                 sequence->PushBack(*it);
@@ -376,7 +390,7 @@ bool GoLadder::IsSnapback(GoPoint prey) {
   bool isSnapback = false;
   if (m_bd->IsSingleStone(prey) && m_bd->InAtari(prey)) {
     GoPoint liberty = *GoBoard::LibertyIterator(*m_bd, prey);
-    if (PlayIfLegal(*m_bd, liberty, SgOppBW(m_bd->GetStone(prey)))) {
+    if (PlayIfLegal(liberty, SgOppBW(m_bd->GetStone(prey)))) {
       isSnapback = (m_bd->InAtari(liberty)
           && !m_bd->IsSingleStone(liberty));
       m_bd->Undo();
@@ -21,12 +21,16 @@ class GoLadder {
   GoLadder();
   int Ladder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
              SgVector<GoPoint>* sequence, bool twoLibIsEscape = false);
+  /** Points played on the board while reading the last Ladder() call.
+      Includes moves of refuted branches, not only the returned sequence. */
+  const GoPointSet& PlayedPoints() const;
 
  private:
   static const int MAX_LADDER_MOVES = 200;
   int m_maxMoveNumber;
   GoBoard* m_bd;
   GoPointSet m_partOfPrey;
+  GoPointSet m_played;
   SgBlackWhite m_preyColor;
   SgBlackWhite m_hunterColor;
   bool CheckMoveOverflow() const;
@@ -48,7 +52,15 @@ class GoLadder {
   int HunterLadder(int depth, GoPoint lib1, GoPoint lib2,
                    const GoPointList& adjBlk, SgVector<GoPoint>* sequence);
   void ReduceToBlocks(GoPointList& stones);
+  int ReadLadder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+                 SgVector<GoPoint>* sequence, bool twoLibIsEscape);
+  bool PlayIfLegal(GoPoint p, SgBlackWhite player);
 };
+
+inline const GoPointSet& GoLadder::PlayedPoints() const {
+  return m_played;
+}
+
 namespace GoLadderUtil {
 
 bool Ladder(const GoBoard& board, GoPoint prey, SgBlackWhite toPlay,
@@ -0,0 +1,112 @@
+
+
+#include "platform/SgSystem.h"
+#include "GoLadderCache.h"
+
+#include <iostream>
+#include "GoBoard.h"
+#include "board/SgWrite.h"
+
+GoLadderCache::Entry::Entry()
+    : m_isValid(false),
+      m_boardToPlay(SG_BLACK),
+      m_koPoint(GO_NULLPOINT),
+      m_result(0) {}
+
+GoLadderCache::GoLadderCache()
+    : m_played(&m_ladder.PlayedPoints()),
+      m_boardSize(0),
+      m_nuLookups(0),
+      m_nuHits(0),
+      m_nuBitboardReads(0),
+      m_nuFullReads(0) {}
+
+void GoLadderCache::Clear() {
+  for (GoPoint p = 0; p < GO_MAXPOINT; ++p) {
+    m_entry[SG_BLACK][p].m_isValid = false;
+    m_entry[SG_WHITE][p].m_isValid = false;
+  }
+}
+
+bool GoLadderCache::IsUnchanged(const GoBoard& bd, const Entry& entry) const {
+  return (bd.All(SG_BLACK) & entry.m_region) == entry.m_stones[SG_BLACK]
+      && (bd.All(SG_WHITE) & entry.m_region) == entry.m_stones[SG_WHITE];
+}
+
+int GoLadderCache::Ladder(const GoBoard& bd, GoPoint prey,
+                          SgBlackWhite toPlay, SgVector<GoPoint>* sequence,
+                          bool useBitboard) {
+  DBG_ASSERT(bd.Occupied(prey));
+  if (bd.Size() != m_boardSize) {
+    Clear();
+    m_boardSize = bd.Size();
+  }
+  ++m_nuLookups;
+  Entry& entry = m_entry[toPlay][bd.Anchor(prey)];
+  // GoLadder checks legality with the board's ko state, which is not part
+  // of the hash or the region
+  if (entry.m_isValid
+      && entry.m_boardToPlay == bd.ToPlay()
+      && entry.m_koPoint == bd.KoPoint()
+      && (entry.m_hash == bd.GetHashCode() || IsUnchanged(bd, entry))) {
+    ++m_nuHits;
+    if (sequence)
+      *sequence = entry.m_sequence;
+    return entry.m_result;
+  }
+  int result = Read(bd, prey, toPlay, &m_sequence, useBitboard);
+  Store(bd, prey, entry, result);
+  if (sequence)
+    *sequence = m_sequence;
+  return result;
+}
+
+int GoLadderCache::Read(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+                        SgVector<GoPoint>* sequence, bool useBitboard) {
+  int result;
+  if (useBitboard
+      && m_bitboardLadder.Ladder(bd, prey, toPlay, sequence, result)) {
+    ++m_nuBitboardReads;
+    m_played = &m_bitboardLadder.PlayedPoints();
+    return result;
+  }
+  ++m_nuFullReads;
+  m_played = &m_ladder.PlayedPoints();
+  return m_ladder.Ladder(bd, prey, toPlay, sequence, false);
+}
+
+void GoLadderCache::Store(const GoBoard& bd, GoPoint prey, Entry& entry,
+                          int result) {
+  const int size = bd.Size();
+  GoPointSet region = *m_played;
+  for (GoBoard::StoneIterator it(bd, prey); it; ++it)
+    region.Include(*it);
+  region.Grow(size);
+  region.Grow(size);
+  GoPointSet blocks;
+  const GoPointSet occupied = region & (bd.All(SG_BLACK) | bd.All(SG_WHITE));
+  for (SgSetIterator it(occupied); it; ++it)
+    if (!blocks.Contains(*it))
+      for (GoBoard::StoneIterator sit(bd, *it); sit; ++sit)
+        blocks.Include(*sit);
+  region |= blocks;
+  region.Grow(size);
+  entry.m_isValid = true;
+  entry.m_hash = bd.GetHashCode();
+  entry.m_boardToPlay = bd.ToPlay();
+  entry.m_koPoint = bd.KoPoint();
+  entry.m_region = region;
+  entry.m_stones[SG_BLACK] = bd.All(SG_BLACK) & region;
+  entry.m_stones[SG_WHITE] = bd.All(SG_WHITE) & region;
+  entry.m_result = result;
+  entry.m_sequence = m_sequence;
+}
+
+std::ostream& operator<<(std::ostream& out, const GoLadderCache& cache) {
+  out << "LadderCacheStatistics:\n"
+      << SgWriteLabel("Lookups") << cache.NuLookups() << '\n'
+      << SgWriteLabel("Hits") << cache.NuHits() << '\n'
+      << SgWriteLabel("BitboardReads") << cache.NuBitboardReads() << '\n'
+      << SgWriteLabel("FullReads") << cache.NuFullReads() << '\n';
+  return out;
+}
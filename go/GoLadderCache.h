@@ -0,0 +1,90 @@
+
+
+#ifndef GO_LADDERCACHE_H
+#define GO_LADDERCACHE_H
+
+#include <cstddef>
+#include "GoBitboardLadder.h"
+#include "GoLadder.h"
+#include "board/GoBWArray.h"
+#include "board/GoBWSet.h"
+#include "board/GoPointArray.h"
+#include "board/GoPointSet.h"
+#include "lib/SgHash.h"
+#include "lib/SgVector.h"
+
+class GoBoard;
+
+/** Ladder reader that remembers the ladder status of each block.
+    Results are stored per prey anchor and color to play, together with the
+    board hash, the ko state and the stones in the region the reading
+    depended on: the points played while reading, grown by two lines, plus
+    the blocks touching them and their liberties. A stored result is reused
+    while the board hash is unchanged or no stone was added or removed in
+    that region, so sibling positions in the search tree share the ladder
+    reading.
+    Not thread-safe, use one instance per search thread. */
+class GoLadderCache {
+ public:
+  GoLadderCache();
+  void Clear();
+
+  /** Same result and sequence as GoLadder::Ladder with
+      twoLibIsEscape = false, reusing a previous reading if it is still
+      valid.
+      @param useBitboard Try GoBitboardLadder before GoLadder on a miss */
+  int Ladder(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+             SgVector<GoPoint>* sequence, bool useBitboard = false);
+
+  /** Read the ladder without looking into the cache. */
+  int Read(const GoBoard& bd, GoPoint prey, SgBlackWhite toPlay,
+           SgVector<GoPoint>* sequence, bool useBitboard = false);
+
+  std::size_t NuLookups() const {
+    return m_nuLookups;
+  }
+
+  std::size_t NuHits() const {
+    return m_nuHits;
+  }
+
+  std::size_t NuBitboardReads() const {
+    return m_nuBitboardReads;
+  }
+
+  std::size_t NuFullReads() const {
+    return m_nuFullReads;
+  }
+
+ private:
+  struct Entry {
+    Entry();
+    bool m_isValid;
+    SgHashCode m_hash;
+    SgBlackWhite m_boardToPlay;
+    GoPoint m_koPoint;
+    GoPointSet m_region;
+    GoBWSet m_stones;
+    int m_result;
+    SgVector<GoPoint> m_sequence;
+  };
+
+  GoLadder m_ladder;
+  GoBitboardLadder m_bitboardLadder;
+  SgVector<GoPoint> m_sequence;
+  const GoPointSet* m_played;
+  int m_boardSize;
+  SgBWArray<GoPointArray<Entry> > m_entry;
+  std::size_t m_nuLookups;
+  std::size_t m_nuHits;
+  std::size_t m_nuBitboardReads;
+  std::size_t m_nuFullReads;
+  bool IsUnchanged(const GoBoard& bd, const Entry& entry) const;
+  void Store(const GoBoard& bd, GoPoint prey, Entry& entry, int result);
+  GoLadderCache(const GoLadderCache&);
+  GoLadderCache& operator=(const GoLadderCache&);
+};
+
+std::ostream& operator<<(std::ostream& out, const GoLadderCache& cache);
+
+#endif
@@ -0,0 +1,274 @@
+
+
+#include "platform/SgSystem.h"
+#include "GoOpeningBook.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "GoBoard.h"
+#include "GoSetup.h"
+#include "SgSgfCorpus.h"
+#include "lib/SgHash.h"
+
+namespace {
+
+const char MAGIC[8] = {'U', 'G', 'B', 'O', 'O', 'K', '1', '\n'};
+
+struct FileHeader {
+  char m_magic[8];
+  std::uint32_t m_boardSize;
+  std::uint32_t m_nuEntries;
+};
+
+inline std::uint64_t ToKey(const SgHashCode& hash) {
+  return (std::uint64_t(hash.Code2()) << 32) | hash.Code1();
+}
+
+/** Keys of the position in all 8 orientations. */
+void RotatedKeys(const GoBoard& bd, std::uint64_t keys[8]) {
+  SgHashCode hash[8];
+  for (GoBoard::Iterator it(bd); it; ++it) {
+    const SgBoardColor c = bd.GetColor(*it);
+    if (c == SG_EMPTY)
+      continue;
+    for (int r = 0; r < 8; ++r)
+      SgHashUtil::XorZobrist(hash[r],
+                             GoPointUtil::Rotate(r, *it, bd.Size())
+                                 + c * GO_MAXPOINT);
+  }
+  for (int r = 0; r < 8; ++r) {
+    SgHashUtil::XorZobrist(hash[r], bd.ToPlay() + 1);
+    keys[r] = ToKey(hash[r]);
+  }
+}
+
+/** Normalized key and the move in the normalized orientation. In a
+    symmetric position, the symmetric moves get the same normalized move. */
+std::uint64_t NormalizedMove(const GoBoard& bd, GoMove move,
+                             GoMove& normalizedMove) {
+  std::uint64_t keys[8];
+  RotatedKeys(bd, keys);
+  const std::uint64_t key = *std::min_element(keys, keys + 8);
+  normalizedMove = GO_NULLMOVE;
+  for (int r = 0; r < 8; ++r)
+    if (keys[r] == key) {
+      const GoMove m = GoPointUtil::Rotate(r, move, bd.Size());
+      if (normalizedMove == GO_NULLMOVE || m < normalizedMove)
+        normalizedMove = m;
+    }
+  return key;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+std::uint64_t GoOpeningBookUtil::NormalizedKey(const GoBoard& bd,
+                                               int& rotation) {
+  std::uint64_t keys[8];
+  RotatedKeys(bd, keys);
+  rotation = static_cast<int>(std::min_element(keys, keys + 8) - keys);
+  return keys[rotation];
+}
+
+//----------------------------------------------------------------------------
+
+struct GoOpeningBook::FileEntry {
+  std::uint64_t m_key;
+  std::int32_t m_move;
+  std::uint32_t m_count;
+  float m_value;
+  std::uint32_t m_reserved;
+};
+
+GoOpeningBook::GoOpeningBook()
+    : m_entries(0),
+      m_nuEntries(0),
+      m_nuPositions(0),
+      m_boardSize(0),
+      m_mapping(0),
+      m_mappingSize(0) {}
+
+GoOpeningBook::~GoOpeningBook() {
+  Close();
+}
+
+bool GoOpeningBook::Open(const std::string& fileName) {
+  Close();
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && std::size_t(st.st_size) >= sizeof(FileHeader))
+    mapping = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+  const FileHeader* header = static_cast<const FileHeader*>(mapping);
+  if (std::memcmp(header->m_magic, MAGIC, sizeof(MAGIC)) != 0
+      || header->m_boardSize < GO_MIN_SIZE
+      || header->m_boardSize > GO_MAX_SIZE
+      || sizeof(FileHeader) + header->m_nuEntries * sizeof(FileEntry)
+          != std::size_t(st.st_size)) {
+    munmap(mapping, st.st_size);
+    return false;
+  }
+  m_mapping = mapping;
+  m_mappingSize = st.st_size;
+  m_boardSize = header->m_boardSize;
+  m_entries = reinterpret_cast<const FileEntry*>(header + 1);
+  m_nuEntries = header->m_nuEntries;
+  m_nuPositions = 0;
+  for (std::size_t i = 0; i < m_nuEntries; ++i)
+    if (i == 0 || m_entries[i].m_key != m_entries[i - 1].m_key)
+      ++m_nuPositions;
+  return true;
+}
+
+void GoOpeningBook::Close() {
+  if (m_mapping)
+    munmap(m_mapping, m_mappingSize);
+  m_mapping = 0;
+  m_mappingSize = 0;
+  m_entries = 0;
+  m_nuEntries = 0;
+  m_nuPositions = 0;
+  m_boardSize = 0;
+}
+
+void GoOpeningBook::Lookup(const GoBoard& bd,
+                           std::vector<Move>& moves) const {
+  moves.clear();
+  if (!IsOpen() || bd.Size() != m_boardSize || bd.KoPoint() != GO_NULLPOINT)
+    return;
+  int rotation;
+  const std::uint64_t key = GoOpeningBookUtil::NormalizedKey(bd, rotation);
+  const int inverse = GoPointUtil::InvRotation(rotation);
+  const FileEntry* end = m_entries + m_nuEntries;
+  const FileEntry* it = std::lower_bound(m_entries, end, key,
+      [](const FileEntry& e, std::uint64_t k) { return e.m_key < k; });
+  for (; it != end && it->m_key == key; ++it) {
+    const GoMove move = GoPointUtil::Rotate(inverse, it->m_move, m_boardSize);
+    if (!bd.IsLegal(move))
+      continue;
+    Move m;
+    m.m_move = move;
+    m.m_count = it->m_count;
+    m.m_value = it->m_value;
+    moves.push_back(m);
+  }
+}
+
+GoMove GoOpeningBook::BestMove(const GoBoard& bd,
+                               unsigned int minCount) const {
+  std::vector<Move> moves;
+  Lookup(bd, moves);
+  if (moves.empty() || moves[0].m_count < minCount)
+    return GO_NULLMOVE;
+  return moves[0].m_move;
+}
+
+//----------------------------------------------------------------------------
+
+GoOpeningBookBuilder::GoOpeningBookBuilder(int boardSize)
+    : m_boardSize(boardSize) {}
+
+void GoOpeningBookBuilder::Add(const GoBoard& bd, GoMove move,
+                               unsigned int count, float value) {
+  if (bd.Size() != m_boardSize || bd.KoPoint() != GO_NULLPOINT
+      || move == GO_PASS || count == 0)
+    return;
+  GoMove normalizedMove;
+  const std::uint64_t key = NormalizedMove(bd, move, normalizedMove);
+  boost::mutex::scoped_lock lock(m_mutex);
+  Stat& stat = m_stats[std::make_pair(key, normalizedMove)];
+  stat.m_count += count;
+  stat.m_valueSum += double(value) * count;
+}
+
+void GoOpeningBookBuilder::AddCorpus(const SgSgfCorpus& corpus,
+                                     int maxMoves) {
+  for (std::size_t i = 0; i < corpus.NuGames(); ++i) {
+    const SgSgfCorpusGame& game = corpus.Game(i);
+    if (game.m_boardSize != m_boardSize)
+      continue;
+    GoSetup setup;
+    for (int j = 0; j < game.m_nuSetup; ++j)
+      setup.m_stones[corpus.Setup(game)[j].m_color].Include(
+          corpus.Setup(game)[j].m_point);
+    GoBoard bd(m_boardSize, setup);
+    const SgSgfCorpusMove* moves = corpus.Moves(game);
+    for (int j = 0; j < std::min(game.m_nuMoves, maxMoves); ++j) {
+      const GoMove move = moves[j].m_point;
+      const SgBlackWhite color = moves[j].m_color;
+      if (move == GO_PASS || !bd.IsLegal(move, color))
+        break;
+      bd.SetToPlay(color);
+      const float value = game.m_winner == SG_EMPTY ? 0.5f
+          : (game.m_winner == color ? 1.f : 0.f);
+      Add(bd, move, 1, value);
+      bd.Play(move);
+    }
+  }
+}
+
+std::size_t GoOpeningBookBuilder::NuMoves() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_stats.size();
+}
+
+bool GoOpeningBookBuilder::Write(const std::string& fileName,
+                                 unsigned int minCount) const {
+  std::vector<GoOpeningBook::FileEntry> entries;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    for (std::map<std::pair<std::uint64_t, int>, Stat>::const_iterator it =
+        m_stats.begin(); it != m_stats.end(); ++it) {
+      if (it->second.m_count < minCount)
+        continue;
+      GoOpeningBook::FileEntry e;
+      e.m_key = it->first.first;
+      e.m_move = it->first.second;
+      e.m_count = static_cast<std::uint32_t>(it->second.m_count);
+      e.m_value = static_cast<float>(it->second.m_valueSum
+                                     / it->second.m_count);
+      e.m_reserved = 0;
+      entries.push_back(e);
+    }
+  }
+  // Most played move of a position first
+  std::sort(entries.begin(), entries.end(),
+            [](const GoOpeningBook::FileEntry& a,
+               const GoOpeningBook::FileEntry& b) {
+              if (a.m_key != b.m_key)
+                return a.m_key < b.m_key;
+              if (a.m_count != b.m_count)
+                return a.m_count > b.m_count;
+              return a.m_move < b.m_move;
+            });
+  FileHeader header;
+  std::memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+  header.m_boardSize = m_boardSize;
+  header.m_nuEntries = static_cast<std::uint32_t>(entries.size());
+  // Write a temporary file, so that a book in use is replaced atomically
+  const std::string tmpName = fileName + ".tmp";
+  std::FILE* file = std::fopen(tmpName.c_str(), "wb");
+  if (!file)
+    return false;
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+  if (ok && !entries.empty())
+    ok = std::fwrite(&entries[0], sizeof(entries[0]), entries.size(), file)
+        == entries.size();
+  ok = std::fclose(file) == 0 && ok;
+  if (ok)
+    ok = std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+  if (!ok)
+    std::remove(tmpName.c_str());
+  return ok;
+}
@@ -0,0 +1,119 @@
+
+
+#ifndef GO_OPENING_BOOK_H
+#define GO_OPENING_BOOK_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "board/GoPoint.h"
+
+class GoBoard;
+class SgSgfCorpus;
+
+namespace GoOpeningBookUtil {
+/** Hash code of the position and the color to play, the same for all 8
+    symmetric positions. Unlike GoBoard::GetHashCodeInclToPlay(), it does
+    not depend on the captures that led to the position.
+    @param[out] rotation The rotation (see GoPointUtil::Rotate) that maps
+    the position to the one that was hashed */
+std::uint64_t NormalizedKey(const GoBoard& bd, int& rotation);
+}
+
+/** Opening book, a sorted file of position keys and moves read by binary
+    search in a memory mapping.
+    The moves and their statistics are stored in the orientation of the
+    normalized position, see GoOpeningBookUtil::NormalizedKey(). Positions
+    with a ko are not in the book. */
+class GoOpeningBook {
+ public:
+  struct Move {
+    GoMove m_move;
+    unsigned int m_count;
+    /** Mean value of the move for the color to play, in [0..1]. */
+    float m_value;
+  };
+
+  GoOpeningBook();
+  ~GoOpeningBook();
+
+  /** @return false if the file is missing or not a book */
+  bool Open(const std::string& fileName);
+  void Close();
+  bool IsOpen() const;
+  int BoardSize() const;
+  std::size_t NuPositions() const;
+
+  /** Book moves of the position, in the orientation of bd, most played
+      first. Illegal moves are left out. */
+  void Lookup(const GoBoard& bd, std::vector<Move>& moves) const;
+
+  /** Most played book move with at least minCount visits.
+      @return GO_NULLMOVE if there is none */
+  GoMove BestMove(const GoBoard& bd, unsigned int minCount = 1) const;
+
+ private:
+  friend class GoOpeningBookBuilder;
+  struct FileEntry;
+  const FileEntry* m_entries;
+  std::size_t m_nuEntries;
+  std::size_t m_nuPositions;
+  int m_boardSize;
+  void* m_mapping;
+  std::size_t m_mappingSize;
+  GoOpeningBook(const GoOpeningBook&);
+  GoOpeningBook& operator=(const GoOpeningBook&);
+};
+
+inline bool GoOpeningBook::IsOpen() const {
+  return m_mapping != 0;
+}
+
+inline int GoOpeningBook::BoardSize() const {
+  return m_boardSize;
+}
+
+inline std::size_t GoOpeningBook::NuPositions() const {
+  return m_nuPositions;
+}
+
+/** Collects move statistics for a GoOpeningBook from search results and
+    played games. Thread-safe. */
+class GoOpeningBookBuilder {
+ public:
+  explicit GoOpeningBookBuilder(int boardSize);
+
+  int BoardSize() const;
+
+  /** Add count visits of move with a mean value for the color to play. */
+  void Add(const GoBoard& bd, GoMove move, unsigned int count, float value);
+
+  /** Add the first maxMoves moves of the games of the corpus, one visit
+      each, with value 1 for the winner. */
+  void AddCorpus(const SgSgfCorpus& corpus, int maxMoves);
+
+  std::size_t NuMoves() const;
+
+  /** Write the moves with at least minCount visits.
+      @return false if the file could not be written */
+  bool Write(const std::string& fileName, unsigned int minCount) const;
+
+ private:
+  struct Stat {
+    double m_count;
+    double m_valueSum;
+  };
+
+  const int m_boardSize;
+  mutable boost::mutex m_mutex;
+  std::map<std::pair<std::uint64_t, int>, Stat> m_stats;
+};
+
+inline int GoOpeningBookBuilder::BoardSize() const {
+  return m_boardSize;
+}
+
+#endif // GO_OPENING_BOOK_H
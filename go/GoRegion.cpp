@@ -58,6 +58,7 @@ GoRegion::GoRegion(const GoBoard& board, const GoPointSet& points,
     : m_bd(board),
       m_points(points),
       m_color(color),
+      m_computedHealthyBlocks(false),
       m_eyes(),
       m_vitalPoint(GO_NULLMOVE),
       m_1vcDepth(0),
@@ -933,6 +934,24 @@ void GoRegion::FindChains(const GoRegionBoard& ra) {
   m_computedFlags.set(GO_REGION_COMPUTED_CHAINS);
 }
 
+void GoRegion::ClearChains() {
+  m_chains.Clear();
+  m_computedFlags.reset(GO_REGION_COMPUTED_CHAINS);
+}
+
+const SgVectorOf<GoBlock>& GoRegion::HealthyBlocks() {
+  const GoPointSet empty = m_points & m_bd.AllEmpty();
+  if (m_computedHealthyBlocks && empty == m_healthyEmpty)
+    return m_healthyBlocks;
+  m_healthyBlocks.Clear();
+  for (SgVectorIteratorOf<GoBlock> it(m_blocks); it; ++it)
+    if ((*it)->AllEmptyAreLiberties(m_points))
+      m_healthyBlocks.PushBack(*it);
+  m_healthyEmpty = empty;
+  m_computedHealthyBlocks = true;
+  return m_healthyBlocks;
+}
+
 bool GoRegion::IsSurrounded(const SgVectorOf<GoBlock>& blocks) const {
   const int size = m_bd.Size();
   GoPointSet adj(Points().Border(size));
@@ -108,6 +108,8 @@ class GoRegion {
     m_computedFlags.reset();
     m_computedFlags.set(GO_REGION_COMPUTED_BLOCKS);
     m_eyes.Clear();
+    m_miaiStrategy.Clear();
+    m_computedHealthyBlocks = false;
     Invalidate();
   }
 
@@ -161,6 +163,12 @@ class GoRegion {
   void FindBlocks(const GoRegionBoard& ra);
   void SetBlocks(const SgVectorOf<GoBlock>& blocks);
   void FindChains(const GoRegionBoard& ra);
+  void ClearChains();
+
+  /** Blocks for which all empty points of the region are liberties.
+      Kept across ReInitialize() and recomputed only after the points,
+      the blocks or the empty points of the region changed. */
+  const SgVectorOf<GoBlock>& HealthyBlocks();
 
   void SetToSafe() { SetFlag(GO_REGION_SAFE, true); }
 
@@ -178,6 +186,9 @@ class GoRegion {
   SgBlackWhite m_color;
   SgVectorOf<GoBlock> m_blocks;
   SgVectorOf<GoChain> m_chains;
+  SgVectorOf<GoBlock> m_healthyBlocks;
+  GoPointSet m_healthyEmpty;
+  bool m_computedHealthyBlocks;
   GoEyeCount m_eyes;
   GoPoint m_vitalPoint;
   int m_1vcDepth;
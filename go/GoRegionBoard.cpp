@@ -156,6 +156,7 @@ void GoRegionBoard::ExecuteMovePrologue() {
 void GoRegionBoard::OnExecutedUncodedMove(int move, SgBlackWhite moveColor) {
   if (DEBUG_REGION_BOARD)
     SgDebug() << "OnExecutedUncodedMove " << GoWritePoint(move) << '\n';
+  m_computedHealthy = false;
   {
     m_stack.StartMoveInfo();
     if (move != GO_PASS) {
@@ -421,6 +422,12 @@ void GoRegionBoard::OnUndoneMove() {
   if (DEBUG_REGION_BOARD)
     SgDebug() << "OnUndoneMove " << '\n';
 
+  m_computedHealthy = false;
+  if (m_stack.IsEmpty()) {
+    // Undo past the position the region board was generated for
+    m_invalid = true;
+    return;
+  }
   const bool IS_UNDO = false;
   SgVectorOf<GoRegion> changed;
 
@@ -498,6 +505,8 @@ void GoRegionBoard::OnUndoneMove() {
 
 void GoRegionBoard::ReInitializeBlocksRegions() {
   DBG_ASSERT(UpToDate());
+  ClearChains();
+  m_computedHealthy = false;
 
   for (SgBWIterator cit; cit; ++cit) {
     SgBlackWhite color(*cit);
@@ -559,6 +568,8 @@ void GoRegionBoard::GenBlocksRegions() {
 
   FindBlocksWithEye();
 
+  // Generation is not undoable, only the moves executed from here on
+  m_stack.Clear();
   m_code = Board().GetHashCode();
   m_invalid = false;
   if (HEAVYCHECK)
@@ -569,10 +580,9 @@ void GoRegionBoard::GenChains() {
   if (ChainsUpToDate())
     return;
 
+  ClearChains();
   for (SgBWIterator cit; cit; ++cit) {
     SgBlackWhite color(*cit);
-    DBG_ASSERT(AllChains(color).IsEmpty());
-
     for (SgVectorIteratorOf<GoBlock> it(AllBlocks(color)); it; ++it)
       AllChains(color).PushBack(new GoChain(*it, Board()));
     for (SgVectorIteratorOf<GoRegion> it(AllRegions(color)); it; ++it)
@@ -581,6 +591,18 @@ void GoRegionBoard::GenChains() {
   m_chainsCode = Board().GetHashCode();
 }
 
+void GoRegionBoard::ClearChains() {
+  for (SgBWIterator cit; cit; ++cit) {
+    SgBlackWhite color(*cit);
+    for (SgVectorIteratorOf<GoChain> it(AllChains(color)); it; ++it)
+      delete *it;
+    AllChains(color).Clear();
+    for (SgVectorIteratorOf<GoRegion> it(AllRegions(color)); it; ++it)
+      (*it)->ClearChains();
+  }
+  m_chainsCode.Clear();
+}
+
 void GoRegionBoard::WriteBlocks(std::ostream& stream) const {
   for (SgBWIterator cit; cit; ++cit) {
     SgBlackWhite color(*cit);
@@ -119,6 +119,7 @@ class GoRegionBoard {
  private:
 
   void GenBlocks();
+  void ClearChains();
   void FindBlocksWithEye();
   GoBlock* GenBlock(GoPoint anchor, SgBlackWhite color);
   GoRegion* GenRegion(const GoPointSet& area, SgBlackWhite color);
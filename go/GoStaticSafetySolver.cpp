@@ -50,11 +50,8 @@ void GoStaticSafetySolver::FindHealthy() {
     for (SgVectorIteratorOf<GoRegion>
              it(Regions()->AllRegions(color)); it; ++it) {
       GoRegion* r = *it;
-      for (SgVectorIteratorOf<GoBlock> it2(r->Blocks()); it2; ++it2) {
-        if (RegionHealthyForBlock(*r, **it2)) {
-          (*it2)->AddHealthy(r);
-        }
-      }
+      for (SgVectorIteratorOf<GoBlock> it2(r->HealthyBlocks()); it2; ++it2)
+        (*it2)->AddHealthy(r);
     }
   }
   Regions()->SetComputedHealthy();
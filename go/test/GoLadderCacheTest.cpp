@@ -0,0 +1,125 @@
+
+
+#include "platform/SgSystem.h"
+#include "GoLadderCache.h"
+
+#include <boost/test/auto_unit_test.hpp>
+#include "GoBitboardLadder.h"
+#include "GoBoard.h"
+#include "GoLadder.h"
+#include "GoSetup.h"
+
+using GoPointUtil::Pt;
+
+namespace {
+
+/** White stone at (3,3) in atari, running in a ladder towards the upper
+    right corner. */
+GoSetup LadderSetup() {
+  GoSetup setup;
+  setup.AddWhite(Pt(3, 3));
+  setup.AddBlack(Pt(2, 3));
+  setup.AddBlack(Pt(3, 2));
+  setup.AddBlack(Pt(4, 2));
+  setup.AddBlack(Pt(3, 4));
+  setup.m_player = SG_WHITE;
+  return setup;
+}
+
+void CheckSameAsGoLadder(const GoBoard& bd, GoPoint prey,
+                         SgBlackWhite toPlay) {
+  GoLadder ladder;
+  SgVector<GoPoint> expected;
+  int expectedResult = ladder.Ladder(bd, prey, toPlay, &expected, false);
+  GoLadderCache cache;
+  SgVector<GoPoint> sequence;
+  BOOST_CHECK_EQUAL(cache.Ladder(bd, prey, toPlay, &sequence, true),
+                    expectedResult);
+  BOOST_CHECK(sequence == expected);
+  BOOST_CHECK_EQUAL(cache.Ladder(bd, prey, toPlay, &sequence, false),
+                    expectedResult);
+  BOOST_CHECK(sequence == expected);
+  BOOST_CHECK_EQUAL(cache.NuHits(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(GoBitboardLadderTest_Captured) {
+  GoBoard bd(9, LadderSetup());
+  GoLadder ladder;
+  SgVector<GoPoint> expected;
+  int expectedResult = ladder.Ladder(bd, Pt(3, 3), SG_WHITE, &expected);
+  BOOST_CHECK(expectedResult < 0);
+  GoBitboardLadder bitboardLadder;
+  SgVector<GoPoint> sequence;
+  int result;
+  BOOST_REQUIRE(bitboardLadder.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence,
+                                      result));
+  BOOST_CHECK_EQUAL(result, expectedResult);
+  BOOST_CHECK(sequence == expected);
+  BOOST_CHECK(bitboardLadder.PlayedPoints().Contains(Pt(4, 3)));
+}
+
+BOOST_AUTO_TEST_CASE(GoBitboardLadderTest_Breaker) {
+  GoSetup setup = LadderSetup();
+  setup.AddWhite(Pt(7, 7));
+  GoBoard bd(9, setup);
+  GoLadder ladder;
+  SgVector<GoPoint> expected;
+  int expectedResult = ladder.Ladder(bd, Pt(3, 3), SG_WHITE, &expected);
+  BOOST_CHECK(expectedResult > 0);
+  GoBitboardLadder bitboardLadder;
+  SgVector<GoPoint> sequence;
+  int result;
+  BOOST_REQUIRE(bitboardLadder.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence,
+                                      result));
+  BOOST_CHECK_EQUAL(result, expectedResult);
+  BOOST_CHECK(sequence == expected);
+}
+
+/** Prey can capture an adjacent hunter block, which is left to GoLadder. */
+BOOST_AUTO_TEST_CASE(GoBitboardLadderTest_FallBack) {
+  GoSetup setup = LadderSetup();
+  setup.AddWhite(Pt(2, 4));
+  setup.AddWhite(Pt(3, 5));
+  GoBoard bd(9, setup);
+  BOOST_REQUIRE(bd.InAtari(Pt(3, 4)));
+  GoBitboardLadder bitboardLadder;
+  SgVector<GoPoint> sequence;
+  int result;
+  BOOST_CHECK(!bitboardLadder.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence,
+                                     result));
+  BOOST_CHECK(sequence.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(GoLadderCacheTest_SameAsGoLadder) {
+  GoBoard bd(9, LadderSetup());
+  CheckSameAsGoLadder(bd, Pt(3, 3), SG_WHITE);
+  CheckSameAsGoLadder(bd, Pt(3, 3), SG_BLACK);
+  GoSetup setup = LadderSetup();
+  setup.AddWhite(Pt(7, 7));
+  GoBoard bd2(9, setup);
+  CheckSameAsGoLadder(bd2, Pt(3, 3), SG_WHITE);
+}
+
+BOOST_AUTO_TEST_CASE(GoLadderCacheTest_Invalidate) {
+  GoBoard bd(9, LadderSetup());
+  GoLadderCache cache;
+  SgVector<GoPoint> sequence;
+  BOOST_CHECK(cache.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence) < 0);
+  const int length = sequence.Length();
+  bd.Play(Pt(1, 9), SG_WHITE);
+  bd.Play(Pt(1, 8), SG_BLACK);
+  BOOST_CHECK(cache.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence) < 0);
+  BOOST_CHECK_EQUAL(cache.NuHits(), 1u);
+  BOOST_CHECK_EQUAL(sequence.Length(), length);
+  bd.Play(Pt(7, 7), SG_WHITE);
+  bd.Play(Pt(9, 1), SG_BLACK);
+  BOOST_CHECK(cache.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence) > 0);
+  BOOST_CHECK_EQUAL(cache.NuHits(), 1u);
+  bd.Undo();
+  bd.Undo();
+  BOOST_CHECK(cache.Ladder(bd, Pt(3, 3), SG_WHITE, &sequence) < 0);
+  BOOST_CHECK_EQUAL(cache.NuHits(), 1u);
+  BOOST_CHECK_EQUAL(cache.NuLookups(), 4u);
+}
+
+}
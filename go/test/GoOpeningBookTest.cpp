@@ -0,0 +1,135 @@
+
+
+#include "platform/SgSystem.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include "GoBoard.h"
+#include "GoOpeningBook.h"
+#include "SgSgfCorpus.h"
+
+using GoPointUtil::Pt;
+
+namespace {
+
+/** Book file, removed at the end of the test. */
+struct TempBook {
+  TempBook()
+      : m_fileName((boost::filesystem::temp_directory_path()
+                    / boost::filesystem::unique_path()).string()) {}
+
+  ~TempBook() {
+    std::remove(m_fileName.c_str());
+  }
+
+  std::string m_fileName;
+};
+
+BOOST_AUTO_TEST_CASE(GoOpeningBookTest_NormalizedKey) {
+  GoBoard bd1(19);
+  bd1.Play(Pt(4, 3), SG_BLACK);
+  GoBoard bd2(19);
+  bd2.Play(Pt(16, 17), SG_BLACK);
+  GoBoard bd3(19);
+  bd3.Play(Pt(3, 16), SG_BLACK);
+  int rotation;
+  const std::uint64_t key = GoOpeningBookUtil::NormalizedKey(bd1, rotation);
+  BOOST_CHECK_EQUAL(GoOpeningBookUtil::NormalizedKey(bd2, rotation), key);
+  BOOST_CHECK_EQUAL(GoOpeningBookUtil::NormalizedKey(bd3, rotation), key);
+  bd1.SetToPlay(SG_BLACK);
+  BOOST_CHECK(GoOpeningBookUtil::NormalizedKey(bd1, rotation) != key);
+  GoBoard bd4(19);
+  bd4.Play(Pt(4, 4), SG_BLACK);
+  BOOST_CHECK(GoOpeningBookUtil::NormalizedKey(bd4, rotation) != key);
+}
+
+BOOST_AUTO_TEST_CASE(GoOpeningBookTest_Lookup) {
+  TempBook file;
+  GoOpeningBookBuilder builder(19);
+  GoBoard bd(19);
+  bd.Play(Pt(4, 3), SG_BLACK);
+  builder.Add(bd, Pt(16, 17), 10, 0.4f);
+  builder.Add(bd, Pt(16, 17), 30, 0.6f);
+  builder.Add(bd, Pt(17, 16), 5, 0.5f);
+  builder.Add(bd, Pt(10, 10), 1, 0.5f);
+  BOOST_CHECK_EQUAL(builder.NuMoves(), 3u);
+  BOOST_REQUIRE(builder.Write(file.m_fileName, 2));
+
+  GoOpeningBook book;
+  BOOST_REQUIRE(book.Open(file.m_fileName));
+  BOOST_CHECK_EQUAL(book.BoardSize(), 19);
+  BOOST_CHECK_EQUAL(book.NuPositions(), 1u);
+  // The same position, mirrored at the vertical center line
+  GoBoard mirrored(19);
+  mirrored.Play(Pt(16, 3), SG_BLACK);
+  std::vector<GoOpeningBook::Move> moves;
+  book.Lookup(mirrored, moves);
+  BOOST_REQUIRE_EQUAL(moves.size(), 2u);
+  BOOST_CHECK_EQUAL(moves[0].m_move, Pt(4, 17));
+  BOOST_CHECK_EQUAL(moves[0].m_count, 40u);
+  BOOST_CHECK_CLOSE(moves[0].m_value, 0.55f, 1e-3);
+  BOOST_CHECK_EQUAL(moves[1].m_move, Pt(3, 16));
+  BOOST_CHECK_EQUAL(book.BestMove(bd), Pt(16, 17));
+  BOOST_CHECK_EQUAL(book.BestMove(bd, 41), GO_NULLMOVE);
+  BOOST_CHECK_EQUAL(book.BestMove(GoBoard(19)), GO_NULLMOVE);
+  BOOST_CHECK_EQUAL(book.BestMove(GoBoard(9)), GO_NULLMOVE);
+  book.Close();
+  BOOST_CHECK(!book.IsOpen());
+  BOOST_CHECK(!book.Open(file.m_fileName + ".missing"));
+}
+
+BOOST_AUTO_TEST_CASE(GoOpeningBookTest_SymmetricMoves) {
+  GoOpeningBookBuilder builder(9);
+  GoBoard bd(9);
+  builder.Add(bd, Pt(3, 3), 1, 1.f);
+  builder.Add(bd, Pt(7, 7), 1, 0.f);
+  builder.Add(bd, Pt(3, 7), 1, 1.f);
+  builder.Add(bd, Pt(5, 5), 1, 1.f);
+  BOOST_CHECK_EQUAL(builder.NuMoves(), 2u);
+  TempBook file;
+  BOOST_REQUIRE(builder.Write(file.m_fileName, 1));
+  GoOpeningBook book;
+  BOOST_REQUIRE(book.Open(file.m_fileName));
+  std::vector<GoOpeningBook::Move> moves;
+  book.Lookup(bd, moves);
+  BOOST_REQUIRE_EQUAL(moves.size(), 2u);
+  BOOST_CHECK_EQUAL(moves[0].m_count, 3u);
+  BOOST_CHECK_EQUAL(bd.Line(moves[0].m_move), 3);
+  BOOST_CHECK_EQUAL(moves[1].m_move, Pt(5, 5));
+}
+
+BOOST_AUTO_TEST_CASE(GoOpeningBookTest_AddCorpus) {
+  const std::string text =
+      "(;SZ[9]RE[B+3];B[ee];W[cc];B[gc])"
+      "(;SZ[9]RE[W+R];B[ee];W[gg];B[cg])"
+      "(;SZ[19];B[dd])";
+  SgSgfCorpus corpus;
+  corpus.Parse(text.c_str(), text.size());
+  GoOpeningBookBuilder builder(9);
+  builder.AddCorpus(corpus, 2);
+  TempBook file;
+  BOOST_REQUIRE(builder.Write(file.m_fileName, 1));
+  GoOpeningBook book;
+  BOOST_REQUIRE(book.Open(file.m_fileName));
+  GoBoard bd(9);
+  std::vector<GoOpeningBook::Move> moves;
+  book.Lookup(bd, moves);
+  BOOST_REQUIRE_EQUAL(moves.size(), 1u);
+  BOOST_CHECK_EQUAL(moves[0].m_move, Pt(5, 5));
+  BOOST_CHECK_EQUAL(moves[0].m_count, 2u);
+  BOOST_CHECK_CLOSE(moves[0].m_value, 0.5f, 1e-3);
+  // W[cc] and W[gg] are symmetric replies
+  bd.Play(Pt(5, 5), SG_BLACK);
+  book.Lookup(bd, moves);
+  BOOST_REQUIRE_EQUAL(moves.size(), 1u);
+  BOOST_CHECK_EQUAL(moves[0].m_count, 2u);
+  BOOST_CHECK_EQUAL(bd.Line(moves[0].m_move), 3);
+  // Only the first two moves
+  bd.Play(moves[0].m_move, SG_WHITE);
+  BOOST_CHECK_EQUAL(book.BestMove(bd), GO_NULLMOVE);
+}
+
+}
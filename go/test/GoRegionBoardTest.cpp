@@ -3,14 +3,92 @@
 #include "platform/SgSystem.h"
 
 #include <boost/test/auto_unit_test.hpp>
+#include "GoBensonSolver.h"
 #include "GoBoard.h"
+#include "GoEyeUtil.h"
 #include "GoRegionBoard.h"
+#include "GoSafetySolver.h"
 #include "SgNode.h"
 
 using GoPointUtil::Pt;
 
 namespace {
 
+/** Deterministic move sequence without filling simple eyes. */
+GoPoint NextMove(const GoBoard& bd, int i) {
+  SgVector<GoPoint> moves;
+  for (GoBoard::Iterator it(bd); it; ++it)
+    if (bd.IsLegal(*it) && !GoEyeUtil::IsSimpleEye(bd, *it, bd.ToPlay()))
+      moves.PushBack(*it);
+  if (moves.IsEmpty())
+    return GO_PASS;
+  return moves[(i * 7919) % moves.Length()];
+}
+
+/** Safe points found with the incrementally updated region board must be
+    the same as with a region board generated from scratch. */
+void CheckSafePoints(const GoBoard& bd, GoRegionBoard& regions) {
+  BOOST_REQUIRE(regions.UpToDate());
+  GoBWSet safe;
+  GoBensonSolver benson(bd, &regions);
+  benson.FindSafePoints(&safe);
+  GoBWSet expected;
+  GoBensonSolver(bd).FindSafePoints(&expected);
+  BOOST_CHECK(safe == expected);
+  safe.Clear();
+  GoSafetySolver solver(bd, &regions);
+  solver.FindSafePoints(&safe);
+  expected.Clear();
+  GoSafetySolver(bd).FindSafePoints(&expected);
+  BOOST_CHECK(safe == expected);
+}
+
+BOOST_AUTO_TEST_CASE(GoRegionBoardTest_ExecuteUndo) {
+  GoBoard bd(7);
+  GoRegionBoard regions(bd);
+  const int nuMoves = 80;
+  int nuPlayed = 0;
+  for (int i = 0; i < nuMoves; ++i) {
+    const GoPoint move = NextMove(bd, i);
+    const SgBlackWhite toPlay = bd.ToPlay();
+    regions.ExecuteMovePrologue();
+    bd.Play(move);
+    regions.OnExecutedMove(GoPlayerMove(toPlay, move));
+    ++nuPlayed;
+    CheckSafePoints(bd, regions);
+    if (i % 3 == 2) {
+      bd.Undo();
+      regions.OnUndoneMove();
+      --nuPlayed;
+      CheckSafePoints(bd, regions);
+    }
+  }
+  for (; nuPlayed > 0; --nuPlayed) {
+    bd.Undo();
+    regions.OnUndoneMove();
+    if (nuPlayed % 4 == 0)
+      CheckSafePoints(bd, regions);
+  }
+  BOOST_CHECK(regions.UpToDate());
+  BOOST_CHECK_EQUAL(regions.AllBlocks(SG_BLACK).Length(), 0);
+  BOOST_CHECK_EQUAL(regions.AllRegions(SG_BLACK).Length(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(GoRegionBoardTest_UndoPastGeneration) {
+  GoBoard bd(7);
+  bd.Play(Pt(3, 3), SG_BLACK);
+  bd.Play(Pt(5, 5), SG_WHITE);
+  GoRegionBoard regions(bd);
+  BOOST_CHECK(regions.UpToDate());
+  bd.Undo();
+  regions.OnUndoneMove();
+  BOOST_CHECK(!regions.UpToDate());
+  regions.ExecuteMovePrologue();
+  BOOST_CHECK(regions.UpToDate());
+  BOOST_CHECK_EQUAL(regions.AllBlocks(SG_BLACK).Length(), 1);
+  BOOST_CHECK_EQUAL(regions.AllBlocks(SG_WHITE).Length(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(GoRegionBoardTest_Setup) {
   GoSetup setup;
   setup.AddBlack(Pt(4, 5));
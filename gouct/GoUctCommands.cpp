@@ -4,6 +4,7 @@
 
 #include "GoGame.h"
 #include "GoGtpCommandUtil.h"
+#include "GoOpeningBook.h"
 #include "GoBoardUtil.h"
 #include "GoSafetySolver.h"
 #include "GoUctDefaultMoveFilter.h"
@@ -17,6 +18,8 @@
 #include "SgGtpUtil.h"
 #include "board/GoPointSetUtil.h"
 #include "platform/SgRestorer.h"
+#include "SgSgfCorpus.h"
+#include "UctDeepPlayer.h"
 #include "UctTreeUtil.h"
 #include "board/SgWrite.h"
 
@@ -101,7 +104,8 @@ GoUctCommands::GoUctCommands(GoPlayer *&player, const GoGame &game, GoRules &rul
     : m_bd(game.Board()),
       m_player(player),
       m_trainer(game, rules),
-      m_game(game) {}
+      m_game(game),
+      m_engine(nullptr) {}
 
 void GoUctCommands::AddGoGuiAnalyzeCommands(GtpCommand &cmd) {
   cmd <<
@@ -134,18 +138,55 @@ void GoUctCommands::AddGoGuiAnalyzeCommands(GtpCommand &cmd) {
           "none/Uct SaveGames/uct_savegames %w\n"
           "none/Uct SaveTree/uct_savetree %w\n"
           "gfx/Uct Sequence/uct_sequence\n"
+          "hstring/Uct Stat Memory/uct_stat_memory\n"
+          "hstring/Uct Stat Phases/uct_stat_phases\n"
+          "none/Uct Stat Phases Clear/uct_stat_phases_clear\n"
           "hstring/Uct Stat Player/uct_stat_player\n"
           "none/Uct Stat Player Clear/uct_stat_player_clear\n"
           "hstring/Uct Stat Policy/uct_stat_policy\n"
           "none/Uct Stat Policy Clear/uct_stat_policy_clear\n"
           "hstring/Uct Stat Search/uct_stat_search\n"
-          "dboard/Uct Stat Territory/uct_stat_territory\n";
+          "dboard/Uct Stat Territory/uct_stat_territory\n"
+          "none/Uct Trace Phases/uct_trace_phases %w\n";
 }
 
 void GoUctCommands::CmdAdditiveKnowledge(GtpCommand &cmd) {
   DisplayKnowledge(cmd, true);
 }
 
+/** Search the current position until the next command and report the
+    candidate moves while searching.
+    Arguments: [interval [minVisits [maxMoves]]]. The response stays open
+    and gets a line in the format of GoUctUtil::WriteAnalysis about every
+    interval seconds (default 1), with the moves with at least minVisits
+    visits (default 1), at most maxMoves of them (default 0 = all). The
+    tree is kept, so the next search of this position or a following one
+    continues with it. */
+void GoUctCommands::CmdAnalyze(GtpCommand &cmd) {
+  cmd.CheckNuArgLessEqual(3);
+  const double interval =
+      cmd.NuArg() < 1 ? 1.0 : cmd.ArgMin<double>(0, 0.01);
+  const UctValueType minVisits =
+      cmd.NuArg() < 2 ? 1 : cmd.ArgMin<UctValueType>(1, 0);
+  const std::size_t maxMoves =
+      cmd.NuArg() < 3 ? 0 : cmd.ArgMin<std::size_t>(2, 0);
+  UctDeepPlayer &player = DeepPlayer();
+  const SgBlackWhite toPlay = m_bd.ToPlay();
+  m_engine->StreamResponse(
+      [&player, toPlay, interval, minVisits, maxMoves](GtpOutputStream &out) {
+        player.Analyze(toPlay, interval,
+                       [&out, minVisits, maxMoves](const UctSearch &search) {
+                         std::ostringstream analysis;
+                         GoUctUtil::WriteAnalysis(search, minVisits, maxMoves,
+                                                  analysis);
+                         if (!analysis.str().empty()) {
+                           out.Write(analysis.str());
+                           out.Flush();
+                         }
+                       });
+      });
+}
+
 void GoUctCommands::CmdBounds(GtpCommand &cmd) {
   cmd.CheckArgNone();
   const GoUctSearch &search = Search();
@@ -171,6 +212,64 @@ void GoUctCommands::CmdBounds(GtpCommand &cmd) {
         << std::fixed << std::setprecision(2) << passBound << '\n';
 }
 
+/** Add the first moves of the games in SGF files to the book statistics.
+    Arguments: maxMoves file... */
+void GoUctCommands::CmdBookAddSgf(GtpCommand &cmd) {
+  if (cmd.NuArg() < 2)
+    throw GtpFailure("need maxMoves and at least one file");
+  const int maxMoves = cmd.ArgMin<int>(0, 1);
+  std::vector<std::string> files;
+  for (std::size_t i = 1; i < cmd.NuArg(); ++i)
+    files.push_back(cmd.Arg(i));
+  SgSgfCorpus corpus;
+  corpus.LoadFiles(files, boost::thread::hardware_concurrency());
+  BookBuilder().AddCorpus(corpus, maxMoves);
+  cmd << corpus.NuGames() << " games, " << BookBuilder().NuMoves()
+      << " book moves";
+}
+
+/** Collect the root moves of all following searches of the deep player
+    into the book statistics.
+    Argument: minimum number of visits of a root move (0 stops collecting) */
+void GoUctCommands::CmdBookBuildStart(GtpCommand &cmd) {
+  cmd.CheckNuArg(1);
+  const unsigned int minVisits = cmd.ArgMin<unsigned int>(0, 0);
+  if (minVisits == 0)
+    DeepPlayer().SetBookBuilder(nullptr, 0);
+  else
+    DeepPlayer().SetBookBuilder(&BookBuilder(), minVisits);
+}
+
+void GoUctCommands::CmdBookLoad(GtpCommand &cmd) {
+  cmd.CheckNuArg(1);
+  GoOpeningBook &book = DeepPlayer().OpeningBook();
+  if (!book.Open(cmd.Arg(0)))
+    throw GtpFailure() << "could not open book " << cmd.Arg(0);
+  cmd << book.NuPositions() << " positions";
+}
+
+/** Book moves of the current position with visit count and value. */
+void GoUctCommands::CmdBookMoves(GtpCommand &cmd) {
+  cmd.CheckArgNone();
+  std::vector<GoOpeningBook::Move> moves;
+  DeepPlayer().OpeningBook().Lookup(m_bd, moves);
+  for (std::size_t i = 0; i < moves.size(); ++i)
+    cmd << GoWritePoint(moves[i].m_move) << ' ' << moves[i].m_count << ' '
+        << std::fixed << std::setprecision(3) << moves[i].m_value << '\n';
+}
+
+/** Write the collected book statistics.
+    Arguments: file [minimum number of visits of a move] */
+void GoUctCommands::CmdBookSave(GtpCommand &cmd) {
+  cmd.CheckNuArgLessEqual(2);
+  const unsigned int minCount =
+      cmd.NuArg() < 2 ? 1 : cmd.ArgMin<unsigned int>(1, 1);
+  if (cmd.NuArg() < 1 || !m_bookBuilder)
+    throw GtpFailure("need file and collected book statistics");
+  if (!m_bookBuilder->Write(cmd.Arg(0), minCount))
+    throw GtpFailure() << "could not write " << cmd.Arg(0);
+}
+
 void GoUctCommands::CmdDeterministicMode(GtpCommand &cmd) {
   cmd.CheckArgNone();
   GoUctSearch &s = Search();
@@ -260,16 +359,34 @@ void GoUctCommands::CmdIsPolicyMove(GtpCommand &cmd) {
   CompareMove(cmd, GOUCT_COMPAREMOVE_POLICY);
 }
 
+/** Memory budget of the player in bytes.
+    The search trees, the evaluation buffers and the game record of a
+    UctDeepPlayer are allocated up front within the budget. When the tree
+    is full, the search stops expanding, or prunes nodes with low counts
+    and goes on if prune_full_tree is set.
+    Arguments: [bytes] */
 void GoUctCommands::CmdMaxMemory(GtpCommand &cmd) {
   cmd.CheckNuArgLessEqual(1);
-  if (cmd.NuArg() == 0)
-    cmd << Search().MaxNodes() * 2 * sizeof(UctNode);
-  else {
+  UctDeepPlayer *player = dynamic_cast<UctDeepPlayer *>(m_player);
+  if (cmd.NuArg() == 0) {
+    size_t memory = UctSearch::MemoryForNodes(Search().MaxNodes());
+    if (player != nullptr)
+      memory += player->MemoryUsage().policy_reserved;
+    cmd << memory;
+  } else {
     if (SgDeterministic::IsDeterministicMode())
       throw GtpFailure() << "Command is blocked in deterministic mode.";
 
-    std::size_t memory = cmd.ArgMin<size_t>(0, 2 * sizeof(UctNode));
-    Search().SetMaxNodes(memory / 2 / sizeof(UctNode));
+    std::size_t memory = cmd.ArgT<size_t>(0);
+    if (player != nullptr) {
+      if (!player->SetMaxMemory(memory))
+        throw GtpFailure() << "memory too small";
+    } else {
+      std::size_t maxNodes = UctSearch::NodesForMemory(memory);
+      if (maxNodes < Search().NumberThreads())
+        throw GtpFailure() << "memory too small";
+      Search().SetMaxNodes(maxNodes);
+    }
   }
 }
 
@@ -294,6 +411,7 @@ void GoUctCommands::CmdParamGlobalSearch(GtpCommand &cmd) {
         << '\n'
         << "[bool] use_default_prior_knowledge "
         << p.m_useDefaultPriorKnowledge << '\n'
+        << "[bool] use_safety_solver " << p.m_useSafetySolver << '\n'
         << "[bool] use_tree_filter " << p.m_useTreeFilter << '\n'
         << "[float] default_prior_weight " << p.m_defaultPriorWeight
         << '\n'
@@ -313,6 +431,8 @@ void GoUctCommands::CmdParamGlobalSearch(GtpCommand &cmd) {
       p.m_territoryStatistics = cmd.ArgT<bool>(1);
     else if (name == "use_default_prior_knowledge")
       p.m_useDefaultPriorKnowledge = cmd.ArgT<bool>(1);
+    else if (name == "use_safety_solver")
+      p.m_useSafetySolver = cmd.ArgT<bool>(1);
     else if (name == "use_tree_filter")
       p.m_useTreeFilter = cmd.ArgT<bool>(1);
     else if (name == "default_prior_weight")
@@ -492,6 +612,8 @@ void GoUctCommands::CmdParamRootFilter(GtpCommand &cmd) {
         << p.CheckOffensiveLadders() << '\n';
     cmd << "[bool] check_safety " << p.CheckSafety() << '\n';
     cmd << "[bool] filter_first_line " << p.FilterFirstLine() << '\n';
+    cmd << "[bool] bitboard_ladder " << p.BitboardLadder() << '\n';
+    cmd << "[bool] use_ladder_cache " << p.UseLadderCache() << '\n';
   } else if (cmd.NuArg() == 2) {
     string name = cmd.Arg(0);
     if (name == "check_ladders")
@@ -502,6 +624,10 @@ void GoUctCommands::CmdParamRootFilter(GtpCommand &cmd) {
       p.SetCheckSafety(cmd.ArgT<bool>(1));
     else if (name == "filter_first_line")
       p.SetFilterFirstLine(cmd.ArgT<bool>(1));
+    else if (name == "bitboard_ladder")
+      p.SetBitboardLadder(cmd.ArgT<bool>(1));
+    else if (name == "use_ladder_cache")
+      p.SetUseLadderCache(cmd.ArgT<bool>(1));
     else
       throw GtpFailure() << "unknown parameter: " << name;
   } else
@@ -517,6 +643,8 @@ void GoUctCommands::CmdParamTreeFilter(GtpCommand &cmd) {
         << p.CheckOffensiveLadders() << '\n';
     cmd << "[bool] check_safety " << p.CheckSafety() << '\n';
     cmd << "[bool] filter_first_line " << p.FilterFirstLine() << '\n';
+    cmd << "[bool] bitboard_ladder " << p.BitboardLadder() << '\n';
+    cmd << "[bool] use_ladder_cache " << p.UseLadderCache() << '\n';
   } else if (cmd.NuArg() == 2) {
     string name = cmd.Arg(0);
     if (name == "check_ladders")
@@ -527,6 +655,10 @@ void GoUctCommands::CmdParamTreeFilter(GtpCommand &cmd) {
       p.SetCheckSafety(cmd.ArgT<bool>(1));
     else if (name == "filter_first_line")
       p.SetFilterFirstLine(cmd.ArgT<bool>(1));
+    else if (name == "bitboard_ladder")
+      p.SetBitboardLadder(cmd.ArgT<bool>(1));
+    else if (name == "use_ladder_cache")
+      p.SetUseLadderCache(cmd.ArgT<bool>(1));
     else
       throw GtpFailure() << "unknown parameter: " << name;
   } else
@@ -544,6 +676,8 @@ void GoUctCommands::CmdParamSearch(GtpCommand &cmd) {
         << "[bool] log_games " << s.LogGames() << '\n'
         << "[bool] prune_full_tree " << s.PruneFullTree() << '\n'
         << "[bool] rave " << s.Rave() << '\n'
+        << "[bool] trace_events " << s.TraceEvents() << '\n'
+        << "[bool] trace_phases " << s.TracePhases() << '\n'
         << "[bool] update_multiple_playouts_as_single " << s.UpdateMultiplePlayoutsAsSingle() << '\n'
         << "[bool] use_virtual_loss " << s.VirtualLoss() << '\n'
         << "[bool] weight_rave_updates " << s.WeightRaveUpdates() << '\n'
@@ -612,6 +746,10 @@ void GoUctCommands::CmdParamSearch(GtpCommand &cmd) {
       s.SetRaveWeightFinal(cmd.ArgT<float>(1));
     else if (name == "rave_weight_initial")
       s.SetRaveWeightInitial(cmd.ArgT<float>(1));
+    else if (name == "trace_events")
+      s.SetTraceEvents(cmd.ArgT<bool>(1));
+    else if (name == "trace_phases")
+      s.SetTracePhases(cmd.ArgT<bool>(1));
     else if (name == "update_multiple_playouts_as_single")
       s.SetUpdateMultiplePlayoutsAsSingle(cmd.ArgT<bool>(1));
     else if (name == "use_virtual_loss")
@@ -775,6 +913,32 @@ void GoUctCommands::CmdSequence(GtpCommand &cmd) {
   GoUctUtil::GfxSequence(Search(), Search().ToPlay(), cmd.ResponseStream());
 }
 
+/** Reserved and used memory of the search and the player in bytes. */
+void GoUctCommands::CmdStatMemory(GtpCommand &cmd) {
+  cmd.CheckArgNone();
+  UctDeepPlayer *player = dynamic_cast<UctDeepPlayer *>(m_player);
+  const UctMemoryUsage usage = player != nullptr ? player->MemoryUsage()
+                                                 : Search().MemoryUsage();
+  usage.Write(cmd.ResponseStream());
+  cmd << SgWriteLabel("MaxMemory")
+      << UctSearch::MemoryForNodes(Search().MaxNodes()) + usage.policy_reserved << '\n';
+}
+
+/** Time spent in the phases of the search iterations.
+    Needs uct_param_search trace_phases 1. The times are summed over all
+    searches since uct_stat_phases_clear. */
+void GoUctCommands::CmdStatPhases(GtpCommand &cmd) {
+  cmd.CheckArgNone();
+  if (!Search().TracePhases())
+    SgWarning() << "phase tracing not enabled in search parameters\n";
+  Search().WritePhaseStatistics(cmd.ResponseStream());
+}
+
+void GoUctCommands::CmdStatPhasesClear(GtpCommand &cmd) {
+  cmd.CheckArgNone();
+  Search().ClearPhaseStatistics();
+}
+
 void GoUctCommands::CmdStatPlayer(GtpCommand &cmd) {
   cmd.CheckArgNone();
   Player().GetStatistics().Write(cmd.ResponseStream());
@@ -800,9 +964,36 @@ void GoUctCommands::CmdStatPolicyClear(GtpCommand &cmd) {
   Policy(0).ClearStatistics();
 }
 
+/** Statistics of the last search.
+    While a deep search runs or an asynchronous genmove is handled, only
+    the snapshot of UctSearch::Snapshot() is written, without the tree
+    statistics, and the parameters count, games_played and nodes refer to
+    it. The tree can change then also before and after the search. */
 void GoUctCommands::CmdStatSearch(GtpCommand &cmd) {
   cmd.CheckNuArgLessEqual(1);
   const GoUctSearch &search = Search();
+  bool useSnapshot = search.IsSearching();
+#if GTPENGINE_ASYNC
+  useSnapshot = useSnapshot || m_engine->IsHandlingConcurrently();
+#endif
+  if (useSnapshot) {
+    const UctSearchSnapshot snapshot = search.Snapshot();
+    if (cmd.NuArg() == 0) {
+      cmd << "SearchSnapshot:\n";
+      snapshot.Write(cmd.ResponseStream());
+    } else {
+      string name = cmd.Arg(0);
+      if (name == "count")
+        cmd << snapshot.root_count << '\n';
+      else if (name == "games_played")
+        cmd << snapshot.games_played << '\n';
+      else if (name == "nodes")
+        cmd << snapshot.nodes << '\n';
+      else
+        throw GtpFailure() << "unknown parameter: " << name;
+    }
+    return;
+  }
   UctTreeStatistics treeStatistics;
   treeStatistics.Compute(search.Tree());
   if (cmd.NuArg() == 0) {
@@ -823,6 +1014,17 @@ void GoUctCommands::CmdStatSearch(GtpCommand &cmd) {
   }
 }
 
+/** Write the timed phases as a Chrome trace (JSON) file.
+    Needs uct_param_search trace_events 1 and trace_phases 1.
+    Arguments: file name */
+void GoUctCommands::CmdTracePhases(GtpCommand &cmd) {
+  cmd.CheckNuArg(1);
+  std::ofstream out(cmd.Arg(0).c_str());
+  if (!out)
+    throw GtpFailure() << "Could not open " << cmd.Arg(0);
+  Search().WritePhaseTrace(out);
+}
+
 namespace {
 
 UctValueType MapMeanToTerritoryEstimate(UctValueType mean) {
@@ -888,6 +1090,11 @@ void GoUctCommands::CmdStartTrainPipeline(GtpCommand &cmd) {
   GetDeepTrainer()->StartTrainEvalPipeLine(true, EVAL_FROM_SERVER_MSG);
 }
 
+void GoUctCommands::CmdStartTrainPipelined(GtpCommand &cmd) {
+  cmd.CheckArgNone();
+  GetDeepTrainer()->StartTrainEvalPipeLine(true, EVAL_PIPELINED);
+}
+
 void GoUctCommands::CmdStartEvalCheckPoint(GtpCommand &cmd) {
   cmd.CheckArgNone();
   GetDeepTrainer()->StartTrainEvalPipeLine(false);
@@ -1067,6 +1274,19 @@ GoUctPlayerType &GoUctCommands::Player() {
   }
 }
 
+UctDeepPlayer &GoUctCommands::DeepPlayer() {
+  UctDeepPlayer *player = dynamic_cast<UctDeepPlayer *>(m_player);
+  if (player == nullptr)
+    throw GtpFailure("player not UctDeepPlayer");
+  return *player;
+}
+
+GoOpeningBookBuilder &GoUctCommands::BookBuilder() {
+  if (!m_bookBuilder)
+    m_bookBuilder.reset(new GoOpeningBookBuilder(m_bd.Size()));
+  return *m_bookBuilder;
+}
+
 GoUctPlayoutPolicy<GoUctBoard> &
 GoUctCommands::Policy(unsigned int threadId) {
   auto *policy = ThreadState(threadId).Policy();
@@ -1076,8 +1296,14 @@ GoUctCommands::Policy(unsigned int threadId) {
 }
 
 void GoUctCommands::Register(GtpEngine &e) {
+  m_engine = &e;
   Register(e, "approximate_territory",
            &GoUctCommands::CmdApproximateTerritory);
+  Register(e, "book_add_sgf", &GoUctCommands::CmdBookAddSgf);
+  Register(e, "book_build_start", &GoUctCommands::CmdBookBuildStart);
+  Register(e, "book_load", &GoUctCommands::CmdBookLoad);
+  Register(e, "book_moves", &GoUctCommands::CmdBookMoves);
+  Register(e, "book_save", &GoUctCommands::CmdBookSave);
   Register(e, "deterministic_mode", &GoUctCommands::CmdDeterministicMode);
   Register(e, "final_score", &GoUctCommands::CmdFinalScore);
   Register(e, "final_status_list", &GoUctCommands::CmdFinalStatusList);
@@ -1087,6 +1313,7 @@ void GoUctCommands::Register(GtpEngine &e) {
            &GoUctCommands::CmdIsPolicyMove);
   Register(e, "uct_additive_knowledge",
            &GoUctCommands::CmdAdditiveKnowledge);
+  Register(e, "uct_analyze", &GoUctCommands::CmdAnalyze);
   Register(e, "uct_bounds", &GoUctCommands::CmdBounds);
   Register(e, "uct_estimator_stat", &GoUctCommands::CmdEstimatorStat);
   Register(e, "uct_gfx", &GoUctCommands::CmdGfx);
@@ -1111,6 +1338,9 @@ void GoUctCommands::Register(GtpEngine &e) {
   Register(e, "uct_savegames", &GoUctCommands::CmdSaveGames);
   Register(e, "uct_savetree", &GoUctCommands::CmdSaveTree);
   Register(e, "uct_sequence", &GoUctCommands::CmdSequence);
+  Register(e, "uct_stat_memory", &GoUctCommands::CmdStatMemory);
+  Register(e, "uct_stat_phases", &GoUctCommands::CmdStatPhases);
+  Register(e, "uct_stat_phases_clear", &GoUctCommands::CmdStatPhasesClear);
   Register(e, "uct_score", &GoUctCommands::CmdScore);
   Register(e, "uct_stat_player", &GoUctCommands::CmdStatPlayer);
   Register(e, "uct_stat_player_clear", &GoUctCommands::CmdStatPlayerClear);
@@ -1118,12 +1348,14 @@ void GoUctCommands::Register(GtpEngine &e) {
   Register(e, "uct_stat_policy_clear", &GoUctCommands::CmdStatPolicyClear);
   Register(e, "uct_stat_search", &GoUctCommands::CmdStatSearch);
   Register(e, "uct_stat_territory", &GoUctCommands::CmdStatTerritory);
+  Register(e, "uct_trace_phases", &GoUctCommands::CmdTracePhases);
   Register(e, "uct_value", &GoUctCommands::CmdValue);
   Register(e, "uct_value_black", &GoUctCommands::CmdValueBlack);
   Register(e, "uct_start_train", &GoUctCommands::CmdStartTrainPipeline);
   Register(e, "uct_self_train", &GoUctCommands::CmdStartTrainPipeline);
   Register(e, "deep-train", &GoUctCommands::CmdStartTrainPipeline);
   Register(e, "deeptrain", &GoUctCommands::CmdStartTrainPipeline);
+  Register(e, "deep-train-pipelined", &GoUctCommands::CmdStartTrainPipelined);
   Register(e, "deep-evaluate", &GoUctCommands::CmdStartEvalCheckPoint);
   Register(e, "deep-eval", &GoUctCommands::CmdStartEvalCheckPoint);
   Register(e, "deep-eval-noipc", &GoUctCommands::CmdStartEvalNoIPC);
@@ -1137,6 +1369,14 @@ void GoUctCommands::Register(GtpEngine &e) {
   Register(e, "selfplayAsServer", &GoUctCommands::CmdStartSelfPlayAsServer);
   Register(e, "selfplayserver", &GoUctCommands::CmdStartSelfPlayAsServer);
   Register(e, "statsevalresult", &GoUctCommands::CmdStartStatServer);
+#if GTPENGINE_ASYNC
+  // Only uct_stat_search has a snapshot of the running search. The other
+  // statistics stay serialized: uct_stat_memory reads the allocators that
+  // genmove fills, uct_stat_player the player statistics that genmove
+  // updates, uct_stat_phases the UctPhaseTracer, which is only read
+  // between searches.
+  e.SetConcurrent("uct_stat_search");
+#endif
 }
 
 void GoUctCommands::Register(GtpEngine &engine, const std::string &command,
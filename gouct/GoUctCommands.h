@@ -2,10 +2,12 @@
 #ifndef GOUCT_COMMANDS_H
 #define GOUCT_COMMANDS_H
 
+#include <memory>
 #include <string>
 #include <UctDeepTrainer.h>
 #include <UctEvalStatServer.h>
 #include "GtpEngine.h"
+#include "GoOpeningBook.h"
 #include "GoUctPlayoutPolicy.h"
 #include "GoUctGlobalSearch.h"
 #include "GoUctPlayer.h"
@@ -33,7 +35,13 @@ class GoUctCommands {
   GoUctCommands(GoPlayer *&player, const GoGame &game, GoRules &rules);
   void AddGoGuiAnalyzeCommands(GtpCommand &cmd);
   void CmdAdditiveKnowledge(GtpCommand &cmd);
+  void CmdAnalyze(GtpCommand &cmd);
   void CmdApproximateTerritory(GtpCommand &cmd);
+  void CmdBookAddSgf(GtpCommand &cmd);
+  void CmdBookBuildStart(GtpCommand &cmd);
+  void CmdBookLoad(GtpCommand &cmd);
+  void CmdBookMoves(GtpCommand &cmd);
+  void CmdBookSave(GtpCommand &cmd);
   void CmdBounds(GtpCommand &cmd);
   void CmdDeterministicMode(GtpCommand &);
   void CmdEstimatorStat(GtpCommand &cmd);
@@ -62,15 +70,20 @@ class GoUctCommands {
   void CmdSaveTree(GtpCommand &cmd);
   void CmdScore(GtpCommand &cmd);
   void CmdSequence(GtpCommand &cmd);
+  void CmdStatMemory(GtpCommand &cmd);
+  void CmdStatPhases(GtpCommand &cmd);
+  void CmdStatPhasesClear(GtpCommand &cmd);
   void CmdStatPlayer(GtpCommand &cmd);
   void CmdStatPlayerClear(GtpCommand &cmd);
   void CmdStatPolicy(GtpCommand &cmd);
   void CmdStatPolicyClear(GtpCommand &cmd);
   void CmdStatSearch(GtpCommand &cmd);
   void CmdStatTerritory(GtpCommand &cmd);
+  void CmdTracePhases(GtpCommand &cmd);
   void CmdValue(GtpCommand &cmd);
   void CmdValueBlack(GtpCommand &cmd);
   void CmdStartTrainPipeline(GtpCommand &cmd);
+  void CmdStartTrainPipelined(GtpCommand &cmd);
   void CmdStartEvalCheckPoint(GtpCommand &cmd);
   void CmdStartEvalNoIPC(GtpCommand &cmd);
   void CmdStartEvalFromClient(GtpCommand &cmd);
@@ -88,6 +101,10 @@ class GoUctCommands {
   UctDeepTrainer m_trainer;
   UctEvalStatServer m_statSvr;
   const GoGame &m_game;
+  /** Engine of Register(), for streamed responses. */
+  GtpEngine *m_engine;
+  /** Statistics collected by book_build_start and book_add_sgf. */
+  std::unique_ptr<GoOpeningBookBuilder> m_bookBuilder;
   void CompareMove(GtpCommand &cmd, GoUctCompareMoveType type);
   void DisplayKnowledge(GtpCommand &cmd, bool additiveKnowledge);
   void DisplayMoveInfo(GtpCommand &cmd,
@@ -98,6 +115,8 @@ class GoUctCommands {
   GoUctGlobalSearch<GoUctPlayoutPolicy<GoUctBoard>,
                     GoUctPlayoutPolicyFactory<GoUctBoard> > &GlobalSearch();
   GoUctPlayerType &Player();
+  UctDeepPlayer &DeepPlayer();
+  GoOpeningBookBuilder &BookBuilder();
   GoUctPlayoutPolicy<GoUctBoard> &Policy(unsigned int threadId);
   void Register(GtpEngine &e, const std::string &command,
                 GtpCallback<GoUctCommands>::Method method);
@@ -58,48 +58,65 @@ GoUctDefaultMoveFilterParam::GoUctDefaultMoveFilterParam()
       m_checkOffensiveLadders(true),
       m_minLadderLength(6),
       m_filterFirstLine(true),
-      m_checkSafety(true) {}
+      m_checkSafety(true),
+      m_useLadderCache(true),
+      m_bitboardLadder(false) {}
 
 GoUctDefaultMoveFilter::GoUctDefaultMoveFilter(const GoBoard &bd, const GoUctDefaultMoveFilterParam &param)
     : m_bd(bd),
-      m_param(param) {}
+      m_param(param),
+      m_regions(0) {}
 
-std::vector<GoPoint> GoUctDefaultMoveFilter::Get() {
-  std::vector<GoPoint> rootFilter;
+int GoUctDefaultMoveFilter::Ladder(GoPoint prey, SgBlackWhite toPlay) {
+  if (m_param.m_useLadderCache)
+    return m_ladder.Ladder(m_bd, prey, toPlay, &m_ladderSequence,
+                           m_param.m_bitboardLadder);
+  return m_ladder.Read(m_bd, prey, toPlay, &m_ladderSequence,
+                       m_param.m_bitboardLadder);
+}
+
+void GoUctDefaultMoveFilter::GetSafeAreaMoves(std::vector<GoPoint> &moves) {
   const SgBlackWhite toPlay = m_bd.ToPlay();
   const SgBlackWhite opp = SgOppBW(toPlay);
-  if (m_param.m_checkSafety) {
-    GoBWSet alternateSafe;
-    GoSafetySolver safetySolver(m_bd);
-    safetySolver.FindSafePoints(&alternateSafe);
-    GoBensonSolver bensonSolver(m_bd);
-    GoBWSet unconditionalSafe;
-    bensonSolver.FindSafePoints(&unconditionalSafe);
-
-    for (GoBoard::Iterator it(m_bd); it; ++it) {
-      const GoPoint p = *it;
-      if (m_bd.IsLegal(p)) {
-        bool isUnconditionalSafe = unconditionalSafe[toPlay].Contains(p);
-        bool isUnconditionalSafeOpp = unconditionalSafe[opp].Contains(p);
-        bool isAlternateSafeOpp = alternateSafe[opp].Contains(p);
-        bool hasOppNeighbors = m_bd.HasNeighbors(p, opp);
-        if (isAlternateSafeOpp
-            || isUnconditionalSafeOpp
-            || (isUnconditionalSafe && !hasOppNeighbors)
-            || (alternateSafe[toPlay].Contains(p)
-                && !safetySolver.PotentialCaptureMove(p, toPlay)
-            )
-            )
-          rootFilter.push_back(p);
-      }
+  GoBWSet alternateSafe;
+  GoSafetySolver safetySolver(m_bd, m_regions);
+  safetySolver.FindSafePoints(&alternateSafe);
+  GoBensonSolver bensonSolver(m_bd, m_regions);
+  GoBWSet unconditionalSafe;
+  bensonSolver.FindSafePoints(&unconditionalSafe);
+  if (alternateSafe.Both().IsEmpty() && unconditionalSafe.Both().IsEmpty())
+    return;
+
+  for (GoBoard::Iterator it(m_bd); it; ++it) {
+    const GoPoint p = *it;
+    if (m_bd.IsLegal(p)) {
+      bool isUnconditionalSafe = unconditionalSafe[toPlay].Contains(p);
+      bool isUnconditionalSafeOpp = unconditionalSafe[opp].Contains(p);
+      bool isAlternateSafeOpp = alternateSafe[opp].Contains(p);
+      bool hasOppNeighbors = m_bd.HasNeighbors(p, opp);
+      if (isAlternateSafeOpp
+          || isUnconditionalSafeOpp
+          || (isUnconditionalSafe && !hasOppNeighbors)
+          || (alternateSafe[toPlay].Contains(p)
+              && !safetySolver.PotentialCaptureMove(p, toPlay)
+          )
+          )
+        moves.push_back(p);
     }
   }
+}
+
+std::vector<GoPoint> GoUctDefaultMoveFilter::Get() {
+  std::vector<GoPoint> rootFilter;
+  const SgBlackWhite toPlay = m_bd.ToPlay();
+  const SgBlackWhite opp = SgOppBW(toPlay);
+  if (m_param.m_checkSafety)
+    GetSafeAreaMoves(rootFilter);
   if (m_param.m_checkLadders) {
     for (GoBlockIterator it(m_bd); it; ++it) {
       const GoPoint p = *it;
       if (m_bd.GetStone(p) == toPlay && m_bd.InAtari(p)) {
-        if (m_ladder.Ladder(m_bd, p, toPlay, &m_ladderSequence,
-                            false) < 0) {
+        if (Ladder(p, toPlay) < 0) {
           if (m_ladderSequence.Length() >= m_param.m_minLadderLength)
             rootFilter.push_back(m_bd.TheLiberty(p));
         }
@@ -115,8 +132,7 @@ std::vector<GoPoint> GoUctDefaultMoveFilter::Get() {
           && m_bd.NumStones(p) >= 5
           && m_bd.NumLiberties(p) == 2
           && LibertiesAreDiagonal(m_bd, p)
-          && m_ladder.Ladder(m_bd, p, toPlay, &m_ladderSequence,
-                             false) > 0
+          && Ladder(p, toPlay) > 0
           && m_ladderSequence.Length() >= m_param.m_minLadderLength
           )
         rootFilter.push_back(m_ladderSequence[0]);
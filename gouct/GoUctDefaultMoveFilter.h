@@ -2,10 +2,11 @@
 #ifndef GOUCT_DEFAULTROOTFILTER_H
 #define GOUCT_DEFAULTROOTFILTER_H
 
-#include "GoLadder.h"
+#include "GoLadderCache.h"
 #include "GoUctMoveFilter.h"
 
 class GoBoard;
+class GoRegionBoard;
 class GoUctDefaultMoveFilterParam {
  public:
   GoUctDefaultMoveFilterParam();
@@ -19,6 +20,10 @@ class GoUctDefaultMoveFilterParam {
   void SetFilterFirstLine(bool enable);
   bool CheckSafety() const;
   void SetCheckSafety(bool enable);
+  bool UseLadderCache() const;
+  void SetUseLadderCache(bool enable);
+  bool BitboardLadder() const;
+  void SetBitboardLadder(bool enable);
 
  public:
   bool m_checkLadders;
@@ -26,6 +31,10 @@ class GoUctDefaultMoveFilterParam {
   int m_minLadderLength;
   bool m_filterFirstLine;
   bool m_checkSafety;
+  /** Reuse ladder readings of sibling positions, see GoLadderCache */
+  bool m_useLadderCache;
+  /** Trace plain ladders with GoBitboardLadder before using GoLadder */
+  bool m_bitboardLadder;
 };
 
 inline bool GoUctDefaultMoveFilterParam::CheckLadders() const {
@@ -60,6 +69,22 @@ inline void GoUctDefaultMoveFilterParam::SetCheckSafety(bool flag) {
   m_checkSafety = flag;
 }
 
+inline bool GoUctDefaultMoveFilterParam::UseLadderCache() const {
+  return m_useLadderCache;
+}
+
+inline void GoUctDefaultMoveFilterParam::SetUseLadderCache(bool enable) {
+  m_useLadderCache = enable;
+}
+
+inline bool GoUctDefaultMoveFilterParam::BitboardLadder() const {
+  return m_bitboardLadder;
+}
+
+inline void GoUctDefaultMoveFilterParam::SetBitboardLadder(bool enable) {
+  m_bitboardLadder = enable;
+}
+
 inline int GoUctDefaultMoveFilterParam::MinLadderLength() const {
   return m_minLadderLength;
 }
@@ -73,11 +98,33 @@ class GoUctDefaultMoveFilter : public GoUctMoveFilter {
   GoUctDefaultMoveFilter(const GoBoard &bd, const GoUctDefaultMoveFilterParam &param);
   std::vector<GoPoint> Get();
 
+  /** Add the moves into safe areas: territory of the opponent and own
+      territory where no capture is possible. Done by Get() if
+      CheckSafety() is set. */
+  void GetSafeAreaMoves(std::vector<GoPoint> &moves);
+
+  /** Region board for the safety solvers. The caller keeps it in sync
+      with the board through its execute/undo hooks; without it the
+      solvers generate their own region board on each call. */
+  void SetRegions(GoRegionBoard *regions);
+
+  const GoLadderCache &LadderCache() const;
+
  private:
   const GoBoard &m_bd;
   const GoUctDefaultMoveFilterParam &m_param;
-  GoLadder m_ladder;
+  GoRegionBoard *m_regions;
+  GoLadderCache m_ladder;
   mutable SgVector<GoPoint> m_ladderSequence;
+  int Ladder(GoPoint prey, SgBlackWhite toPlay);
 };
 
+inline void GoUctDefaultMoveFilter::SetRegions(GoRegionBoard *regions) {
+  m_regions = regions;
+}
+
+inline const GoLadderCache &GoUctDefaultMoveFilter::LadderCache() const {
+  return m_ladder;
+}
+
 #endif
@@ -8,6 +8,7 @@ GoUctGlobalSearchStateParam::GoUctGlobalSearchStateParam()
       m_lengthModification(0),
       m_scoreModification(0.02f),
       m_useTreeFilter(true),
+      m_useSafetySolver(true),
       m_useDefaultPriorKnowledge(true),
       m_defaultPriorWeight(0.15f),
       m_additiveKnowledgeScale(0.03f) {}
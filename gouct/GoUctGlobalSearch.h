@@ -17,13 +17,16 @@
 #include "board/GoPoint.h"
 #include "GoUctPlayoutPolicy.h"
 
-const bool GOUCT_USE_SAFETY_SOLVER = false;
 struct GoUctGlobalSearchStateParam {
   bool m_mercyRule;
   bool m_territoryStatistics;
   UctValueType m_lengthModification;
   UctValueType m_scoreModification;
   bool m_useTreeFilter;
+  /** Run the safety solver at the root and at every tree expansion and
+      prune moves into safe areas. Each thread keeps a region board in sync
+      with its in-tree moves for this. */
+  bool m_useSafetySolver;
   bool m_useDefaultPriorKnowledge;
   float m_defaultPriorWeight;
   float m_additiveKnowledgeScale;
@@ -58,6 +61,9 @@ class GoUctGlobalSearchState
   bool WinTheGame();
   bool TrompTaylorPassWins();
   void CollectFeatures(char feature[][GO_MAX_SIZE][GO_MAX_SIZE], int numFeatures);
+  void Execute(GoMove move);
+  void Apply(GoMove move);
+  void TakeBackInTree(std::size_t nuMoves);
   bool GenerateAllMoves(UctValueType count, std::vector<UctMoveInfo> &moves,
                         UctProvenType &provenType);
   void GenerateLegalMoves(std::vector<UctMoveInfo> &moves);
@@ -86,10 +92,14 @@ class GoUctGlobalSearchState
   UctValueType m_invMaxScore;
   SgRandom m_random;
   boost::scoped_ptr<POLICY> m_policy;
+  /** Follows the in-tree moves if m_trackRegions is set */
+  GoRegionBoard m_regions;
+  bool m_trackRegions;
   GoUctDefaultMoveFilter m_treeFilter;
   GoUctGlobalSearchState(const GoUctGlobalSearchState &search);
   GoUctGlobalSearchState &operator=(const GoUctGlobalSearchState &search);
-  void ApplyFilter(std::vector<UctMoveInfo> &moves);
+  void ApplyFilter(std::vector<UctMoveInfo> &moves,
+                   const std::vector<GoPoint> &filtered);
   bool CheckMercyRule();
   template<class BOARD>
   UctValueType EvaluateBoard(const BOARD &bd, float komi);
@@ -106,7 +116,10 @@ GoUctGlobalSearchState<POLICY>::GoUctGlobalSearchState(unsigned int threadId,
       m_param(param),
       m_swapMoves(true),
       m_policy(policy),
+      m_regions(Board()),
+      m_trackRegions(false),
       m_treeFilter(Board(), m_param.m_moveFilterParam) {
+  m_treeFilter.SetRegions(&m_regions);
   ClearTerritoryStatistics();
 }
 
@@ -130,8 +143,8 @@ bool GoUctGlobalSearchState<POLICY>::CheckMercyRule() {
 }
 
 template<class POLICY>
-void GoUctGlobalSearchState<POLICY>::ApplyFilter(std::vector<UctMoveInfo> &moves) {
-  std::vector<GoPoint> filtered = m_treeFilter.Get();
+void GoUctGlobalSearchState<POLICY>::ApplyFilter(std::vector<UctMoveInfo> &moves,
+                                                 const std::vector<GoPoint> &filtered) {
   if (filtered.size() > 0) {
     std::vector<UctMoveInfo> filteredMoves;
     for (std::vector<UctMoveInfo>::const_iterator it = moves.begin();
@@ -205,6 +218,47 @@ void GoUctGlobalSearchState<POLICY>::CollectFeatures(char features[][GO_MAX_SIZE
   }
 }
 
+template<class POLICY>
+void GoUctGlobalSearchState<POLICY>::Execute(GoMove move) {
+  if (!m_trackRegions) {
+    GoUctState::Execute(move);
+    return;
+  }
+  const SgBlackWhite toPlay = Board().ToPlay();
+  m_regions.ExecuteMovePrologue();
+  GoUctState::Execute(move);
+  m_regions.OnExecutedMove(GoPlayerMove(toPlay, move));
+}
+
+template<class POLICY>
+void GoUctGlobalSearchState<POLICY>::Apply(GoMove move) {
+  if (!m_trackRegions) {
+    GoUctState::Apply(move);
+    return;
+  }
+  const SgBlackWhite toPlay = Board().ToPlay();
+  m_regions.ExecuteMovePrologue();
+  GoUctState::Apply(move);
+  m_regions.OnExecutedMove(GoPlayerMove(toPlay, move));
+}
+
+template<class POLICY>
+void GoUctGlobalSearchState<POLICY>::TakeBackInTree(std::size_t nuMoves) {
+  if (!m_trackRegions) {
+    GoUctState::TakeBackInTree(nuMoves);
+    return;
+  }
+  for (std::size_t i = 0; i < nuMoves; ++i) {
+    // The region board can only undo moves it has executed itself
+    const bool upToDate = m_regions.UpToDate();
+    GoUctState::TakeBackInTree(1);
+    if (upToDate)
+      m_regions.OnUndoneMove();
+    else
+      m_regions.Clear();
+  }
+}
+
 template<class POLICY>
 UctValueType GoUctGlobalSearchState<POLICY>::Evaluate() {
   float komi = GetKomi();
@@ -342,9 +396,14 @@ GenerateAllMoves(UctValueType count,
   provenType = PROVEN_NONE;
   moves.clear();
   GenerateLegalMoves(moves);
+  if (!moves.empty() && count != 0 && param.m_useSafetySolver) {
+    std::vector<GoPoint> safeAreaMoves;
+    m_treeFilter.GetSafeAreaMoves(safeAreaMoves);
+    ApplyFilter(moves, safeAreaMoves);
+  }
   if (!moves.empty() && count == 0) {
     if (param.m_useTreeFilter)
-      ApplyFilter(moves);
+      ApplyFilter(moves, m_treeFilter.Get());
 #ifdef USE_KNOWLEDGE
     if (  feParam.m_priorKnowledgeType != PRIOR_NONE
        || feParam.m_useAsAdditivePredictor
@@ -438,6 +497,11 @@ void GoUctGlobalSearchState<POLICY>::StartPlayouts() {
 template<class POLICY>
 void GoUctGlobalSearchState<POLICY>::StartSearch() {
   GoUctState::StartSearch();
+  const GoUctGlobalSearchStateParam &param = m_param.m_searchStateParam;
+  m_trackRegions = param.m_useSafetySolver
+      || (param.m_useTreeFilter && m_param.m_moveFilterParam.CheckSafety());
+  if (!m_trackRegions)
+    m_regions.Clear();
   const GoBoard &bd = Board();
   const int size = bd.Size();
   const float maxScore = float(size * size) + std::abs(GetKomi());
@@ -580,7 +644,7 @@ void GoUctGlobalSearch<POLICY, FACTORY>::OnStartSearch() {
   GoUctSearch::OnStartSearch();
   m_safe.Clear();
   m_allSafe.Fill(false);
-  if (GOUCT_USE_SAFETY_SOLVER) {
+  if (m_param.m_useSafetySolver) {
     const GoBoard &bd = Board();
     GoSafetySolver solver(bd, &m_regions);
     solver.FindSafePoints(&m_safe);
@@ -204,6 +204,26 @@ namespace {
 bool IsMeanLess(const UctNode *lhs, const UctNode *rhs) {
   return (lhs->Mean() < rhs->Mean());
 }
+
+bool IsMoveCountGreater(const UctNode *lhs, const UctNode *rhs) {
+  return (lhs->MoveCount() > rhs->MoveCount());
+}
+
+const UctNode *MostVisitedChild(const UctSearchTree &tree,
+                                const UctNode &node) {
+  if (!node.HasChildren())
+    return 0;
+  const UctNode *bestChild = 0;
+  for (UctChildNodeIterator it(tree, node); it; ++it)
+    if ((*it).MoveCount() > 0
+        && (bestChild == 0 || (*it).MoveCount() > bestChild->MoveCount()))
+      bestChild = &(*it);
+  return bestChild;
+}
+
+int Permyriad(UctValueType value) {
+  return static_cast<int>(value * 10000 + 0.5);
+}
 } // namespace
 
 std::string GoUctUtil::ChildrenStatistics(const UctSearch &search,
@@ -224,4 +244,35 @@ std::string GoUctUtil::ChildrenStatistics(const UctSearch &search,
         << child.Mean() << " count=" << child.MoveCount() << '\n';
   }
   return out.str();
+}
+
+void GoUctUtil::WriteAnalysis(const UctSearch &search, UctValueType minVisits,
+                              std::size_t maxMoves, std::ostream &out) {
+  const UctSearchTree &tree = search.Tree();
+  const UctNode &root = tree.Root();
+  if (!root.HasChildren())
+    return;
+  vector<const UctNode *> moves;
+  for (UctChildNodeIterator it(tree, root); it; ++it) {
+    const UctNode &child = *it;
+    if (child.HasMean() && child.MoveCount() >= minVisits)
+      moves.push_back(&child);
+  }
+  std::stable_sort(moves.begin(), moves.end(), IsMoveCountGreater);
+  if (maxMoves > 0 && moves.size() > maxMoves)
+    moves.resize(maxMoves);
+  for (std::size_t i = 0; i < moves.size(); ++i) {
+    const UctNode &child = *moves[i];
+    out << (i == 0 ? "" : " ") << "info move " << GoWritePoint(child.Move())
+        << " visits " << static_cast<std::size_t>(child.MoveCount())
+        << " winrate "
+        << Permyriad(UctSearch::InverseEstimate(child.Mean()))
+        << " prior " << Permyriad(child.getPrior())
+        << " order " << i << " pv";
+    for (const UctNode *node = &child; node != 0;
+         node = MostVisitedChild(tree, *node))
+      out << ' ' << GoWritePoint(node->Move());
+  }
+  if (!moves.empty())
+    out << '\n';
 }
\ No newline at end of file
@@ -61,6 +61,13 @@ template<class BOARD>
 void SetEdgeCorrection(const BOARD &bd, GoPoint p, int &edgeCorrection);
 std::string ChildrenStatistics(const UctSearch &search,
                                bool bSort, const UctNode &node);
+/** The root moves with at least minVisits visits, at most maxMoves of them
+    if maxMoves is not 0, most visited first, in the format of the
+    lz-analyze command of Leela Zero: "info move M visits N winrate W prior
+    P order I pv M ..." for each move on one line, with winrate and prior
+    in 1/10000 for the color to play. Nothing if no move qualifies. */
+void WriteAnalysis(const UctSearch &search, UctValueType minVisits,
+                   std::size_t maxMoves, std::ostream &out);
 template<class BOARD>
 bool SubsetOfBlocks(const BOARD &bd, const GoPoint anchor[], GoPoint nb);
 }
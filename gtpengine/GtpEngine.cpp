@@ -3,9 +3,10 @@
 #include <iomanip>
 #include <cassert>
 #include <cctype>
+#include <exception>
 #include <fstream>
 
-#if GTPENGINE_PONDER || GTPENGINE_INTERRUPT
+#if GTPENGINE_PONDER || GTPENGINE_INTERRUPT || GTPENGINE_ASYNC
 #include <boost/thread/barrier.hpp>
 #include <boost/thread/condition.hpp>
 #include <boost/thread/mutex.hpp>
@@ -126,7 +127,10 @@ namespace {
       GtpEngine &engine = m_ponderThread.m_engine;
       if (engine.IsQuitSet())
         return;
-      engine.Ponder();
+      if (engine.IsStreaming())
+        engine.Stream();
+      else
+        engine.Ponder();
       Notify(m_ponderThread.m_ponderFinishedMutex,
              m_ponderThread.m_ponderFinished);
     }
@@ -421,7 +425,13 @@ GtpCallbackBase::~GtpCallbackBase() throw() {}
 
 
 GtpEngine::GtpEngine()
-        : m_quit(false) {
+        : m_quit(false),
+          m_isMainLoop(false),
+          m_streamOut(0)
+#if GTPENGINE_ASYNC
+          , m_handlingConcurrently(false)
+#endif
+{
   Register("known_command", &GtpEngine::CmdKnownCommand, this);
   Register("list_commands", &GtpEngine::CmdListCommands, this);
   Register("l", &GtpEngine::CmdListCommands, this);
@@ -430,6 +440,14 @@ GtpEngine::GtpEngine()
   Register("quit", &GtpEngine::CmdQuit, this);
   Register("q", &GtpEngine::CmdQuit, this);
   Register("version", &GtpEngine::CmdVersion, this);
+#if GTPENGINE_ASYNC
+  SetConcurrent("known_command");
+  SetConcurrent("list_commands");
+  SetConcurrent("l");
+  SetConcurrent("name");
+  SetConcurrent("protocol_version");
+  SetConcurrent("version");
+#endif
 }
 
 GtpEngine::~GtpEngine() {
@@ -510,8 +528,10 @@ void GtpEngine::ExecuteFile(const string &name, std::ostream &log) {
   }
 }
 
-bool GtpEngine::HandleCommand(GtpCommand &cmd, GtpOutputStream &out) {
-  BeforeHandleCommand();
+bool GtpEngine::HandleCommand(GtpCommand &cmd, GtpOutputStream &out,
+                              bool callHooks, bool asynchronous) {
+  if (callHooks)
+    BeforeHandleCommand();
   bool status = true;
   string response;
   try {
@@ -529,15 +549,35 @@ bool GtpEngine::HandleCommand(GtpCommand &cmd, GtpOutputStream &out) {
     status = false;
     response = failure.Response();
   }
+  catch (const std::exception &e) {
+    if (!asynchronous)
+      throw;
+    status = false;
+    response = e.what();
+  }
   
   response = ReplaceEmptyLines(response);
-  BeforeWritingResponse();
+  if (callHooks)
+    BeforeWritingResponse();
   std::ostringstream ostr;
   ostr << (status ? '=' : '?') << cmd.ID() << ' ' << response;
   size_t size = response.size();
   if (size == 0 || response[size - 1] != '\n')
     ostr << '\n';
-  ostr << '\n' << std::flush;
+#if GTPENGINE_PONDER
+  if (m_stream && status)
+    m_streamOut = &out;
+  else {
+    m_stream = nullptr;
+    ostr << '\n';
+  }
+#else
+  ostr << '\n';
+#endif
+  ostr << std::flush;
+#if GTPENGINE_ASYNC
+  boost::mutex::scoped_lock lock(m_responseMutex);
+#endif
   out.Write(ostr.str());
   out.Flush();
   return status;
@@ -550,6 +590,7 @@ bool GtpEngine::IsRegistered(const string &command) const {
 void GtpEngine::MainLoop(GtpInputStream &in, GtpOutputStream &out) {
   m_quit = false;
 #if GTPENGINE_PONDER
+  m_isMainLoop = true;
   PonderThread ponderThread(*this);
 #endif
 #if GTPENGINE_INTERRUPT
@@ -557,9 +598,32 @@ void GtpEngine::MainLoop(GtpInputStream &in, GtpOutputStream &out) {
 #endif
 
   GtpCommand cmd;
+#if GTPENGINE_ASYNC
+  GtpCommand asyncCmd;
+  thread asyncThread;
+#if GTPENGINE_PONDER
+  // An asynchronous command that finishes while the loop waits for the
+  // next command starts pondering itself
+  boost::mutex ponderMutex;
+  bool asyncFinished = false;
+  bool waitingForCommand = false;
+  bool asyncPondering = false;
+#endif
+#endif
   while (true) {
 #if GTPENGINE_PONDER
-    ponderThread.StartPonder();
+#if GTPENGINE_ASYNC
+    bool ponder;
+    {
+      boost::mutex::scoped_lock lock(ponderMutex);
+      ponder = !asyncThread.joinable() || asyncFinished;
+      waitingForCommand = true;
+    }
+#else
+    const bool ponder = true;
+#endif
+    if (ponder)
+      ponderThread.StartPonder();
 #endif
 
 #if GTPENGINE_INTERRUPT
@@ -569,9 +633,53 @@ void GtpEngine::MainLoop(GtpInputStream &in, GtpOutputStream &out) {
 #endif
 
 #if GTPENGINE_PONDER
-    ponderThread.StopPonder();
+#if GTPENGINE_ASYNC
+    {
+      boost::mutex::scoped_lock lock(ponderMutex);
+      waitingForCommand = false;
+      if (asyncPondering) {
+        ponder = true;
+        asyncPondering = false;
+      }
+    }
+#endif
+    if (ponder) {
+      ponderThread.StopPonder();
+      EndStream(out);
+    }
 #endif
 
+#if GTPENGINE_ASYNC
+    if (asyncThread.joinable()) {
+      if (isStreamGood && IsConcurrent(cmd.Name())) {
+        m_handlingConcurrently = true;
+        HandleCommand(cmd, out, false);
+        m_handlingConcurrently = false;
+        continue;
+      }
+      asyncThread.join();
+    }
+    if (isStreamGood && IsAsynchronous(cmd.Name())) {
+      asyncCmd.Init(cmd.Line());
+#if GTPENGINE_PONDER
+      asyncFinished = false;
+      asyncThread = thread([&]() {
+        HandleCommand(asyncCmd, out, true, true);
+        boost::mutex::scoped_lock lock(ponderMutex);
+        asyncFinished = true;
+        if (waitingForCommand) {
+          ponderThread.StartPonder();
+          asyncPondering = true;
+        }
+      });
+#else
+      asyncThread = thread([this, &asyncCmd, &out]() {
+        HandleCommand(asyncCmd, out, true, true);
+      });
+#endif
+      continue;
+    }
+#endif
     if (isStreamGood)
       HandleCommand(cmd, out);
     else
@@ -579,6 +687,7 @@ void GtpEngine::MainLoop(GtpInputStream &in, GtpOutputStream &out) {
     if (m_quit) {
 #if GTPENGINE_PONDER
       ponderThread.Quit();
+      m_isMainLoop = false;
 #endif
 #if GTPENGINE_INTERRUPT
       readThread.JoinThread();
@@ -600,6 +709,34 @@ void GtpEngine::Register(const string &command, GtpCallbackBase *callback) {
   m_callbacks.insert(make_pair(command, callback));
 }
 
+#if GTPENGINE_ASYNC
+void GtpEngine::SetAsynchronous(const string &command, bool enable) {
+  if (enable)
+    m_asynchronous.insert(command);
+  else
+    m_asynchronous.erase(command);
+}
+
+bool GtpEngine::IsAsynchronous(const string &command) const {
+  return m_asynchronous.count(command) > 0;
+}
+
+void GtpEngine::SetConcurrent(const string &command, bool enable) {
+  if (enable)
+    m_concurrent.insert(command);
+  else
+    m_concurrent.erase(command);
+}
+
+bool GtpEngine::IsConcurrent(const string &command) const {
+  return m_concurrent.count(command) > 0;
+}
+
+bool GtpEngine::IsHandlingConcurrently() const {
+  return m_handlingConcurrently;
+}
+#endif
+
 void GtpEngine::SetQuit() {
   m_quit = true;
 }
@@ -627,6 +764,31 @@ void GtpEngine::InitPonder() {
   std::cerr << "GtpEngine::InitPonder()\n";
 #endif
 }
+
+void GtpEngine::StreamResponse(const GtpStreamFunction &stream) {
+  if (!m_isMainLoop)
+    throw GtpFailure("command needs the GTP main loop");
+  m_stream = stream;
+}
+
+bool GtpEngine::IsStreaming() const {
+  return m_streamOut != 0;
+}
+
+void GtpEngine::Stream() {
+  assert(IsStreaming());
+  m_stream(*m_streamOut);
+  m_streamOut->Flush();
+}
+
+void GtpEngine::EndStream(GtpOutputStream &out) {
+  if (!IsStreaming())
+    return;
+  m_stream = nullptr;
+  m_streamOut = 0;
+  out.Write("\n");
+  out.Flush();
+}
 #endif
 
 #if GTPENGINE_INTERRUPT
@@ -3,8 +3,10 @@
 #define GTPENGINE_H
 
 #include <cstddef>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -27,6 +29,14 @@
 #define GTPENGINE_INTERRUPT 1
 #endif
 
+#ifndef GTPENGINE_ASYNC
+#define GTPENGINE_ASYNC 1
+#endif
+
+#if GTPENGINE_ASYNC
+#include <boost/thread/mutex.hpp>
+#endif
+
 class GtpFailure {
 public:
   GtpFailure();
@@ -263,6 +273,9 @@ void GtpCallback<ENGINE>::operator()(GtpCommand &cmd) {
   (m_instance->*m_method)(cmd);
 }
 
+/** Writes the rest of an open response, see GtpEngine::StreamResponse(). */
+typedef std::function<void(GtpOutputStream &out)> GtpStreamFunction;
+
 class GtpEngine {
 public:
   virtual void CmdKnownCommand(GtpCommand &);
@@ -294,12 +307,43 @@ public:
   virtual void Ponder();
   virtual void InitPonder();
   virtual void StopPonder();
+
+  /** Keep the response of the command being handled open.
+      Only in MainLoop(). The response so far is written without the
+      terminating empty line, then stream runs in the ponder thread instead
+      of Ponder() and may write more lines, which must not be empty. When
+      the next command arrives, StopPonder() is called, stream must return
+      soon, and the response is terminated before the command is handled.
+      Ignored if the command fails. */
+  void StreamResponse(const GtpStreamFunction &stream);
+  bool IsStreaming() const;
+  /** Run the stream of the open response. Called by the ponder thread. */
+  void Stream();
 #endif
 
 #if GTPENGINE_INTERRUPT
   virtual void Interrupt();
 #endif
 
+#if GTPENGINE_ASYNC
+  /** Run the command in a worker thread in MainLoop(), which meanwhile
+      reads the following commands. Concurrent commands are handled at
+      once, the others wait until the command has finished. Their
+      responses can come before its response. */
+  void SetAsynchronous(const std::string &command, bool enable = true);
+  bool IsAsynchronous(const std::string &command) const;
+  /** The command may run while an asynchronous command runs. It must only
+      read state that stays consistent meanwhile, like a snapshot of a
+      running search. Commands that read state the running command writes
+      without a lock must stay serialized. BeforeHandleCommand() and
+      BeforeWritingResponse() are not called for it then. */
+  void SetConcurrent(const std::string &command, bool enable = true);
+  bool IsConcurrent(const std::string &command) const;
+  /** True while a concurrent command is handled beside a running
+      asynchronous command. */
+  bool IsHandlingConcurrently() const;
+#endif
+
 protected:
   virtual void BeforeHandleCommand();
   virtual void BeforeWritingResponse();
@@ -308,10 +352,26 @@ private:
   typedef std::map<std::string, GtpCallbackBase *> CallbackMap;
   bool m_quit;
   CallbackMap m_callbacks;
+  bool m_isMainLoop;
+  GtpStreamFunction m_stream;
+  GtpOutputStream *m_streamOut;
+#if GTPENGINE_ASYNC
+  std::set<std::string> m_asynchronous;
+  std::set<std::string> m_concurrent;
+  bool m_handlingConcurrently;
+  /** Serializes the responses of asynchronous and concurrent commands. */
+  boost::mutex m_responseMutex;
+#endif
 
   GtpEngine(const GtpEngine &engine);
   GtpEngine &operator=(const GtpEngine &engine) const;
-  bool HandleCommand(GtpCommand &cmd, GtpOutputStream &out);
+  /** An asynchronous command also answers with a failure on other
+      exceptions, which would terminate its worker thread. */
+  bool HandleCommand(GtpCommand &cmd, GtpOutputStream &out,
+                     bool callHooks = true, bool asynchronous = false);
+#if GTPENGINE_PONDER
+  void EndStream(GtpOutputStream &out);
+#endif
 };
 
 template<class T>
@@ -13,6 +13,12 @@
 #include <boost/test/floating_point_comparison.hpp>
 #include <boost/test/test_tools.hpp>
 
+#if GTPENGINE_ASYNC
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <stdexcept>
+#endif
+
 using namespace std;
 
 //----------------------------------------------------------------------------
@@ -217,6 +223,195 @@ namespace {
                               "\n");
   }
 
+#if GTPENGINE_PONDER
+
+/** GTP engine with a command that streams its response. */
+  class StreamEngine
+          : public GtpEngine {
+  public:
+    StreamEngine();
+
+    void CmdStream(GtpCommand &cmd);
+  };
+
+  StreamEngine::StreamEngine() {
+    Register("stream",
+             new GtpCallback<StreamEngine>(this, &StreamEngine::CmdStream));
+  }
+
+  void StreamEngine::CmdStream(GtpCommand &cmd) {
+    cmd << "start";
+    StreamResponse([](GtpOutputStream &out) {
+      out.Write("line\n");
+    });
+  }
+
+/** Check that a streamed response is terminated by the next command. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_StreamResponse) {
+    istringstream in("1 stream\n2 version\n");
+    ostringstream out;
+    GtpInputStream gin(in);
+    GtpOutputStream gout(out);
+    StreamEngine engine;
+    engine.MainLoop(gin, gout);
+    BOOST_CHECK_EQUAL(out.str(), "=1 start\nline\n\n=2 \n\n");
+    BOOST_CHECK(!engine.IsStreaming());
+  }
+
+/** Check that a streamed response is terminated at the end of the input. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_StreamResponseEndOfInput) {
+    istringstream in("stream\n");
+    ostringstream out;
+    GtpInputStream gin(in);
+    GtpOutputStream gout(out);
+    StreamEngine engine;
+    engine.MainLoop(gin, gout);
+    BOOST_CHECK_EQUAL(out.str(), "= start\nline\n\n");
+  }
+
+/** Check that streaming fails outside of MainLoop. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_StreamResponseNoMainLoop) {
+    ostringstream log;
+    StreamEngine engine;
+    BOOST_CHECK_THROW(engine.ExecuteCommand("stream", log), GtpFailure);
+    BOOST_CHECK(!engine.IsStreaming());
+  }
+
+#endif
+
+#if GTPENGINE_ASYNC
+
+/** GTP engine with an asynchronous command "wait", which waits until the
+    concurrent command "release" was handled or 5 seconds passed, and a
+    normal command "echo". "release" answers "concurrent" if it ran beside
+    "wait". Ponder() records if it ran between "wait" and "echo". */
+  class AsyncEngine
+          : public GtpEngine {
+  public:
+    AsyncEngine();
+
+    void CmdEcho(GtpCommand &cmd);
+
+    void CmdRelease(GtpCommand &cmd);
+
+    void CmdThrow(GtpCommand &cmd);
+
+    void CmdWait(GtpCommand &cmd);
+
+    void Ponder();
+
+    bool m_ponderedBeforeEcho;
+
+  private:
+    bool m_released;
+    bool m_echoed;
+    boost::mutex m_mutex;
+    boost::condition m_releasedCondition;
+  };
+
+  AsyncEngine::AsyncEngine()
+          : m_ponderedBeforeEcho(false),
+            m_released(false),
+            m_echoed(false) {
+    typedef GtpCallback<AsyncEngine> Callback;
+    Register("echo", new Callback(this, &AsyncEngine::CmdEcho));
+    Register("release", new Callback(this, &AsyncEngine::CmdRelease));
+    Register("throw", new Callback(this, &AsyncEngine::CmdThrow));
+    Register("wait", new Callback(this, &AsyncEngine::CmdWait));
+    SetConcurrent("release");
+    SetAsynchronous("throw");
+    SetAsynchronous("wait");
+  }
+
+  void AsyncEngine::CmdEcho(GtpCommand &cmd) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_echoed = true;
+    cmd << cmd.ArgLine();
+  }
+
+  void AsyncEngine::CmdRelease(GtpCommand &cmd) {
+    if (IsHandlingConcurrently())
+      cmd << "concurrent";
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_released = true;
+    m_releasedCondition.notify_all();
+  }
+
+  void AsyncEngine::CmdThrow(GtpCommand &) {
+    throw std::runtime_error("thrown");
+  }
+
+  void AsyncEngine::Ponder() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (m_released && !m_echoed)
+      m_ponderedBeforeEcho = true;
+  }
+
+  void AsyncEngine::CmdWait(GtpCommand &cmd) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    boost::system_time timeout =
+            boost::get_system_time() + boost::posix_time::seconds(5);
+    while (!m_released)
+      if (!m_releasedCondition.timed_wait(lock, timeout))
+        break;
+    cmd << (m_released ? "released" : "timeout");
+  }
+
+/** Check that a concurrent command runs while an asynchronous command runs
+    and that other commands wait for it. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_Asynchronous) {
+    istringstream in("1 wait\n2 release\n3 echo done\n");
+    ostringstream out;
+    GtpInputStream gin(in);
+    GtpOutputStream gout(out);
+    AsyncEngine engine;
+    engine.MainLoop(gin, gout);
+    const string response = out.str();
+    BOOST_CHECK(response.find("=1 released\n\n") != string::npos);
+    BOOST_CHECK(response.find("=2 concurrent\n\n") != string::npos);
+    BOOST_CHECK(response.find("=3 done\n\n") != string::npos);
+    BOOST_CHECK(response.find("=3") > response.find("=1"));
+  }
+
+/** Check that an exception from an asynchronous command is answered as a
+    failure instead of terminating its thread. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_AsynchronousException) {
+    istringstream in("1 throw\n2 echo done\n");
+    ostringstream out;
+    GtpInputStream gin(in);
+    GtpOutputStream gout(out);
+    AsyncEngine engine;
+    engine.MainLoop(gin, gout);
+    BOOST_CHECK(out.str().find("?1 thrown\n\n") != string::npos);
+    BOOST_CHECK(out.str().find("=2 done\n\n") != string::npos);
+  }
+
+#if GTPENGINE_PONDER && GTPENGINE_INTERRUPT
+/** Check that the engine ponders when an asynchronous command finished
+    while it waits for the next command. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_AsynchronousPonder) {
+    istringstream in("1 wait\n2 release\n# gtpengine-sleep 1\n3 echo done\n");
+    ostringstream out;
+    GtpInputStream gin(in);
+    GtpOutputStream gout(out);
+    AsyncEngine engine;
+    engine.MainLoop(gin, gout);
+    BOOST_CHECK(out.str().find("=3 done\n\n") != string::npos);
+    BOOST_CHECK(engine.m_ponderedBeforeEcho);
+  }
+#endif
+
+/** Check that asynchronous commands run synchronously outside of
+    MainLoop. */
+  BOOST_AUTO_TEST_CASE(GtpEngineTest_AsynchronousExecuteCommand) {
+    ostringstream log;
+    AsyncEngine engine;
+    BOOST_CHECK_EQUAL(engine.ExecuteCommand("release", log), "");
+    BOOST_CHECK_EQUAL(engine.ExecuteCommand("wait", log), "released");
+  }
+
+#endif
+
   BOOST_AUTO_TEST_CASE(GtpEngineTest_UnknownCommand) {
     istringstream in("unknowncommand\n");
     ostringstream out;
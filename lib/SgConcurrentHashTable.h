@@ -0,0 +1,330 @@
+//----------------------------------------------------------------------------
+/** @file SgConcurrentHashTable.h
+    Hash table shared by several search threads. */
+//----------------------------------------------------------------------------
+
+#ifndef SG_CONCURRENTHASHTABLE_H
+#define SG_CONCURRENTHASHTABLE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "lib/SgHash.h"
+#include "board/SgWrite.h"
+#include "platform/SgPlatform.h"
+
+namespace SgConcurrentHashTableUtil {
+
+/** Maximum number of threads with separate statistics.
+    Further threads share the statistics of earlier ones. */
+const int MAX_THREADS = 64;
+
+/** Slot of a thread in the statistics of all tables.
+    A slot is returned when its thread exits, so a program that starts new
+    search threads for each search keeps separate statistics per thread. */
+class ThreadSlot {
+ public:
+  ThreadSlot();
+  ~ThreadSlot();
+  int Index() const;
+
+ private:
+  int m_index;
+  bool m_isOwner;
+  /** Bit i is set while slot i is used by a thread. */
+  static std::atomic<std::uint64_t> &UsedSlots();
+};
+
+inline ThreadSlot::ThreadSlot()
+    : m_index(0),
+      m_isOwner(false) {
+  static_assert(MAX_THREADS <= 64, "one bit per slot");
+  static std::atomic<int> s_nuShared(0);
+  std::atomic<std::uint64_t> &used = UsedSlots();
+  std::uint64_t bits = used.load(std::memory_order_relaxed);
+  while (bits != ~std::uint64_t(0)) {
+    int i = 0;
+    while (bits & (std::uint64_t(1) << i))
+      ++i;
+    if (used.compare_exchange_weak(bits, bits | (std::uint64_t(1) << i))) {
+      m_index = i;
+      m_isOwner = true;
+      return;
+    }
+  }
+  m_index = s_nuShared.fetch_add(1) % MAX_THREADS;
+}
+
+inline ThreadSlot::~ThreadSlot() {
+  if (m_isOwner)
+    UsedSlots().fetch_and(~(std::uint64_t(1) << m_index));
+}
+
+inline int ThreadSlot::Index() const {
+  return m_index;
+}
+
+inline std::atomic<std::uint64_t> &ThreadSlot::UsedSlots() {
+  static std::atomic<std::uint64_t> s_used(0);
+  return s_used;
+}
+
+/** Index of the calling thread in the statistics of all tables. */
+inline int ThreadIndex() {
+  static thread_local ThreadSlot s_slot;
+  return s_slot.Index();
+}
+
+}
+
+/** Thread-safe variant of SgHashTable.
+    Same interface and the same replacement within blocks of BLOCK_SIZE
+    entries, but Lookup() and Store() can be called from several threads.
+    No locks: DATA is copied into 64 bit words and the key word stores the
+    hash code xor all data words (Hyatt and Mann, "A lock-less transposition
+    table implementation for parallel search chess engines", ICGA Journal
+    25(1), 2002). All words are relaxed atomics; an entry torn by a
+    concurrent Store() fails the key check and reads as a miss. A Store()
+    racing with another Store() to the same block can lose one of the two
+    entries, as in any lock-less table.
+    DATA must be trivially copyable and zero bytes must read as invalid.
+    The statistics are counted per thread and summed when read.
+    The table memory comes from SgPlatform::AllocateLarge(), which uses
+    huge pages for large tables. */
+template<class DATA, int BLOCK_SIZE = 1>
+class SgConcurrentHashTable {
+ public:
+  explicit SgConcurrentHashTable(int maxHash);
+  ~SgConcurrentHashTable();
+
+  /** Not thread-safe. */
+  void Age();
+
+  /** Not thread-safe. */
+  void Clear();
+
+  bool Lookup(const SgHashCode &code, DATA *data) const;
+  int MaxHash() const;
+  bool Store(const SgHashCode &code, const DATA &data);
+
+  size_t NuCollisions() const;
+  size_t NuStores() const;
+  size_t NuLookups() const;
+  size_t NuFound() const;
+
+ private:
+  static_assert(std::is_trivially_copyable<DATA>::value,
+                "DATA is copied word by word");
+
+  static const int NU_WORDS = (sizeof(DATA) + 7) / 8;
+
+  struct Entry {
+    std::atomic<std::uint64_t> m_key;
+    std::atomic<std::uint64_t> m_data[NU_WORDS];
+  };
+
+  /** Statistics of one thread, on its own cache line. */
+  struct alignas(64) Statistics {
+    std::atomic<size_t> m_nuCollisions;
+    std::atomic<size_t> m_nuStores;
+    std::atomic<size_t> m_nuLookups;
+    std::atomic<size_t> m_nuFound;
+  };
+
+  Entry *m_entry;
+  int m_maxHash;
+  mutable Statistics m_stat[SgConcurrentHashTableUtil::MAX_THREADS];
+  static std::uint64_t Key(const SgHashCode &code);
+  static void Increment(std::atomic<size_t> &counter);
+  size_t Sum(std::atomic<size_t> Statistics::*counter) const;
+  std::size_t MemorySize() const;
+  /** Copy the entry into data.
+      @return The hash key of the entry, if it was not torn by a
+      concurrent Store(). */
+  std::uint64_t Load(const Entry &entry, DATA &data) const;
+  static void Write(Entry &entry, std::uint64_t key, const DATA &data);
+  SgConcurrentHashTable(const SgConcurrentHashTable &) = delete;
+  SgConcurrentHashTable &operator=(const SgConcurrentHashTable &) = delete;
+};
+
+template<class DATA, int BLOCK_SIZE>
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::SgConcurrentHashTable(int maxHash)
+    : m_entry(0),
+      m_maxHash(maxHash) {
+  // AllocateLarge returns zeroed memory, which is a table of empty entries
+  m_entry = static_cast<Entry *>(SgPlatform::AllocateLarge(MemorySize()));
+  for (int i = 0; i < SgConcurrentHashTableUtil::MAX_THREADS; ++i) {
+    m_stat[i].m_nuCollisions = 0;
+    m_stat[i].m_nuStores = 0;
+    m_stat[i].m_nuLookups = 0;
+    m_stat[i].m_nuFound = 0;
+  }
+}
+
+template<class DATA, int BLOCK_SIZE>
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::~SgConcurrentHashTable() {
+  SgPlatform::FreeLarge(m_entry, MemorySize());
+}
+
+template<class DATA, int BLOCK_SIZE>
+std::size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::MemorySize() const {
+  return (m_maxHash + BLOCK_SIZE - 1) * sizeof(Entry);
+}
+
+template<class DATA, int BLOCK_SIZE>
+inline std::uint64_t
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::Key(const SgHashCode &code) {
+  return (std::uint64_t(code.Code2()) << 32) | code.Code1();
+}
+
+template<class DATA, int BLOCK_SIZE>
+inline void
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::Increment(std::atomic<size_t> &
+counter) {
+  // Usually uncontended, but with more than MAX_THREADS threads a slot
+  // is shared
+  counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<class DATA, int BLOCK_SIZE>
+size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::Sum(
+    std::atomic<size_t> Statistics::*counter) const {
+  size_t sum = 0;
+  for (int i = 0; i < SgConcurrentHashTableUtil::MAX_THREADS; ++i)
+    sum += (m_stat[i].*counter).load(std::memory_order_relaxed);
+  return sum;
+}
+
+template<class DATA, int BLOCK_SIZE>
+size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::NuCollisions() const {
+  return Sum(&Statistics::m_nuCollisions);
+}
+
+template<class DATA, int BLOCK_SIZE>
+size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::NuStores() const {
+  return Sum(&Statistics::m_nuStores);
+}
+
+template<class DATA, int BLOCK_SIZE>
+size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::NuLookups() const {
+  return Sum(&Statistics::m_nuLookups);
+}
+
+template<class DATA, int BLOCK_SIZE>
+size_t SgConcurrentHashTable<DATA, BLOCK_SIZE>::NuFound() const {
+  return Sum(&Statistics::m_nuFound);
+}
+
+template<class DATA, int BLOCK_SIZE>
+inline std::uint64_t
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::Load(const Entry &entry,
+                                              DATA &data) const {
+  std::uint64_t words[NU_WORDS];
+  std::uint64_t key = entry.m_key.load(std::memory_order_relaxed);
+  for (int j = 0; j < NU_WORDS; ++j) {
+    words[j] = entry.m_data[j].load(std::memory_order_relaxed);
+    key ^= words[j];
+  }
+  std::memcpy(&data, words, sizeof(DATA));
+  return key;
+}
+
+template<class DATA, int BLOCK_SIZE>
+inline void
+SgConcurrentHashTable<DATA, BLOCK_SIZE>::Write(Entry &entry, std::uint64_t key,
+                                               const DATA &data) {
+  std::uint64_t words[NU_WORDS] = {0};
+  std::memcpy(words, &data, sizeof(DATA));
+  for (int j = 0; j < NU_WORDS; ++j)
+    key ^= words[j];
+  entry.m_key.store(key, std::memory_order_relaxed);
+  for (int j = 0; j < NU_WORDS; ++j)
+    entry.m_data[j].store(words[j], std::memory_order_relaxed);
+}
+
+template<class DATA, int BLOCK_SIZE>
+void SgConcurrentHashTable<DATA, BLOCK_SIZE>::Age() {
+  for (int i = m_maxHash + BLOCK_SIZE - 2; i >= 0; --i) {
+    DATA data;
+    const std::uint64_t key = Load(m_entry[i], data);
+    if (data.IsValid()) {
+      data.AgeData();
+      Write(m_entry[i], key, data);
+    }
+  }
+}
+
+template<class DATA, int BLOCK_SIZE>
+void SgConcurrentHashTable<DATA, BLOCK_SIZE>::Clear() {
+  for (int i = m_maxHash + BLOCK_SIZE - 2; i >= 0; --i) {
+    m_entry[i].m_key.store(0, std::memory_order_relaxed);
+    for (int j = 0; j < NU_WORDS; ++j)
+      m_entry[i].m_data[j].store(0, std::memory_order_relaxed);
+  }
+}
+
+template<class DATA, int BLOCK_SIZE>
+int SgConcurrentHashTable<DATA, BLOCK_SIZE>::MaxHash() const {
+  return m_maxHash;
+}
+
+template<class DATA, int BLOCK_SIZE>
+bool SgConcurrentHashTable<DATA, BLOCK_SIZE>::Store(const SgHashCode &code,
+                                                    const DATA &data) {
+  Statistics &stat = m_stat[SgConcurrentHashTableUtil::ThreadIndex()];
+  Increment(stat.m_nuStores);
+  const std::uint64_t key = Key(code);
+  int h = code.Hash(m_maxHash);
+  int best = -1;
+  DATA bestData;
+  bool collision = true;
+  for (int i = h; i < h + BLOCK_SIZE; i++) {
+    DATA entryData;
+    if (Load(m_entry[i], entryData) == key || !entryData.IsValid()) {
+      best = i;
+      collision = false;
+      break;
+    } else if (best == -1 || bestData.IsBetterThan(entryData)) {
+      best = i;
+      bestData = entryData;
+    }
+  }
+  if (collision)
+    Increment(stat.m_nuCollisions);
+  DBG_ASSERTRANGE(best, h, h + BLOCK_SIZE - 1);
+  Write(m_entry[best], key, data);
+  return true;
+}
+
+template<class DATA, int BLOCK_SIZE>
+bool SgConcurrentHashTable<DATA, BLOCK_SIZE>::Lookup(const SgHashCode &code,
+                                                     DATA *data) const {
+  Statistics &stat = m_stat[SgConcurrentHashTableUtil::ThreadIndex()];
+  Increment(stat.m_nuLookups);
+  const std::uint64_t key = Key(code);
+  int h = code.Hash(m_maxHash);
+  for (int i = h; i < h + BLOCK_SIZE; i++) {
+    // Leave data unchanged on a miss, as SgHashTable does
+    DATA entryData;
+    if (Load(m_entry[i], entryData) == key && entryData.IsValid()) {
+      *data = entryData;
+      Increment(stat.m_nuFound);
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class DATA, int BLOCK_SIZE>
+std::ostream &operator<<(std::ostream &out,
+                         const SgConcurrentHashTable<DATA, BLOCK_SIZE> &hash) {
+  out << "HashTableStatistics:\n"
+      << SgWriteLabel("Stores") << hash.NuStores() << '\n'
+      << SgWriteLabel("LookupAttempt") << hash.NuLookups() << '\n'
+      << SgWriteLabel("LookupSuccess") << hash.NuFound() << '\n'
+      << SgWriteLabel("Collisions") << hash.NuCollisions() << '\n';
+  return out;
+}
+
+#endif // SG_CONCURRENTHASHTABLE_H
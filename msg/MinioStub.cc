@@ -4,6 +4,17 @@
 #include "ZmqUtil.h"
 #include "funcapproximator/DlConfig.h"
 
+namespace {
+
+/** Context of the TryUpload() sockets, a context per call would start and
+    stop its I/O threads for every upload. */
+zmq::context_t &UploadContext() {
+  static zmq::context_t s_ctx;
+  return s_ctx;
+}
+
+}
+
 void UnrealGo::MinioStub::SetObjPolicy(const std::string& bucket, const std::string& obj, const std::string& policy) {
   zmq::context_t ctx;
   zmq::socket_t socket(ctx, ZMQ_REQ);
@@ -23,4 +34,20 @@ void UnrealGo::MinioStub::Upload(const std::string& bucket, const std::string& o
   socket.connect(DlConfig::GetInstance().get_minioproxyserver_socket());
   std::string command = "upload:" + bucket + ":" + obj + ":" + localFilePath;
   ZmqUtil::sendData(socket, command);
-}
\ No newline at end of file
+}
+bool UnrealGo::MinioStub::TryUpload(const std::string& bucket, const std::string& obj,
+                                    const std::string& localFilePath, int timeoutMs) {
+  zmq::socket_t socket(UploadContext(), ZMQ_REQ);
+  // A REQ socket is unusable after a timeout, every attempt has its own
+  socket.setsockopt(ZMQ_LINGER, 0);
+  socket.setsockopt(ZMQ_SNDTIMEO, timeoutMs);
+  socket.setsockopt(ZMQ_RCVTIMEO, timeoutMs);
+  socket.connect(DlConfig::GetInstance().get_minioproxyserver_socket());
+  std::string command = "upload:" + bucket + ":" + obj + ":" + localFilePath;
+  zmq::message_t request(command.size());
+  memcpy(request.data(), command.c_str(), command.size());
+  if (!socket.send(request))
+    return false;
+  zmq::message_t reply;
+  return socket.recv(&reply);
+}
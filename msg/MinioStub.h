@@ -21,6 +21,10 @@ along with UnrealGo.  If not, see <http://www.gnu.org/licenses/>.
 namespace UnrealGo {
 namespace MinioStub {
   void Upload(const std::string& bucket, const std::string& obj, const std::string& localFilePath);
+  /** Upload and wait at most timeoutMs for the reply of the proxy server.
+      @return Whether the proxy server replied */
+  bool TryUpload(const std::string& bucket, const std::string& obj, const std::string& localFilePath,
+                 int timeoutMs);
   void SetObjPolicy(const std::string& bucket, const std::string& obj, const std::string& policy);
   void SetObjPolicy(const std::string& path, const std::string& policy);
 }
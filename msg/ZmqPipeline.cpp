@@ -0,0 +1,279 @@
+
+#include <vector>
+#include "ZmqPipeline.h"
+#include "ZmqUtil.h"
+
+namespace {
+
+/** Milliseconds between the checks of the I/O threads for work that does
+    not arrive on their socket. */
+const long POLL_INTERVAL = 10;
+
+UnrealGo::Command MakeCommand(int type, const std::string &data) {
+  UnrealGo::Command command;
+  command.set_type(type);
+  command.set_data(data);
+  return command;
+}
+
+std::string SerializeCommand(const UnrealGo::Command &command) {
+  std::string buffer;
+  command.SerializeToString(&buffer);
+  return buffer;
+}
+
+void SendFrame(zmq::socket_t &socket, const std::string &frame, int flags = 0) {
+  zmq::message_t message(frame.size());
+  memcpy(message.data(), frame.data(), frame.size());
+  socket.send(message, flags);
+}
+
+bool Readable(zmq::socket_t &socket, long timeout) {
+  zmq::pollitem_t item = {(void *) socket, 0, ZMQ_POLLIN, 0};
+  return zmq::poll(&item, 1, timeout) > 0 && (item.revents & ZMQ_POLLIN);
+}
+
+}
+
+ZmqWorkQueue::ZmqWorkQueue(zmq::context_t &ctx, const std::string &endpoint,
+                           std::size_t capacity, long creditTimeout) :
+    m_capacity(capacity),
+    m_creditTimeout(creditTimeout),
+    m_socket(ctx, ZMQ_ROUTER),
+    m_nuGranted(0),
+    m_quit(false) {
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  m_socket.bind(endpoint);
+  m_thread = boost::thread(&ZmqWorkQueue::Run, this);
+}
+
+ZmqWorkQueue::~ZmqWorkQueue() {
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_quit = true;
+    m_itemAdded.notify_all();
+  }
+  m_thread.join();
+}
+
+bool ZmqWorkQueue::Pop(UnrealGo::Command &item, long timeout) {
+  boost::mutex::scoped_lock lock(m_mutex);
+  const boost::system_time deadline =
+      boost::get_system_time() + boost::posix_time::milliseconds(timeout);
+  while (m_items.empty() && !m_quit) {
+    if (timeout < 0)
+      m_itemAdded.wait(lock);
+    else if (!m_itemAdded.timed_wait(lock, deadline))
+      break;
+  }
+  if (m_items.empty())
+    return false;
+  item = m_items.front();
+  m_items.pop_front();
+  return true;
+}
+
+std::size_t ZmqWorkQueue::Size() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_items.size();
+}
+
+std::size_t ZmqWorkQueue::Capacity() const {
+  return m_capacity;
+}
+
+std::size_t ZmqWorkQueue::NuWaiting() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_waiting.size();
+}
+
+std::size_t ZmqWorkQueue::NuGranted() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_nuGranted;
+}
+
+void ZmqWorkQueue::Run() {
+  while (true) {
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      if (m_quit)
+        break;
+    }
+    if (Readable(m_socket, POLL_INTERVAL)) {
+      zmq::message_t identity;
+      zmq::message_t payload;
+      m_socket.recv(&identity);
+      if (!identity.more())
+        continue;
+      m_socket.recv(&payload);
+      UnrealGo::Command command;
+      if (command.ParseFromArray(payload.data(), (int) payload.size())) {
+        const std::string producer((const char *) identity.data(),
+                                   identity.size());
+        boost::mutex::scoped_lock lock(m_mutex);
+        if (command.type() == ZmqUtil::CMD_READY)
+          m_waiting.push_back(producer);
+        else {
+          auto it = m_granted.find(producer);
+          if (it != m_granted.end()) {
+            it->second.pop_front();
+            --m_nuGranted;
+            if (it->second.empty())
+              m_granted.erase(it);
+          }
+          m_items.push_back(command);
+          m_itemAdded.notify_one();
+        }
+      }
+    }
+    GrantCredits();
+  }
+}
+
+void ZmqWorkQueue::GrantCredits() {
+  std::vector<std::string> producers;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    ExpireCredits();
+    const boost::system_time now = boost::get_system_time();
+    while (!m_waiting.empty() && m_items.size() + m_nuGranted < m_capacity) {
+      producers.push_back(m_waiting.front());
+      m_waiting.pop_front();
+      m_granted[producers.back()].push_back(now);
+      ++m_nuGranted;
+    }
+  }
+  const std::string credit =
+      SerializeCommand(MakeCommand(ZmqUtil::CMD_CREDIT, ""));
+  for (const std::string &producer : producers) {
+    SendFrame(m_socket, producer, ZMQ_SNDMORE);
+    SendFrame(m_socket, credit);
+  }
+}
+
+void ZmqWorkQueue::ExpireCredits() {
+  if (m_nuGranted == 0)
+    return;
+  const boost::system_time expired = boost::get_system_time()
+      - boost::posix_time::milliseconds(m_creditTimeout);
+  for (auto it = m_granted.begin(); it != m_granted.end();) {
+    std::deque<boost::system_time> &times = it->second;
+    while (!times.empty() && times.front() < expired) {
+      times.pop_front();
+      --m_nuGranted;
+    }
+    if (times.empty())
+      it = m_granted.erase(it);
+    else
+      ++it;
+  }
+}
+
+ZmqCreditSender::ZmqCreditSender(zmq::context_t &ctx,
+                                 const std::string &endpoint) :
+    m_socket(ctx, ZMQ_DEALER),
+    m_requested(false),
+    m_credits(0) {
+  m_socket.setsockopt(ZMQ_LINGER, 1000);
+  m_socket.connect(endpoint);
+}
+
+bool ZmqCreditSender::Send(int type, const std::string &data, long timeout) {
+  return Send(MakeCommand(type, data), timeout);
+}
+
+bool ZmqCreditSender::Send(const UnrealGo::Command &item, long timeout) {
+  if (m_credits == 0 && !m_requested) {
+    ZmqUtil::post_command(m_socket, ZmqUtil::CMD_READY, "");
+    m_requested = true;
+  }
+  UnrealGo::Command command;
+  while (m_credits == 0) {
+    if (!ZmqUtil::poll_command(m_socket, command, timeout))
+      return false;
+    if (command.type() == ZmqUtil::CMD_CREDIT) {
+      ++m_credits;
+      m_requested = false;
+    }
+  }
+  ZmqUtil::post_message(m_socket, item);
+  --m_credits;
+  return true;
+}
+
+ZmqNotifier::ZmqNotifier(zmq::context_t &ctx, const std::string &endpoint) :
+    m_socket(ctx, ZMQ_XPUB),
+    m_quit(false) {
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  // Report every subscription, also repeated ones, to resend the last values
+  m_socket.setsockopt(ZMQ_XPUB_VERBOSE, 1);
+  m_socket.bind(endpoint);
+  m_thread = boost::thread(&ZmqNotifier::Run, this);
+}
+
+ZmqNotifier::~ZmqNotifier() {
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_quit = true;
+  }
+  m_thread.join();
+}
+
+void ZmqNotifier::Publish(int type, const std::string &data) {
+  Publish(MakeCommand(type, data));
+}
+
+void ZmqNotifier::Publish(const UnrealGo::Command &command) {
+  const std::string frame = SerializeCommand(command);
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_last[command.type()] = frame;
+  m_pending.push_back(frame);
+}
+
+void ZmqNotifier::Run() {
+  while (true) {
+    bool newSubscriber = false;
+    if (Readable(m_socket, POLL_INTERVAL)) {
+      zmq::message_t subscription;
+      m_socket.recv(&subscription);
+      newSubscriber = subscription.size() > 0
+          && *static_cast<const char *>(subscription.data()) == 1;
+    }
+    std::deque<std::string> frames;
+    {
+      boost::mutex::scoped_lock lock(m_mutex);
+      if (m_quit)
+        break;
+      if (newSubscriber)
+        for (const auto &last : m_last)
+          frames.push_back(last.second);
+      frames.insert(frames.end(), m_pending.begin(), m_pending.end());
+      m_pending.clear();
+    }
+    for (const std::string &frame : frames)
+      SendFrame(m_socket, frame);
+  }
+}
+
+ZmqSubscriber::ZmqSubscriber(zmq::context_t &ctx,
+                             const std::string &endpoint) :
+    m_socket(ctx, ZMQ_SUB) {
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  m_socket.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+  m_socket.connect(endpoint);
+}
+
+bool ZmqSubscriber::Receive(UnrealGo::Command &command, long timeout) {
+  return ZmqUtil::poll_command(m_socket, command, timeout);
+}
+
+bool ZmqSubscriber::Latest(int type, UnrealGo::Command &command) {
+  bool found = false;
+  UnrealGo::Command received;
+  while (ZmqUtil::poll_command(m_socket, received, 0))
+    if (received.type() == type) {
+      command = received;
+      found = true;
+    }
+  return found;
+}
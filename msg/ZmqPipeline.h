@@ -0,0 +1,140 @@
+
+#ifndef UNREALGO_ZMQPIPELINE_H
+#define UNREALGO_ZMQPIPELINE_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <zmq.hpp>
+#include "msg/command.pb.h"
+
+/** Building blocks for running self-play, training and gating at the same
+    time: a bounded work queue with credit-based flow control and checkpoint
+    notifications that are pushed to the subscribers.
+    The endpoints may be inproc:// (the sockets must then share the
+    zmq::context_t) or tcp://. Each socket is used by one thread only. */
+
+/** Receiving end of a bounded queue of commands.
+    A producer (ZmqCreditSender) asks for a credit before each item, and the
+    queue grants credits only for free slots, in the order of the requests.
+    A full queue therefore stops the producers instead of growing. An I/O
+    thread owns the ROUTER socket; Pop() may be called from any thread.
+    Credits are counted per producer. A credit that is not used within
+    creditTimeout milliseconds, for instance because its producer
+    disconnected, frees its slot again; an item that still arrives on
+    such a credit is queued beyond the capacity. */
+class ZmqWorkQueue {
+ public:
+  ZmqWorkQueue(zmq::context_t &ctx, const std::string &endpoint,
+               std::size_t capacity, long creditTimeout = 60000);
+
+  ~ZmqWorkQueue();
+
+  /** Wait up to timeout milliseconds (-1: no limit) for an item.
+      @return false if none arrived or the queue is shutting down */
+  bool Pop(UnrealGo::Command &item, long timeout = -1);
+
+  std::size_t Size() const;
+
+  std::size_t Capacity() const;
+
+  /** Producers waiting for a credit. */
+  std::size_t NuWaiting() const;
+
+  /** Credits granted and not used or expired yet. */
+  std::size_t NuGranted() const;
+
+ private:
+  const std::size_t m_capacity;
+  const long m_creditTimeout;
+  zmq::socket_t m_socket;
+  mutable boost::mutex m_mutex;
+  boost::condition_variable m_itemAdded;
+  std::deque<UnrealGo::Command> m_items;
+  /** Identities of the producers that asked for a credit. */
+  std::deque<std::string> m_waiting;
+  /** Times of the credits granted and not used yet, by producer. */
+  std::map<std::string, std::deque<boost::system_time> > m_granted;
+  std::size_t m_nuGranted;
+  bool m_quit;
+  boost::thread m_thread;
+
+  void Run();
+
+  void GrantCredits();
+
+  void ExpireCredits();
+
+  ZmqWorkQueue(const ZmqWorkQueue &);
+  ZmqWorkQueue &operator=(const ZmqWorkQueue &);
+};
+
+/** Sending end of a ZmqWorkQueue. Not thread-safe. */
+class ZmqCreditSender {
+ public:
+  ZmqCreditSender(zmq::context_t &ctx, const std::string &endpoint);
+
+  /** Send an item once the queue has room.
+      @param timeout Milliseconds to wait for a credit (-1: no limit)
+      @return false if no credit arrived in time. The request stays
+      pending, so a later call gets the next free slot. */
+  bool Send(int type, const std::string &data, long timeout = -1);
+
+  bool Send(const UnrealGo::Command &item, long timeout = -1);
+
+ private:
+  zmq::socket_t m_socket;
+  bool m_requested;
+  int m_credits;
+};
+
+/** Publishes commands, for instance CMD_UPDATE_CKP, to all ZmqSubscriber.
+    The last command of each type is kept and sent to each new subscriber,
+    so a subscriber that connects late still learns the current checkpoint.
+    The other subscribers get these commands again, so handling a command
+    must be idempotent. Thread-safe. */
+class ZmqNotifier {
+ public:
+  ZmqNotifier(zmq::context_t &ctx, const std::string &endpoint);
+
+  ~ZmqNotifier();
+
+  void Publish(int type, const std::string &data);
+
+  void Publish(const UnrealGo::Command &command);
+
+ private:
+  zmq::socket_t m_socket;
+  boost::mutex m_mutex;
+  std::deque<std::string> m_pending;
+  std::map<int, std::string> m_last;
+  bool m_quit;
+  boost::thread m_thread;
+
+  void Run();
+
+  ZmqNotifier(const ZmqNotifier &);
+  ZmqNotifier &operator=(const ZmqNotifier &);
+};
+
+/** Receives the commands of a ZmqNotifier. Not thread-safe. */
+class ZmqSubscriber {
+ public:
+  ZmqSubscriber(zmq::context_t &ctx, const std::string &endpoint);
+
+  /** Wait up to timeout milliseconds (-1: no limit) for a command. */
+  bool Receive(UnrealGo::Command &command, long timeout);
+
+  /** Drain the received commands and keep the last one of a type. The
+      commands of other types are dropped.
+      @return false if there was none of that type */
+  bool Latest(int type, UnrealGo::Command &command);
+
+ private:
+  zmq::socket_t m_socket;
+};
+
+#endif //UNREALGO_ZMQPIPELINE_H
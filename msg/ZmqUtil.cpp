@@ -15,6 +15,10 @@ void ZmqUtil::send_command(zmq::socket_t &socket, int cmd, const std::string &da
   UnrealGo::Command command;
   command.set_type(cmd);
   command.set_data(data);
+  send_message(socket, command);
+}
+
+void ZmqUtil::send_message(zmq::socket_t &socket, const UnrealGo::Command &command) {
   zmq::message_t request(command.ByteSizeLong());
   command.SerializeToArray(request.data(), command.ByteSize());
   socket.send(request);
@@ -31,3 +35,40 @@ void ZmqUtil::receive_command(zmq::socket_t &socket, UnrealGo::Command &command,
   command.ParseFromArray(request.data(), (int) request.size());
   socket.send(reply);
 }
+
+void ZmqUtil::post_command(zmq::socket_t &socket, int cmd, const std::string &data) {
+  UnrealGo::Command command;
+  command.set_type(cmd);
+  command.set_data(data);
+  post_message(socket, command);
+}
+
+bool ZmqUtil::post_message(zmq::socket_t &socket, const UnrealGo::Command &command) {
+  zmq::message_t request(command.ByteSizeLong());
+  command.SerializeToArray(request.data(), (int) request.size());
+  return socket.send(request);
+}
+
+std::string ZmqUtil::checkpoint_name(const UnrealGo::Command &command) {
+  if (command.has_checkpoint())
+    return command.checkpoint().checkpoint().name();
+  return command.data();
+}
+
+bool ZmqUtil::poll_command(zmq::socket_t &socket, UnrealGo::Command &command, long timeout) {
+  zmq::pollitem_t item = {(void *) socket, 0, ZMQ_POLLIN, 0};
+  if (zmq::poll(&item, 1, timeout) <= 0 || !(item.revents & ZMQ_POLLIN))
+    return false;
+  zmq::message_t request;
+  if (!socket.recv(&request))
+    return false;
+  return command.ParseFromArray(request.data(), (int) request.size());
+}
+
+bool ZmqUtil::poll_reply(zmq::socket_t &socket, long timeout) {
+  zmq::pollitem_t item = {(void *) socket, 0, ZMQ_POLLIN, 0};
+  if (zmq::poll(&item, 1, timeout) <= 0 || !(item.revents & ZMQ_POLLIN))
+    return false;
+  zmq::message_t reply;
+  return socket.recv(&reply);
+}
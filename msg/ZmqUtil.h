@@ -20,10 +20,50 @@ along with UnrealGo.  If not, see <http://www.gnu.org/licenses/>.
 #include "msg/command.pb.h"
 
 namespace ZmqUtil {
+  /** Types of UnrealGo::Command. */
+  enum CommandType {
+    CMD_TRAIN = 0,
+    CMD_UPDATE_CKP = 1,
+    CMD_GET_CKP = 2,
+    CMD_GET_METAGRAPH = 3,
+    CMD_EXIT = 4,
+    /** A producer asks a ZmqWorkQueue for a credit. */
+    CMD_READY = 5,
+    /** A ZmqWorkQueue allows a producer to send one item. */
+    CMD_CREDIT = 6,
+    /** A checkpoint passed the gating games. */
+    CMD_BEST_CKP = 7,
+    /** UnrealGo::EvalResult of a gating game. */
+    CMD_EVAL_RESULT = 8
+  };
+
   void sendData(zmq::socket_t &socket, const std::string &data);
 
   void send_command(zmq::socket_t &socket, int cmd, const std::string &data);
 
+  /** Send a command and wait for the reply. */
+  void send_message(zmq::socket_t &socket, const UnrealGo::Command &command);
+
   void receive_command(zmq::socket_t &socket, UnrealGo::Command &command, zmq::message_t &reply);
+
+  /** Send a command without waiting for a reply. */
+  void post_command(zmq::socket_t &socket, int cmd, const std::string &data);
+
+  /** @return false if the socket could not send within its ZMQ_SNDTIMEO */
+  bool post_message(zmq::socket_t &socket, const UnrealGo::Command &command);
+
+  /** Name of the checkpoint of a CMD_UPDATE_CKP or CMD_BEST_CKP command,
+      from the CheckPointAnnouncement or else from the data. */
+  std::string checkpoint_name(const UnrealGo::Command &command);
+
+  /** Wait up to timeout milliseconds (-1: no limit) for a command without
+      sending a reply.
+      @return false if no command arrived */
+  bool poll_command(zmq::socket_t &socket, UnrealGo::Command &command, long timeout);
+
+  /** Wait up to timeout milliseconds (-1: no limit) for the reply to a
+      command sent with post_message().
+      @return false if no reply arrived */
+  bool poll_reply(zmq::socket_t &socket, long timeout);
 }
 #endif //UNREALGO_ATOMZMQ_H
\ No newline at end of file
@@ -0,0 +1,105 @@
+
+
+#include "platform/SgSystem.h"
+#include "msg/ZmqPipeline.h"
+
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "msg/ZmqUtil.h"
+
+namespace {
+
+BOOST_AUTO_TEST_CASE(ZmqPipelineTest_Backpressure) {
+  zmq::context_t ctx(1);
+  ZmqWorkQueue queue(ctx, "inproc://test-backpressure", 2);
+  ZmqCreditSender sender(ctx, "inproc://test-backpressure");
+  BOOST_CHECK(sender.Send(ZmqUtil::CMD_TRAIN, "a", 1000));
+  BOOST_CHECK(sender.Send(ZmqUtil::CMD_TRAIN, "b", 1000));
+  // Full queue, no credit
+  BOOST_CHECK(!sender.Send(ZmqUtil::CMD_TRAIN, "c", 100));
+  UnrealGo::Command item;
+  BOOST_REQUIRE(queue.Pop(item, 1000));
+  BOOST_CHECK_EQUAL(item.type(), ZmqUtil::CMD_TRAIN);
+  BOOST_CHECK_EQUAL(item.data(), "a");
+  BOOST_CHECK(sender.Send(ZmqUtil::CMD_TRAIN, "c", 1000));
+  BOOST_REQUIRE(queue.Pop(item, 1000));
+  BOOST_CHECK_EQUAL(item.data(), "b");
+  BOOST_REQUIRE(queue.Pop(item, 1000));
+  BOOST_CHECK_EQUAL(item.data(), "c");
+  BOOST_CHECK(!queue.Pop(item, 50));
+  BOOST_CHECK_EQUAL(queue.Size(), 0u);
+}
+
+/** The credit of a producer that disconnects before it sends expires. */
+BOOST_AUTO_TEST_CASE(ZmqPipelineTest_CreditExpiry) {
+  zmq::context_t ctx(1);
+  ZmqWorkQueue queue(ctx, "inproc://test-expiry", 1, 100);
+  {
+    zmq::socket_t gone(ctx, ZMQ_DEALER);
+    gone.setsockopt(ZMQ_LINGER, 1000);
+    gone.connect("inproc://test-expiry");
+    ZmqUtil::post_command(gone, ZmqUtil::CMD_READY, "");
+    UnrealGo::Command credit;
+    BOOST_REQUIRE(ZmqUtil::poll_command(gone, credit, 1000));
+    BOOST_CHECK_EQUAL(credit.type(), ZmqUtil::CMD_CREDIT);
+  }
+  BOOST_CHECK_EQUAL(queue.NuGranted(), 1u);
+  ZmqCreditSender sender(ctx, "inproc://test-expiry");
+  BOOST_CHECK(sender.Send(ZmqUtil::CMD_TRAIN, "a", 2000));
+  UnrealGo::Command item;
+  BOOST_REQUIRE(queue.Pop(item, 1000));
+  BOOST_CHECK_EQUAL(item.data(), "a");
+  BOOST_CHECK_EQUAL(queue.NuGranted(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(ZmqPipelineTest_Producers) {
+  const int nuProducers = 3;
+  const int nuItems = 20;
+  zmq::context_t ctx(1);
+  ZmqWorkQueue queue(ctx, "inproc://test-producers", 1);
+  std::vector<boost::thread> producers;
+  for (int i = 0; i < nuProducers; ++i)
+    producers.push_back(boost::thread([&ctx, i]() {
+      ZmqCreditSender sender(ctx, "inproc://test-producers");
+      for (int j = 0; j < nuItems; ++j)
+        sender.Send(ZmqUtil::CMD_TRAIN,
+                    std::to_string(i) + "-" + std::to_string(j));
+    }));
+  std::set<std::string> received;
+  UnrealGo::Command item;
+  for (int i = 0; i < nuProducers * nuItems; ++i) {
+    BOOST_REQUIRE(queue.Pop(item, 5000));
+    BOOST_CHECK(queue.Size() <= queue.Capacity());
+    received.insert(item.data());
+  }
+  for (auto &producer : producers)
+    producer.join();
+  BOOST_CHECK_EQUAL(received.size(), std::size_t(nuProducers * nuItems));
+}
+
+BOOST_AUTO_TEST_CASE(ZmqPipelineTest_Notifications) {
+  zmq::context_t ctx(1);
+  ZmqNotifier notifier(ctx, "inproc://test-notifications");
+  notifier.Publish(ZmqUtil::CMD_UPDATE_CKP, "ckpt-1");
+  notifier.Publish(ZmqUtil::CMD_BEST_CKP, "ckpt-0");
+  // A late subscriber gets the last value of each type
+  ZmqSubscriber subscriber(ctx, "inproc://test-notifications");
+  UnrealGo::Command command;
+  std::set<std::string> received;
+  while (received.size() < 2 && subscriber.Receive(command, 2000))
+    received.insert(command.data());
+  BOOST_CHECK(received.count("ckpt-1"));
+  BOOST_CHECK(received.count("ckpt-0"));
+  // Pushed without polling, possibly after repeated older notifications
+  notifier.Publish(ZmqUtil::CMD_UPDATE_CKP, "ckpt-2");
+  notifier.Publish(ZmqUtil::CMD_UPDATE_CKP, "ckpt-3");
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  BOOST_REQUIRE(subscriber.Latest(ZmqUtil::CMD_UPDATE_CKP, command));
+  BOOST_CHECK_EQUAL(command.data(), "ckpt-3");
+  BOOST_CHECK(!subscriber.Receive(command, 50));
+}
+
+}
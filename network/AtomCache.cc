@@ -0,0 +1,435 @@
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ctime>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <curl/curl.h>
+#include "openssl/sha.h"
+#include "AtomCache.h"
+#include "AtomHash.h"
+#include "platform/SgDebug.h"
+
+namespace {
+
+/** Smallest part of a file that gets its own connection. */
+const curl_off_t MIN_RANGE_SIZE = 4 << 20;
+
+/** Seconds between the saves of the ranges of a running download. */
+const double SAVE_INTERVAL = 2;
+
+typedef AtomCache::Range Range;
+
+struct Download {
+  int fd;
+  std::vector<Range> ranges;
+  SHA_CTX sha;
+  /** The SHA1 covers the bytes before this offset. */
+  curl_off_t hashed;
+  /** Where the ranges are saved, empty if they are not. */
+  std::string rangesName;
+  curl_off_t length;
+  std::time_t lastSave;
+
+  Download() : fd(-1), hashed(0), length(-1), lastSave(0) {
+    SHA1_Init(&sha);
+  }
+
+  bool Write(size_t index, const char *data, size_t size);
+
+  bool CatchUp();
+
+  void SaveRanges();
+};
+
+struct Transfer {
+  Download *download;
+  size_t index;
+  CURL *handle;
+  bool checked;
+  bool failed;
+};
+
+bool Download::Write(size_t index, const char *data, size_t size) {
+  Range &range = ranges[index];
+  const curl_off_t offset = range.begin + range.done;
+  if (range.end >= 0 && offset + (curl_off_t) size > range.end)
+    return false;
+  for (size_t written = 0; written < size;) {
+    ssize_t n = pwrite(fd, data + written, size - written, offset + written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    written += n;
+  }
+  if (offset == hashed) {
+    SHA1_Update(&sha, data, size);
+    hashed += size;
+  }
+  range.done += size;
+  return CatchUp();
+}
+
+/** Hash data of later ranges that arrived before the hashed prefix reached
+    it. This is the only time the file is read. */
+bool Download::CatchUp() {
+  char buffer[32768];
+  for (const Range &range : ranges) {
+    if (range.end >= 0 && hashed >= range.end)
+      continue;
+    if (hashed < range.begin)
+      return true;
+    while (hashed < range.begin + range.done) {
+      const size_t size = (size_t) std::min<curl_off_t>(
+          sizeof(buffer), range.begin + range.done - hashed);
+      ssize_t n = pread(fd, buffer, size, hashed);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      SHA1_Update(&sha, buffer, n);
+      hashed += n;
+    }
+    if (!range.Complete())
+      return true;
+  }
+  return true;
+}
+
+void Download::SaveRanges() {
+  if (rangesName.empty())
+    return;
+  AtomCache::SaveRanges(rangesName, length, ranges);
+  lastSave = std::time(nullptr);
+}
+
+size_t WriteCB(char *data, size_t size, size_t nmemb, void *userdata) {
+  auto *transfer = (Transfer *) userdata;
+  if (!transfer->checked) {
+    // A server that ignores the range sends the whole file with status 200
+    const Range &range = transfer->download->ranges[transfer->index];
+    long status = 0;
+    curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &status);
+    const bool partial = range.begin + range.done > 0 || range.end >= 0;
+    if (partial && status != 206 && !(status == 200 && range.begin + range.done == 0
+        && transfer->download->ranges.size() == 1)) {
+      transfer->failed = true;
+      return 0;
+    }
+    transfer->checked = true;
+  }
+  if (!transfer->download->Write(transfer->index, data, size * nmemb)) {
+    transfer->failed = true;
+    return 0;
+  }
+  return size * nmemb;
+}
+
+size_t AcceptRangesCB(char *data, size_t size, size_t nmemb, void *userdata) {
+  const char *key = "accept-ranges:";
+  const size_t length = size * nmemb;
+  if (length > strlen(key) && strncasecmp(data, key, strlen(key)) == 0) {
+    std::string value(data + strlen(key), length - strlen(key));
+    *(bool *) userdata = value.find("bytes") != std::string::npos;
+  }
+  return length;
+}
+
+/** Ask for the length of the file and whether range requests work. */
+bool Probe(const std::string &url, curl_off_t &length, bool &acceptRanges) {
+  CURL *curl = curl_easy_init();
+  if (!curl)
+    return false;
+  acceptRanges = false;
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, AcceptRangesCB);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &acceptRanges);
+  const bool ok = curl_easy_perform(curl) == CURLE_OK;
+  length = -1;
+  if (ok)
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+  curl_easy_cleanup(curl);
+  return ok;
+}
+
+bool Perform(const std::string &url, Download &download) {
+  CURLM *multi = curl_multi_init();
+  if (!multi)
+    return false;
+  std::vector<Transfer> transfers;
+  transfers.reserve(download.ranges.size());
+  for (size_t i = 0; i < download.ranges.size(); ++i) {
+    const Range &range = download.ranges[i];
+    if (range.Complete())
+      continue;
+    Transfer transfer = {&download, i, curl_easy_init(), false, false};
+    if (!transfer.handle)
+      continue;
+    transfers.push_back(transfer);
+    CURL *curl = transfer.handle;
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCB);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfers.back());
+    if (range.begin + range.done > 0 || download.ranges.size() > 1) {
+      std::string bytes = std::to_string(range.begin + range.done) + "-";
+      if (range.end >= 0)
+        bytes += std::to_string(range.end - 1);
+      curl_easy_setopt(curl, CURLOPT_RANGE, bytes.c_str());
+    }
+    curl_multi_add_handle(multi, curl);
+  }
+
+  int running = 0;
+  do {
+    if (curl_multi_perform(multi, &running) != CURLM_OK)
+      break;
+    if (running > 0)
+      curl_multi_wait(multi, nullptr, 0, 1000, nullptr);
+    if (std::difftime(std::time(nullptr), download.lastSave) >= SAVE_INTERVAL)
+      download.SaveRanges();
+  } while (running > 0);
+
+  bool ok = running == 0;
+  int queued;
+  while (CURLMsg *msg = curl_multi_info_read(multi, &queued))
+    if (msg->msg == CURLMSG_DONE && msg->data.result != CURLE_OK) {
+      SgDebug() << "AtomCache: " << url << ": " << curl_easy_strerror(msg->data.result) << '\n';
+      ok = false;
+    }
+  for (Transfer &transfer : transfers) {
+    ok = ok && !transfer.failed;
+    curl_multi_remove_handle(multi, transfer.handle);
+    curl_easy_cleanup(transfer.handle);
+  }
+  curl_multi_cleanup(multi);
+  return ok;
+}
+
+std::string HexDigest(SHA_CTX &sha) {
+  unsigned char hash[SHA_DIGEST_LENGTH];
+  SHA1_Final(hash, &sha);
+  char hex[SHA1HEXLEN];
+  for (int i = 0; i < SHA_DIGEST_LENGTH; ++i)
+    sprintf(hex + i * 2, "%02x", hash[i]);
+  return std::string(hex, SHA_DIGEST_LENGTH * 2);
+}
+
+/** A file of the cache, as opposed to a .part or .ranges file. */
+bool IsCacheEntry(const char *name) {
+  if (strlen(name) != SHA_DIGEST_LENGTH * 2)
+    return false;
+  for (const char *c = name; *c; ++c)
+    if (!isxdigit((unsigned char) *c))
+      return false;
+  return true;
+}
+
+struct Entry {
+  std::string path;
+  std::time_t time;
+  std::uint64_t size;
+
+  bool operator<(const Entry &entry) const {
+    return time < entry.time;
+  }
+};
+
+}
+
+void AtomCache::PlanRanges(std::int64_t length, bool acceptRanges,
+                           int maxConnections, std::int64_t existing,
+                           std::vector<Range> &ranges) {
+  ranges.clear();
+  if (length <= 0 || !acceptRanges) {
+    Range range = {0, length > 0 ? length : -1, 0};
+    ranges.push_back(range);
+    return;
+  }
+  if (existing > 0) {
+    // A partial file without saved ranges was written sequentially
+    Range range = {0, length, std::min(existing, length)};
+    ranges.push_back(range);
+    return;
+  }
+  std::int64_t count = std::max<std::int64_t>(1, std::min<std::int64_t>(maxConnections, length / MIN_RANGE_SIZE));
+  for (std::int64_t i = 0; i < count; ++i) {
+    Range range = {length * i / count, length * (i + 1) / count, 0};
+    ranges.push_back(range);
+  }
+}
+
+bool AtomCache::LoadRanges(const std::string &fileName, std::int64_t length,
+                           std::vector<Range> &ranges) {
+  std::ifstream in(fileName.c_str());
+  std::int64_t savedLength;
+  size_t count;
+  if (!(in >> savedLength >> count) || savedLength != length || count == 0
+      || count > 1024)
+    return false;
+  std::vector<Range> loaded(count);
+  std::int64_t next = 0;
+  for (Range &range : loaded) {
+    if (!(in >> range.begin >> range.end >> range.done))
+      return false;
+    // The ranges must cover the file in order
+    if (range.begin != next || range.done < 0
+        || (range.end >= 0 && range.begin + range.done > range.end))
+      return false;
+    next = range.end;
+  }
+  if (next != (length > 0 ? length : -1))
+    return false;
+  ranges.swap(loaded);
+  return true;
+}
+
+bool AtomCache::SaveRanges(const std::string &fileName, std::int64_t length,
+                           const std::vector<Range> &ranges) {
+  const std::string tmpName = fileName + ".tmp";
+  {
+    std::ofstream out(tmpName.c_str());
+    out << length << ' ' << ranges.size() << '\n';
+    for (const Range &range : ranges)
+      out << range.begin << ' ' << range.end << ' ' << range.done << '\n';
+    if (!out.flush())
+      return false;
+  }
+  return rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+AtomCache::AtomCache(const std::string &dir, int maxConnections,
+                     std::size_t maxEntries, std::uint64_t maxBytes) :
+    m_dir(dir),
+    m_maxConnections(maxConnections),
+    m_maxEntries(maxEntries),
+    m_maxBytes(maxBytes) {
+  curl_global_init(CURL_GLOBAL_DEFAULT);
+  mkdir(m_dir.c_str(), 0777);
+}
+
+std::string AtomCache::Path(const std::string &sha1) const {
+  return m_dir + "/" + sha1;
+}
+
+bool AtomCache::Contains(const std::string &sha1) const {
+  struct stat st;
+  return stat(Path(sha1).c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+bool AtomCache::Fetch(const std::string &url, const std::string &sha1,
+                      std::string &path) {
+  path = Path(sha1);
+  if (Contains(sha1)) {
+    // The modification time orders the files for Evict()
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    return true;
+  }
+  const std::string partName = path + ".part";
+  const std::string rangesName = partName + ".ranges";
+  Download download;
+  download.fd = open(partName.c_str(), O_RDWR | O_CREAT, 0666);
+  if (download.fd < 0) {
+    SgDebug() << "AtomCache: cannot create " << partName << '\n';
+    return false;
+  }
+  // Another process may be fetching the same file; it renames the part file
+  // before it releases the lock
+  if (flock(download.fd, LOCK_EX) != 0 || Contains(sha1)) {
+    close(download.fd);
+    return Contains(sha1);
+  }
+
+  curl_off_t length = -1;
+  bool acceptRanges = false;
+  if (!Probe(url, length, acceptRanges))
+    SgDebug() << "AtomCache: no HEAD response for " << url << '\n';
+  struct stat st;
+  const curl_off_t existing = fstat(download.fd, &st) == 0 ? st.st_size : 0;
+  if (!acceptRanges || !LoadRanges(rangesName, length, download.ranges))
+    PlanRanges(length, acceptRanges, m_maxConnections, existing, download.ranges);
+  if (download.ranges.size() == 1 && download.ranges[0].done == 0)
+    if (ftruncate(download.fd, 0) != 0) {
+      close(download.fd);
+      return false;
+    }
+  SgDebug() << "AtomCache: fetching " << url << " over " << download.ranges.size() << " connection(s)\n";
+  if (acceptRanges) {
+    download.rangesName = rangesName;
+    download.length = length;
+    download.SaveRanges();
+  }
+
+  bool ok = download.CatchUp() && Perform(url, download) && download.CatchUp();
+  for (const Range &range : download.ranges)
+    ok = ok && (range.end < 0 || range.Complete());
+  if (!ok) {
+    download.SaveRanges();
+    close(download.fd);
+    return false;
+  }
+  remove(rangesName.c_str());
+  if (HexDigest(download.sha) != sha1) {
+    SgDebug() << "AtomCache: SHA1 mismatch for " << url << '\n';
+    remove(partName.c_str());
+    close(download.fd);
+    return false;
+  }
+  ok = fsync(download.fd) == 0 && rename(partName.c_str(), path.c_str()) == 0;
+  close(download.fd);
+  if (ok)
+    Evict(path);
+  return ok;
+}
+
+void AtomCache::Evict(const std::string &keep) {
+  if (m_maxEntries == 0 && m_maxBytes == 0)
+    return;
+  DIR *dir = opendir(m_dir.c_str());
+  if (!dir)
+    return;
+  std::vector<Entry> entries;
+  std::uint64_t totalSize = 0;
+  while (struct dirent *file = readdir(dir)) {
+    if (!IsCacheEntry(file->d_name))
+      continue;
+    Entry entry;
+    entry.path = m_dir + "/" + file->d_name;
+    struct stat st;
+    if (stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+      continue;
+    entry.time = st.st_mtime;
+    entry.size = st.st_size;
+    entries.push_back(entry);
+    totalSize += entry.size;
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end());
+  size_t nuEntries = entries.size();
+  for (const Entry &entry : entries) {
+    if ((m_maxEntries == 0 || nuEntries <= m_maxEntries)
+        && (m_maxBytes == 0 || totalSize <= m_maxBytes))
+      break;
+    if (entry.path == keep)
+      continue;
+    // A process that has the file open can still read it
+    if (remove(entry.path.c_str()) == 0) {
+      SgDebug() << "AtomCache: evicted " << entry.path << '\n';
+      --nuEntries;
+      totalSize -= entry.size;
+    }
+  }
+}
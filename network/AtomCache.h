@@ -0,0 +1,93 @@
+/*
+This file is part of UnrealGo.
+Copyright (C) 2017 Kevin
+UnrealGo is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+UnrealGo is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with UnrealGo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNREALGO_ATOMCACHE_H
+#define UNREALGO_ATOMCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Local cache of downloaded files, addressed by the SHA1 of their content.
+    A file is downloaded into <dir>/<sha1>.part and renamed to <dir>/<sha1>
+    once its hash is verified, so a file in the cache is always complete.
+    Large files are fetched over several connections with HTTP range
+    requests. The SHA1 is computed from the received data while it arrives;
+    only data that arrives ahead of the hashed prefix, from a later range,
+    is read back from the file. The progress of each range is saved in
+    <dir>/<sha1>.part.ranges when the download starts and every few seconds
+    while it runs, so the next Fetch() resumes an interrupted download, even
+    one whose process was killed.
+    Several processes may share a cache directory: the .part file is locked
+    while it is written.
+    The cache keeps at most maxEntries files and maxBytes bytes (0: no
+    limit) and removes the least recently fetched files beyond that. */
+class AtomCache {
+ public:
+  /** Part [begin, end) of a file, of which done bytes are written.
+      end is -1 if the length of the file is unknown. */
+  struct Range {
+    std::int64_t begin;
+    std::int64_t end;
+    std::int64_t done;
+
+    bool Complete() const {
+      return end >= 0 && begin + done >= end;
+    }
+  };
+
+  AtomCache(const std::string &dir, int maxConnections = 4,
+            std::size_t maxEntries = 0, std::uint64_t maxBytes = 0);
+
+  std::string Path(const std::string &sha1) const;
+
+  bool Contains(const std::string &sha1) const;
+
+  /** Make sure the file with this SHA1 is in the cache, downloading it from
+      url if needed.
+      @param[out] path The file in the cache
+      @return false if the download failed or the content has another SHA1 */
+  bool Fetch(const std::string &url, const std::string &sha1,
+             std::string &path);
+
+  /** Remove the least recently fetched files until the cache is within its
+      limits. The file keep is never removed. */
+  void Evict(const std::string &keep = "");
+
+  /** Split a file of length bytes (-1: unknown) into the ranges of the
+      connections. existing bytes of a partial file without saved ranges
+      are kept. */
+  static void PlanRanges(std::int64_t length, bool acceptRanges,
+                         int maxConnections, std::int64_t existing,
+                         std::vector<Range> &ranges);
+
+  /** @return false if the file is missing, corrupt, or saved for a file
+      of another length */
+  static bool LoadRanges(const std::string &fileName, std::int64_t length,
+                         std::vector<Range> &ranges);
+
+  /** Replaces the file atomically, a process killed while saving leaves
+      the old ranges. */
+  static bool SaveRanges(const std::string &fileName, std::int64_t length,
+                         const std::vector<Range> &ranges);
+
+ private:
+  std::string m_dir;
+  int m_maxConnections;
+  std::size_t m_maxEntries;
+  std::uint64_t m_maxBytes;
+};
+
+#endif //UNREALGO_ATOMCACHE_H
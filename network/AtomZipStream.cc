@@ -0,0 +1,551 @@
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AtomZipStream.h"
+#include "AtomHash.h"
+
+using UnrealGo::ZipStream::Input;
+using UnrealGo::ZipStream::Output;
+
+namespace {
+
+const std::size_t BUFFER_SIZE = 65536;
+
+const uint32_t LOCAL_HEADER = 0x04034b50;
+const uint32_t DATA_DESCRIPTOR = 0x08074b50;
+const uint32_t CENTRAL_HEADER = 0x02014b50;
+const uint32_t END_OF_CENTRAL_DIR = 0x06054b50;
+const uint16_t FLAG_ENCRYPTED = 1;
+const uint16_t FLAG_DATA_DESCRIPTOR = 8;
+const uint16_t METHOD_STORED = 0;
+const uint16_t METHOD_DEFLATED = 8;
+const uint16_t ZIP64_EXTRA = 0x0001;
+
+std::string HexDigest(SHA_CTX &sha) {
+  unsigned char hash[SHA_DIGEST_LENGTH];
+  SHA1_Final(hash, &sha);
+  char hex[SHA1HEXLEN];
+  for (int i = 0; i < SHA_DIGEST_LENGTH; ++i)
+    sprintf(hex + i * 2, "%02x", hash[i]);
+  return std::string(hex, SHA_DIGEST_LENGTH * 2);
+}
+
+void Put16(std::string &out, uint16_t value) {
+  out += (char) (value & 0xff);
+  out += (char) (value >> 8);
+}
+
+void Put32(std::string &out, uint32_t value) {
+  Put16(out, (uint16_t) (value & 0xffff));
+  Put16(out, (uint16_t) (value >> 16));
+}
+
+uint16_t Get16(const unsigned char *data) {
+  return (uint16_t) (data[0] | (data[1] << 8));
+}
+
+uint32_t Get32(const unsigned char *data) {
+  return Get16(data) | ((uint32_t) Get16(data + 2) << 16);
+}
+
+uint64_t Get64(const unsigned char *data) {
+  return Get32(data) | ((uint64_t) Get32(data + 4) << 32);
+}
+
+/** Buffered reading of an Input, so that the bytes after the end of a
+    compressed entry are kept for the next header. */
+class Reader {
+ public:
+  explicit Reader(Input &in) : m_in(in), m_pos(0), m_end(0), m_error(false) {}
+
+  bool Fill() {
+    if (m_pos < m_end)
+      return true;
+    long n = m_in.Read(m_buffer, BUFFER_SIZE);
+    if (n < 0)
+      m_error = true;
+    if (n <= 0)
+      return false;
+    m_pos = 0;
+    m_end = (std::size_t) n;
+    return true;
+  }
+
+  bool ReadExact(void *data, std::size_t size) {
+    auto *out = (unsigned char *) data;
+    while (size > 0) {
+      if (!Fill())
+        return false;
+      std::size_t n = std::min(size, m_end - m_pos);
+      memcpy(out, m_buffer + m_pos, n);
+      m_pos += n;
+      out += n;
+      size -= n;
+    }
+    return true;
+  }
+
+  void Drain() {
+    while (Fill())
+      m_pos = m_end;
+  }
+
+  unsigned char *Data() {
+    return m_buffer + m_pos;
+  }
+
+  std::size_t Available() const {
+    return m_end - m_pos;
+  }
+
+  void Consume(std::size_t size) {
+    m_pos += size;
+  }
+
+  bool Error() const {
+    return m_error;
+  }
+
+ private:
+  Input &m_in;
+  unsigned char m_buffer[BUFFER_SIZE];
+  std::size_t m_pos;
+  std::size_t m_end;
+  bool m_error;
+};
+
+/** Compress all of in, with a zlib header for windowBits > 0 and raw for
+    zip entries otherwise. */
+int DeflateStream(Input &in, Output &out, int level, int windowBits,
+                  uLong *crc) {
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  int ret = deflateInit2(&strm, level, Z_DEFLATED, windowBits, 8,
+                         Z_DEFAULT_STRATEGY);
+  if (ret != Z_OK)
+    return ret;
+  std::vector<unsigned char> inBuffer(BUFFER_SIZE);
+  std::vector<unsigned char> outBuffer(BUFFER_SIZE);
+  int flush;
+  do {
+    long n = in.Read(inBuffer.data(), inBuffer.size());
+    if (n < 0) {
+      (void) deflateEnd(&strm);
+      return Z_ERRNO;
+    }
+    if (crc)
+      *crc = crc32(*crc, inBuffer.data(), (uInt) n);
+    flush = n == 0 ? Z_FINISH : Z_NO_FLUSH;
+    strm.next_in = inBuffer.data();
+    strm.avail_in = (uInt) n;
+    do {
+      strm.next_out = outBuffer.data();
+      strm.avail_out = (uInt) outBuffer.size();
+      ret = deflate(&strm, flush);
+      std::size_t have = outBuffer.size() - strm.avail_out;
+      if (ret == Z_STREAM_ERROR || !out.Write(outBuffer.data(), have)) {
+        (void) deflateEnd(&strm);
+        return ret == Z_STREAM_ERROR ? ret : Z_ERRNO;
+      }
+    } while (strm.avail_out == 0);
+  } while (flush != Z_FINISH);
+  (void) deflateEnd(&strm);
+  return Z_OK;
+}
+
+/** Decompress one stream. Input after its end stays in the reader. */
+int InflateStream(Reader &reader, Output &out, int windowBits, uLong *crc) {
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  strm.avail_in = 0;
+  strm.next_in = Z_NULL;
+  int ret = inflateInit2(&strm, windowBits);
+  if (ret != Z_OK)
+    return ret;
+  std::vector<unsigned char> outBuffer(BUFFER_SIZE);
+  while (ret != Z_STREAM_END) {
+    if (!reader.Fill()) {
+      ret = reader.Error() ? Z_ERRNO : Z_DATA_ERROR;
+      break;
+    }
+    strm.next_in = reader.Data();
+    strm.avail_in = (uInt) reader.Available();
+    strm.next_out = outBuffer.data();
+    strm.avail_out = (uInt) outBuffer.size();
+    ret = inflate(&strm, Z_NO_FLUSH);
+    reader.Consume(reader.Available() - strm.avail_in);
+    if (ret != Z_OK && ret != Z_STREAM_END) {
+      if (ret == Z_NEED_DICT || ret == Z_BUF_ERROR)
+        ret = Z_DATA_ERROR;
+      break;
+    }
+    std::size_t have = outBuffer.size() - strm.avail_out;
+    if (crc)
+      *crc = crc32(*crc, outBuffer.data(), (uInt) have);
+    if (!out.Write(outBuffer.data(), have)) {
+      ret = Z_ERRNO;
+      break;
+    }
+  }
+  (void) inflateEnd(&strm);
+  return ret == Z_STREAM_END ? Z_OK : ret;
+}
+
+std::string FileNameNoPath(const std::string &path) {
+  return path.substr(path.find_last_of("/\\") + 1);
+}
+
+void DosTime(time_t time, uint16_t &dosTime, uint16_t &dosDate) {
+  struct tm local;
+  localtime_r(&time, &local);
+  if (local.tm_year < 80) {
+    dosTime = 0;
+    dosDate = (1 << 5) | 1;
+    return;
+  }
+  dosTime = (uint16_t) ((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+  dosDate = (uint16_t) (((local.tm_year - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+}
+
+bool SafeEntryName(const std::string &name) {
+  if (name.empty() || name[0] == '/' || name[0] == '\\')
+    return false;
+  std::string::size_type begin = 0;
+  while (begin <= name.size()) {
+    std::string::size_type end = name.find_first_of("/\\", begin);
+    if (end == std::string::npos)
+      end = name.size();
+    if (name.compare(begin, end - begin, "..") == 0)
+      return false;
+    begin = end + 1;
+  }
+  return true;
+}
+
+bool MakeDirs(const std::string &path) {
+  for (std::string::size_type pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+    std::string dir = path.substr(0, pos);
+    if (!dir.empty() && mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+      return false;
+    if (pos == std::string::npos)
+      return true;
+  }
+}
+
+}
+
+Input::Input(int fd, bool hash) :
+    m_fd(fd),
+    m_data(nullptr),
+    m_left(0),
+    m_hash(hash),
+    m_size(0) {
+  SHA1_Init(&m_sha);
+}
+
+Input::Input(const void *data, std::size_t size, bool hash) :
+    m_fd(-1),
+    m_data((const unsigned char *) data),
+    m_left(size),
+    m_hash(hash),
+    m_size(0) {
+  SHA1_Init(&m_sha);
+}
+
+long Input::Read(void *data, std::size_t size) {
+  long n;
+  if (m_fd >= 0) {
+    do
+      n = read(m_fd, data, size);
+    while (n < 0 && errno == EINTR);
+  } else {
+    n = (long) std::min(size, m_left);
+    memcpy(data, m_data, n);
+    m_data += n;
+    m_left -= n;
+  }
+  if (n > 0) {
+    if (m_hash)
+      SHA1_Update(&m_sha, data, n);
+    m_size += n;
+  }
+  return n;
+}
+
+uint64_t Input::Size() const {
+  return m_size;
+}
+
+std::string Input::Sha1() {
+  return HexDigest(m_sha);
+}
+
+Output::Output(int fd, bool hash) :
+    m_fd(fd),
+    m_buffer(nullptr),
+    m_hash(hash),
+    m_size(0) {
+  SHA1_Init(&m_sha);
+}
+
+Output::Output(std::string &buffer, bool hash) :
+    m_fd(-1),
+    m_buffer(&buffer),
+    m_hash(hash),
+    m_size(0) {
+  SHA1_Init(&m_sha);
+}
+
+bool Output::Write(const void *data, std::size_t size) {
+  if (m_buffer)
+    m_buffer->append((const char *) data, size);
+  else
+    for (std::size_t written = 0; written < size;) {
+      long n = write(m_fd, (const char *) data + written, size - written);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      written += n;
+    }
+  if (m_hash)
+    SHA1_Update(&m_sha, data, size);
+  m_size += size;
+  return true;
+}
+
+uint64_t Output::Size() const {
+  return m_size;
+}
+
+std::string Output::Sha1() {
+  return HexDigest(m_sha);
+}
+
+int UnrealGo::ZipStream::Deflate(Input &in, Output &out, int level) {
+  return DeflateStream(in, out, level, MAX_WBITS, nullptr);
+}
+
+int UnrealGo::ZipStream::Inflate(Input &in, Output &out) {
+  Reader reader(in);
+  return InflateStream(reader, out, MAX_WBITS, nullptr);
+}
+
+int UnrealGo::ZipStream::WriteZip(const std::vector<std::string> &files,
+                                  Output &out, int level) {
+  const uint64_t base = out.Size();
+  std::string central;
+  if (files.size() > 0xffff)
+    return Z_DATA_ERROR;
+  for (const std::string &file : files) {
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      if (fd >= 0)
+        close(fd);
+      printf("error in opening %s for reading\n", file.c_str());
+      return Z_ERRNO;
+    }
+    const std::string name = FileNameNoPath(file);
+    uint16_t dosTime, dosDate;
+    DosTime(st.st_mtime, dosTime, dosDate);
+    const uint64_t offset = out.Size() - base;
+
+    // CRC and sizes are not known yet; they follow the data
+    std::string header;
+    Put32(header, LOCAL_HEADER);
+    Put16(header, 20);
+    Put16(header, FLAG_DATA_DESCRIPTOR);
+    Put16(header, METHOD_DEFLATED);
+    Put16(header, dosTime);
+    Put16(header, dosDate);
+    Put32(header, 0);
+    Put32(header, 0);
+    Put32(header, 0);
+    Put16(header, (uint16_t) name.size());
+    Put16(header, 0);
+    header += name;
+    if (!out.Write(header.data(), header.size())) {
+      close(fd);
+      return Z_ERRNO;
+    }
+
+    Input in(fd, false);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    const uint64_t dataBegin = out.Size();
+    int ret = DeflateStream(in, out, level, -MAX_WBITS, &crc);
+    close(fd);
+    if (ret != Z_OK)
+      return ret;
+    const uint64_t compressedSize = out.Size() - dataBegin;
+    if (in.Size() >= 0xffffffffu || compressedSize >= 0xffffffffu || offset >= 0xffffffffu)
+      return Z_DATA_ERROR;
+
+    std::string descriptor;
+    Put32(descriptor, DATA_DESCRIPTOR);
+    Put32(descriptor, (uint32_t) crc);
+    Put32(descriptor, (uint32_t) compressedSize);
+    Put32(descriptor, (uint32_t) in.Size());
+    if (!out.Write(descriptor.data(), descriptor.size()))
+      return Z_ERRNO;
+
+    Put32(central, CENTRAL_HEADER);
+    Put16(central, (3 << 8) | 20);
+    Put16(central, 20);
+    Put16(central, FLAG_DATA_DESCRIPTOR);
+    Put16(central, METHOD_DEFLATED);
+    Put16(central, dosTime);
+    Put16(central, dosDate);
+    Put32(central, (uint32_t) crc);
+    Put32(central, (uint32_t) compressedSize);
+    Put32(central, (uint32_t) in.Size());
+    Put16(central, (uint16_t) name.size());
+    Put16(central, 0);
+    Put16(central, 0);
+    Put16(central, 0);
+    Put16(central, 0);
+    Put32(central, (uint32_t) (st.st_mode & 0xffff) << 16);
+    Put32(central, (uint32_t) offset);
+    central += name;
+  }
+  const uint64_t centralOffset = out.Size() - base;
+  const std::size_t centralSize = central.size();
+  if (centralOffset >= 0xffffffffu)
+    return Z_DATA_ERROR;
+  Put32(central, END_OF_CENTRAL_DIR);
+  Put16(central, 0);
+  Put16(central, 0);
+  Put16(central, (uint16_t) files.size());
+  Put16(central, (uint16_t) files.size());
+  Put32(central, (uint32_t) centralSize);
+  Put32(central, (uint32_t) centralOffset);
+  Put16(central, 0);
+  return out.Write(central.data(), central.size()) ? Z_OK : Z_ERRNO;
+}
+
+int UnrealGo::ZipStream::ExtractZip(Input &in, const std::string &dir,
+                                    std::vector<std::string> *extracted) {
+  Reader reader(in);
+  int ret = Z_OK;
+  // File being written, removed if its entry turns out to be bad
+  std::string partial;
+  while (ret == Z_OK) {
+    unsigned char header[30];
+    if (!reader.ReadExact(header, 4)) {
+      ret = reader.Error() ? Z_ERRNO : Z_DATA_ERROR;
+      break;
+    }
+    const uint32_t signature = Get32(header);
+    if (signature == CENTRAL_HEADER || signature == END_OF_CENTRAL_DIR)
+      break;
+    if (signature != LOCAL_HEADER || !reader.ReadExact(header + 4, 26)) {
+      ret = reader.Error() ? Z_ERRNO : Z_DATA_ERROR;
+      break;
+    }
+    const uint16_t flags = Get16(header + 6);
+    const uint16_t method = Get16(header + 8);
+    uint32_t crc = Get32(header + 14);
+    uint64_t compressedSize = Get32(header + 18);
+    std::string name(Get16(header + 26), '\0');
+    std::vector<unsigned char> extra(Get16(header + 28));
+    if (!reader.ReadExact(&name[0], name.size())
+        || !reader.ReadExact(extra.data(), extra.size())) {
+      ret = Z_DATA_ERROR;
+      break;
+    }
+    bool zip64 = false;
+    for (std::size_t pos = 0; pos + 4 <= extra.size();
+         pos += 4 + Get16(&extra[pos + 2]))
+      if (Get16(&extra[pos]) == ZIP64_EXTRA) {
+        zip64 = true;
+        // Uncompressed size, then compressed size, each only if the
+        // header field is 0xffffffff
+        std::size_t field = pos + 4;
+        if (Get32(header + 22) == 0xffffffffu)
+          field += 8;
+        if (compressedSize == 0xffffffffu && field + 8 <= extra.size())
+          compressedSize = Get64(&extra[field]);
+      }
+    if ((flags & FLAG_ENCRYPTED)
+        || (method != METHOD_STORED && method != METHOD_DEFLATED)
+        || ((flags & FLAG_DATA_DESCRIPTOR) && method == METHOD_STORED)
+        || !SafeEntryName(name)) {
+      ret = Z_DATA_ERROR;
+      break;
+    }
+
+    const std::string path = dir + "/" + name;
+    const bool isDir = name[name.size() - 1] == '/';
+    if (!MakeDirs(isDir ? path : path.substr(0, path.find_last_of('/')))) {
+      ret = Z_ERRNO;
+      break;
+    }
+    int fd = isDir ? -1 : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (!isDir && fd < 0) {
+      printf("error in opening %s for writing\n", path.c_str());
+      ret = Z_ERRNO;
+      break;
+    }
+    if (!isDir)
+      partial = path;
+    std::string ignored;
+    Output out(fd, false);
+    Output skip(ignored, false);
+    uLong actualCrc = crc32(0L, Z_NULL, 0);
+    if (method == METHOD_DEFLATED)
+      ret = InflateStream(reader, isDir ? skip : out, -MAX_WBITS, &actualCrc);
+    else
+      for (uint64_t left = compressedSize; left > 0 && ret == Z_OK;) {
+        if (!reader.Fill()) {
+          ret = reader.Error() ? Z_ERRNO : Z_DATA_ERROR;
+          break;
+        }
+        std::size_t n = (std::size_t) std::min<uint64_t>(left, reader.Available());
+        actualCrc = crc32(actualCrc, reader.Data(), (uInt) n);
+        if (!isDir && !out.Write(reader.Data(), n))
+          ret = Z_ERRNO;
+        reader.Consume(n);
+        left -= n;
+      }
+    if (fd >= 0)
+      close(fd);
+    if (ret != Z_OK)
+      break;
+
+    if (flags & FLAG_DATA_DESCRIPTOR) {
+      // The signature of the descriptor is optional
+      unsigned char descriptor[24];
+      const std::size_t sizes = zip64 ? 16 : 8;
+      if (!reader.ReadExact(descriptor, 4)
+          || (Get32(descriptor) == DATA_DESCRIPTOR && !reader.ReadExact(descriptor, 4))
+          || !reader.ReadExact(descriptor + 4, sizes)) {
+        ret = Z_DATA_ERROR;
+        break;
+      }
+      crc = Get32(descriptor);
+    }
+    if (crc != (uint32_t) actualCrc) {
+      printf("CRC error in %s\n", name.c_str());
+      ret = Z_DATA_ERROR;
+      break;
+    }
+    if (!isDir && extracted)
+      extracted->push_back(path);
+    partial.clear();
+  }
+  if (ret != Z_OK && !partial.empty())
+    unlink(partial.c_str());
+  if (ret == Z_OK)
+    reader.Drain();
+  return ret == Z_OK && reader.Error() ? Z_ERRNO : ret;
+}
@@ -0,0 +1,109 @@
+/*
+This file is part of UnrealGo.
+Copyright (C) 2017 Kevin
+UnrealGo is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+UnrealGo is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with UnrealGo.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNREALGO_ATOMZIPSTREAM_H
+#define UNREALGO_ATOMZIPSTREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include "openssl/sha.h"
+
+/** Compression between memory buffers and file descriptors in one pass.
+    Unlike AtomZIP, AtomUNZIP and CCZLib, nothing is staged in temporary
+    files, and the SHA1 of the data read or written is computed while it
+    passes through, so an archive need not be read again to hash it. */
+namespace UnrealGo {
+  namespace ZipStream {
+
+    /** Source of bytes: a file descriptor or a memory buffer. */
+    class Input {
+     public:
+      /** @param hash Compute the SHA1 of the bytes read */
+      explicit Input(int fd, bool hash = true);
+
+      Input(const void *data, std::size_t size, bool hash = true);
+
+      /** @return Bytes read, 0 at the end, -1 on error */
+      long Read(void *data, std::size_t size);
+
+      uint64_t Size() const;
+
+      /** Hex SHA1 of the bytes read so far. Ends the hash. */
+      std::string Sha1();
+
+     private:
+      int m_fd;
+      const unsigned char *m_data;
+      std::size_t m_left;
+      bool m_hash;
+      SHA_CTX m_sha;
+      uint64_t m_size;
+    };
+
+    /** Destination of bytes: a file descriptor or a memory buffer. */
+    class Output {
+     public:
+      explicit Output(int fd, bool hash = true);
+
+      explicit Output(std::string &buffer, bool hash = true);
+
+      bool Write(const void *data, std::size_t size);
+
+      uint64_t Size() const;
+
+      std::string Sha1();
+
+     private:
+      int m_fd;
+      std::string *m_buffer;
+      bool m_hash;
+      SHA_CTX m_sha;
+      uint64_t m_size;
+    };
+
+    /** Compress in to out in the zlib format, a buffer at a time.
+        @return Z_OK, or an error like CCZLib::def() */
+    int Deflate(Input &in, Output &out, int level = Z_DEFAULT_COMPRESSION);
+
+    /** @return Z_OK, or an error like CCZLib::inf() */
+    int Inflate(Input &in, Output &out);
+
+    /** Write a zip archive of files, stored under their names without
+        directories like in ZIP::compress_zip_files(). The archive is
+        written front to back: the CRC and sizes of each entry follow its
+        data, so out need not be seekable. Entries of 4 GB or more are not
+        supported.
+        @return Z_OK, Z_ERRNO if a file cannot be read or out written,
+        Z_DATA_ERROR if the archive needs zip64 */
+    int WriteZip(const std::vector<std::string> &files, Output &out,
+                 int level = Z_DEFAULT_COMPRESSION);
+
+    /** Extract a zip archive read front to back into dir. The input is read
+        to its end, so in.Sha1() then covers the whole archive. Entries with
+        ".." or absolute paths are rejected. A file whose entry fails, for
+        instance its CRC check, is removed again.
+        @param[out] extracted The paths of the files written, if not null
+        @return Z_OK, Z_DATA_ERROR if the archive is invalid or unsupported
+        (encrypted, or stored with the sizes after the data), Z_ERRNO if a
+        file cannot be written */
+    int ExtractZip(Input &in, const std::string &dir,
+                   std::vector<std::string> *extracted = nullptr);
+  }
+}
+
+#endif //UNREALGO_ATOMZIPSTREAM_H
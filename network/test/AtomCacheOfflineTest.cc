@@ -0,0 +1,140 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "../AtomCache.h"
+
+namespace {
+
+int nuFailures = 0;
+
+void Check(bool condition, const char *what) {
+  if (!condition) {
+    std::cerr << "FAILED: " << what << std::endl;
+    ++nuFailures;
+  }
+}
+
+#define CHECK(condition) Check(condition, #condition)
+
+typedef AtomCache::Range Range;
+
+void TestPlanRanges() {
+  std::vector<Range> ranges;
+  const std::int64_t mb = 1 << 20;
+  AtomCache::PlanRanges(20 * mb, true, 4, 0, ranges);
+  CHECK(ranges.size() == 4);
+  CHECK(ranges.front().begin == 0 && ranges.back().end == 20 * mb);
+  for (size_t i = 1; i < ranges.size(); ++i)
+    CHECK(ranges[i].begin == ranges[i - 1].end);
+  // Ranges are at least 4 MB
+  AtomCache::PlanRanges(9 * mb, true, 4, 0, ranges);
+  CHECK(ranges.size() == 2);
+  AtomCache::PlanRanges(mb, true, 4, 0, ranges);
+  CHECK(ranges.size() == 1 && ranges[0].end == mb && ranges[0].done == 0);
+  // No range requests or unknown length: one sequential range
+  AtomCache::PlanRanges(20 * mb, false, 4, 0, ranges);
+  CHECK(ranges.size() == 1 && ranges[0].end == 20 * mb);
+  AtomCache::PlanRanges(-1, true, 4, 0, ranges);
+  CHECK(ranges.size() == 1 && ranges[0].end == -1 && !ranges[0].Complete());
+  // A partial file without saved ranges continues sequentially
+  AtomCache::PlanRanges(20 * mb, true, 4, 3 * mb, ranges);
+  CHECK(ranges.size() == 1 && ranges[0].done == 3 * mb);
+  AtomCache::PlanRanges(mb, true, 4, 2 * mb, ranges);
+  CHECK(ranges.size() == 1 && ranges[0].Complete());
+}
+
+void WriteFile(const std::string &fileName, const std::string &content) {
+  std::ofstream out(fileName.c_str());
+  out << content;
+}
+
+void TestLoadRanges(const std::string &dir) {
+  const std::string fileName = dir + "/test.ranges";
+  std::vector<Range> ranges;
+  CHECK(!AtomCache::LoadRanges(fileName, 100, ranges));
+  const Range saved[] = {{0, 40, 10}, {40, 70, 30}, {70, 100, 0}};
+  CHECK(AtomCache::SaveRanges(fileName, 100,
+                              std::vector<Range>(saved, saved + 3)));
+  CHECK(AtomCache::LoadRanges(fileName, 100, ranges));
+  CHECK(ranges.size() == 3);
+  for (size_t i = 0; i < ranges.size() && i < 3; ++i)
+    CHECK(ranges[i].begin == saved[i].begin && ranges[i].end == saved[i].end
+          && ranges[i].done == saved[i].done);
+  CHECK(ranges[1].Complete() && !ranges[0].Complete());
+  // Saved for a file of another length
+  ranges.clear();
+  CHECK(!AtomCache::LoadRanges(fileName, 101, ranges));
+  CHECK(ranges.empty());
+  // Truncated, with a gap, or with more done than the range holds
+  WriteFile(fileName, "100 3\n0 40 10\n40 70 30\n");
+  CHECK(!AtomCache::LoadRanges(fileName, 100, ranges));
+  WriteFile(fileName, "100 2\n0 40 10\n50 100 0\n");
+  CHECK(!AtomCache::LoadRanges(fileName, 100, ranges));
+  WriteFile(fileName, "100 1\n0 100 101\n");
+  CHECK(!AtomCache::LoadRanges(fileName, 100, ranges));
+  WriteFile(fileName, "garbage");
+  CHECK(!AtomCache::LoadRanges(fileName, 100, ranges));
+  remove(fileName.c_str());
+}
+
+std::string Sha1Name(char c) {
+  return std::string(40, c);
+}
+
+void AddEntry(const std::string &dir, char c, size_t size, time_t time) {
+  const std::string path = dir + "/" + Sha1Name(c);
+  WriteFile(path, std::string(size, 'x'));
+  struct timeval times[2] = {{time, 0}, {time, 0}};
+  utimes(path.c_str(), times);
+}
+
+void TestEvict(const std::string &dir) {
+  const time_t now = time(nullptr);
+  {
+    AtomCache cache(dir, 1, 2);
+    AddEntry(dir, 'a', 10, now - 300);
+    AddEntry(dir, 'b', 10, now - 200);
+    AddEntry(dir, 'c', 10, now - 100);
+    WriteFile(dir + "/" + Sha1Name('d') + ".part", "partial");
+    // A hit in the cache makes a the most recent file
+    std::string path;
+    CHECK(cache.Fetch("http://unused.invalid/a", Sha1Name('a'), path));
+    cache.Evict();
+    CHECK(cache.Contains(Sha1Name('a')));
+    CHECK(!cache.Contains(Sha1Name('b')));
+    CHECK(cache.Contains(Sha1Name('c')));
+    struct stat st;
+    CHECK(stat((dir + "/" + Sha1Name('d') + ".part").c_str(), &st) == 0);
+  }
+  {
+    AtomCache cache(dir, 1, 0, 15);
+    // The kept file is never removed, even if it is the oldest
+    cache.Evict(cache.Path(Sha1Name('c')));
+    CHECK(!cache.Contains(Sha1Name('a')));
+    CHECK(cache.Contains(Sha1Name('c')));
+  }
+  remove((dir + "/" + Sha1Name('c')).c_str());
+  remove((dir + "/" + Sha1Name('d') + ".part").c_str());
+}
+
+}
+
+/** Tests of AtomCache that need no network. */
+int main() {
+  char dirName[] = "/tmp/AtomCacheOfflineTestXXXXXX";
+  if (!mkdtemp(dirName))
+    return 1;
+  const std::string dir = dirName;
+  TestPlanRanges();
+  TestLoadRanges(dir);
+  TestEvict(dir);
+  rmdir(dirName);
+  std::cout << (nuFailures == 0 ? "ok" : "failed") << std::endl;
+  return nuFailures == 0 ? 0 : 1;
+}
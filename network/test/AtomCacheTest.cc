@@ -0,0 +1,16 @@
+#include <iostream>
+#include "../AtomCache.h"
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: AtomCacheTest url sha1 [cachedir]" << std::endl;
+    return 1;
+  }
+  AtomCache cache(argc > 3 ? argv[3] : "checkpoint_cache");
+  std::string path;
+  bool ok = cache.Fetch(argv[1], argv[2], path);
+  std::cout << ok << " " << path << std::endl;
+  // Fetching again is answered by the cache
+  ok = ok && cache.Fetch(argv[1], argv[2], path);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include "../AtomHash.h"
+#include "../AtomZipStream.h"
+
+using namespace UnrealGo::ZipStream;
+
+/** Zip the files given as arguments into memory and into a file, check that
+    the fused SHA1 matches the one of the file, and extract both archives.
+    Then check that a corrupted archive leaves no partial file. */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    std::cerr << "usage: AtomZipStreamTest outdir file..." << std::endl;
+    return 1;
+  }
+  const std::string dir = argv[1];
+  std::vector<std::string> files(argv + 2, argv + argc);
+
+  std::string buffer;
+  Output memory(buffer);
+  if (WriteZip(files, memory) != Z_OK)
+    return 1;
+  const std::string zipName = dir + ".zip";
+  int fd = open(zipName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  Output file(fd);
+  int ret = WriteZip(files, file);
+  close(fd);
+  char sha1Buf[SHA1HEXLEN];
+  UnrealGo::Hash::sha1(zipName, sha1Buf);
+  const std::string sha1 = file.Sha1();
+  std::cout << zipName << " " << sha1 << std::endl;
+  if (ret != Z_OK || sha1 != sha1Buf || memory.Sha1() != sha1)
+    return 1;
+
+  Input in(buffer.data(), buffer.size());
+  std::vector<std::string> extracted;
+  if (ExtractZip(in, dir, &extracted) != Z_OK || in.Sha1() != sha1)
+    return 1;
+  for (const std::string &name : extracted)
+    std::cout << name << std::endl;
+  if (extracted.size() != files.size())
+    return 1;
+
+  // A corrupt first entry fails and leaves no partial file
+  std::string corrupt = buffer;
+  const std::size_t data = 30 + (unsigned char) corrupt[26]
+      + 256 * (unsigned char) corrupt[27] + (unsigned char) corrupt[28]
+      + 256 * (unsigned char) corrupt[29];
+  corrupt[data + 1] ^= 0x55;
+  Input bad(corrupt.data(), corrupt.size());
+  const std::string badDir = dir + "_corrupt";
+  std::vector<std::string> none;
+  if (ExtractZip(bad, badDir, &none) == Z_OK || !none.empty())
+    return 1;
+  const std::string first = badDir + extracted[0].substr(dir.size());
+  return access(first.c_str(), F_OK) != 0 ? 0 : 1;
+}
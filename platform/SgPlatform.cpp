@@ -8,10 +8,14 @@
 #endif
 #include <windows.h>
 #else
+#include <sys/mman.h>
 #include <unistd.h>
 #include <lib/FileUtil.h>
 #endif
 
+#include <cstdlib>
+#include <new>
+
 #ifdef HAVE_SYS_SYSCTL_H
 #include <sys/sysctl.h>
 #endif
@@ -78,6 +82,59 @@ std::size_t SgPlatform::TotalMemory() {
 }
 
 
+namespace {
+
+const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+std::size_t HugePageRoundUp(std::size_t size) {
+  return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+}
+
+void *SgPlatform::AllocateLarge(std::size_t size) {
+  void *p = 0;
+#if defined WIN32
+  p = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+#ifdef MAP_ANONYMOUS
+  if (size >= HUGE_PAGE_SIZE) {
+    // Whole huge pages, so the kernel can back all of the mapping with them
+    size = HugePageRoundUp(size);
+    p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+             -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    madvise(p, size, MADV_HUGEPAGE);
+#endif
+    return p;
+  }
+#endif
+  p = std::calloc(1, size);
+#endif
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void SgPlatform::FreeLarge(void *p, std::size_t size) {
+  if (!p)
+    return;
+#if defined WIN32
+  static_cast<void>(size);
+  VirtualFree(p, 0, MEM_RELEASE);
+#else
+#ifdef MAP_ANONYMOUS
+  if (size >= HUGE_PAGE_SIZE) {
+    munmap(p, HugePageRoundUp(size));
+    return;
+  }
+#endif
+  std::free(p);
+#endif
+}
+
 /** Get a default value for lock-free mode.
     Lock-free mode works only on IA-32/Intel-64 architectures or if the macro
     ENABLE_CACHE_SYNC from configure script is defined. The
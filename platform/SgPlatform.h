@@ -13,6 +13,14 @@ namespace SgPlatform {
   void SetTopSourceDir(const boost::filesystem::path &dir);
   std::size_t TotalMemory();
 
+  /** Allocate zero-initialized memory for a large table.
+      Allocations of at least 2 MB are mapped with transparent huge pages
+      where the OS supports it, which saves TLB misses in multi-GB hash
+      tables. Free with FreeLarge() and the same size. */
+  void *AllocateLarge(std::size_t size);
+
+  void FreeLarge(void *p, std::size_t size);
+
   bool GetLockFreeDefault();
 }
 
@@ -15,6 +15,10 @@ class UctPolicyAllocator {
   float *Finish();
   const float *Finish() const;
   float *CreateOneBlock(float value = 0.0f);
+  /** Bytes allocated by SetMaxPolicies(). */
+  std::size_t MemoryReserved() const;
+  /** Bytes of the blocks created since Clear(). */
+  std::size_t MemoryUsed() const;
 
  private:
   float *m_start;
@@ -52,6 +56,14 @@ inline const float *UctPolicyAllocator::Finish() const {
   return m_finish;
 }
 
+inline std::size_t UctPolicyAllocator::MemoryReserved() const {
+  return (m_endOfStorage - m_start) * sizeof(float);
+}
+
+inline std::size_t UctPolicyAllocator::MemoryUsed() const {
+  return (m_finish - m_start) * sizeof(float);
+}
+
 inline float *UctPolicyAllocator::CreateOneBlock(float value) {
   DBG_ASSERT(HasCapacity(1));
   float *addr = m_finish;
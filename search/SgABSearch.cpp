@@ -7,7 +7,10 @@
 #include <limits>
 #include <sstream>
 #include <math.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
 #include "platform/SgDebug.h"
+#include "SgConcurrentHashTable.h"
 #include "SgHashTable.h"
 #include "SgMath.h"
 #include "SgNode.h"
@@ -95,10 +98,23 @@ void PrintPV(const SgABSearch &search, int depth, int value,
 
 }
 
+/** Helper threads of a parallel IteratedSearch. */
+struct SgABSearchHelpers {
+  SgHelperSearchControl m_control;
+
+  vector<SgABSearch *> m_search;
+
+  boost::thread_group m_threads;
+};
+
 const int SgABSearch::SG_INFINITY = numeric_limits<int>::max();
 
 SgABSearch::SgABSearch(SgSearchHashTable *hash)
     : m_hash(hash),
+      m_sharedHash(0),
+      m_numThreads(1),
+      m_threadId(0),
+      m_helpers(0),
       m_tracer(0),
       m_currentDepth(0),
       m_useScout(false),
@@ -117,7 +133,9 @@ SgABSearch::SgABSearch(SgSearchHashTable *hash)
   InitSearch();
 }
 
-SgABSearch::~SgABSearch() {}
+SgABSearch::~SgABSearch() {
+  DBG_ASSERT(!m_helpers);
+}
 
 void SgABSearch::CallGenerate(SgVector<GoMove> *moves, int depth) {
   Generate(moves, depth);
@@ -139,9 +157,19 @@ void SgABSearch::InitSearch(int startDepth) {
   }
 }
 
+void SgABSearch::ClearHash() {
+  if (m_sharedHash)
+    m_sharedHash->Clear();
+  else if (m_hash)
+    m_hash->Clear();
+}
+
 bool SgABSearch::LookupHash(SgSearchHashData &data) const {
   DBG_ASSERT(!data.IsValid());
-  if (m_hash == 0 || !m_hash->Lookup(GetHashCode(), &data))
+  if (m_sharedHash) {
+    if (!m_sharedHash->Lookup(GetHashCode(), &data))
+      return false;
+  } else if (m_hash == 0 || !m_hash->Lookup(GetHashCode(), &data))
     return false;
   if (DEBUG_SEARCH) {
     SgDebug() << "SgABSearch::LookupHash: " << GetHashCode() << ' ';
@@ -161,9 +189,16 @@ void SgABSearch::SetProbCut(SgProbCut *probcut) {
   m_probcut = probcut;
 }
 
+void SgABSearch::StoreHashData(const SgSearchHashData &data) {
+  if (m_sharedHash)
+    m_sharedHash->Store(GetHashCode(), data);
+  else
+    m_hash->Store(GetHashCode(), data);
+}
+
 void SgABSearch::StoreHash(int depth, int value, GoMove move,
                            bool isUpperBound, bool isLowerBound, bool isExact) {
-  DBG_ASSERT(m_hash);
+  DBG_ASSERT(HasHash());
   SgSearchHashData data(depth, value, move, isUpperBound, isLowerBound,
                         isExact);
   if (DEBUG_SEARCH) {
@@ -171,7 +206,7 @@ void SgABSearch::StoreHash(int depth, int value, GoMove move,
               << ": ";
     WriteSgSearchHashData(SgDebug(), *this, data);
   }
-  m_hash->Store(GetHashCode(), data);
+  StoreHashData(data);
 }
 
 bool SgABSearch::TraceIsOn() const {
@@ -271,7 +306,7 @@ void SgABSearch::CreateTracer() {
 }
 
 void SgABSearch::AddSequenceToHash(const SgVector<GoMove> &sequence, int depth) {
-  if (!m_hash)
+  if (!HasHash())
     return;
   int numMovesToUndo = 0;
   for (SgVectorIterator<GoMove> iter(sequence); iter; ++iter) {
@@ -281,7 +316,7 @@ void SgABSearch::AddSequenceToHash(const SgVector<GoMove> &sequence, int depth)
       CallTakeBack();
       SgSearchHashData data(0, 0, move);
       DBG_ASSERT(move != GO_NULLMOVE);
-      m_hash->Store(GetHashCode(), data);
+      StoreHashData(data);
       if (DEBUG_SEARCH)
         SgDebug() << "SgABSearch::AddSequenceToHash: "
                   << MoveString(move) << '\n';
@@ -324,8 +359,8 @@ int SgABSearch::DepthFirstSearch(int depthLimit, int boundLo, int boundHi,
     m_tracer->InitTracing("DepthFirstSearch");
   }
   StartTime();
-  if (clearHash && m_hash) {
-    m_hash->Clear();
+  if (clearHash && HasHash()) {
+    ClearHash();
     AddSequenceToHash(*sequence, 0);
   }
   m_depthLimit = 0;
@@ -348,10 +383,11 @@ int SgABSearch::IteratedSearch(int depthMin, int depthMax, int boundLo,
     m_tracer->InitTracing("IteratedSearch");
   }
   StartTime();
-  if (clearHash && m_hash) {
-    m_hash->Clear();
+  if (clearHash && HasHash()) {
+    ClearHash();
     AddSequenceToHash(*sequence, 0);
   }
+  StartHelpers(depthMin, depthMax, boundLo, boundHi);
 
   int value = 0;
   m_depthLimit = depthMin;
@@ -398,12 +434,66 @@ int SgABSearch::IteratedSearch(int depthMin, int depthMax, int boundLo,
       && (!CheckDepthLimitReached() || m_reachedDepthLimit)
       );
 
+  StopHelpers();
   StopTime();
   if (m_tracer && traceNode)
     m_tracer->AppendTrace(traceNode);
   return value;
 }
 
+void SgABSearch::StartHelpers(int depthMin, int depthMax, int boundLo,
+                              int boundHi) {
+  DBG_ASSERT(!m_helpers);
+  if (!m_sharedHash || m_numThreads <= 1)
+    return;
+  m_helpers = new SgABSearchHelpers();
+  for (int i = 1; i < m_numThreads; ++i) {
+    SgABSearch *helper = Clone();
+    if (!helper)
+      break;
+    helper->m_hash = 0;
+    helper->m_sharedHash = m_sharedHash;
+    helper->m_numThreads = 1;
+    helper->m_threadId = i;
+    helper->m_control = &m_helpers->m_control;
+    helper->m_useScout = m_useScout;
+    helper->m_useKillers = m_useKillers;
+    helper->m_useOpponentBest = m_useOpponentBest;
+    helper->m_useNullMove = m_useNullMove;
+    helper->m_nullMoveDepth = m_nullMoveDepth;
+    helper->m_abortFrequency = m_abortFrequency;
+    m_helpers->m_search.push_back(helper);
+  }
+  for (size_t i = 0; i < m_helpers->m_search.size(); ++i) {
+    // Every second helper searches one ply deeper than the main thread
+    const int depthOffset = (i + 1) % 2;
+    m_helpers->m_threads.create_thread(
+        boost::bind(&SgABSearch::RunHelper, m_helpers->m_search[i],
+                    min(depthMin + depthOffset, depthMax), depthMax,
+                    boundLo, boundHi));
+  }
+}
+
+void SgABSearch::StopHelpers() {
+  m_helperStat.Clear();
+  if (!m_helpers)
+    return;
+  m_helpers->m_control.Stop();
+  m_helpers->m_threads.join_all();
+  for (size_t i = 0; i < m_helpers->m_search.size(); ++i) {
+    m_helperStat += m_helpers->m_search[i]->m_stat;
+    delete m_helpers->m_search[i];
+  }
+  delete m_helpers;
+  m_helpers = 0;
+}
+
+void SgABSearch::RunHelper(int depthMin, int depthMax, int boundLo,
+                           int boundHi) {
+  SgVector<GoMove> sequence;
+  IteratedSearch(depthMin, depthMax, boundLo, boundHi, &sequence, false);
+}
+
 bool SgABSearch::TryMove(GoMove move, const SgVector<GoMove> &specialMoves,
                          const int depth,
                          const int alpha, const int beta,
@@ -631,6 +721,10 @@ int SgABSearch::SearchEngine(int depth, int alpha, int beta,
     SgVector<GoMove> moves;
     if (!foundCutoff && !m_aborted) {
       CallGenerate(&moves, depth);
+      if (m_threadId > 0 && m_currentDepth < 2 && moves.Length() > 1) {
+        vector<GoMove> &v = moves.Vector();
+        rotate(v.begin(), v.begin() + m_threadId % v.size(), v.end());
+      }
       for (SgVectorIterator<GoMove> it(moves); it && !foundCutoff; ++it) {
         if (TryMove(*it, specialMoves,
                     depth, alpha, beta,
@@ -668,7 +762,7 @@ int SgABSearch::SearchEngine(int depth, int alpha, int beta,
     isSolved = solvedByEval
         || SgSearchValue::IsSolved(loValue)
         || (hasMove && allExact);
-    if (m_hash
+    if (HasHash()
         && !m_aborted
         && (isSolved || stack.NonEmpty())
         ) {
@@ -13,6 +13,8 @@
 
 template<class DATA, int BLOCK_SIZE>
 class SgHashTable;
+template<class DATA, int BLOCK_SIZE>
+class SgConcurrentHashTable;
 class SgNode;
 class SgProbCut;
 class SgSearchControl;
@@ -54,7 +56,6 @@ class SgSearchHashData {
                    bool isOnlyUpperBound = false,
                    bool isOnlyLowerBound = false,
                    bool isExactValue = false);
-  ~SgSearchHashData();
   int Depth() const;
   int Value() const;
   GoMove BestMove() const;
@@ -78,6 +79,9 @@ class SgSearchHashData {
 };
 typedef SgHashTable<SgSearchHashData, 4> SgSearchHashTable;
 
+/** Hash table shared by the threads of a parallel SgABSearch. */
+typedef SgConcurrentHashTable<SgSearchHashData, 4> SgSearchSharedHashTable;
+
 inline SgSearchHashData::SgSearchHashData()
     : m_depth(0),
       m_isUpperBound(0),
@@ -103,8 +107,6 @@ inline SgSearchHashData::SgSearchHashData(int depth, signed value,
   DBG_ASSERT(m_value == value);
 }
 
-inline SgSearchHashData::~SgSearchHashData() {}
-
 inline int SgSearchHashData::Depth() const {
   return static_cast<int> (m_depth);
 }
@@ -156,6 +158,8 @@ static const int MAX_DEPTH = 256;
 }
 typedef SgStack<GoMove, SgSearchLimit::MAX_DEPTH> SgSearchStack;
 
+struct SgABSearchHelpers;
+
 
 class SgABSearch {
  public:
@@ -172,6 +176,27 @@ class SgABSearch {
   virtual bool CheckDepthLimitReached() const = 0;
   const SgSearchHashTable *HashTable() const;
   void SetHashTable(SgSearchHashTable *hashtable);
+
+  const SgSearchSharedHashTable *SharedHashTable() const;
+
+  /** Use a table that can be shared between threads instead of the
+      SgSearchHashTable. Needed for a search with several threads. */
+  void SetSharedHashTable(SgSearchSharedHashTable *hashtable);
+
+  int NumThreads() const;
+
+  /** Number of threads of IteratedSearch with a shared hash table.
+      Lazy SMP: NumThreads() - 1 helper threads run the same iterated
+      search on copies made by Clone(), sharing the hash table. Every
+      second helper starts one depth deeper, and helper i rotates the move
+      lists of the first two plies by i, so the helpers fill the table
+      with different subtrees. The value and sequence are those of the
+      main thread; the helpers stop when it is done. */
+  void SetNumThreads(int numThreads);
+
+  /** Copy of the search in the current position for a helper thread.
+      The default returns 0, which restricts the search to one thread. */
+  virtual SgABSearch *Clone() const;
   const SgSearchControl *SearchControl() const;
   
   void SetSearchControl(SgSearchControl *control);
@@ -217,6 +242,11 @@ class SgABSearch {
     return m_stat;
   }
 
+  /** Sum of the statistics of the helper threads of the last search. */
+  const SgSearchStatistics &HelperStatistics() const {
+    return m_helperStat;
+  }
+
   
   void StartTime();
   
@@ -260,6 +290,17 @@ class SgABSearch {
  private:
   
   SgSearchHashTable *m_hash;
+
+  SgSearchSharedHashTable *m_sharedHash;
+
+  int m_numThreads;
+
+  /** 0 for the main thread, 1.. for helper threads. */
+  int m_threadId;
+
+  SgABSearchHelpers *m_helpers;
+
+  SgSearchStatistics m_helperStat;
   
   SgSearchTracer *m_tracer;
   
@@ -298,7 +339,19 @@ class SgABSearch {
   int DFS(int startDepth, int depthLimit, int boundLo, int boundHi,
           SgVector<GoMove> *sequence, bool *isExactValue);
   
+  bool HasHash() const;
+
+  void ClearHash();
+
   bool LookupHash(SgSearchHashData &data) const;
+
+  void StoreHashData(const SgSearchHashData &data);
+
+  void StartHelpers(int depthMin, int depthMax, int boundLo, int boundHi);
+
+  void StopHelpers();
+
+  void RunHelper(int depthMin, int depthMax, int boundLo, int boundHi);
   bool NullMovePrune(int depth, int delta, int beta);
   
   void StoreHash(int depth, int value, GoMove move, bool isUpperBound,
@@ -356,6 +409,32 @@ inline void SgABSearch::SetHashTable(SgSearchHashTable *hashtable) {
   m_hash = hashtable;
 }
 
+inline const SgSearchSharedHashTable *SgABSearch::SharedHashTable() const {
+  return m_sharedHash;
+}
+
+inline void
+SgABSearch::SetSharedHashTable(SgSearchSharedHashTable *hashtable) {
+  m_sharedHash = hashtable;
+}
+
+inline int SgABSearch::NumThreads() const {
+  return m_numThreads;
+}
+
+inline void SgABSearch::SetNumThreads(int numThreads) {
+  DBG_ASSERT(numThreads >= 1);
+  m_numThreads = numThreads;
+}
+
+inline SgABSearch *SgABSearch::Clone() const {
+  return 0;
+}
+
+inline bool SgABSearch::HasHash() const {
+  return m_hash != 0 || m_sharedHash != 0;
+}
+
 inline int SgABSearch::IteratedSearchDepthLimit() const {
   return m_depthLimit;
 }
@@ -4,6 +4,9 @@
 #include "SgSearchTracer.h"
 
 #include <cmath>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include "platform/SgDebug.h"
 #include "board/SgWrite.h"
 
@@ -31,18 +34,76 @@ void DfpnBounds::CheckConsistency() const {
 
 DfpnChildren::DfpnChildren() {}
 
+/** State shared by the threads of a parallel search. */
+struct DfpnParallelSearch {
+  explicit DfpnParallelSearch(int maxHash);
+
+  ~DfpnParallelSearch();
+
+  void Enter(const SgHashCode &code);
+
+  void Leave(const SgHashCode &code);
+
+  /** Number of threads between Enter() and Leave() for this position or a
+      position with the same index. */
+  unsigned NuBusy(const SgHashCode &code) const;
+
+  /** Set when one thread has solved the root or the search was aborted. */
+  std::atomic<bool> m_stop;
+
+  boost::mutex m_mutex;
+
+  /** Root data of the first thread that solved the root. Written to the
+      table again after the search, because a thread that still worked on
+      the root may have overwritten it. */
+  DfpnData m_root;
+
+  std::atomic<unsigned> *m_busy;
+
+  int m_maxHash;
+};
+
+DfpnParallelSearch::DfpnParallelSearch(int maxHash)
+    : m_stop(false),
+      m_busy(new std::atomic<unsigned>[maxHash]),
+      m_maxHash(maxHash) {
+  for (int i = 0; i < m_maxHash; ++i)
+    m_busy[i].store(0, std::memory_order_relaxed);
+}
+
+DfpnParallelSearch::~DfpnParallelSearch() {
+  delete[] m_busy;
+}
+
+inline void DfpnParallelSearch::Enter(const SgHashCode &code) {
+  m_busy[code.Hash(m_maxHash)].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void DfpnParallelSearch::Leave(const SgHashCode &code) {
+  m_busy[code.Hash(m_maxHash)].fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline unsigned DfpnParallelSearch::NuBusy(const SgHashCode &code) const {
+  return m_busy[code.Hash(m_maxHash)].load(std::memory_order_relaxed);
+}
+
 DfpnSolver::DfpnSolver()
     : m_hashTable(0),
+      m_sharedTable(0),
+      m_parallel(0),
       m_timelimit(0.0),
       m_wideningBase(1),
       m_wideningFactor(0.25f),
-      m_epsilon(0.0f) {}
+      m_epsilon(0.0f),
+      m_numThreads(1) {}
 
 DfpnSolver::~DfpnSolver() {}
 
 bool DfpnSolver::CheckAbort() {
   if (!m_aborted) {
-    if (ForceAbort()) {
+    if (m_parallel && m_parallel->m_stop.load(std::memory_order_relaxed))
+      m_aborted = true;
+    else if (ForceAbort()) {
       m_aborted = true;
       SgDebug() << "DfpnSolver::CheckAbort(): Abort flag!\n";
     } else if (m_timelimit > 0) {
@@ -61,10 +122,25 @@ bool DfpnSolver::CheckAbort() {
       } else
         --m_checkTimerAbortCalls;
     }
+    if (m_aborted && m_parallel)
+      m_parallel->m_stop.store(true, std::memory_order_relaxed);
   }
   return m_aborted;
 }
 
+void DfpnSolver::ClearStatistics() {
+  m_aborted = false;
+  m_numTerminal = 0;
+  m_numMIDcalls = 0;
+  m_generateMoves = 0;
+  m_totalWastedWork = 0;
+  m_prunedSiblingStats.Clear();
+  m_moveOrderingPercent.Clear();
+  m_moveOrderingIndex.Clear();
+  m_deltaIncrease.Clear();
+  m_checkTimerAbortCalls = 0;
+}
+
 void DfpnSolver::GetPVFromHash(PointSequence &pv) {
   int nuMoves = 0;
   for (;; ++nuMoves) {
@@ -87,6 +163,12 @@ void DfpnSolver::LookupChildDataNonConst(GoMove move, DfpnData &data) {
     data.m_bounds.delta = 1;
     data.m_work = 0;
   }
+  if (m_parallel && !data.m_bounds.IsSolved()) {
+    const unsigned nuBusy = m_parallel->NuBusy(Hash());
+    if (nuBusy > 0)
+      data.m_bounds.delta = std::min(data.m_bounds.delta + nuBusy,
+                                     DfpnBounds::MAX_WORK);
+  }
   UndoMove();
 }
 
@@ -131,6 +213,8 @@ size_t DfpnSolver::MID(const DfpnBounds &maxBounds, DfpnHistory &history) {
   }
 
   ++m_generateMoves;
+  if (m_parallel)
+    m_parallel->Enter(Hash());
   DfpnChildren children;
   GenerateChildren(children.Children());
   std::vector<DfpnData> childrenData(children.Size());
@@ -169,8 +253,11 @@ size_t DfpnSolver::MID(const DfpnBounds &maxBounds, DfpnHistory &history) {
       m_moveOrderingIndex.Add(float(bestIndex));
       m_moveOrderingPercent.Add(float(bestIndex)
                                     / (float) childrenData.size());
-      m_totalWastedWork += prevWork + localWork
-          - childrenData[bestIndex].m_work;
+      // Can be negative in a parallel search, the child work includes the
+      // work of other threads
+      if (prevWork + localWork > childrenData[bestIndex].m_work)
+        m_totalWastedWork += prevWork + localWork
+            - childrenData[bestIndex].m_work;
     } else if (childrenData[bestIndex].m_bounds.IsWinning())
       maxChildIndex = ComputeMaxChildIndex(childrenData);
 
@@ -195,7 +282,16 @@ size_t DfpnSolver::MID(const DfpnBounds &maxBounds, DfpnHistory &history) {
       }
     }
   }
-  TTWrite(DfpnData(currentBounds, bestMove, localWork + prevWork));
+  const DfpnData result(currentBounds, bestMove, localWork + prevWork);
+  if (m_parallel) {
+    m_parallel->Leave(currentHash);
+    if (history.Depth() == 0 && currentBounds.IsSolved()) {
+      boost::mutex::scoped_lock lock(m_parallel->m_mutex);
+      if (!m_parallel->m_root.IsValid())
+        m_parallel->m_root = result;
+    }
+  }
+  TTWrite(result);
   return localWork;
 }
 
@@ -264,6 +360,8 @@ void DfpnSolver::PrintStatistics(SgEmptyBlackWhite winner,
   os << '\n';
   if (m_hashTable)
     os << '\n' << *m_hashTable << '\n';
+  if (m_sharedTable)
+    os << '\n' << *m_sharedTable << '\n';
   SgDebug() << os.str();
 }
 
@@ -297,17 +395,9 @@ SgEmptyBlackWhite DfpnSolver::StartSearch(DfpnHashTable &hashTable,
 SgEmptyBlackWhite DfpnSolver::StartSearch(DfpnHashTable &hashTable,
                                           PointSequence &pv,
                                           const DfpnBounds &maxBounds) {
-  m_aborted = false;
   m_hashTable = &hashTable;
-  m_numTerminal = 0;
-  m_numMIDcalls = 0;
-  m_generateMoves = 0;
-  m_totalWastedWork = 0;
-  m_prunedSiblingStats.Clear();
-  m_moveOrderingPercent.Clear();
-  m_moveOrderingIndex.Clear();
-  m_deltaIncrease.Clear();
-  m_checkTimerAbortCalls = 0;
+  m_sharedTable = 0;
+  ClearStatistics();
   DfpnData data;
   if (TTRead(data) && data.m_bounds.IsSolved()) {
     SgDebug() << "Already solved!\n";
@@ -337,6 +427,84 @@ SgEmptyBlackWhite DfpnSolver::StartSearch(DfpnHashTable &hashTable,
   return winner;
 }
 
+SgEmptyBlackWhite DfpnSolver::StartSearch(DfpnSharedHashTable &hashTable,
+                                          PointSequence &pv) {
+  return StartSearch(hashTable, pv,
+                     DfpnBounds(DfpnBounds::MAX_WORK, DfpnBounds::MAX_WORK));
+}
+
+SgEmptyBlackWhite DfpnSolver::StartSearch(DfpnSharedHashTable &hashTable,
+                                          PointSequence &pv,
+                                          const DfpnBounds &maxBounds) {
+  m_hashTable = 0;
+  m_sharedTable = &hashTable;
+  ClearStatistics();
+  DfpnData data;
+  if (TTRead(data) && data.m_bounds.IsSolved()) {
+    SgDebug() << "Already solved!\n";
+    const SgEmptyBlackWhite toPlay = GetColorToMove();
+    SgEmptyBlackWhite w = Winner(data.m_bounds.IsWinning(), toPlay);
+    GetPVFromHash(pv);
+    SgDebug() << SgEBW(w) << " wins!\n";
+    WriteMoveSequence(SgDebug(), pv);
+    return w;
+  }
+
+  DfpnParallelSearch parallel(hashTable.MaxHash());
+  std::vector<DfpnSolver *> helpers;
+  for (int i = 1; i < m_numThreads; ++i) {
+    DfpnSolver *helper = Clone();
+    if (!helper)
+      break;
+    helper->m_sharedTable = &hashTable;
+    helper->m_parallel = &parallel;
+    helper->m_timelimit = m_timelimit;
+    helper->m_wideningBase = m_wideningBase;
+    helper->m_wideningFactor = m_wideningFactor;
+    helper->m_epsilon = m_epsilon;
+    helper->ClearStatistics();
+    helpers.push_back(helper);
+  }
+  m_parallel = &parallel;
+  boost::thread_group threads;
+  for (std::size_t i = 0; i < helpers.size(); ++i)
+    threads.create_thread(boost::bind(&DfpnSolver::RunParallel, helpers[i],
+                                      maxBounds));
+  RunParallel(maxBounds);
+  threads.join_all();
+  m_parallel = 0;
+  const bool aborted = m_aborted && !parallel.m_root.IsValid();
+  for (std::size_t i = 0; i < helpers.size(); ++i) {
+    m_numTerminal += helpers[i]->m_numTerminal;
+    m_numMIDcalls += helpers[i]->m_numMIDcalls;
+    m_generateMoves += helpers[i]->m_generateMoves;
+    m_totalWastedWork += helpers[i]->m_totalWastedWork;
+    delete helpers[i];
+  }
+  if (parallel.m_root.IsValid())
+    TTWrite(parallel.m_root);
+
+  GetPVFromHash(pv);
+  SgEmptyBlackWhite winner = SG_EMPTY;
+  if (TTRead(data) && data.m_bounds.IsSolved()) {
+    const SgEmptyBlackWhite toPlay = GetColorToMove();
+    winner = Winner(data.m_bounds.IsWinning(), toPlay);
+  }
+  PrintStatistics(winner, pv);
+
+  if (aborted)
+    SgWarning() << "Search aborted.\n";
+  return winner;
+}
+
+void DfpnSolver::RunParallel(const DfpnBounds &maxBounds) {
+  m_timer.Start();
+  DfpnHistory history;
+  MID(maxBounds, history);
+  m_parallel->m_stop.store(true, std::memory_order_relaxed);
+  m_timer.Stop();
+}
+
 void DfpnSolver::UpdateBounds(DfpnBounds &bounds,
                               const std::vector<DfpnData> &childData,
                               size_t maxChildIndex) const {
@@ -4,10 +4,13 @@
 
 #include "board/GoBoardColor.h"
 #include "SgHashTable.h"
+#include "SgConcurrentHashTable.h"
 #include "SgStatistics.h"
 #include "platform/SgTimer.h"
 #include "SgSearchTracer.h"
 
+#include <atomic>
+#include <cstdint>
 #include <limits>
 #include <ostream>
 #include <boost/scoped_ptr.hpp>
@@ -128,7 +131,6 @@ class DfpnData {
   size_t m_work;
   DfpnData();
   DfpnData(const DfpnBounds &bounds, GoMove bestMove, size_t work);
-  ~DfpnData();
   std::string Print() const;
 
 
@@ -150,8 +152,6 @@ inline DfpnData::DfpnData(const DfpnBounds &bounds,
       m_work(work),
       m_isValid(true) {}
 
-inline DfpnData::~DfpnData() {}
-
 inline std::string DfpnData::Print() const {
   std::ostringstream os;
   os << '['
@@ -233,6 +233,13 @@ inline GoMove DfpnHistory::LastMove() const {
 
 typedef SgHashTable<DfpnData, 4> DfpnHashTable;
 
+/** Transposition table shared by the threads of a parallel DfpnSolver.
+    DfpnSolver never replaces a solved entry by an unsolved one for the
+    same position. */
+typedef SgConcurrentHashTable<DfpnData, 4> DfpnSharedHashTable;
+
+struct DfpnParallelSearch;
+
 class DfpnSolver {
  public:
 
@@ -245,6 +252,19 @@ class DfpnSolver {
   StartSearch(DfpnHashTable &positions, PointSequence &pv,
               const DfpnBounds &maxBounds);
 
+  /** Search with NumThreads() threads sharing the table.
+      All threads run MID from the root (SPDFPN, Hoki et al., "A Parallel
+      Depth-First Proof-Number Search with Shared Transposition Table",
+      2013); a child that other threads are expanding looks harder to
+      disprove by the number of those threads, so the threads spread over
+      the most promising children. The helper threads search copies of
+      this solver made by Clone(). */
+  SgEmptyBlackWhite
+  StartSearch(DfpnSharedHashTable &positions, PointSequence &pv);
+  SgEmptyBlackWhite
+  StartSearch(DfpnSharedHashTable &positions, PointSequence &pv,
+              const DfpnBounds &maxBounds);
+
   bool Validate(DfpnHashTable &positions, const SgBlackWhite winner,
                 SgSearchTracer &tracer);
 
@@ -269,6 +289,12 @@ class DfpnSolver {
 
   virtual void WriteMoveSequence(std::ostream &stream,
                                  const PointSequence &sequence) const = 0;
+
+  /** Copy of the solver in the current position, used by the helper
+      threads of a parallel search. The default returns 0, which restricts
+      the parallel search to one thread. */
+  virtual DfpnSolver *Clone() const;
+
   size_t NumGenerateMovesCalls() const;
   size_t NumMIDcalls() const;
   size_t NumTerminalNodes() const;
@@ -291,9 +317,18 @@ class DfpnSolver {
 
   void SetEpsilon(float epsilon);
 
+  /** Number of threads of a search with a DfpnSharedHashTable. */
+  int NumThreads() const;
+
+  void SetNumThreads(int numThreads);
+
  private:
 
   DfpnHashTable *m_hashTable;
+
+  DfpnSharedHashTable *m_sharedTable;
+
+  DfpnParallelSearch *m_parallel;
   SgTimer m_timer;
 
   double m_timelimit;
@@ -304,6 +339,8 @@ class DfpnSolver {
 
   float m_epsilon;
 
+  int m_numThreads;
+
   size_t m_checkTimerAbortCalls;
   bool m_aborted;
   size_t m_numTerminal;
@@ -322,6 +359,8 @@ class DfpnSolver {
                     const std::vector<DfpnData> &childBounds,
                     size_t maxChildIndex) const;
   bool CheckAbort();
+  void ClearStatistics();
+  void RunParallel(const DfpnBounds &maxBounds);
   size_t ComputeMaxChildIndex(const std::vector<DfpnData> &
   childrenData) const;
   // reconstruct the pv by following the best moves in hash table.
@@ -348,6 +387,19 @@ inline float DfpnSolver::Epsilon() const {
   return m_epsilon;
 }
 
+inline DfpnSolver *DfpnSolver::Clone() const {
+  return 0;
+}
+
+inline int DfpnSolver::NumThreads() const {
+  return m_numThreads;
+}
+
+inline void DfpnSolver::SetNumThreads(int numThreads) {
+  DBG_ASSERT(numThreads >= 1);
+  m_numThreads = numThreads;
+}
+
 inline size_t DfpnSolver::NumGenerateMovesCalls() const {
   return m_generateMoves;
 }
@@ -386,6 +438,8 @@ inline double DfpnSolver::Timelimit() const {
 }
 
 inline bool DfpnSolver::TTRead(SgHashCode hash, DfpnData &data) const {
+  if (m_sharedTable)
+    return m_sharedTable->Lookup(hash, &data);
   return m_hashTable->Lookup(hash, &data);
 }
 
@@ -397,7 +451,16 @@ inline void DfpnSolver::TTWrite(const DfpnData &data) {
 #ifndef NDEBUG
   data.m_bounds.CheckConsistency();
 #endif
-  m_hashTable->Store(Hash(), data);
+  if (m_sharedTable) {
+    // Another thread may have solved the position meanwhile
+    const SgHashCode hash = Hash();
+    DfpnData old;
+    if (!data.m_bounds.IsSolved() && m_sharedTable->Lookup(hash, &old)
+        && old.m_bounds.IsSolved())
+      return;
+    m_sharedTable->Store(hash, data);
+  } else
+    m_hashTable->Store(Hash(), data);
 }
 
 inline int DfpnSolver::WideningBase() const {
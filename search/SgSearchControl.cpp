@@ -44,3 +44,20 @@ bool SgRelaxedSearchControl::Abort(double elapsedTime, int numNodes) {
       && numNodes >= MIN_NODES_PER_SECOND * m_maxTime);
 }
 
+
+SgHelperSearchControl::~SgHelperSearchControl() {}
+
+bool SgHelperSearchControl::Abort(double ignoreElapsedTime,
+                                  int ignoreNumNodes) {
+  SuppressUnused(ignoreElapsedTime);
+  SuppressUnused(ignoreNumNodes);
+  return m_stop.load(std::memory_order_relaxed);
+}
+
+bool SgHelperSearchControl::StartNextIteration(int depth, double elapsedTime,
+                                               int numNodes) {
+  SuppressUnused(depth);
+  SuppressUnused(elapsedTime);
+  SuppressUnused(numNodes);
+  return !m_stop.load(std::memory_order_relaxed);
+}
@@ -2,6 +2,8 @@
 #ifndef SG_SEARCHCONTROL_H
 #define SG_SEARCHCONTROL_H
 
+#include <atomic>
+
 class SgSearchControl {
  public:
   SgSearchControl();
@@ -110,4 +112,31 @@ class SgRelaxedSearchControl
 inline SgRelaxedSearchControl::SgRelaxedSearchControl(double maxTime)
     : m_maxTime(maxTime) {}
 
+/** Search control of the helper threads of a parallel search.
+    The helpers run until the main thread calls Stop(). */
+class SgHelperSearchControl
+    : public SgSearchControl {
+ public:
+  SgHelperSearchControl();
+  virtual ~SgHelperSearchControl();
+  virtual bool Abort(double ignoreElapsedTime, int ignoreNumNodes);
+  virtual bool StartNextIteration(int depth, double elapsedTime,
+                                  int numNodes);
+  void Stop();
+
+ private:
+  std::atomic<bool> m_stop;
+
+  SgHelperSearchControl(const SgHelperSearchControl &);
+
+  SgHelperSearchControl &operator=(const SgHelperSearchControl &);
+};
+
+inline SgHelperSearchControl::SgHelperSearchControl()
+    : m_stop(false) {}
+
+inline void SgHelperSearchControl::Stop() {
+  m_stop.store(true, std::memory_order_relaxed);
+}
+
 #endif
@@ -0,0 +1,378 @@
+//----------------------------------------------------------------------------
+/** @file SgSgfCorpus.cpp
+    See SgSgfCorpus.h */
+//----------------------------------------------------------------------------
+
+#include "platform/SgSystem.h"
+#include "SgSgfCorpus.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "board/GoPoint.h"
+
+using namespace std;
+
+namespace {
+
+/** Read-only memory mapping of a file. */
+class MappedFile {
+ public:
+  explicit MappedFile(const string& fileName)
+      : m_data(0),
+        m_size(0) {
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data != MAP_FAILED) {
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(data);
+        m_size = st.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (m_data)
+      munmap(const_cast<char*>(m_data), m_size);
+  }
+
+  const char* m_data;
+  size_t m_size;
+
+ private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+};
+
+inline bool IsUpper(char c) {
+  return 'A' <= c && c <= 'Z';
+}
+
+inline bool IsLabelChar(char c) {
+  return IsUpper(c) || ('a' <= c && c <= 'z') || ('0' <= c && c <= '9');
+}
+
+/** Label without the lower case letters of FF[3], for instance "B" for
+    "Black". */
+inline bool IsLabel(const char* label, size_t size, const char* name) {
+  for (size_t i = 0; i < size; ++i)
+    if (IsUpper(label[i]) && *name++ != label[i])
+      return false;
+  return *name == 0;
+}
+
+/** Skip a property value. pos is at the '['.
+    @return The position of the closing ']' or size */
+inline size_t SkipValue(const char* data, size_t size, size_t pos) {
+  while (++pos < size && data[pos] != ']')
+    if (data[pos] == '\\')
+      ++pos;
+  return pos < size ? pos : size;
+}
+
+/** Same conversion as SgPropUtil::SgfStringToPoint, but a point outside
+    the board is an error. */
+bool SgfToPoint(const char* value, size_t size, int boardSize,
+                GoMove& point) {
+  if (size == 0 || (size == 2 && value[0] == 't' && value[1] == 't'
+                    && boardSize <= 19)) {
+    point = GO_PASS;
+    return true;
+  }
+  if (size != 2)
+    return false;
+  const int col = value[0] - 'a' + 1;
+  const int row = value[1] - 'a' + 1;
+  if (col < 1 || col > boardSize || row < 1 || row > boardSize)
+    return false;
+  point = GoPointUtil::Pt(col, boardSize - row + 1);
+  return true;
+}
+
+/** Value of a property with the newlines removed, as in SgGameReader. */
+string ValueString(const char* value, size_t size) {
+  string s;
+  for (size_t i = 0; i < size; ++i)
+    if (value[i] != '\n')
+      s += value[i];
+  return s;
+}
+
+/** Point values of the current node. They are converted at the end of
+    the node, because SZ can follow the stones in the root node. */
+struct PendingPoint {
+  const char* m_value;
+  size_t m_size;
+  SgBlackWhite m_color;
+  bool m_isSetup;
+};
+
+bool AddPending(const vector<PendingPoint>& pending, int boardSize,
+                SgSgfCorpusGame& game, vector<SgSgfCorpusMove>& moves) {
+  for (vector<PendingPoint>::const_iterator it = pending.begin();
+       it != pending.end(); ++it) {
+    GoMove point;
+    if (!SgfToPoint(it->m_value, it->m_size, boardSize, point))
+      return false;
+    if (it->m_isSetup && point == GO_PASS)
+      return false;
+    SgSgfCorpusMove move;
+    move.m_point = static_cast<short>(point);
+    move.m_color = static_cast<signed char>(it->m_color);
+    if (it->m_isSetup) {
+      // Setup stones come before all moves
+      if (game.m_nuMoves > 0)
+        return false;
+      ++game.m_nuSetup;
+    } else
+      ++game.m_nuMoves;
+    moves.push_back(move);
+  }
+  return true;
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
+
+SgSgfCorpus::SgSgfCorpus(int defaultSize)
+    : m_defaultSize(defaultSize),
+      m_nuErrors(0) {}
+
+void SgSgfCorpus::Clear() {
+  m_nuErrors = 0;
+  m_games.clear();
+  m_moves.clear();
+}
+
+void SgSgfCorpus::SplitGames(const char* data, size_t size,
+                             vector<pair<size_t, size_t> >& games) {
+  int depth = 0;
+  size_t start = 0;
+  for (size_t pos = 0; pos < size; ++pos) {
+    const char* next;
+    switch (data[pos]) {
+      case '(':
+        if (depth++ == 0)
+          start = pos;
+        break;
+      case ')':
+        if (depth > 0 && --depth == 0)
+          games.push_back(make_pair(start, pos + 1));
+        break;
+      case '[':
+        if (depth > 0)
+          pos = SkipValue(data, size, pos);
+        break;
+      default:
+        // Text between the games cannot contain parentheses of a game
+        if (depth == 0) {
+          next = static_cast<const char*>(memchr(data + pos, '(',
+                                                 size - pos));
+          pos = (next ? next - data : size) - 1;
+        }
+    }
+  }
+  // Unterminated last game, SgGameReader reads it up to the end
+  if (depth > 0)
+    games.push_back(make_pair(start, size));
+}
+
+bool SgSgfCorpus::ParseMainLine(const char* data, size_t size,
+                                int defaultSize, SgSgfCorpusGame& game,
+                                vector<SgSgfCorpusMove>& moves) {
+  const size_t oldSize = moves.size();
+  game.m_boardSize = defaultSize;
+  game.m_komi = 0;
+  game.m_handicap = 0;
+  game.m_winner = SG_EMPTY;
+  game.m_firstSetup = oldSize;
+  game.m_nuSetup = 0;
+  game.m_firstMove = oldSize;
+  game.m_nuMoves = 0;
+  vector<PendingPoint> pending;
+  bool ok = true;
+  size_t pos = (size > 0 && data[0] == '(') ? 1 : 0;
+  // The main line is the first variation at each branch, so it ends at the
+  // first closing parenthesis
+  for (; ok && pos < size && data[pos] != ')'; ++pos) {
+    const char c = data[pos];
+    if (c == ';' || c == '(') {
+      ok = AddPending(pending, game.m_boardSize, game, moves);
+      pending.clear();
+      continue;
+    }
+    if (!IsUpper(c))
+      continue;
+    const size_t labelStart = pos;
+    while (pos < size && IsLabelChar(data[pos]))
+      ++pos;
+    const char* label = data + labelStart;
+    const size_t labelSize = pos - labelStart;
+    SgEmptyBlackWhite color = SG_EMPTY;
+    bool isSetup = false;
+    if (IsLabel(label, labelSize, "B"))
+      color = SG_BLACK;
+    else if (IsLabel(label, labelSize, "W"))
+      color = SG_WHITE;
+    else if (IsLabel(label, labelSize, "AB")) {
+      color = SG_BLACK;
+      isSetup = true;
+    } else if (IsLabel(label, labelSize, "AW")) {
+      color = SG_WHITE;
+      isSetup = true;
+    }
+    bool first = true;
+    while (true) {
+      while (pos < size && isspace(static_cast<unsigned char>(data[pos])))
+        ++pos;
+      if (pos >= size || data[pos] != '[')
+        break;
+      const size_t valueStart = pos + 1;
+      pos = SkipValue(data, size, pos);
+      const char* value = data + valueStart;
+      const size_t valueSize = pos - valueStart;
+      if (color != SG_EMPTY) {
+        // Only the first value of a move counts
+        if (isSetup || first) {
+          PendingPoint point = {value, valueSize, color, isSetup};
+          pending.push_back(point);
+        }
+      } else if (first && IsLabel(label, labelSize, "SZ")) {
+        const int boardSize = atoi(ValueString(value, valueSize).c_str());
+        if (boardSize < GO_MIN_SIZE || boardSize > GO_MAX_SIZE)
+          ok = false;
+        game.m_boardSize = boardSize;
+      } else if (first && IsLabel(label, labelSize, "GM")) {
+        if (atoi(ValueString(value, valueSize).c_str()) != 1)
+          ok = false;
+      } else if (first && IsLabel(label, labelSize, "KM"))
+        game.m_komi = static_cast<float>(
+            atof(ValueString(value, valueSize).c_str()));
+      else if (first && IsLabel(label, labelSize, "HA"))
+        game.m_handicap = atoi(ValueString(value, valueSize).c_str());
+      else if (first && IsLabel(label, labelSize, "RE") && valueSize > 0) {
+        if (value[0] == 'B' || value[0] == 'b')
+          game.m_winner = SG_BLACK;
+        else if (value[0] == 'W' || value[0] == 'w')
+          game.m_winner = SG_WHITE;
+      }
+      first = false;
+      if (pos < size)
+        ++pos;
+    }
+    // The loop increments pos again
+    --pos;
+  }
+  if (ok)
+    ok = AddPending(pending, game.m_boardSize, game, moves);
+  if (!ok)
+    moves.resize(oldSize);
+  game.m_firstMove = game.m_firstSetup + game.m_nuSetup;
+  return ok;
+}
+
+size_t SgSgfCorpus::LoadFiles(const vector<string>& files, int numThreads) {
+  vector<MappedFile*> mapped;
+  vector<Span> spans;
+  for (vector<string>::const_iterator it = files.begin(); it != files.end();
+       ++it) {
+    MappedFile* file = new MappedFile(*it);
+    mapped.push_back(file);
+    if (!file->m_data)
+      continue;
+    vector<pair<size_t, size_t> > games;
+    SplitGames(file->m_data, file->m_size, games);
+    for (size_t i = 0; i < games.size(); ++i) {
+      Span span = {file->m_data + games[i].first,
+                   games[i].second - games[i].first};
+      spans.push_back(span);
+    }
+  }
+  const size_t nuAdded = ParseSpans(spans, numThreads);
+  for (size_t i = 0; i < mapped.size(); ++i)
+    delete mapped[i];
+  return nuAdded;
+}
+
+size_t SgSgfCorpus::Parse(const char* data, size_t size, int numThreads) {
+  vector<pair<size_t, size_t> > games;
+  SplitGames(data, size, games);
+  vector<Span> spans;
+  for (size_t i = 0; i < games.size(); ++i) {
+    Span span = {data + games[i].first, games[i].second - games[i].first};
+    spans.push_back(span);
+  }
+  return ParseSpans(spans, numThreads);
+}
+
+namespace {
+
+/** Games parsed by one thread, with the moves at positions relative to
+    the thread. */
+struct ThreadResult {
+  vector<SgSgfCorpusGame> m_games;
+  vector<SgSgfCorpusMove> m_moves;
+  size_t m_nuErrors;
+};
+
+template<typename SPAN>
+void ParseRange(const vector<SPAN>* spans, size_t first, size_t last,
+                int defaultSize, ThreadResult* result) {
+  result->m_nuErrors = 0;
+  for (size_t i = first; i < last; ++i) {
+    SgSgfCorpusGame game;
+    if (SgSgfCorpus::ParseMainLine((*spans)[i].m_data, (*spans)[i].m_size,
+                                   defaultSize, game, result->m_moves))
+      result->m_games.push_back(game);
+    else
+      ++result->m_nuErrors;
+  }
+}
+
+} // namespace
+
+size_t SgSgfCorpus::ParseSpans(const vector<Span>& spans, int numThreads) {
+  const size_t nuThreads = max(size_t(1), min(spans.size(),
+                                              size_t(max(numThreads, 1))));
+  // Each thread parses a contiguous range, so the games stay in order
+  vector<ThreadResult> results(nuThreads);
+  boost::thread_group threads;
+  for (size_t i = 1; i < nuThreads; ++i)
+    threads.create_thread(boost::bind(&ParseRange<Span>, &spans,
+                                      i * spans.size() / nuThreads,
+                                      (i + 1) * spans.size() / nuThreads,
+                                      m_defaultSize, &results[i]));
+  ParseRange(&spans, 0, spans.size() / nuThreads, m_defaultSize,
+             &results[0]);
+  threads.join_all();
+  size_t nuAdded = 0;
+  for (size_t i = 0; i < nuThreads; ++i) {
+    const size_t offset = m_moves.size();
+    m_moves.insert(m_moves.end(), results[i].m_moves.begin(),
+                   results[i].m_moves.end());
+    for (size_t j = 0; j < results[i].m_games.size(); ++j) {
+      SgSgfCorpusGame game = results[i].m_games[j];
+      game.m_firstSetup += offset;
+      game.m_firstMove += offset;
+      m_games.push_back(game);
+    }
+    nuAdded += results[i].m_games.size();
+    m_nuErrors += results[i].m_nuErrors;
+  }
+  return nuAdded;
+}
+
+//----------------------------------------------------------------------------
@@ -0,0 +1,122 @@
+//----------------------------------------------------------------------------
+/** @file SgSgfCorpus.h
+    Fast loader for the main lines of large SGF collections. */
+//----------------------------------------------------------------------------
+
+#ifndef SG_SGFCORPUS_H
+#define SG_SGFCORPUS_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "board/GoBoardColor.h"
+#include "config/BoardStaticConfig.h"
+
+/** Move or setup stone of a game in a SgSgfCorpus. */
+struct SgSgfCorpusMove {
+  short m_point;
+  signed char m_color;
+};
+
+/** Main line of a game in a SgSgfCorpus. The moves and setup stones are
+    stored in one array of the corpus. */
+struct SgSgfCorpusGame {
+  int m_boardSize;
+  float m_komi;
+  int m_handicap;
+  /** SG_EMPTY if the result is unknown or a draw. */
+  SgEmptyBlackWhite m_winner;
+  std::size_t m_firstSetup;
+  int m_nuSetup;
+  std::size_t m_firstMove;
+  int m_nuMoves;
+};
+
+/** Collection of the main lines of many SGF games, for opening statistics
+    and training data.
+    Unlike SgGameReader, which builds a tree of SgNode for each game, this
+    reads memory-mapped files, splits them at the top-level parentheses and
+    parses only the moves, setup stones and a few root properties of the
+    main lines, with several threads. The games of a file that contains a
+    collection are added in the order of the file.
+    Games of other games than Go, with an invalid board size or with a
+    point outside the board are skipped and counted as errors. */
+class SgSgfCorpus {
+ public:
+  explicit SgSgfCorpus(int defaultSize = 19);
+
+  /** @return The number of games added */
+  std::size_t LoadFiles(const std::vector<std::string>& files,
+                        int numThreads = 1);
+
+  /** Parse SGF text in memory.
+      @return The number of games added */
+  std::size_t Parse(const char* data, std::size_t size, int numThreads = 1);
+
+  void Clear();
+
+  std::size_t NuGames() const;
+
+  /** Number of games that were skipped. */
+  std::size_t NuErrors() const;
+
+  const SgSgfCorpusGame& Game(std::size_t i) const;
+
+  const SgSgfCorpusMove* Setup(const SgSgfCorpusGame& game) const;
+
+  const SgSgfCorpusMove* Moves(const SgSgfCorpusGame& game) const;
+
+  /** Find the games of an SGF collection.
+      @param[out] games The first and one past the last character of each
+      top-level parenthesized game */
+  static void SplitGames(const char* data, std::size_t size,
+                         std::vector<std::pair<std::size_t,
+                                               std::size_t> >& games);
+
+  /** Parse the main line of one game.
+      @param[out] moves The setup stones followed by the moves are
+      appended to moves
+      @return false if the game is skipped */
+  static bool ParseMainLine(const char* data, std::size_t size,
+                            int defaultSize, SgSgfCorpusGame& game,
+                            std::vector<SgSgfCorpusMove>& moves);
+
+ private:
+  struct Span {
+    const char* m_data;
+    std::size_t m_size;
+  };
+
+  const int m_defaultSize;
+  std::size_t m_nuErrors;
+  std::vector<SgSgfCorpusGame> m_games;
+  std::vector<SgSgfCorpusMove> m_moves;
+
+  std::size_t ParseSpans(const std::vector<Span>& spans, int numThreads);
+  SgSgfCorpus(const SgSgfCorpus&);
+  SgSgfCorpus& operator=(const SgSgfCorpus&);
+};
+
+inline std::size_t SgSgfCorpus::NuGames() const {
+  return m_games.size();
+}
+
+inline std::size_t SgSgfCorpus::NuErrors() const {
+  return m_nuErrors;
+}
+
+inline const SgSgfCorpusGame& SgSgfCorpus::Game(std::size_t i) const {
+  return m_games[i];
+}
+
+inline const SgSgfCorpusMove*
+SgSgfCorpus::Setup(const SgSgfCorpusGame& game) const {
+  return m_moves.data() + game.m_firstSetup;
+}
+
+inline const SgSgfCorpusMove*
+SgSgfCorpus::Moves(const SgSgfCorpusGame& game) const {
+  return m_moves.data() + game.m_firstMove;
+}
+
+#endif // SG_SGFCORPUS_H
@@ -1,33 +1,109 @@
-
 #include <funcapproximator/DlConfig.h>
+#include "funcapproximator/DlCpuNetworkEvaluator.h"
+#include "funcapproximator/DlMockNetworkEvaluator.h"
 #include "funcapproximator/DlTFNetworkEvaluator.h"
+#include "platform/SgDebug.h"
+#include "platform/SgException.h"
 #include "UctBoardEvaluator.h"
 
-UctBoardEvaluator::UctBoardEvaluator() : m_evaluator("", DF_HWC) {
-  m_evaluator.SetNetworkInput(DlConfig::GetInstance().get_network_input());
+namespace {
+
+/** Positions of nn_calibration used for calibration and the accuracy
+    report of a quantized network. */
+const std::size_t CALIBRATION_POSITIONS = 512;
+
+}
+
+UctBoardEvaluator::UctBoardEvaluator(bool allowRemote) :
+    m_model(0) {
+  if (allowRemote)
+    m_server = DlConfig::GetInstance().get_inference_server();
+  if (IsRemote())
+    return;
+  DlConfig &config = DlConfig::GetInstance();
+  if (config.get_network_backend() == "mock") {
+    m_evaluator.reset(new DlMockNetworkEvaluator(config.get_mock_batchlatency(),
+                                                 config.get_mock_positionlatency()));
+    return;
+  }
+  if (config.get_network_backend() == "cpu") {
+    DlCpuNetworkEvaluator::Precision precision;
+    if (!DlCpuNetworkEvaluator::ParsePrecision(config.get_network_precision(), precision))
+      throw SgException(boost::format("UctBoardEvaluator: unknown nn_precision '%1%'")
+                            % config.get_network_precision());
+    DlCpuNetworkEvaluator *evaluator = new DlCpuNetworkEvaluator(
+        config.get_network_cputhreads(), precision);
+    m_evaluator.reset(evaluator);
+    const std::string calibration = config.get_network_calibration();
+    std::vector<DlTrainingExample> samples;
+    if (!calibration.empty()) {
+      if (DlCpuNetworkEvaluator::ReadCalibrationSamples(calibration, CALIBRATION_POSITIONS, samples))
+        evaluator->SetCalibrationSamples(samples);
+      else
+        SgDebug() << "UctBoardEvaluator: no positions in " << calibration << '\n';
+    }
+    return;
+  }
+  tensorflow::DlTFNetworkEvaluator<bool> *evaluator =
+      new tensorflow::DlTFNetworkEvaluator<bool>("", DF_HWC);
+  m_evaluator.reset(evaluator);
+  evaluator->SetNetworkInput(config.get_network_input());
   std::vector<std::string> outputs;
-  DlConfig::GetInstance().get_network_outputs(outputs);
-  m_evaluator.SetNetworkOutput(outputs);
+  config.get_network_outputs(outputs);
+  evaluator->SetNetworkOutput(outputs);
+  evaluator->SetGraphOptimization(config.get_graph_optimization(), config.get_graphcache_dir());
 }
 
-UctBoardEvaluator::UctBoardEvaluator(const std::string &graphPath, const std::string &checkpoint) : m_evaluator(graphPath) {
+UctBoardEvaluator::UctBoardEvaluator(const std::string &graphPath, const std::string &checkpoint) :
+    m_evaluator(new tensorflow::DlTFNetworkEvaluator<bool>(graphPath)),
+    m_model(0) {
   if (!checkpoint.empty())
-    m_evaluator.UpdateCheckPoint(checkpoint);
+    m_evaluator->UpdateCheckPoint(checkpoint);
+}
+
+UctBoardEvaluator::UctBoardEvaluator(const std::string &server, int model) :
+    m_server(server),
+    m_model(model) {
+}
+
+bool UctBoardEvaluator::IsRemote() const {
+  return !m_server.empty();
+}
+
+UctInferenceClient &UctBoardEvaluator::Client() {
+  if (!m_client)
+    m_client.reset(new UctInferenceClient(m_server, m_model));
+  return *m_client;
 }
 
 void UctBoardEvaluator::LoadGraph(const std::string &graphPath) {
-  m_evaluator.LoadGraph(graphPath);
+  // The server loads the graph of its own configuration
+  if (!IsRemote())
+    m_evaluator->LoadGraph(graphPath);
 }
 
 void UctBoardEvaluator::UpdateCheckPoint(const std::string &checkpoint) {
-  m_evaluator.UpdateCheckPoint(checkpoint);
+  if (IsRemote())
+    Client().UpdateCheckPoint(checkpoint);
+  else
+    m_evaluator->UpdateCheckPoint(checkpoint);
 }
 
 void UctBoardEvaluator::EvaluateState(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
                                    UctValueType actions_[][GO_MAX_MOVES], UctValueType value_[], int numBatches) {
-  m_evaluator.Evaluate(feature, actions_, value_, numBatches);
+  if (!IsRemote()) {
+    m_evaluator->Evaluate(feature, actions_, value_, numBatches);
+    return;
+  }
+  // Connect again once if the server restarted
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (Client().Evaluate(feature, actions_, value_, numBatches))
+      return;
+    m_client.reset();
+  }
+  throw SgException("UctBoardEvaluator: no answer from inference server " + m_server);
 }
 
 bool UctBoardEvaluator::GraphLoaded() {
-  return m_evaluator.MetaGraphLoaded();
-}
\ No newline at end of file
+  return IsRemote() || m_evaluator->MetaGraphLoaded();
+}
@@ -9,20 +9,37 @@
 #include "UctValue.h"
 #include "lib/SgRandom.h"
 
-#include "funcapproximator/DlTFNetworkEvaluator.h"
+#include <memory>
+#include "funcapproximator/DlNetworkEvaluator.h"
+#include "UctInferenceServer.h"
 
+/** Evaluates positions with a network of its own, or, if the DlConfig key
+    inferenceserver names a UctInferenceServer, by sending them to that
+    server. The DlConfig key nn_backend selects the network: "tf" for a
+    TensorFlow session, "cpu" for DlCpuNetworkEvaluator, "mock" for
+    DlMockNetworkEvaluator. */
 class UctBoardEvaluator {
  public:
-  UctBoardEvaluator();
+  /** @param allowRemote Use the inference server if one is configured;
+      false for the evaluator of the server itself */
+  explicit UctBoardEvaluator(bool allowRemote = true);
   explicit UctBoardEvaluator(const std::string &graphPath, const std::string &checkpoint);
+  /** Evaluate with the model of the UctInferenceServer server. */
+  UctBoardEvaluator(const std::string &server, int model);
   void LoadGraph(const std::string &graphPath);
   void UpdateCheckPoint(const std::string &checkpoint);
   void EvaluateState(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
                      UctValueType actions_[][GO_MAX_MOVES], UctValueType value_[], int numBatches = MAX_BATCHES);
   bool GraphLoaded();
+  bool IsRemote() const;
 
  private:
-  tensorflow::DlTFNetworkEvaluator<bool> m_evaluator;
+  std::unique_ptr<DlNetworkEvaluator> m_evaluator;
+  std::string m_server;
+  int m_model;
+  std::unique_ptr<UctInferenceClient> m_client;
+
+  UctInferenceClient &Client();
 };
 
 #endif
\ No newline at end of file
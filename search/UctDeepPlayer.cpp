@@ -39,7 +39,10 @@ UctDeepPlayer::UctDeepPlayer(GoGame& game, GoRules& rules) : GoPlayer(game.Board
                                                              m_mpiSynchronizer(NullMpiSynchronizer::Create()),
                                                              m_writeDebugOutput(false),
                                                              m_policyAllocator(new UctPolicyAllocator()),
-                                                             m_nodeAllocator(new UctNodeAllocator) {
+                                                             m_nodeAllocator(new UctNodeAllocator),
+                                                             m_bookMaxMoves(30),
+                                                             m_bookBuilder(nullptr),
+                                                             m_bookMinVisits(0) {
   m_policyAllocator->SetMaxPolicies((size_t)GO_MAX_NUM_MOVES);
   m_nodeAllocator->SetMaxNodes((size_t)GO_MAX_NUM_MOVES);
 
@@ -48,6 +51,11 @@ UctDeepPlayer::UctDeepPlayer(GoGame& game, GoRules& rules) : GoPlayer(game.Board
   m_game.SetTimeSettingsGlobal(game.TimeSettings(), game.TimeRecord().Overhead());
 
   m_search.SetPruneMinCount(0);
+  // max_memory also covers the game record, which the default tree size
+  // does not know about
+  const size_t maxMemory = DlConfig::GetInstance().get_max_memory();
+  if (maxMemory > 0 && !SetMaxMemory(maxMemory))
+    SgWarning() << "UctDeepPlayer: max_memory " << maxMemory << " is too small\n";
 }
 
 void UctDeepPlayer::ClearBoard() {
@@ -172,6 +180,7 @@ void UctDeepPlayer::SelfPlayAsClient() {
 
   const std::string path = UnrealGo::GetCWD();
   int gameID = 0;
+  DlCheckPoint::CheckPointInfo loaded;
 
   while (!m_aborted) {
     bool gotCheckPoint =
@@ -179,8 +188,12 @@ void UctDeepPlayer::SelfPlayAsClient() {
     if (!gotCheckPoint) {
       gotCheckPoint = DlCheckPoint::CheckDefaultCheckPoint(m_bestCheckPoint);
     }
-    if (gotCheckPoint)
+    // The search loads a new checkpoint in the background, skip unchanged ones
+    if (gotCheckPoint
+        && (m_bestCheckPoint.sha1 != loaded.sha1 || m_bestCheckPoint.name != loaded.name)) {
       m_search.UpdateCheckPoint(m_bestCheckPoint.name);
+      loaded = m_bestCheckPoint;
+    }
 
     if (!m_bestCheckPoint.name.empty())
       SelfPlayOneGame(path, gameID++, true);
@@ -200,6 +213,12 @@ GoPoint UctDeepPlayer::GenMove(const SgTimeRecord& timeRecord, SgBlackWhite toPl
     if (move != GO_NULLMOVE)
       SgDebug() << "DeepUctPlayer: Forced opening move\n";
   }
+  if (move == GO_NULLMOVE && m_book.IsOpen()
+      && bd.MoveNumber() < m_bookMaxMoves) {
+    move = m_book.BestMove(bd);
+    if (move != GO_NULLMOVE)
+      SgDebug() << "DeepUctPlayer: Book move\n";
+  }
   if (move == GO_NULLMOVE && GoBoardUtil::TrompTaylorPassWins(bd, toPlay)) {
     move = GO_PASS;
     SgDebug() << "DeepUctPlayer: Pass wins (By Tromp-Taylor Score)\n";
@@ -220,6 +239,38 @@ GoPoint UctDeepPlayer::GenMove(const SgTimeRecord& timeRecord, SgBlackWhite toPl
 }
 
 
+void UctDeepPlayer::Analyze(SgBlackWhite toPlay, double interval,
+                            const UctProgressCallback& report) {
+  const double maxTime = std::numeric_limits<double>::max();
+  UctSearchTree& initTree = m_search.GetTempTree();
+  FindInitTree(initTree, toPlay, maxTime);
+  ((GoUctGlobalSearchType&)m_search).SetToPlay(toPlay);
+  std::vector<GoPoint> sequence;
+  std::vector<GoMove> rootFilter;
+  m_search.SetProgressCallback(report, interval);
+  m_search.StartDeepUCTSearchThread(std::numeric_limits<UctValueType>::max(),
+                                    maxTime, sequence, nullptr, nullptr, 1.0,
+                                    rootFilter, &initTree, nullptr, true);
+  m_search.SetProgressCallback(UctProgressCallback(), interval);
+  report(m_search);
+}
+
+
+void UctDeepPlayer::AddRootToBook(SgBlackWhite toPlay) {
+  const UctSearchTree& tree = m_search.Tree();
+  if (!tree.Root().HasChildren())
+    return;
+  Board().SetToPlay(toPlay);
+  for (UctChildNodeIterator it(tree, tree.Root()); it; ++it) {
+    const UctNode& child = *it;
+    if (child.MoveCount() < m_bookMinVisits || !child.HasMean())
+      continue;
+    m_bookBuilder->Add(Board(), child.Move(),
+                       static_cast<unsigned int>(child.MoveCount()),
+                       float(UctSearch::InverseEstimate(child.Mean())));
+  }
+}
+
 void UctDeepPlayer::FindInitTree(UctSearchTree& initTree, SgBlackWhite toPlay, double maxTime) {
   Board().SetToPlay(toPlay);
   std::vector<GoPoint> sequence;
@@ -321,6 +372,8 @@ GoPoint UctDeepPlayer::DoSearch(SgBlackWhite toPlay, double maxTime, double tau,
   bool wasEarlyAbort = m_search.WasEarlyAbort();
   UctValueType rootMoveCount = m_search.Tree().Root().MoveCount();
   m_mpiSynchronizer->SynchronizeSearchStatus(value, wasEarlyAbort, rootMoveCount);
+  if (m_bookBuilder)
+    AddRootToBook(toPlay);
 
   if (m_writeDebugOutput) {
     std::ostringstream out;
@@ -360,6 +413,14 @@ void checkNodeSequence(UctNode* root, std::vector<UctNode*>& sequence) {
 }
 
 void UctDeepPlayer::WriteTFRecord(UctNode* root, const std::string& fileName) {
+  std::vector<std::string> records;
+  CollectExamples(root, records);
+  tensorflow::io::DlTFRecordWriter tfRecordWriter(fileName);
+  for (size_t i = 0; i < records.size(); ++i)
+    tfRecordWriter.WriteRecord(records[i]);
+}
+
+void UctDeepPlayer::CollectExamples(UctNode* root, std::vector<std::string>& records) {
   checkNodeSequence(root, m_nodeSequence);
   UctThreadState& state = m_search.ThreadState(0);
   DBG_ASSERT(state.Board().GetHashCode() == Board().GetHashCode());
@@ -372,17 +433,17 @@ void UctDeepPlayer::WriteTFRecord(UctNode* root, const std::string& fileName) {
     state.TakeBackInTree(1);
   }
 
-  tensorflow::io::DlTFRecordWriter tfRecordWriter(fileName);
   UctValueType score = state.FinalScore();
   SgBlackWhite color = node->GetColor();
   bool win = (score > 0 && color == SG_BLACK) || (score < 0 && color == SG_WHITE);
   float reward = win ? 1 : -1;
   while (state.LastMove() != GO_NULLMOVE) {
     state.CollectFeatures(m_feature, NUM_MAPS);
-    tfRecordWriter.WriteExample((char*)m_feature, sizeof(m_feature),
-                                node->Policy(), (size_t)GO_MAX_MOVES,
-                                reward);
     state.TakeBackInTree(1);
+    // Mark the first position, the replay buffer splits the games there
+    const int gameStart = state.LastMove() == GO_NULLMOVE ? 1 : 0;
+    records.push_back(tensorflow::io::DlTFRecordWriter::SerializeExample(
+        (char*)m_feature, sizeof(m_feature), node->Policy(), (size_t)GO_MAX_MOVES, reward, gameStart));
     node = node->Parent();
     reward *= -1;
   }
@@ -430,14 +491,21 @@ void UctDeepPlayer::LogSelfPlayGame(UctNode* root, const std::string& path,
 }
 
 void UctDeepPlayer::UploadTFRecordToServer(UctNode* root, const std::string& path) {
-
-  std::string uuid;
-  SgUUID::generateUUID(uuid);
-  std::string fileName = uuid + ".tfrecords";
-  std::string fullPath = UnrealGo::GetFullPathStr(path, fileName);
-  WriteTFRecord(root, fileName);
-  UnrealGo::MinioStub::Upload("train-data", m_bestCheckPoint.sha1 + "/" + fileName, fullPath);
-  boost::filesystem::remove(fullPath);
+  if (!m_shardWriter) {
+    DlShardWriter::Options options;
+    options.dir = UnrealGo::GetFullPathStr(path, "shards");
+    std::string uuid;
+    SgUUID::generateUUID(uuid);
+    options.prefix = uuid;
+    m_shardWriter.reset(new DlShardWriter(options, [](const std::string& localPath, const std::string& obj) {
+      return UnrealGo::MinioStub::TryUpload("train-data", obj, localPath, 60000);
+    }));
+  }
+  std::vector<std::string> records;
+  CollectExamples(root, records);
+  // Shards are grouped by the checkpoint that played the games
+  if (!m_shardWriter->AddGame(m_bestCheckPoint.sha1, records))
+    SgDebug() << "UctDeepPlayer: shard queue full, game dropped\n";
 }
 
 const GoUctSearch& UctDeepPlayer::Search() const {
@@ -448,6 +516,22 @@ GoUctSearch& UctDeepPlayer::Search() {
   return m_search;
 }
 
+UctMemoryUsage UctDeepPlayer::MemoryUsage() const {
+  UctMemoryUsage usage = m_search.MemoryUsage();
+  usage.policy_reserved = m_policyAllocator->MemoryReserved() + m_nodeAllocator->MaxNodes() * sizeof(UctNode);
+  usage.policy_used = m_policyAllocator->MemoryUsed() + m_nodeAllocator->NuNodes() * sizeof(UctNode);
+  return usage;
+}
+
+bool UctDeepPlayer::SetMaxMemory(std::size_t memory) {
+  const size_t fixed = MemoryUsage().policy_reserved;
+  const size_t maxNodes = memory > fixed ? UctSearch::NodesForMemory(memory - fixed) : 0;
+  if (maxNodes < m_search.NumberThreads())
+    return false;
+  m_search.SetMaxNodes(maxNodes);
+  return true;
+}
+
 UctDeepPlayer::Statistics::Statistics() {
   Clear();
 }
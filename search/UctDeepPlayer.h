@@ -11,6 +11,7 @@
 #include <boost/thread/thread.hpp>
 #include <zmq.hpp>
 #include "GoGame.h"
+#include "GoOpeningBook.h"
 #include "GoPlayer.h"
 #include "GoTimeControl.h"
 #include "gouct/GoUctGlobalSearch.h"
@@ -21,6 +22,7 @@
 #include "lib/SgRandom.h"
 #include "funcapproximator/DlTFRecordWriter.h"
 #include "funcapproximator/DlCheckPoint.h"
+#include "funcapproximator/DlShardWriter.h"
 #include "Allocator.h"
 
 typedef GoUctGlobalSearch<GoUctPlayoutPolicy<GoUctBoard>, GoUctPlayoutPolicyFactory<GoUctBoard> > GoUctGlobalSearchType;
@@ -52,6 +54,8 @@ class UctDeepPlayer
   void UploadTFRecordToServer(UctNode *root, const std::string &path);
   void WriteSgf(UctNode *root, const std::string &path);
   void WriteTFRecord(UctNode *root, const std::string &filename);
+  /** Serialized training examples of the game, last position first. */
+  void CollectExamples(UctNode *root, std::vector<std::string> &records);
   void
   LogSelfPlayGame(UctNode *root, const std::string &path, int gameID);
 
@@ -62,6 +66,12 @@ class UctDeepPlayer
                    bool syncState = true);
   void FindInitTree(UctSearchTree &initTree, SgBlackWhite toPlay, double maxTime);
   GoPoint GenMove(const SgTimeRecord &timeRecord, SgBlackWhite toPlay) final;
+  /** Search the current position until aborted, with the tree of the
+      last search of this position or its predecessors, and report the
+      progress about every interval seconds and once at the end. The tree
+      is kept for the next search. */
+  void Analyze(SgBlackWhite toPlay, double interval,
+               const UctProgressCallback &report);
   void OnOppMove(GoMove move, SgBlackWhite color);
 
   void TryInitNeuralNetwork();
@@ -69,9 +79,25 @@ class UctDeepPlayer
   const SgDefaultTimeControl &TimeControl() const;
   GoUctSearch &Search();
   const GoUctSearch &Search() const;
+  /** Memory of the search and of the game record. */
+  UctMemoryUsage MemoryUsage() const;
+  /** Size the search trees so that the player reserves at most memory
+      bytes.
+      @return false if memory is too small for a tree */
+  bool SetMaxMemory(std::size_t memory);
   void SetLogReuse(bool reuse);
   void Abort();
 
+  /** Book consulted by GenMove before searching. */
+  GoOpeningBook &OpeningBook();
+  /** Book moves are played up to this move number. */
+  void SetBookMaxMoves(int maxMoves);
+  /** Collect the root moves with at least minVisits visits of all following
+      searches into builder. Null stops collecting. */
+  void SetBookBuilder(GoOpeningBookBuilder *builder, unsigned int minVisits);
+  /** Synchronizer of the player and its search. */
+  void SetMpiSynchronizer(const MpiSynchronizerHandle &handle);
+
  private:
   bool m_logReuse;
   GoUctGlobalSearchType m_search;
@@ -96,6 +122,14 @@ class UctDeepPlayer
   std::vector<UctNode *> m_nodeSequence;
   std::unique_ptr<UctPolicyAllocator> m_policyAllocator;
   std::unique_ptr<UctNodeAllocator> m_nodeAllocator;
+  /** Writes and uploads the games of SelfPlayAsClient in the background. */
+  std::unique_ptr<DlShardWriter> m_shardWriter;
+  GoOpeningBook m_book;
+  int m_bookMaxMoves;
+  GoOpeningBookBuilder *m_bookBuilder;
+  unsigned int m_bookMinVisits;
+
+  void AddRootToBook(SgBlackWhite toPlay);
 };
 
 inline SgDefaultTimeControl &UctDeepPlayer::TimeControl() {
@@ -106,6 +140,25 @@ inline const SgDefaultTimeControl &UctDeepPlayer::TimeControl() const {
   return m_timeControl;
 }
 
+inline GoOpeningBook &UctDeepPlayer::OpeningBook() {
+  return m_book;
+}
+
+inline void UctDeepPlayer::SetBookMaxMoves(int maxMoves) {
+  m_bookMaxMoves = maxMoves;
+}
+
+inline void UctDeepPlayer::SetBookBuilder(GoOpeningBookBuilder *builder,
+                                          unsigned int minVisits) {
+  m_bookBuilder = builder;
+  m_bookMinVisits = minVisits;
+}
+
+inline void UctDeepPlayer::SetMpiSynchronizer(const MpiSynchronizerHandle &handle) {
+  m_mpiSynchronizer = handle;
+  m_search.SetMpiSynchronizer(handle);
+}
+
 inline void UctDeepPlayer::UpdateCheckPoint(DlCheckPoint::CheckPointInfo &ckInfo) {
   m_bestCheckPoint = ckInfo;
   m_search.UpdateCheckPoint(m_bestCheckPoint.name);
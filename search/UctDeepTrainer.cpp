@@ -10,12 +10,48 @@
 #include "msg/ZmqUtil.h"
 #include "network/AtomZIP.h"
 #include "network/AtomHash.h"
+#include "UctBoardEvaluator.h"
+#include "UctInferenceServer.h"
+#include <unistd.h>
+#include <algorithm>
+#include <boost/bind.hpp>
 
-static const int CMD_TRAIN = 0;
-static const int CMD_UPDATE_CKP = 1;
-static const int CMD_GET_CKP = 2;
-static const int CMD_GET_METAGRAPH = 3;
-static const int CMD_EXIT = 4;
+using ZmqUtil::CMD_TRAIN;
+using ZmqUtil::CMD_UPDATE_CKP;
+
+namespace {
+
+UnrealGo::Command CheckPointCommand(int type, const std::string &checkpoint) {
+  UnrealGo::Command command;
+  command.set_type(type);
+  command.set_data(checkpoint);
+  UnrealGo::CheckPointAnnouncement *announcement = command.mutable_checkpoint();
+  announcement->mutable_checkpoint()->set_name(checkpoint);
+  announcement->set_best(type == ZmqUtil::CMD_BEST_CKP);
+  return command;
+}
+
+/** Describe the shards written by one self-play round, so that the trainer
+    does not need to list the directory. */
+UnrealGo::Command TrainCommand(const std::string &path, int round, const std::string &checkpoint) {
+  UnrealGo::Command command;
+  command.set_type(CMD_TRAIN);
+  command.set_data(path);
+  UnrealGo::ShardManifest *manifest = command.mutable_shard_manifest();
+  manifest->set_group(checkpoint);
+  manifest->set_round(round);
+  boost::system::error_code ec;
+  for (boost::filesystem::directory_iterator it(path, ec), end; !ec && it != end; it.increment(ec)) {
+    if (!boost::filesystem::is_regular_file(it->status()))
+      continue;
+    UnrealGo::ShardManifest::Shard *shard = manifest->add_shards();
+    shard->set_path(it->path().string());
+    shard->set_bytes(boost::filesystem::file_size(it->path(), ec));
+  }
+  return command;
+}
+
+}
 
 static void Notify(boost::mutex &mutex, boost::condition &cv) {
   boost::mutex::scoped_lock lock(mutex);
@@ -55,6 +91,8 @@ void UctDeepTrainer::SelfPlayThread::operator()() {
       m_running = true;
       if (m_uploadSgf)
         m_trainer.SelfPlayGamesClientMode();
+      else if (m_trainer.m_evalMode == EVAL_PIPELINED)
+        m_trainer.SelfPlayGamesPipelined();
       else
         m_trainer.SelfPlayGamesServerMode();
     }
@@ -121,6 +159,9 @@ void UctDeepTrainer::EvaluateThread::operator()() {
         }
       }
     }
+  } else if (m_trainer.m_evalMode == EVAL_PIPELINED) {
+    m_waitCommand.wait(lock);
+    m_trainer.PipelinedEvalLoop();
   } else if (m_trainer.m_evalMode == EVAL_FROM_SERVER) {
     m_waitCommand.wait(lock);
     m_trainer.SvrEvalLoop();
@@ -184,7 +225,10 @@ void UctDeepTrainer::NetworkThread::operator()() {
     if (m_quit)
       break;
     ZmqUtil::receive_command(m_trainer.m_receive_socket, command, reply);
-    if (command.type() == CMD_UPDATE_CKP) {
+    if (command.type() == CMD_UPDATE_CKP && m_trainer.m_checkpointNotifier) {
+      std::cout << "new checkpoint received " << command.data() << std::endl;
+      m_trainer.m_checkpointNotifier->Publish(CheckPointCommand(CMD_UPDATE_CKP, ZmqUtil::checkpoint_name(command)));
+    } else if (command.type() == CMD_UPDATE_CKP) {
       std::cout << "new checkpoint received " << command.data() << std::endl;
       Msg msg(CMD_UPDATE_CKP, new std::string(command.data()));
       if (m_trainer.IsSelfPlayRunning()) {
@@ -230,13 +274,31 @@ UctDeepTrainer::UctDeepTrainer(const GoGame &game, GoRules &rules) :
 }
 
 UctDeepTrainer::~UctDeepTrainer() {
+  m_quit = true;
   m_trainer.Abort();
   m_opponent.Abort();
+  {
+    boost::mutex::scoped_lock lock(m_gatingMutex);
+    for (UctDeepPlayer *player : m_gatingPlayers)
+      player->Abort();
+  }
+  if (m_selfPlayer)
+    m_selfPlayer->Abort();
+  if (m_evalMode == EVAL_PIPELINED) {
+    // The pipeline threads own sockets of m_ctx, stop them before it
+    m_selfplayThread.reset();
+    m_evalThread.reset();
+    m_dispatchThread.join();
+  }
 }
 
 void UctDeepTrainer::StartTrainEvalPipeLine(bool withSelfplay, EvalMode evalMode) {
   m_selfplay = withSelfplay;
   m_evalMode = evalMode;
+  if (m_evalMode == EVAL_PIPELINED) {
+    StartPipeline();
+    return;
+  }
   if (m_selfplay && m_selfplayThread.get() == nullptr)
     m_selfplayThread.reset(new SelfPlayThread(*this));
   if (m_evalMode == EVAL_FROM_SERVER_MSG && m_networkThread.get() == nullptr)
@@ -250,6 +312,52 @@ void UctDeepTrainer::StartTrainEvalPipeLine(bool withSelfplay, EvalMode evalMode
   SgDebug() << "DeepTrainer: train pipeline started \n";
 }
 
+void UctDeepTrainer::StartPipeline() {
+  m_selfplay = true;
+  if (!m_trainQueue) {
+    DlConfig &config = DlConfig::GetInstance();
+    m_trainQueue.reset(new ZmqWorkQueue(m_ctx, config.get_trainqueue_socket(),
+                                        config.get_trainqueue_size()));
+    m_checkpointNotifier.reset(new ZmqNotifier(m_ctx, config.get_checkpointnotify_socket()));
+    m_dispatchThread = boost::thread(boost::bind(&UctDeepTrainer::DispatchTrainingData, this));
+  }
+  if (m_networkThread.get() == nullptr)
+    m_networkThread.reset(new NetworkThread(*this));
+  if (m_selfplayThread.get() == nullptr)
+    m_selfplayThread.reset(new SelfPlayThread(*this));
+  if (m_evalThread.get() == nullptr)
+    m_evalThread.reset(new EvaluateThread(*this));
+  m_selfplayThread->NotifyExecuteCommand();
+  m_evalThread->NotifyExecuteCommand();
+  SgDebug() << "DeepTrainer: pipelined self-play, training and gating started\n";
+}
+
+void UctDeepTrainer::DispatchTrainingData() {
+  // Never block on the trainer, the destructor joins this thread
+  m_send_socket.setsockopt(ZMQ_LINGER, 0);
+  m_send_socket.setsockopt(ZMQ_SNDTIMEO, 1000);
+  m_send_socket.connect(DlConfig::GetInstance().get("deeptrainertraindataconsocket"));
+  UnrealGo::Command item;
+  bool hasItem = false;
+  bool sent = false;
+  while (!m_quit) {
+    if (!hasItem) {
+      if (!m_trainQueue->Pop(item, 1000))
+        continue;
+      hasItem = true;
+      std::cout << "Sending training data to server: " << item.data() << " ("
+                << item.shard_manifest().shards_size() << " shards)" << std::endl;
+    }
+    if (!sent) {
+      sent = ZmqUtil::post_message(m_send_socket, item);
+      if (!sent)
+        continue;
+    }
+    if (ZmqUtil::poll_reply(m_send_socket, 1000))
+      hasItem = sent = false;
+  }
+}
+
 void UctDeepTrainer::StartSelfPlay(bool uploadSgf) {
   m_selfplay = true;
   m_selfplayThread.reset(new SelfPlayThread(*this));
@@ -276,13 +384,16 @@ void UctDeepTrainer::SvrEvalLoop() {
   std::string dir = UnrealGo::GetFullPathStr(DlConfig::GetInstance().get_minio_path(),
                                              DlConfig::GetInstance().get_checkdata_subpath());
   int cnt = 0;
+  // The concurrent gating matches do not load the candidate into m_opponent
+  std::string evaluated = m_opponent.Search().getCheckPoint();
   while (cnt < 10000000) {
     std::string checkpointToEval = DlCheckPoint::getLatestCheckPointPrefix();
     if (checkpointToEval[0] != '/') {
       checkpointToEval = UnrealGo::GetFullPathStr(dir, checkpointToEval);
     }
-    if (checkpointToEval != m_opponent.Search().getCheckPoint()) {
+    if (checkpointToEval != evaluated) {
       std::cout << "evaluating new checkpoint" << std::endl;
+      evaluated = checkpointToEval;
       EvalPlayAsServer(checkpointToEval);
     } else {
       sleep(60);
@@ -291,43 +402,65 @@ void UctDeepTrainer::SvrEvalLoop() {
   }
 }
 
+void UctDeepTrainer::PipelinedEvalLoop() {
+  ZmqSubscriber checkpoints(m_ctx, DlConfig::GetInstance().get_checkpointnotify_socket());
+  UnrealGo::Command command;
+  std::string evaluated;
+  while (!m_quit) {
+    if (!checkpoints.Receive(command, 1000) || command.type() != CMD_UPDATE_CKP)
+      continue;
+    UnrealGo::Command newer;
+    if (checkpoints.Latest(CMD_UPDATE_CKP, newer))
+      command = newer;
+    if (ZmqUtil::checkpoint_name(command) == evaluated)
+      continue;
+    evaluated = ZmqUtil::checkpoint_name(command);
+    std::cout << "evaluating new checkpoint " << evaluated << std::endl;
+    EvalPlayAsServer(evaluated);
+  }
+}
+
 bool UctDeepTrainer::EvalPlayNetworkModel(int gameID) {
+  return PlayGatingGame(m_trainer, m_opponent, m_trainGame, m_random.Int(2), gameID);
+}
+
+bool UctDeepTrainer::PlayGatingGame(UctDeepPlayer &trainer, UctDeepPlayer &opponent, GoGame &trainGame,
+                                    SgBlackWhite trainColor, int gameID) {
   SuppressUnused(gameID);
-  SgBlackWhite trainColor = m_random.Int(2);
   SgBlackWhite oppColor = SgOpp(trainColor);
-  m_trainer.Search().PrepareGamePlay();
-  m_opponent.Search().PrepareGamePlay();
+  trainer.Search().PrepareGamePlay();
+  opponent.Search().PrepareGamePlay();
   double tau = 0.0001;
   GoMove oppMove = GO_NULLMOVE;
   GoMove trainerMove;
   bool trainerWin;
   double maxTime = std::numeric_limits<double>::max();
-  m_trainer.ClearBoard();
-  m_opponent.ClearBoard();
+  trainer.ClearBoard();
+  opponent.ClearBoard();
 
   if (trainColor == SG_WHITE)
   {
-    oppMove = m_opponent.SearchAgainstAndSync(oppColor, maxTime, tau, 0, 0, false);
-    m_trainer.SyncState(oppMove, oppColor);
+    oppMove = opponent.SearchAgainstAndSync(oppColor, maxTime, tau, 0, 0, false);
+    trainer.SyncState(oppMove, oppColor);
   }
-  m_trainer.SetLogReuse(false);
-  m_opponent.SetLogReuse(false);
+  trainer.SetLogReuse(false);
+  opponent.SetLogReuse(false);
 
   int steps = 0;
 
   while (true) {
     maxTime = std::numeric_limits<double>::max();
-    DBG_ASSERT(BoardConsistent());
+    DBG_ASSERT(trainer.Board().GetHashCode() == opponent.Board().GetHashCode());
     trainerMove =
-        m_trainer.SearchAgainstAndSync(trainColor, maxTime, tau, 0, 0, false);
-    if (ShouldStop(trainColor, trainerMove, oppMove, steps, trainerWin))
+        trainer.SearchAgainstAndSync(trainColor, maxTime, tau, 0, 0, false);
+    if (ShouldStop(trainer, opponent, trainColor, trainerMove, oppMove, steps, trainerWin))
       break;
-    m_opponent.SyncState(trainerMove, trainColor);
+    opponent.SyncState(trainerMove, trainColor);
 
-    oppMove = m_opponent.SearchAgainstAndSync(oppColor, maxTime, tau, 0, 0, false);
-    if (ShouldStop(trainColor, trainerMove, oppMove, steps, trainerWin))
+    oppMove = opponent.SearchAgainstAndSync(oppColor, maxTime, tau, 0, 0, false);
+    if (ShouldStop(trainer, opponent, trainColor, trainerMove, oppMove, steps, trainerWin))
       break;
-    m_trainer.SyncState(oppMove, oppColor);
+    trainer.SyncState(oppMove, oppColor);
 
     ++steps;
 #ifndef NDEBUG
@@ -337,7 +470,7 @@ bool UctDeepTrainer::EvalPlayNetworkModel(int gameID) {
 #endif
   }
 
-  SaveSgf(&m_trainGame);
+  SaveSgf(&trainGame, gameID);
 
 #ifndef NDEBUG
   std::string result = ((trainColor == SG_BLACK && trainerWin) || (trainColor == SG_WHITE && !trainerWin)) ? "B+"
@@ -348,6 +481,73 @@ bool UctDeepTrainer::EvalPlayNetworkModel(int gameID) {
   return trainerWin;
 }
 
+bool UctDeepTrainer::EvalPlayConcurrently(const std::string &checkpoint, int maxGames, int numMatches,
+                                          float &wins) {
+  const std::string bestCheckPoint = m_trainer.Search().getCheckPoint();
+  if (bestCheckPoint.empty()) {
+    SgDebug() << "DeepTrainer: no best checkpoint to gate " << checkpoint << " against\n";
+    return false;
+  }
+  DlConfig &config = DlConfig::GetInstance();
+  UctBoardEvaluator best(false);
+  UctBoardEvaluator candidate(false);
+  best.LoadGraph(config.get_metagraph());
+  candidate.LoadGraph(config.get_metagraph());
+  best.UpdateCheckPoint(bestCheckPoint);
+  candidate.UpdateCheckPoint(checkpoint);
+
+  const std::string server = "gating-" + std::to_string(getpid());
+  UctInferenceServer inferenceServer(server,
+                                     boost::bind(&UctBoardEvaluator::EvaluateState, &best, _1, _2, _3, _4));
+  inferenceServer.AddModel(boost::bind(&UctBoardEvaluator::EvaluateState, &candidate, _1, _2, _3, _4));
+  inferenceServer.SetBatchWait(config.get_inference_batchwait());
+  boost::thread serverThread(boost::bind(&UctInferenceServer::Run, &inferenceServer));
+
+  std::atomic<int> nextGame(0);
+  std::atomic<int> bestWins(0);
+  boost::thread_group matches;
+  for (int i = 0; i < numMatches; ++i)
+    matches.create_thread(boost::bind(&UctDeepTrainer::PlayGatingMatch, this, server, maxGames,
+                                      &nextGame, &bestWins));
+  matches.join_all();
+  inferenceServer.Stop();
+  serverThread.join();
+  SgDebug() << "DeepTrainer: " << numMatches << " gating matches, "
+            << inferenceServer.NuPositions() << " positions in "
+            << inferenceServer.NuBatches() << " batches\n";
+  wins = float(bestWins);
+  return true;
+}
+
+void UctDeepTrainer::PlayGatingMatch(const std::string &server, int maxGames,
+                                     std::atomic<int> *nextGame, std::atomic<int> *wins) {
+  GoGame trainGame(m_trainGame.Board().Size());
+  GoGame oppGame(m_oppGame.Board().Size());
+  UctDeepPlayer trainer(trainGame, m_engineRules);
+  UctDeepPlayer opponent(oppGame, m_engineRules);
+  trainer.Search().SetNumberThreads(m_trainer.Search().NumberThreads());
+  trainer.Search().SetMaxNodes(m_trainer.Search().MaxNodes());
+  trainer.Search().SetInferenceServer(server, 0);
+  opponent.Search().SetNumberThreads(m_opponent.Search().NumberThreads());
+  opponent.Search().SetMaxNodes(m_opponent.Search().MaxNodes());
+  opponent.Search().SetInferenceServer(server, 1);
+  {
+    boost::mutex::scoped_lock lock(m_gatingMutex);
+    m_gatingPlayers.push_back(&trainer);
+    m_gatingPlayers.push_back(&opponent);
+  }
+  for (int gameID = (*nextGame)++; gameID < maxGames && !m_quit; gameID = (*nextGame)++) {
+    // Each match alternates colors, so the colors of all games are balanced
+    if (PlayGatingGame(trainer, opponent, trainGame, gameID % 2, gameID))
+      ++*wins;
+  }
+  boost::mutex::scoped_lock lock(m_gatingMutex);
+  m_gatingPlayers.erase(std::remove(m_gatingPlayers.begin(), m_gatingPlayers.end(), &trainer),
+                        m_gatingPlayers.end());
+  m_gatingPlayers.erase(std::remove(m_gatingPlayers.begin(), m_gatingPlayers.end(), &opponent),
+                        m_gatingPlayers.end());
+}
+
 void UctDeepTrainer::EvalPlayAsClient() {
   if (!DlCheckPoint::DownloadMetagraph())
     return;
@@ -369,10 +569,15 @@ void UctDeepTrainer::EvalPlayAsClient() {
       if (bestCheckPoint.sha1 != latestCheckPoint.sha1) {
         SgDebug() << "evaluating " << bestCheckPoint.sha1 << " vs " << latestCheckPoint.sha1 << "\n";
         bool trainerWin = EvalPlayNetworkModel(cnt);
-        std::string result = bestCheckPoint.sha1 + "/" + bestCheckPoint.name + ":" +
-            latestCheckPoint.sha1 + "/" + latestCheckPoint.name +
-            (trainerWin ? "1" : "0");
-        ZmqUtil::sendData(m_evalres_socket, result);
+        UnrealGo::Command result;
+        result.set_type(ZmqUtil::CMD_EVAL_RESULT);
+        UnrealGo::EvalResult *evalResult = result.mutable_eval_result();
+        evalResult->mutable_best()->set_sha1(bestCheckPoint.sha1);
+        evalResult->mutable_best()->set_name(bestCheckPoint.name);
+        evalResult->mutable_latest()->set_sha1(latestCheckPoint.sha1);
+        evalResult->mutable_latest()->set_name(latestCheckPoint.name);
+        evalResult->set_best_won(trainerWin);
+        ZmqUtil::send_message(m_evalres_socket, result);
         SgDebug() << "game result uploaded\n";
       } else if (!bestCheckPoint.sha1.empty()) {
         SgDebug() << "selfplaying checkpoint: " << bestCheckPoint.sha1 << "\n";
@@ -388,34 +593,46 @@ void UctDeepTrainer::EvalPlayAsClient() {
 void UctDeepTrainer::EvalPlayAsServer(const std::string &checkpoint) {
   float winCount = 0;
   int maxGames = 400;
-  if (!checkpoint.empty()) {
-    m_opponent.Search().UpdateCheckPoint(checkpoint);
-  }
-
-  for (int i = 0; i < maxGames; i++) {
-    winCount += EvalPlayNetworkModel(i) ? 1.0f : 0.0f;
+  bool gated = true;
+  const int numMatches = DlConfig::GetInstance().get_gating_matches();
+  if (numMatches > 1) {
+    // The matches have their own evaluators, m_opponent is not used
+    gated = EvalPlayConcurrently(checkpoint, maxGames, numMatches, winCount);
+  } else {
+    if (!checkpoint.empty())
+      m_opponent.Search().UpdateCheckPoint(checkpoint);
+    for (int i = 0; i < maxGames && !m_quit; i++) {
+      winCount += EvalPlayNetworkModel(i) ? 1.0f : 0.0f;
 #ifndef NDEBUG
-    SgDebug() << "DeepTrainer::Eval real-time winRate " << (winCount / (i + 1)) << '\n';
+      SgDebug() << "DeepTrainer::Eval real-time winRate " << (winCount / (i + 1)) << '\n';
 #endif
+    }
   }
 
   float winRate = winCount / maxGames;
-  if (winRate < 0.45f) {
+  if (gated && winRate < 0.45f) {
     m_trainer.Search().UpdateCheckPoint(checkpoint);
     DlCheckPoint::UpdateBestCheckPointList(checkpoint);
     DlCheckPoint::WriteBestCheckpointInfo(checkpoint);
+    if (m_checkpointNotifier)
+      m_checkpointNotifier->Publish(CheckPointCommand(ZmqUtil::CMD_BEST_CKP, checkpoint));
   }
 
-  if (m_selfplay)
+  if (m_selfplay && m_evalMode != EVAL_PIPELINED)
     m_selfplayThread->NotifyExecuteCommand();
 }
 
 bool UctDeepTrainer::ShouldStop(SgBlackWhite trainColor, GoMove trainerMove, GoMove oppMove, int steps,
                                   bool &trainerWin) {
+  return ShouldStop(m_trainer, m_opponent, trainColor, trainerMove, oppMove, steps, trainerWin);
+}
+
+bool UctDeepTrainer::ShouldStop(UctDeepPlayer &trainer, UctDeepPlayer &opponent, SgBlackWhite trainColor,
+                                GoMove trainerMove, GoMove oppMove, int steps, bool &trainerWin) {
   if (trainerMove == UCT_RESIGN || oppMove == UCT_RESIGN || (trainerMove == GO_PASS && oppMove == GO_PASS) ||
       steps >= GO_MAX_NUM_MOVES) {
-    UctValueType trainerScore = m_trainer.Search().EstimateGameScore();
-    UctValueType oppScore = m_opponent.Search().EstimateGameScore();
+    UctValueType trainerScore = trainer.Search().EstimateGameScore();
+    UctValueType oppScore = opponent.Search().EstimateGameScore();
     SuppressUnused(oppScore);
     if (trainerMove == oppMove) {
       DBG_ASSERT(trainerScore == oppScore);
@@ -427,13 +644,16 @@ bool UctDeepTrainer::ShouldStop(SgBlackWhite trainColor, GoMove trainerMove, GoM
   return false;
 }
 
-void UctDeepTrainer::SaveSgf(GoGame *game) {
+void UctDeepTrainer::SaveSgf(GoGame *game, int gameID) {
   time_t timeValue = time(nullptr);
   struct tm *timeStruct = localtime(&timeValue);
   char timeBuffer[128];
   strftime(timeBuffer, sizeof(timeBuffer), "%Y%m%d%H%M%S", timeStruct);
   std::ostringstream stream;
-  stream << "evaluate_" << timeBuffer << ".sgf";
+  stream << "evaluate_" << timeBuffer;
+  if (gameID >= 0)
+    stream << "_" << gameID;
+  stream << ".sgf";
   std::string outFileName = m_evalPath + "/" + stream.str();
   std::ofstream out(outFileName);
   SgGameWriter writer(out);
@@ -468,6 +688,33 @@ void UctDeepTrainer::SelfPlayGamesServerMode() {
   }
 }
 
+void UctDeepTrainer::SelfPlayGamesPipelined() {
+  if (!m_selfPlayer) {
+    m_selfPlayGame.reset(new GoGame(m_trainGame.Board().Size()));
+    m_selfPlayer.reset(new UctDeepPlayer(*m_selfPlayGame, m_engineRules));
+  }
+  DlConfig &config = DlConfig::GetInstance();
+  ZmqCreditSender trainQueue(m_ctx, config.get_trainqueue_socket());
+  ZmqSubscriber checkpoints(m_ctx, config.get_checkpointnotify_socket());
+  UnrealGo::Command best;
+  while (!m_quit) {
+    if (checkpoints.Latest(ZmqUtil::CMD_BEST_CKP, best)) {
+      const std::string checkpoint = ZmqUtil::checkpoint_name(best);
+      SgDebug() << "DeepTrainer: self-play switches to " << checkpoint << '\n';
+      m_selfPlayer->Search().UpdateCheckPoint(checkpoint);
+    }
+    m_selfPlayer->SetLogReuse(true);
+    std::string path = m_selfPlayer->SelfPlayAsServer(m_roundID);
+    if (path[0] != '/') {
+      path = UnrealGo::GetCWD() + "/" + path;
+    }
+    const UnrealGo::Command item = TrainCommand(path, m_roundID, m_selfPlayer->Search().getCheckPoint());
+    m_roundID++;
+    // Blocks while the trainer is behind by the capacity of the queue
+    while (!m_quit && !trainQueue.Send(item, 1000)) {}
+  }
+}
+
 void UctDeepTrainer::SelfPlayGamesClientMode() {
   m_trainer.SetLogReuse(false);
   m_trainer.SelfPlayAsClient();
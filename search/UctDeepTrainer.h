@@ -2,6 +2,7 @@
 #ifndef SG_UCT_DEEPTRAINER_H
 #define SG_UCT_DEEPTRAINER_H
 
+#include <atomic>
 #include <boost/scoped_array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/barrier.hpp>
@@ -21,11 +22,15 @@
 #include "lib/SgRandom.h"
 #include "funcapproximator/DlTFRecordWriter.h"
 #include "UctDeepPlayer.h"
+#include "msg/ZmqPipeline.h"
 
 enum EvalMode {
   EVAL_FROM_CLIENT,
   EVAL_FROM_SERVER,
-  EVAL_FROM_SERVER_MSG
+  EVAL_FROM_SERVER_MSG,
+  /** Self-play, training and gating run at the same time, see
+      StartPipeline(). */
+  EVAL_PIPELINED
 };
 
 class UctDeepTrainer {
@@ -37,14 +42,30 @@ class UctDeepTrainer {
   void StartTrainEvalPipeLine(bool withSelfplay = false, EvalMode evalMode = EVAL_FROM_CLIENT);
   void StartSelfPlay(bool uploadSgf = true);
   void SelfPlayGamesServerMode();
+  /** Play rounds of self-play games with a separate player until quit.
+      Waits while the training queue is full and switches to each new best
+      checkpoint between the rounds. */
+  void SelfPlayGamesPipelined();
+  /** Evaluate each new checkpoint of the trainer, skipping the ones that
+      were superseded while a gating match ran. */
+  void PipelinedEvalLoop();
   void SelfPlayGamesClientMode();
   void SvrEvalLoop();
   void EvalPlayAsServer(const std::string &checkpoint);
   void EvalPlayAsClient();
   bool EvalPlayNetworkModel(int gameID);
+  /** Play maxGames gating games, numMatches at a time, each match with its
+      own pair of players. One UctInferenceServer in this process hosts the
+      best model and the candidate, so the positions of all matches are
+      evaluated in shared batches. The best model is the checkpoint of
+      m_trainer, like in EvalPlayNetworkModel().
+      @param[out] wins The number of games the best model won
+      @return false if m_trainer has no checkpoint */
+  bool EvalPlayConcurrently(const std::string &checkpoint, int maxGames, int numMatches,
+                            float &wins);
   bool BoardConsistent();
   bool ShouldStop(SgBlackWhite trainColor, GoMove trainerMove, GoMove oppMove, int steps, bool &trainerWin);
-  void SaveSgf(GoGame *game);
+  void SaveSgf(GoGame *game, int gameID = -1);
   bool IsSelfPlayRunning();
   class SelfPlayThread {
    public:
@@ -136,6 +157,22 @@ class UctDeepTrainer {
   };
 
  private:
+  /** Queue, notifier and train data dispatch of EVAL_PIPELINED. Self-play
+      sends each finished round to the training queue through a
+      ZmqCreditSender, the dispatch thread passes them to the trainer one
+      at a time, and new and promoted checkpoints are published through
+      the notifier instead of polling the file system. */
+  void StartPipeline();
+  void DispatchTrainingData();
+  bool PlayGatingGame(UctDeepPlayer &trainer, UctDeepPlayer &opponent, GoGame &trainGame,
+                      SgBlackWhite trainColor, int gameID);
+  bool ShouldStop(UctDeepPlayer &trainer, UctDeepPlayer &opponent, SgBlackWhite trainColor,
+                  GoMove trainerMove, GoMove oppMove, int steps, bool &trainerWin);
+  /** Play games of a concurrent gating match until nextGame reaches
+      maxGames. */
+  void PlayGatingMatch(const std::string &server, int maxGames,
+                       std::atomic<int> *nextGame, std::atomic<int> *wins);
+
   bool m_quit;
   bool m_selfplay;
   EvalMode m_evalMode;
@@ -154,6 +191,14 @@ class UctDeepTrainer {
   GoRules &m_engineRules;
   int m_roundID;
   std::string m_evalPath;
+  std::unique_ptr<ZmqWorkQueue> m_trainQueue;
+  std::unique_ptr<ZmqNotifier> m_checkpointNotifier;
+  boost::thread m_dispatchThread;
+  std::unique_ptr<GoGame> m_selfPlayGame;
+  std::unique_ptr<UctDeepPlayer> m_selfPlayer;
+  /** Players of the concurrent gating matches, to abort them. */
+  boost::mutex m_gatingMutex;
+  std::vector<UctDeepPlayer *> m_gatingPlayers;
 };
 
 #endif // SG_UCT_DEEPTRAINER_H
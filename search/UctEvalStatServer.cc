@@ -1,10 +1,18 @@
 
-#include <boost/lexical_cast.hpp>
+#include <memory>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include "UctEvalStatServer.h"
 #include "../lib/FileUtil.h"
-#include "../lib/StringUtil.h"
 #include "funcapproximator/DlCheckPoint.h"
 #include "platform/SgDebug.h"
+#include "msg/ZmqPipeline.h"
+
+namespace {
+
+/** Milliseconds between snapshots of the evaluation results. */
+const long SNAPSHOT_INTERVAL = 10000;
+
+}
 
 static void Notify(boost::mutex &aMutex, boost::condition &aCondition) {
   boost::mutex::scoped_lock lock(aMutex);
@@ -50,64 +58,52 @@ UctEvalStatServer::UctEvalStatServer() :
 void UctEvalStatServer::ProcessRequest() {
   m_socket.bind(DlConfig::GetInstance().get_evalstatslisten_socket());
   SgDebug() << "CheckPoint Evaluation Stat Sever Started\n";
-  zmq::message_t reply;
-  memcpy(reply.data(), "updated", 7);
   std::string minio_path = DlConfig::GetInstance().get_minio_path();
-  // std::string evalResFileName = UnrealGo::GetFullPathStr(minio_path, DlConfig::GetInstance().get_checkeval_subpath());
+  // Game results are counted in memory and only snapshotted, instead of
+  // reading and writing a file for each game
+  const std::string snapshot = DlConfig::GetInstance().get("evalstatsnapshot", minio_path + "/evalstats.snapshot");
+  if (m_stats.Load(snapshot))
+    SgDebug() << "Loaded " << m_stats.NuPairs() << " evaluation pairs from " << snapshot << "\n";
+  boost::posix_time::ptime lastSave = boost::posix_time::microsec_clock::universal_time();
 
   while (!m_quit) {
-    zmq::message_t request;
-    m_socket.recv(&request);
-
-    if (request.size() > 0) {
-      std::string msg((const char *) request.data(), request.size());
-      std::vector<std::string> splits;
-      UnrealGo::StringUtil::Split(msg, ":", splits);
-      if (splits.size() >= 3 && splits[0] != splits[1]) {
-        DlCheckPoint::CheckPointInfo best(splits[0], "/");
-        DlCheckPoint::CheckPointInfo latest(splits[1], "/");
-
-        int bestWinCnt = 0;
-        int total = 0;
-        std::vector<std::string> lines;
-        std::string evalResFileName = UnrealGo::GetFullPathStr(minio_path, best.sha1 + "-" + latest.sha1);
-        UnrealGo::ReadLines(evalResFileName, lines);
-        if (lines.size() >= 2) {
-          bestWinCnt = boost::lexical_cast<int>(lines[0]);
-          total = boost::lexical_cast<int>(lines[1]);
-        }
-        if (splits[2] == "1")
-          bestWinCnt++;
-        total++;
-
-        lines.clear();
-        float winRate = (float) bestWinCnt * 1.0f / total;
-        if (total >= 500) {
-          if (winRate < 0.45f) {
-            DlCheckPoint::UpdateBestCheckPointList(latest);
-            DlCheckPoint::WriteBestCheckpointInfo(latest);
-            // TODO delete evalResFileName file
-          }
-          DlCheckPoint::WriteLatestCheckPointInfo(); // write latest checkpoint info
-        } else {
-          lines.push_back(std::to_string(bestWinCnt));
-          lines.push_back(std::to_string(total));
-          UnrealGo::WriteLines(evalResFileName, lines);
-        }
-
-        /*if (total >= 500 && winRate < 0.45f) {
-            DlCheckPoint::UpdateBestCheckPointList(latest);
-            DlCheckPoint::WriteBestCheckpointInfo(latest);
-            DlCheckPoint::WriteLatestCheckPointInfo();
-        } else {
-          lines.push_back(std::to_string(bestWinCnt));
-          lines.push_back(std::to_string(total));
-          UnrealGo::WriteLines(evalResFileName, lines);
-        }*/
-      }
+    zmq::pollitem_t item = {(void *) m_socket, 0, ZMQ_POLLIN, 0};
+    if (zmq::poll(&item, 1, SNAPSHOT_INTERVAL) > 0) {
+      zmq::message_t request;
+      m_socket.recv(&request);
+      UnrealGo::EvalResult result;
+      if (UctEvalStatUtil::ParseRequest(request.data(), request.size(), result)
+          && result.best().sha1() != result.latest().sha1())
+        AddResult(result);
+      zmq::message_t reply(7);
+      memcpy(reply.data(), "updated", 7);
+      m_socket.send(reply);
     }
 
-    m_socket.send(reply);
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if (m_stats.IsModified() && (now - lastSave).total_milliseconds() >= SNAPSHOT_INTERVAL) {
+      if (!m_stats.Save(snapshot))
+        SgDebug() << "Could not write " << snapshot << "\n";
+      lastSave = now;
+    }
+  }
+  if (m_stats.IsModified())
+    m_stats.Save(snapshot);
+}
+
+void UctEvalStatServer::AddResult(const UnrealGo::EvalResult &result) {
+  DlCheckPoint::CheckPointInfo latest;
+  latest.sha1 = result.latest().sha1();
+  latest.name = result.latest().name();
+  const UctEvalStatStore::Result stat = m_stats.Add(result.best().sha1(), latest.sha1, result.best_won());
+  if (stat.m_total >= 500) {
+    float winRate = (float) stat.m_bestWins / stat.m_total;
+    if (winRate < 0.45f) {
+      DlCheckPoint::UpdateBestCheckPointList(latest);
+      DlCheckPoint::WriteBestCheckpointInfo(latest);
+    }
+    DlCheckPoint::WriteLatestCheckPointInfo(); // write latest checkpoint info
+    m_stats.Erase(result.best().sha1(), latest.sha1);
   }
 }
 
@@ -160,6 +156,11 @@ void UctEvalStatServer::CPUpdateThread::setQuit(bool quit) {
 }
 
 void UctEvalStatServer::ProcessUpdate() {
+  // Wake up on checkpoint notifications, polling only as a fallback
+  const std::string notifySocket = DlConfig::GetInstance().get("checkpointnotifyconnectsocket", "");
+  std::unique_ptr<ZmqSubscriber> checkpoints;
+  if (!notifySocket.empty())
+    checkpoints.reset(new ZmqSubscriber(m_ctx, notifySocket));
   while (!m_quit) {
     std::string latestCK = UnrealGo::ExtractFileName(DlCheckPoint::getLatestCheckPointPrefix());
     DlCheckPoint::CheckPointInfo best;
@@ -174,6 +175,10 @@ void UctEvalStatServer::ProcessUpdate() {
     if (best.sha1.empty() && !latestCK.empty())
       DlCheckPoint::WriteBestCheckpointInfo(latestCK);
 
-    sleep(60);
+    UnrealGo::Command command;
+    if (checkpoints)
+      checkpoints->Receive(command, 60000);
+    else
+      sleep(60);
   }
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <zmq.hpp>
+#include "UctEvalStatStore.h"
 
 class UctEvalStatServer {
  public:
@@ -85,6 +86,9 @@ class UctEvalStatServer {
  private:
   zmq::context_t m_ctx;
   zmq::socket_t m_socket;
+  UctEvalStatStore m_stats;
+
+  void AddResult(const UnrealGo::EvalResult &result);
 };
 
 #endif
@@ -0,0 +1,118 @@
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "UctEvalStatStore.h"
+#include "msg/ZmqUtil.h"
+#include "lib/StringUtil.h"
+
+UctEvalStatStore::Result::Result() :
+    m_bestWins(0),
+    m_total(0) {}
+
+UctEvalStatStore::UctEvalStatStore() :
+    m_modified(false) {}
+
+UctEvalStatStore::Result UctEvalStatStore::Add(const std::string &best,
+                                               const std::string &latest,
+                                               bool bestWon) {
+  boost::mutex::scoped_lock lock(m_mutex);
+  Result &result = m_results[Pair(best, latest)];
+  if (bestWon)
+    ++result.m_bestWins;
+  ++result.m_total;
+  m_modified = true;
+  return result;
+}
+
+UctEvalStatStore::Result UctEvalStatStore::Get(const std::string &best,
+                                               const std::string &latest) const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  auto it = m_results.find(Pair(best, latest));
+  return it == m_results.end() ? Result() : it->second;
+}
+
+void UctEvalStatStore::Erase(const std::string &best,
+                             const std::string &latest) {
+  boost::mutex::scoped_lock lock(m_mutex);
+  if (m_results.erase(Pair(best, latest)) > 0)
+    m_modified = true;
+}
+
+std::size_t UctEvalStatStore::NuPairs() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_results.size();
+}
+
+bool UctEvalStatStore::IsModified() const {
+  boost::mutex::scoped_lock lock(m_mutex);
+  return m_modified;
+}
+
+bool UctEvalStatStore::Save(const std::string &fileName) {
+  std::ostringstream buffer;
+  {
+    boost::mutex::scoped_lock lock(m_mutex);
+    for (const auto &entry : m_results)
+      buffer << entry.first.first << ' ' << entry.first.second << ' '
+             << entry.second.m_bestWins << ' ' << entry.second.m_total << '\n';
+    m_modified = false;
+  }
+  const std::string tmpName = fileName + ".tmp";
+  {
+    std::ofstream out(tmpName.c_str());
+    out << buffer.str();
+    if (!out.flush()) {
+      boost::mutex::scoped_lock lock(m_mutex);
+      m_modified = true;
+      return false;
+    }
+  }
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+bool UctEvalStatStore::Load(const std::string &fileName) {
+  std::ifstream in(fileName.c_str());
+  if (!in)
+    return false;
+  std::map<Pair, Result> results;
+  std::string best, latest;
+  Result result;
+  while (in >> best >> latest >> result.m_bestWins >> result.m_total)
+    results[Pair(best, latest)] = result;
+  boost::mutex::scoped_lock lock(m_mutex);
+  m_results.swap(results);
+  m_modified = false;
+  return true;
+}
+
+namespace {
+
+void ParseCheckPoint(const std::string &text, UnrealGo::CheckPointRef &ref) {
+  const std::string::size_type pos = text.find('/');
+  ref.set_sha1(text.substr(0, pos));
+  ref.set_name(pos == std::string::npos ? "" : text.substr(pos + 1));
+}
+
+}
+
+bool UctEvalStatUtil::ParseRequest(const void *data, std::size_t size,
+                                   UnrealGo::EvalResult &result) {
+  UnrealGo::Command command;
+  if (command.ParseFromArray(data, (int) size)
+      && command.type() == ZmqUtil::CMD_EVAL_RESULT
+      && command.has_eval_result()) {
+    result = command.eval_result();
+    return true;
+  }
+  std::vector<std::string> splits;
+  UnrealGo::StringUtil::Split(std::string((const char *) data, size), ":",
+                              splits);
+  if (splits.size() < 3 || (splits[2] != "0" && splits[2] != "1"))
+    return false;
+  ParseCheckPoint(splits[0], *result.mutable_best());
+  ParseCheckPoint(splits[1], *result.mutable_latest());
+  result.set_best_won(splits[2] == "1");
+  return true;
+}
@@ -0,0 +1,66 @@
+
+#ifndef SG_UCT_EVALSTATSTORE_H
+#define SG_UCT_EVALSTATSTORE_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <boost/thread/mutex.hpp>
+#include "msg/command.pb.h"
+
+/** Wins of the best checkpoint against the latest checkpoint, for each pair
+    of checkpoints that play gating games.
+    The results are kept in memory and written to a snapshot file with
+    Save(), so adding a game result does not touch the disk. Thread-safe. */
+class UctEvalStatStore {
+ public:
+  struct Result {
+    Result();
+    int m_bestWins;
+    int m_total;
+  };
+
+  UctEvalStatStore();
+
+  /** Add the result of one game.
+      @return The results of the pair including this game */
+  Result Add(const std::string &best, const std::string &latest,
+             bool bestWon);
+
+  Result Get(const std::string &best, const std::string &latest) const;
+
+  /** Forget a pair, for instance after it was decided. */
+  void Erase(const std::string &best, const std::string &latest);
+
+  std::size_t NuPairs() const;
+
+  /** Whether there are changes since the last Save() or Load(). */
+  bool IsModified() const;
+
+  /** Write all pairs, one per line, through a temporary file that is
+      renamed, so a crash leaves the last snapshot intact.
+      @return false if the file could not be written */
+  bool Save(const std::string &fileName);
+
+  /** Replace the pairs with the ones in a snapshot.
+      @return false if the file could not be read */
+  bool Load(const std::string &fileName);
+
+ private:
+  typedef std::pair<std::string, std::string> Pair;
+  mutable boost::mutex m_mutex;
+  std::map<Pair, Result> m_results;
+  bool m_modified;
+};
+
+namespace UctEvalStatUtil {
+/** Decode a request to the stat server: a Command with an EvalResult, or
+    the older text format "bestSha1/bestName:latestSha1/latestName:won",
+    where won is "1" if the best checkpoint won.
+    @return false if the request is neither */
+bool ParseRequest(const void *data, std::size_t size,
+                  UnrealGo::EvalResult &result);
+}
+
+#endif // SG_UCT_EVALSTATSTORE_H
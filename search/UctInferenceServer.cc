@@ -0,0 +1,495 @@
+
+#include "platform/SgSystem.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "UctInferenceServer.h"
+#include "platform/SgDebug.h"
+
+namespace {
+
+const uint32_t SEGMENT_MAGIC = 0x55474932;
+
+const int NU_SLOTS = 32;
+
+/** Longest wait in Run() before it checks for Stop() again. */
+const int POLL_INTERVAL = 1000;
+
+/** A client gives up if the server is gone or after this many seconds
+    without an answer, which covers loading a checkpoint. */
+const int REPLY_TIMEOUT = 120;
+
+const std::size_t FEATURE_BYTES = FEATURE_SIZE;
+
+const std::size_t POLICY_BYTES = GO_MAX_MOVES * sizeof(UctValueType);
+
+enum SlotState {
+  SLOT_IDLE,
+  SLOT_REQUEST,
+  SLOT_BUSY,
+  SLOT_DONE
+};
+
+enum MessageType {
+  MSG_EVALUATE,
+  MSG_CHECKPOINT
+};
+
+/** Leads every ZMQ request; followed by count features or the name of the
+    checkpoint. The answer to MSG_EVALUATE is count policies and values. */
+struct MessageHeader {
+  int32_t m_type;
+  int32_t m_count;
+  int32_t m_model;
+};
+
+bool ProcessAlive(int pid) {
+  return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+timespec Deadline(long microseconds) {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += microseconds / 1000000;
+  ts.tv_nsec += (microseconds % 1000000) * 1000;
+  if (ts.tv_nsec >= 1000000000) {
+    ++ts.tv_sec;
+    ts.tv_nsec -= 1000000000;
+  }
+  return ts;
+}
+
+bool Readable(zmq::socket_t &socket, long timeout) {
+  zmq::pollitem_t item = {(void *) socket, 0, ZMQ_POLLIN, 0};
+  return zmq::poll(&item, 1, timeout) > 0 && (item.revents & ZMQ_POLLIN);
+}
+
+}
+
+/** The owner of a slot is the pid of a client process; 0 if the slot is
+    free. Slots of dead processes are taken over by new clients. */
+struct UctInferenceSlot {
+  std::atomic<int> m_owner;
+  std::atomic<int> m_state;
+  sem_t m_done;
+  int m_count;
+  int m_model;
+  char m_feature[MAX_BATCHES][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE];
+  UctValueType m_policy[MAX_BATCHES][GO_MAX_MOVES];
+  UctValueType m_value[MAX_BATCHES];
+};
+
+struct UctInferenceSegment {
+  uint32_t m_magic;
+  int m_serverPid;
+  sem_t m_doorbell;
+  UctInferenceSlot m_slots[NU_SLOTS];
+};
+
+std::string UctInferenceUtil::SharedMemoryName(const std::string &name) {
+  if (name.find("://") != std::string::npos)
+    return "";
+  std::string shmName = "/unrealgo-infer-" + name;
+  for (std::size_t i = 1; i < shmName.size(); ++i)
+    if (shmName[i] == '/')
+      shmName[i] = '_';
+  return shmName;
+}
+
+std::string UctInferenceUtil::ZmqEndpoint(const std::string &name) {
+  if (name.find("://") != std::string::npos)
+    return name;
+  return "ipc:///tmp/unrealgo-infer-" + name + ".ipc";
+}
+
+struct UctInferenceServer::Request {
+  /** Slot in the shared memory segment, -1 for a ZMQ request. */
+  int m_slot;
+  int m_model;
+  int m_count;
+  std::string m_identity;
+  std::string m_data;
+};
+
+UctInferenceServer::UctInferenceServer(const std::string &name,
+                                       const UctBatchFunction &evaluate,
+                                       const UctCheckPointFunction &updateCheckPoint) :
+    m_shmName(UctInferenceUtil::SharedMemoryName(name)),
+    m_segment(nullptr),
+    m_context(1),
+    m_socket(m_context, ZMQ_ROUTER),
+    m_batchWait(200),
+    m_quit(false),
+    m_nuBatches(0),
+    m_nuPositions(0),
+    m_feature(new char[MAX_BATCHES][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE]),
+    m_policy(new UctValueType[MAX_BATCHES][GO_MAX_MOVES]) {
+  AddModel(evaluate, updateCheckPoint);
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  m_socket.bind(UctInferenceUtil::ZmqEndpoint(name));
+  if (!m_shmName.empty())
+    CreateSharedMemory();
+  SgDebug() << "UctInferenceServer: " << UctInferenceUtil::ZmqEndpoint(name)
+            << (m_segment ? ", shared memory " + m_shmName : "") << '\n';
+}
+
+UctInferenceServer::~UctInferenceServer() {
+  if (m_segment) {
+    munmap(m_segment, sizeof(UctInferenceSegment));
+    shm_unlink(m_shmName.c_str());
+  }
+}
+
+void UctInferenceServer::CreateSharedMemory() {
+  // A segment left by a server that died is replaced; its clients notice
+  // that its pid is gone
+  shm_unlink(m_shmName.c_str());
+  int fd = shm_open(m_shmName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0) {
+    SgDebug() << "UctInferenceServer: no shared memory: " << strerror(errno) << '\n';
+    return;
+  }
+  void *addr = MAP_FAILED;
+  if (ftruncate(fd, sizeof(UctInferenceSegment)) == 0)
+    addr = mmap(nullptr, sizeof(UctInferenceSegment), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    shm_unlink(m_shmName.c_str());
+    return;
+  }
+  UctInferenceSegment *segment = new(addr) UctInferenceSegment;
+  segment->m_serverPid = getpid();
+  sem_init(&segment->m_doorbell, 1, 0);
+  for (UctInferenceSlot &slot : segment->m_slots) {
+    slot.m_owner = 0;
+    slot.m_state = SLOT_IDLE;
+    sem_init(&slot.m_done, 1, 0);
+  }
+  // Clients only attach to a segment with the magic number set
+  std::atomic_thread_fence(std::memory_order_release);
+  segment->m_magic = SEGMENT_MAGIC;
+  m_segment = segment;
+}
+
+int UctInferenceServer::AddModel(const UctBatchFunction &evaluate,
+                                 const UctCheckPointFunction &updateCheckPoint) {
+  Model model;
+  model.m_evaluate = evaluate;
+  model.m_updateCheckPoint = updateCheckPoint;
+  m_models.push_back(model);
+  return int(m_models.size()) - 1;
+}
+
+void UctInferenceServer::SetBatchWait(int microseconds) {
+  m_batchWait = microseconds;
+}
+
+void UctInferenceServer::Stop() {
+  m_quit = true;
+}
+
+bool UctInferenceServer::HasSharedMemory() const {
+  return m_segment != nullptr;
+}
+
+std::size_t UctInferenceServer::NuBatches() const {
+  return m_nuBatches;
+}
+
+std::size_t UctInferenceServer::NuPositions() const {
+  return m_nuPositions;
+}
+
+void UctInferenceServer::Run() {
+  typedef std::chrono::steady_clock Clock;
+  while (!m_quit) {
+    std::vector<Request> requests;
+    if (Collect(requests) == 0) {
+      WaitForRequests(POLL_INTERVAL);
+      continue;
+    }
+    const Clock::time_point deadline = Clock::now() + std::chrono::microseconds(m_batchWait);
+    while (MaxModelRows(requests) < MAX_BATCHES) {
+      const long left = std::chrono::duration_cast<std::chrono::microseconds>(
+          deadline - Clock::now()).count();
+      if (left <= 0)
+        break;
+      if (WaitForRequests((int) left))
+        Collect(requests);
+    }
+    Evaluate(requests);
+  }
+}
+
+int UctInferenceServer::Collect(std::vector<Request> &requests) {
+  // ZMQ first, so that a checkpoint is loaded before the requests that
+  // follow it in shared memory
+  const int rows = ReceiveZmq(requests);
+  return rows + CollectSharedMemory(requests);
+}
+
+int UctInferenceServer::MaxModelRows(const std::vector<Request> &requests) const {
+  std::vector<int> rows(m_models.size(), 0);
+  for (const Request &request : requests)
+    rows[request.m_model] += request.m_count;
+  return *std::max_element(rows.begin(), rows.end());
+}
+
+int UctInferenceServer::CollectSharedMemory(std::vector<Request> &requests) {
+  if (!m_segment)
+    return 0;
+  while (sem_trywait(&m_segment->m_doorbell) == 0);
+  int rows = 0;
+  for (int i = 0; i < NU_SLOTS; ++i) {
+    UctInferenceSlot &slot = m_segment->m_slots[i];
+    int state = SLOT_REQUEST;
+    if (!slot.m_state.compare_exchange_strong(state, SLOT_BUSY))
+      continue;
+    if (slot.m_count < 1 || slot.m_count > MAX_BATCHES
+        || slot.m_model < 0 || slot.m_model >= int(m_models.size())) {
+      slot.m_count = 0;
+      slot.m_state = SLOT_DONE;
+      sem_post(&slot.m_done);
+      continue;
+    }
+    Request request = {i, slot.m_model, slot.m_count, "", ""};
+    requests.push_back(request);
+    rows += slot.m_count;
+  }
+  return rows;
+}
+
+int UctInferenceServer::ReceiveZmq(std::vector<Request> &requests) {
+  int rows = 0;
+  while (true) {
+    zmq::message_t identity;
+    if (!m_socket.recv(&identity, ZMQ_DONTWAIT))
+      break;
+    if (!identity.more())
+      continue;
+    zmq::message_t payload;
+    m_socket.recv(&payload);
+    if (payload.size() < sizeof(MessageHeader))
+      continue;
+    MessageHeader header;
+    memcpy(&header, payload.data(), sizeof(header));
+    const char *data = (const char *) payload.data() + sizeof(header);
+    const std::size_t size = payload.size() - sizeof(header);
+    if (header.m_model < 0 || header.m_model >= int(m_models.size()))
+      continue;
+    Model &model = m_models[header.m_model];
+    if (header.m_type == MSG_CHECKPOINT) {
+      const std::string checkpoint(data, size);
+      if (checkpoint != model.m_checkpoint && model.m_updateCheckPoint) {
+        SgDebug() << "UctInferenceServer: loading " << checkpoint
+                  << " into model " << header.m_model << '\n';
+        model.m_updateCheckPoint(checkpoint);
+      }
+      model.m_checkpoint = checkpoint;
+    } else if (header.m_type == MSG_EVALUATE && header.m_count >= 1
+        && header.m_count <= MAX_BATCHES && size == header.m_count * FEATURE_BYTES) {
+      Request request = {-1, header.m_model, header.m_count,
+                         std::string((const char *) identity.data(), identity.size()),
+                         std::string(data, size)};
+      requests.push_back(request);
+      rows += header.m_count;
+    }
+  }
+  return rows;
+}
+
+/** @return Whether a request may have arrived */
+bool UctInferenceServer::WaitForRequests(int microseconds) {
+  if (!m_segment)
+    return Readable(m_socket, std::max(1, microseconds / 1000));
+  if (Readable(m_socket, 0))
+    return true;
+  // The doorbell does not ring for ZMQ requests, so wait at most 1 ms on it
+  const timespec deadline = Deadline(std::min(microseconds, 1000));
+  if (sem_timedwait(&m_segment->m_doorbell, &deadline) == 0) {
+    sem_post(&m_segment->m_doorbell);
+    return true;
+  }
+  return Readable(m_socket, 0);
+}
+
+void UctInferenceServer::Evaluate(std::vector<Request> &requests) {
+  if (m_models.size() > 1)
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const Request &a, const Request &b) { return a.m_model < b.m_model; });
+  std::size_t next = 0;
+  while (next < requests.size()) {
+    const std::size_t first = next;
+    const int model = requests[first].m_model;
+    int rows = 0;
+    for (; next < requests.size() && requests[next].m_model == model
+           && rows + requests[next].m_count <= MAX_BATCHES; ++next) {
+      const Request &request = requests[next];
+      const void *feature = request.m_slot >= 0
+                            ? (const void *) m_segment->m_slots[request.m_slot].m_feature
+                            : (const void *) request.m_data.data();
+      memcpy(m_feature[rows], feature, request.m_count * FEATURE_BYTES);
+      rows += request.m_count;
+    }
+    m_models[model].m_evaluate(m_feature.get(), m_policy.get(), m_value, rows);
+    ++m_nuBatches;
+    m_nuPositions += rows;
+    int row = 0;
+    for (std::size_t i = first; i < next; ++i) {
+      Reply(requests[i], row);
+      row += requests[i].m_count;
+    }
+  }
+}
+
+void UctInferenceServer::Reply(const Request &request, int row) {
+  if (request.m_slot >= 0) {
+    UctInferenceSlot &slot = m_segment->m_slots[request.m_slot];
+    memcpy(slot.m_policy, m_policy[row], request.m_count * POLICY_BYTES);
+    memcpy(slot.m_value, m_value + row, request.m_count * sizeof(UctValueType));
+    slot.m_state = SLOT_DONE;
+    sem_post(&slot.m_done);
+    return;
+  }
+  const std::size_t policySize = request.m_count * POLICY_BYTES;
+  zmq::message_t identity(request.m_identity.data(), request.m_identity.size());
+  zmq::message_t payload(policySize + request.m_count * sizeof(UctValueType));
+  memcpy(payload.data(), m_policy[row], policySize);
+  memcpy((char *) payload.data() + policySize, m_value + row,
+         request.m_count * sizeof(UctValueType));
+  m_socket.send(identity, ZMQ_SNDMORE);
+  m_socket.send(payload);
+}
+
+UctInferenceClient::UctInferenceClient(const std::string &name, int model) :
+    m_segment(nullptr),
+    m_slot(-1),
+    m_model(model),
+    m_context(1),
+    m_socket(m_context, ZMQ_DEALER) {
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  m_socket.connect(UctInferenceUtil::ZmqEndpoint(name));
+  const std::string shmName = UctInferenceUtil::SharedMemoryName(name);
+  if (!shmName.empty())
+    AttachSharedMemory(shmName);
+}
+
+UctInferenceClient::~UctInferenceClient() {
+  if (m_segment) {
+    m_segment->m_slots[m_slot].m_owner = 0;
+    munmap(m_segment, sizeof(UctInferenceSegment));
+  }
+}
+
+void UctInferenceClient::AttachSharedMemory(const std::string &shmName) {
+  int fd = shm_open(shmName.c_str(), O_RDWR, 0);
+  if (fd < 0)
+    return;
+  void *addr = mmap(nullptr, sizeof(UctInferenceSegment), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return;
+  UctInferenceSegment *segment = (UctInferenceSegment *) addr;
+  if (segment->m_magic != SEGMENT_MAGIC || !ProcessAlive(segment->m_serverPid)) {
+    munmap(addr, sizeof(UctInferenceSegment));
+    return;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const int pid = getpid();
+  for (int i = 0; i < NU_SLOTS; ++i) {
+    UctInferenceSlot &slot = segment->m_slots[i];
+    int owner = slot.m_owner;
+    const int state = slot.m_state;
+    // A slot of a dead client is only taken once the server answered it
+    if (state == SLOT_REQUEST || state == SLOT_BUSY
+        || (owner != 0 && ProcessAlive(owner))
+        || !slot.m_owner.compare_exchange_strong(owner, pid))
+      continue;
+    while (sem_trywait(&slot.m_done) == 0);
+    slot.m_state = SLOT_IDLE;
+    m_segment = segment;
+    m_slot = i;
+    return;
+  }
+  SgDebug() << "UctInferenceClient: no free slot, using ZMQ\n";
+  munmap(addr, sizeof(UctInferenceSegment));
+}
+
+bool UctInferenceClient::UsesSharedMemory() const {
+  return m_segment != nullptr;
+}
+
+bool UctInferenceClient::Evaluate(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                                  UctValueType actions_[][GO_MAX_MOVES],
+                                  UctValueType value_[], int numBatches) {
+  DBG_ASSERT(numBatches >= 1 && numBatches <= MAX_BATCHES);
+  if (m_segment)
+    return EvaluateSharedMemory(feature, actions_, value_, numBatches);
+  return EvaluateZmq(feature, actions_, value_, numBatches);
+}
+
+bool UctInferenceClient::EvaluateSharedMemory(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                                              UctValueType actions_[][GO_MAX_MOVES],
+                                              UctValueType value_[], int numBatches) {
+  UctInferenceSlot &slot = m_segment->m_slots[m_slot];
+  slot.m_count = numBatches;
+  slot.m_model = m_model;
+  memcpy(slot.m_feature, feature, numBatches * FEATURE_BYTES);
+  slot.m_state = SLOT_REQUEST;
+  sem_post(&m_segment->m_doorbell);
+  for (int waited = 0;;) {
+    const timespec deadline = Deadline(1000000);
+    if (sem_timedwait(&slot.m_done, &deadline) == 0)
+      break;
+    if (errno == EINTR)
+      continue;
+    if (!ProcessAlive(m_segment->m_serverPid) || ++waited >= REPLY_TIMEOUT)
+      return false;
+  }
+  const bool ok = slot.m_count == numBatches;
+  if (ok) {
+    memcpy(actions_, slot.m_policy, numBatches * POLICY_BYTES);
+    memcpy(value_, slot.m_value, numBatches * sizeof(UctValueType));
+  }
+  slot.m_state = SLOT_IDLE;
+  return ok;
+}
+
+bool UctInferenceClient::EvaluateZmq(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                                     UctValueType actions_[][GO_MAX_MOVES],
+                                     UctValueType value_[], int numBatches) {
+  const MessageHeader header = {MSG_EVALUATE, numBatches, m_model};
+  zmq::message_t request(sizeof(header) + numBatches * FEATURE_BYTES);
+  memcpy(request.data(), &header, sizeof(header));
+  memcpy((char *) request.data() + sizeof(header), feature, numBatches * FEATURE_BYTES);
+  m_socket.send(request);
+  if (!Readable(m_socket, REPLY_TIMEOUT * 1000L))
+    return false;
+  zmq::message_t reply;
+  m_socket.recv(&reply);
+  const std::size_t policySize = numBatches * POLICY_BYTES;
+  if (reply.size() != policySize + numBatches * sizeof(UctValueType))
+    return false;
+  memcpy(actions_, reply.data(), policySize);
+  memcpy(value_, (const char *) reply.data() + policySize,
+         numBatches * sizeof(UctValueType));
+  return true;
+}
+
+bool UctInferenceClient::UpdateCheckPoint(const std::string &checkpoint) {
+  const MessageHeader header = {MSG_CHECKPOINT, 0, m_model};
+  zmq::message_t request(sizeof(header) + checkpoint.size());
+  memcpy(request.data(), &header, sizeof(header));
+  memcpy((char *) request.data() + sizeof(header), checkpoint.data(), checkpoint.size());
+  return m_socket.send(request);
+}
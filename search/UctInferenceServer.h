@@ -0,0 +1,146 @@
+
+#ifndef SG_UCT_INFERENCESERVER_H
+#define SG_UCT_INFERENCESERVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/function.hpp>
+#include <zmq.hpp>
+#include "UctValue.h"
+#include "funcapproximator/DlNetworkEvaluator.h"
+
+/** Evaluates numBatches feature planes like UctBoardEvaluator::EvaluateState. */
+typedef boost::function<void(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                             UctValueType actions_[][GO_MAX_MOVES],
+                             UctValueType value_[], int numBatches)> UctBatchFunction;
+
+typedef boost::function<void(const std::string &checkpoint)> UctCheckPointFunction;
+
+struct UctInferenceSegment;
+
+namespace UctInferenceUtil {
+  /** POSIX shared memory object of the server called name, empty if name is
+      a ZMQ endpoint, which may be on another host. */
+  std::string SharedMemoryName(const std::string &name);
+
+  /** name itself if it contains "://", else an ipc endpoint in /tmp. */
+  std::string ZmqEndpoint(const std::string &name);
+}
+
+/** One process that owns the network and evaluates the positions of all
+    search processes on the host.
+    Clients write their features into a slot of a shared memory segment and
+    ring a doorbell semaphore; the server answers in the same slot. Clients
+    that cannot map the segment use a ZMQ ROUTER socket instead. The requests
+    waiting at the same time are merged into batches of up to MAX_BATCHES
+    positions, so the network runs on full batches even if each search
+    process only has a few positions in flight. A request is never split
+    across batches.
+    The server can host several models, for example the two sides of
+    gating matches. Each request names its model and a batch only holds
+    requests of one model. */
+class UctInferenceServer {
+ public:
+  /** @param name See UctInferenceUtil
+      @param evaluate Model 0, called from Run() only
+      @param updateCheckPoint Called from Run() when a client sends a
+      checkpoint other than the current one; all clients of the model
+      share it */
+  UctInferenceServer(const std::string &name, const UctBatchFunction &evaluate,
+                     const UctCheckPointFunction &updateCheckPoint = UctCheckPointFunction());
+  ~UctInferenceServer();
+
+  /** Host another model. Not after Run() started.
+      @return The id of the model for UctInferenceClient */
+  int AddModel(const UctBatchFunction &evaluate,
+               const UctCheckPointFunction &updateCheckPoint = UctCheckPointFunction());
+
+  /** Time to wait for more requests if a batch is not full. */
+  void SetBatchWait(int microseconds);
+
+  /** Serve requests until Stop() is called. */
+  void Run();
+
+  /** Can be called from another thread or a signal handler. */
+  void Stop();
+
+  bool HasSharedMemory() const;
+
+  std::size_t NuBatches() const;
+
+  std::size_t NuPositions() const;
+
+ private:
+  struct Request;
+
+  struct Model {
+    UctBatchFunction m_evaluate;
+    UctCheckPointFunction m_updateCheckPoint;
+    std::string m_checkpoint;
+  };
+
+  std::string m_shmName;
+  UctInferenceSegment *m_segment;
+  zmq::context_t m_context;
+  zmq::socket_t m_socket;
+  std::vector<Model> m_models;
+  int m_batchWait;
+  std::atomic<bool> m_quit;
+  std::atomic<std::size_t> m_nuBatches;
+  std::atomic<std::size_t> m_nuPositions;
+  std::unique_ptr<char[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE]> m_feature;
+  std::unique_ptr<UctValueType[][GO_MAX_MOVES]> m_policy;
+  UctValueType m_value[MAX_BATCHES];
+
+  void CreateSharedMemory();
+  int Collect(std::vector<Request> &requests);
+  /** Positions of the model with the most positions in requests. */
+  int MaxModelRows(const std::vector<Request> &requests) const;
+  int CollectSharedMemory(std::vector<Request> &requests);
+  int ReceiveZmq(std::vector<Request> &requests);
+  bool WaitForRequests(int microseconds);
+  void Evaluate(std::vector<Request> &requests);
+  void Reply(const Request &request, int row);
+};
+
+/** Connection of a search process to a UctInferenceServer. Not thread-safe;
+    each evaluation thread has its own client. */
+class UctInferenceClient {
+ public:
+  /** @param model Model of the server to evaluate with */
+  explicit UctInferenceClient(const std::string &name, int model = 0);
+  ~UctInferenceClient();
+
+  /** @param numBatches At most MAX_BATCHES
+      @return false if the server did not answer; the client should then be
+      replaced, since a late answer may still arrive */
+  bool Evaluate(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                UctValueType actions_[][GO_MAX_MOVES], UctValueType value_[],
+                int numBatches);
+
+  /** Ask the server to load a checkpoint into the model before its next
+      batch. */
+  bool UpdateCheckPoint(const std::string &checkpoint);
+
+  bool UsesSharedMemory() const;
+
+ private:
+  UctInferenceSegment *m_segment;
+  int m_slot;
+  int m_model;
+  zmq::context_t m_context;
+  zmq::socket_t m_socket;
+
+  void AttachSharedMemory(const std::string &shmName);
+  bool EvaluateSharedMemory(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                            UctValueType actions_[][GO_MAX_MOVES],
+                            UctValueType value_[], int numBatches);
+  bool EvaluateZmq(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                   UctValueType actions_[][GO_MAX_MOVES],
+                   UctValueType value_[], int numBatches);
+};
+
+#endif
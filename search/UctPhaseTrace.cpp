@@ -0,0 +1,217 @@
+
+#include "platform/SgSystem.h"
+#include "UctPhaseTrace.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <boost/io/ios_state.hpp>
+
+namespace {
+
+const UctPhaseTracer::Clock::time_point s_epoch = UctPhaseTracer::Clock::now();
+
+const char *const s_phaseNames[UCT_NU_PHASES] = {
+    "select", "expand", "collect", "wait", "evaluate", "backup"
+};
+
+std::int64_t SinceEpochNs(UctPhaseTracer::Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      time - s_epoch).count();
+}
+
+double Microseconds(std::uint64_t ns) {
+  return double(ns) / 1e3;
+}
+
+void WriteJsonString(std::ostream &out, const std::string &s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    out << c;
+  }
+  out << '"';
+}
+
+}
+
+UctPhaseHistogram::UctPhaseHistogram() {
+  Clear();
+}
+
+int UctPhaseHistogram::Bucket(std::uint64_t ns) {
+  int bucket = 0;
+  while (ns > 1 && bucket < NU_BUCKETS - 1) {
+    ns >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void UctPhaseHistogram::Add(std::uint64_t ns) {
+  ++m_count;
+  m_totalNs += ns;
+  m_maxNs = std::max(m_maxNs, ns);
+  ++m_buckets[Bucket(ns)];
+}
+
+void UctPhaseHistogram::Add(const UctPhaseHistogram &histogram) {
+  m_count += histogram.m_count;
+  m_totalNs += histogram.m_totalNs;
+  m_maxNs = std::max(m_maxNs, histogram.m_maxNs);
+  for (int i = 0; i < NU_BUCKETS; ++i)
+    m_buckets[i] += histogram.m_buckets[i];
+}
+
+void UctPhaseHistogram::Clear() {
+  m_count = 0;
+  m_totalNs = 0;
+  m_maxNs = 0;
+  std::fill(m_buckets, m_buckets + NU_BUCKETS, 0);
+}
+
+std::size_t UctPhaseHistogram::Count() const {
+  return m_count;
+}
+
+std::size_t UctPhaseHistogram::Count(int bucket) const {
+  DBG_ASSERT(bucket >= 0);
+  DBG_ASSERT(bucket < NU_BUCKETS);
+  return m_buckets[bucket];
+}
+
+std::uint64_t UctPhaseHistogram::TotalNs() const {
+  return m_totalNs;
+}
+
+std::uint64_t UctPhaseHistogram::MaxNs() const {
+  return m_maxNs;
+}
+
+std::uint64_t UctPhaseHistogram::PercentileNs(double fraction) const {
+  if (m_count == 0)
+    return 0;
+  const double rank = fraction * double(m_count);
+  std::size_t count = 0;
+  for (int i = 0; i < NU_BUCKETS; ++i) {
+    count += m_buckets[i];
+    if (count > 0 && double(count) >= rank)
+      return std::min(m_maxNs, (std::uint64_t(1) << (i + 1)) - 1);
+  }
+  return m_maxNs;
+}
+
+UctPhaseTracer::UctPhaseTracer()
+    : m_enabled(false),
+      m_recordEvents(false),
+      m_droppedEvents(0) {}
+
+void UctPhaseTracer::SetEnabled(bool enable) {
+  m_enabled = enable;
+}
+
+void UctPhaseTracer::SetRecordEvents(bool enable) {
+  m_recordEvents = enable;
+}
+
+void UctPhaseTracer::Add(UctSearchPhase phase, Clock::time_point start,
+                         Clock::time_point end) {
+  const std::int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      end - start).count();
+  m_histograms[phase].Add(ns > 0 ? std::uint64_t(ns) : 0);
+  if (!m_recordEvents)
+    return;
+  if (m_events.size() < MAX_EVENTS) {
+    UctPhaseEvent event;
+    event.m_phase = phase;
+    event.m_startNs = SinceEpochNs(start);
+    event.m_durationNs = ns;
+    m_events.push_back(event);
+  } else
+    ++m_droppedEvents;
+}
+
+void UctPhaseTracer::Clear() {
+  for (UctPhaseHistogram &histogram : m_histograms)
+    histogram.Clear();
+  m_events.clear();
+  m_droppedEvents = 0;
+}
+
+const UctPhaseHistogram &UctPhaseTracer::Histogram(UctSearchPhase phase) const {
+  return m_histograms[phase];
+}
+
+const std::vector<UctPhaseEvent> &UctPhaseTracer::Events() const {
+  return m_events;
+}
+
+std::size_t UctPhaseTracer::NuDroppedEvents() const {
+  return m_droppedEvents;
+}
+
+const char *UctPhaseTraceUtil::PhaseName(UctSearchPhase phase) {
+  DBG_ASSERT(phase >= 0 && phase < UCT_NU_PHASES);
+  return s_phaseNames[phase];
+}
+
+void UctPhaseTraceUtil::WriteStatistics(std::ostream &out,
+                                        const std::vector<const UctPhaseTracer *> &tracers) {
+  boost::io::ios_all_saver saver(out);
+  UctPhaseHistogram histograms[UCT_NU_PHASES];
+  std::size_t dropped = 0;
+  for (const UctPhaseTracer *tracer : tracers) {
+    for (int i = 0; i < UCT_NU_PHASES; ++i)
+      histograms[i].Add(tracer->Histogram(UctSearchPhase(i)));
+    dropped += tracer->NuDroppedEvents();
+  }
+  std::uint64_t totalNs = 0;
+  for (const UctPhaseHistogram &histogram : histograms)
+    totalNs += histogram.TotalNs();
+  out << std::left << std::setw(9) << "Phase" << std::right
+      << std::setw(10) << "Count" << std::setw(10) << "Total(s)"
+      << std::setw(7) << "%" << std::setw(10) << "Mean(us)"
+      << std::setw(10) << "P50(us)" << std::setw(10) << "P90(us)"
+      << std::setw(10) << "P99(us)" << std::setw(10) << "Max(us)" << '\n'
+      << std::fixed;
+  for (int i = 0; i < UCT_NU_PHASES; ++i) {
+    const UctPhaseHistogram &h = histograms[i];
+    out << std::left << std::setw(9) << PhaseName(UctSearchPhase(i))
+        << std::right << std::setw(10) << h.Count()
+        << std::setprecision(3) << std::setw(10) << double(h.TotalNs()) / 1e9
+        << std::setprecision(1) << std::setw(7)
+        << (totalNs > 0 ? 100.0 * double(h.TotalNs()) / double(totalNs) : 0.0)
+        << std::setw(10)
+        << (h.Count() > 0 ? Microseconds(h.TotalNs()) / double(h.Count()) : 0.0)
+        << std::setw(10) << Microseconds(h.PercentileNs(0.5))
+        << std::setw(10) << Microseconds(h.PercentileNs(0.9))
+        << std::setw(10) << Microseconds(h.PercentileNs(0.99))
+        << std::setw(10) << Microseconds(h.MaxNs()) << '\n';
+  }
+  if (dropped > 0)
+    out << "Trace events dropped: " << dropped << '\n';
+}
+
+void UctPhaseTraceUtil::WriteChromeTrace(std::ostream &out,
+                                         const std::vector<const UctPhaseTracer *> &tracers,
+                                         const std::vector<std::string> &threadNames) {
+  DBG_ASSERT(threadNames.size() == tracers.size());
+  boost::io::ios_all_saver saver(out);
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  bool first = true;
+  for (std::size_t tid = 0; tid < tracers.size(); ++tid) {
+    out << (first ? "\n" : ",\n")
+        << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid
+        << ",\"args\":{\"name\":";
+    WriteJsonString(out, threadNames[tid]);
+    out << "}}";
+    first = false;
+    for (const UctPhaseEvent &event : tracers[tid]->Events())
+      out << ",\n{\"name\":\"" << PhaseName(event.m_phase)
+          << "\",\"cat\":\"uct\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+          << ",\"ts\":" << double(event.m_startNs) / 1e3
+          << ",\"dur\":" << double(event.m_durationNs) / 1e3 << '}';
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
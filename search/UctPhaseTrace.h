@@ -0,0 +1,147 @@
+
+#ifndef SG_UCT_PHASETRACE_H
+#define SG_UCT_PHASETRACE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/** Phases of a deep UCT search iteration. UCT_PHASE_EVALUATE is the batched
+    network evaluation of the evaluation thread, the other phases are spent
+    in the search threads. */
+enum UctSearchPhase {
+  UCT_PHASE_SELECT,
+  UCT_PHASE_EXPAND,
+  UCT_PHASE_COLLECT,
+  UCT_PHASE_WAIT,
+  UCT_PHASE_EVALUATE,
+  UCT_PHASE_BACKUP,
+  UCT_NU_PHASES
+};
+
+/** Durations of one phase, in buckets of powers of two nanoseconds. */
+class UctPhaseHistogram {
+ public:
+  /** Bucket i counts durations in [2^i, 2^(i+1)) ns, the first one also
+      durations below 1 ns. */
+  static const int NU_BUCKETS = 40;
+
+  UctPhaseHistogram();
+  void Add(std::uint64_t ns);
+  void Add(const UctPhaseHistogram &histogram);
+  void Clear();
+  std::size_t Count() const;
+  std::size_t Count(int bucket) const;
+  std::uint64_t TotalNs() const;
+  std::uint64_t MaxNs() const;
+  /** Upper bound of the bucket of the given fraction of the durations. */
+  std::uint64_t PercentileNs(double fraction) const;
+
+  static int Bucket(std::uint64_t ns);
+
+ private:
+  std::size_t m_count;
+  std::uint64_t m_totalNs;
+  std::uint64_t m_maxNs;
+  std::size_t m_buckets[NU_BUCKETS];
+};
+
+/** One timed phase, for the Chrome trace. */
+struct UctPhaseEvent {
+  UctSearchPhase m_phase;
+  /** Since the start of the process. */
+  std::int64_t m_startNs;
+  std::int64_t m_durationNs;
+};
+
+/** Phase timers of one thread.
+    Disabled by default; a disabled tracer costs one branch per phase. Only
+    written by its thread, and only read between searches. */
+class UctPhaseTracer {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /** Events kept for the Chrome trace, after that they are counted as
+      dropped. */
+  static const std::size_t MAX_EVENTS = 1 << 18;
+
+  UctPhaseTracer();
+
+  bool Enabled() const;
+  /** Record the phases into the histograms. */
+  void SetEnabled(bool enable);
+  /** Also keep the single phases for WriteChromeTrace(). */
+  void SetRecordEvents(bool enable);
+
+  void Add(UctSearchPhase phase, Clock::time_point start,
+           Clock::time_point end);
+  void Clear();
+
+  const UctPhaseHistogram &Histogram(UctSearchPhase phase) const;
+  const std::vector<UctPhaseEvent> &Events() const;
+  std::size_t NuDroppedEvents() const;
+
+ private:
+  bool m_enabled;
+  bool m_recordEvents;
+  UctPhaseHistogram m_histograms[UCT_NU_PHASES];
+  std::vector<UctPhaseEvent> m_events;
+  std::size_t m_droppedEvents;
+};
+
+/** Times the enclosing scope, or up to Stop(), as one phase, if the tracer
+    is enabled. */
+class UctPhaseTimer {
+ public:
+  UctPhaseTimer(UctPhaseTracer &tracer, UctSearchPhase phase);
+  ~UctPhaseTimer();
+  void Stop();
+
+ private:
+  UctPhaseTracer *m_tracer;
+  UctSearchPhase m_phase;
+  UctPhaseTracer::Clock::time_point m_start;
+};
+
+inline bool UctPhaseTracer::Enabled() const {
+  return m_enabled;
+}
+
+inline UctPhaseTimer::UctPhaseTimer(UctPhaseTracer &tracer,
+                                    UctSearchPhase phase)
+    : m_tracer(tracer.Enabled() ? &tracer : nullptr),
+      m_phase(phase) {
+  if (m_tracer)
+    m_start = UctPhaseTracer::Clock::now();
+}
+
+inline UctPhaseTimer::~UctPhaseTimer() {
+  Stop();
+}
+
+inline void UctPhaseTimer::Stop() {
+  if (m_tracer) {
+    m_tracer->Add(m_phase, m_start, UctPhaseTracer::Clock::now());
+    m_tracer = nullptr;
+  }
+}
+
+namespace UctPhaseTraceUtil {
+const char *PhaseName(UctSearchPhase phase);
+
+/** For each phase the count, total and mean time and percentiles, summed
+    over the tracers. */
+void WriteStatistics(std::ostream &out,
+                     const std::vector<const UctPhaseTracer *> &tracers);
+
+/** Events of the tracers in the Chrome trace event format, one thread per
+    tracer with the given name. Open with chrome://tracing or Perfetto. */
+void WriteChromeTrace(std::ostream &out,
+                      const std::vector<const UctPhaseTracer *> &tracers,
+                      const std::vector<std::string> &threadNames);
+}
+
+#endif // SG_UCT_PHASETRACE_H
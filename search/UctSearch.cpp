@@ -2,6 +2,10 @@
 #include "platform/SgSystem.h"
 #include "UctSearch.h"
 
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <GoUctGlobalSearch.h>
 #include <lib/ArrayUtil.h>
@@ -33,15 +37,16 @@ size_t GetMaxNodesDefault() {
   else
       SgDebug() << totalMemory;
 #endif
-  size_t searchMemory = size_t(totalMemory * 0.32);
-  if (searchMemory < 384000000)
-    searchMemory = 384000000;
-  size_t memoryPerTree = searchMemory;
-  size_t nodesPerTree = memoryPerTree / sizeof(UctNode);
+  size_t searchMemory = DlConfig::GetInstance().get_max_memory();
+  if (searchMemory == 0) {
+    searchMemory = size_t(totalMemory * 0.32);
+    if (searchMemory < 384000000)
+      searchMemory = 384000000;
+  }
 #ifdef DEBUG_MEMORY
   SgDebug() << ", " << searchMemory << " used for current player\n";
 #endif
-  return nodesPerTree;
+  return std::max(size_t(1), UctSearch::NodesForMemory(searchMemory));
 }
 
 void Notify(mutex& aMutex, condition& aCondition) {
@@ -53,6 +58,9 @@ void Notify(mutex& aMutex, condition& aCondition) {
 
 const size_t INVALID_THREAD_ID = numeric_limits<size_t>::max();
 
+/** Seconds between the updates of UctSearch::Snapshot(). */
+const double SNAPSHOT_INTERVAL = 0.1;
+
 void UctGameInfo::Clear(std::size_t numberPlayouts) {
   m_nodes.clear();
   m_inTreeSequence.clear();
@@ -82,7 +90,8 @@ EvalMsg::EvalMsg() :
 }
 
 EvalMsg::EvalMsg(size_t threadID, EvalMsgType type) :
-    thread_id(threadID), msg_type(type), thread_exited(false), state_ready(false) {
+    thread_id(threadID), msg_type(type), thread_exited(false), state_ready(false),
+    state_evaluated(false), eval_failed(false) {
 }
 
 void EvalMsg::WaitEvalFinish() {
@@ -97,7 +106,8 @@ UctThreadState::UctThreadState(unsigned int threadId, int moveRange)
     : thread_id(threadId),
       eval_msg(threadId),
       search_initialised(false),
-      tree_exceed_memory_limit(false) {
+      tree_exceed_memory_limit(false),
+      eval_wait_time(0) {
   if (moveRange > 0) {
     first_play.reset(new size_t[moveRange]);
     first_play_opp.reset(new size_t[moveRange]);
@@ -136,10 +146,14 @@ void UctSearch::NetworkEvalThread::Function::operator()() {
 
 UctSearch::NetworkEvalThread::NetworkEvalThread(UctSearch& search) :
     neural_initialized(false),
-    evaluator(),
+    evaluator(search.NewEvaluator()),
+    standby_ready(false),
+    nu_batches(0),
+    nu_positions(0),
     searcher(search),
     to_quit(false),
     paused(true),
+    loading(false),
     thread_ready_barrier(2),
     sys_thread(Function(*this)) {
   for (size_t i = 0; i < searcher.num_threads; ++i)
@@ -152,6 +166,8 @@ UctSearch::NetworkEvalThread::NetworkEvalThread(UctSearch& search) :
 }
 
 UctSearch::NetworkEvalThread::~NetworkEvalThread() {
+  if (load_thread.joinable())
+    load_thread.join();
   to_quit = true;
   mutex::scoped_lock lock(wait_mutex);
   wait_cv.notify_all();
@@ -175,27 +191,49 @@ void UctSearch::NetworkEvalThread::operator()() {
 
       if (to_quit)
         break;
-      if (!new_checkpoint.empty()) {
+      std::string checkpoint;
+      {
+        boost::mutex::scoped_lock lock(swap_mutex);
+        checkpoint.swap(new_checkpoint);
+      }
+      if (!checkpoint.empty()) {
         TryLoadNeuralNetwork();
-        evaluator.UpdateCheckPoint(new_checkpoint);
-        new_checkpoint = "";
+        evaluator->UpdateCheckPoint(checkpoint);
+      }
+      if (standby_ready)
+        SwapStandby();
+      bool failed = false;
+      {
+        UctPhaseTimer timer(tracer, UCT_PHASE_EVALUATE);
+        try {
+          evaluator->EvaluateState(eval_buf.feature_buf,
+                                  eval_buf.policy_out,
+                                  eval_buf.values_out,
+                                  searcher.num_threads);
+        } catch (const std::exception& e) {
+          SgWarning() << e.what() << '\n';
+          failed = true;
+        }
       }
-      evaluator.EvaluateState(eval_buf.feature_buf,
-                              eval_buf.policy_out,
-                              eval_buf.values_out,
-                              searcher.num_threads);
 
+      std::size_t positions = 0;
       for (size_t i = 0; i < searcher.num_threads; ++i) {
         EvalMsg* msg = thread_msg[i];
         if (!msg->thread_exited && msg->state_ready && !msg->state_evaluated) {
           {
             boost::mutex::scoped_lock mslk(msg->mutex);
             msg->state_evaluated = true;
+            msg->eval_failed = failed;
             msg->state_ready = false;
           }
           msg->condition_variable.notify_all();
+          ++positions;
         }
       }
+      if (positions > 0) {
+        ++nu_batches;
+        nu_positions += positions;
+      }
     }
   }
 
@@ -207,6 +245,8 @@ void UctSearch::NetworkEvalThread::operator()() {
 void UctSearch::NetworkEvalThread::Start() {
   for (std::size_t i = 0; i < searcher.num_threads; ++i)
     thread_msg[i]->SetThreadExited(false);
+  nu_batches = 0;
+  nu_positions = 0;
   {
     mutex::scoped_lock lock(wait_mutex);
     paused = false;
@@ -219,23 +259,94 @@ void UctSearch::NetworkEvalThread::Stop() {
 }
 
 const std::string& UctSearch::NetworkEvalThread::getCheckPoint() {
-  return new_checkpoint;
+  return requested_checkpoint;
+}
+
+std::size_t UctSearch::NetworkEvalThread::NuBatches() const {
+  return nu_batches;
+}
+
+std::size_t UctSearch::NetworkEvalThread::NuPositions() const {
+  return nu_positions;
 }
 
 bool UctSearch::NetworkEvalThread::TryLoadNeuralNetwork() {
   if (!neural_initialized) {
-    evaluator.LoadGraph(DlConfig::GetInstance().get_metagraph());
+    evaluator->LoadGraph(DlConfig::GetInstance().get_metagraph());
     neural_initialized = true;
 
-    return evaluator.GraphLoaded();
+    return evaluator->GraphLoaded();
   }
 
   return false;
 }
 
 void UctSearch::NetworkEvalThread::UpdateCheckPoint(const std::string& checkpoint) {
-  if (checkpoint != new_checkpoint) {
+  if (checkpoint.empty() || checkpoint == requested_checkpoint)
+    return;
+  requested_checkpoint = checkpoint;
+  if (!neural_initialized) {
+    // Nothing to evaluate with yet, the first batch waits for the load
+    boost::mutex::scoped_lock lock(swap_mutex);
     new_checkpoint = checkpoint;
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(swap_mutex);
+    if (loading) {
+      // Do not wait for the running load, it continues with this one
+      pending_checkpoint = checkpoint;
+      return;
+    }
+    loading = true;
+    standby_ready = false;
+  }
+  // The previous load has finished
+  if (load_thread.joinable())
+    load_thread.join();
+  load_thread = boost::thread(boost::bind(&NetworkEvalThread::LoadStandby,
+                                          this, checkpoint));
+}
+
+void UctSearch::NetworkEvalThread::LoadStandby(std::string checkpoint) {
+  while (true) {
+    const bool ready = LoadAndWarmUp(checkpoint);
+    boost::mutex::scoped_lock lock(swap_mutex);
+    if (pending_checkpoint.empty()) {
+      standby_ready = ready;
+      loading = false;
+      return;
+    }
+    checkpoint.swap(pending_checkpoint);
+    pending_checkpoint.clear();
+  }
+}
+
+bool UctSearch::NetworkEvalThread::LoadAndWarmUp(const std::string& checkpoint) {
+  if (!standby)
+    standby.reset(searcher.NewEvaluator());
+  if (!standby->GraphLoaded())
+    standby->LoadGraph(DlConfig::GetInstance().get_metagraph());
+  standby->UpdateCheckPoint(checkpoint);
+  // The first run of a session is slow, do it before the search uses it
+  std::unique_ptr<EvalBuffer> warmup(new EvalBuffer());
+  std::memset(warmup->feature_buf, 0, sizeof(warmup->feature_buf));
+  try {
+    standby->EvaluateState(warmup->feature_buf, warmup->policy_out,
+                           warmup->values_out, int(searcher.num_threads));
+  } catch (const std::exception& e) {
+    SgWarning() << e.what() << '\n';
+    return false;
+  }
+  return true;
+}
+
+void UctSearch::NetworkEvalThread::SwapStandby() {
+  boost::mutex::scoped_lock lock(swap_mutex);
+  if (standby_ready) {
+    // The old evaluator keeps its graph and loads the next checkpoint
+    evaluator.swap(standby);
+    standby_ready = false;
   }
 }
 
@@ -311,11 +422,15 @@ void UctSearch::Thread::WaitPlayFinished() {
   finish_cond.wait(play_finish_lock);
 }
 
-UctSearchStat::UctSearchStat() : time_elapsed(0), searches_per_second(0) {}
+UctSearchStat::UctSearchStat() : time_elapsed(0), searches_per_second(0),
+                                 eval_batches(0), eval_positions(0), eval_wait_time(0) {}
 
 void UctSearchStat::Clear() {
   time_elapsed = 0;
   searches_per_second = 0;
+  eval_batches = 0;
+  eval_positions = 0;
+  eval_wait_time = 0;
   game_length.Clear();
   moves_in_tree.Clear();
   search_aborted.Clear();
@@ -334,7 +449,45 @@ void UctSearchStat::Write(std::ostream& out) const {
       << static_cast<int>(100 * search_aborted.Mean()) << "%\n"
       << SgWriteLabel("Games/s") << fixed << setprecision(1)
       << searches_per_second << '\n';
+  if (eval_batches > 0)
+    out << SgWriteLabel("EvalBatch") << setprecision(2)
+        << double(eval_positions) / double(eval_batches) << '\n'
+        << SgWriteLabel("EvalWait") << setprecision(2) << eval_wait_time << '\n';
+}
+UctMemoryUsage::UctMemoryUsage() : tree_reserved(0), tree_used(0), policy_reserved(0),
+                                   policy_used(0), eval_buffers(0) {}
+
+std::size_t UctMemoryUsage::Reserved() const {
+  return tree_reserved + policy_reserved + eval_buffers;
+}
+
+std::size_t UctMemoryUsage::Used() const {
+  return tree_used + policy_used + eval_buffers;
+}
+
+void UctMemoryUsage::Write(std::ostream& out) const {
+  out << SgWriteLabel("TreeReserved") << tree_reserved << '\n'
+      << SgWriteLabel("TreeUsed") << tree_used << '\n'
+      << SgWriteLabel("PolicyReserved") << policy_reserved << '\n'
+      << SgWriteLabel("PolicyUsed") << policy_used << '\n'
+      << SgWriteLabel("EvalBuffers") << eval_buffers << '\n'
+      << SgWriteLabel("Reserved") << Reserved() << '\n'
+      << SgWriteLabel("Used") << Used() << '\n';
+}
+
+UctSearchSnapshot::UctSearchSnapshot() : searching(false), time(0), games_played(0), root_count(0),
+                                         root_mean(0), nodes(0) {}
+
+void UctSearchSnapshot::Write(std::ostream& out) const {
+  out << SgWriteLabel("Searching") << (searching ? "yes" : "no") << '\n'
+      << SgWriteLabel("Time") << time << '\n'
+      << SgWriteLabel("Count") << root_count << '\n'
+      << SgWriteLabel("GamesPlayed") << games_played << '\n'
+      << SgWriteLabel("Nodes") << nodes << '\n'
+      << SgWriteLabel("Value") << root_mean << '\n'
+      << SgWriteLabel("Sequence") << sequence << '\n';
 }
+
 UctEarlyAbortParam::UctEarlyAbortParam() : abort_threshold(0), min_searches_to_abort(0), reduction_factor(0) {}
 
 UctSearch::UctSearch(UctThreadStateFactory* threadStateFactory, int moveRange)
@@ -370,7 +523,14 @@ UctSearch::UctSearch(UctThreadStateFactory* threadStateFactory, int moveRange)
       puct_const(2.5),
       use_virtual_loss(false),
       select_with_dirichlet(false),
+      trace_phases(false),
+      trace_events(false),
+      progress_interval(1.0),
+      next_progress_time(0),
+      searching(false),
+      next_snapshot_time(0),
       log_file_name("uctsearch.log"),
+      inference_model(0),
 #if USE_FASTLOG
       fast_logrithm(10),
 #endif
@@ -391,6 +551,17 @@ void UctSearch::UpdateCheckPoint(const std::string& checkpoint) {
   check_point = checkpoint;
 }
 
+void UctSearch::SetInferenceServer(const std::string& server, int model) {
+  inference_server = server;
+  inference_model = model;
+}
+
+UctBoardEvaluator* UctSearch::NewEvaluator() const {
+  if (inference_server.empty())
+    return new UctBoardEvaluator();
+  return new UctBoardEvaluator(inference_server, inference_model);
+}
+
 const std::string& UctSearch::getCheckPoint() {
   return eval_thread->getCheckPoint();
 }
@@ -457,6 +628,7 @@ void UctSearch::CreateThreads() {
   }
   search_tree.CreateAllocators(num_threads);
   search_tree.SetMaxNodes(max_nodes);
+  ApplyTraceSettings();
 
   search_finish_barier.reset(new barrier(num_threads));
 }
@@ -476,6 +648,7 @@ void UctSearch::DeleteThreads() {
 }
 
 bool UctSearch::ExpandAndBackup(UctThreadState& state, const UctNode* root, const UctNode& leafNode) {
+  UctPhaseTimer expandTimer(state.phase_tracer, UCT_PHASE_EXPAND);
   state.move_info.clear();
   UctProvenType provenType = PROVEN_NONE;
   state.GenerateAllMoves(1, state.move_info, provenType);
@@ -507,15 +680,32 @@ bool UctSearch::ExpandAndBackup(UctThreadState& state, const UctNode* root, cons
     return false;
   }
   search_tree.Expand(threadId, leafNode, state.move_info);
+  expandTimer.Stop();
 
 #ifdef USE_NNEVALTHREAD
-  state.CollectFeatures(eval_thread->eval_buf.feature_buf[threadId], NUM_MAPS);
+  {
+    UctPhaseTimer timer(state.phase_tracer, UCT_PHASE_COLLECT);
+    state.CollectFeatures(eval_thread->eval_buf.feature_buf[threadId], NUM_MAPS);
+  }
   // printTransformedFeatures(eval_thread->eval_buf.feature_buf[threadId]);
 
-  state.eval_msg.state_ready = true;
-  state.eval_msg.state_evaluated = false;
-  state.eval_msg.WaitEvalFinish();
+  const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+  {
+    UctPhaseTimer timer(state.phase_tracer, UCT_PHASE_WAIT);
+    state.eval_msg.state_ready = true;
+    state.eval_msg.state_evaluated = false;
+    state.eval_msg.WaitEvalFinish();
+  }
+  state.eval_wait_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+  if (state.eval_msg.eval_failed) {
+    // Backing up made-up values would corrupt the tree, and children
+    // without priors would survive in a reused tree; stop the search
+    search_tree.RemoveChildren(leafNode);
+    search_aborted = true;
+    return false;
+  }
 
+  UctPhaseTimer timer(state.phase_tracer, UCT_PHASE_BACKUP);
   UpdatePrior(leafNode, eval_thread->eval_buf.policy_out[threadId]);
   BackupTree(root, &leafNode, eval_thread->eval_buf.values_out[threadId]);
 #endif
@@ -815,6 +1005,7 @@ int UctSearch::DeepUctSearchTree(UctThreadState& state, GlobalRecursiveLock* loc
     search_tree.AddVirtualLoss(*node);
   nodes.push_back(node);
 
+  UctPhaseTimer selectTimer(state.phase_tracer, UCT_PHASE_SELECT);
   while (node->HasChildren()) {
     if (node == root && select_with_dirichlet)
       node = SelectWithDirichletNoise(state, *node, puct_const);
@@ -827,6 +1018,7 @@ int UctSearch::DeepUctSearchTree(UctThreadState& state, GlobalRecursiveLock* loc
     if (use_virtual_loss && num_threads > 1)
       search_tree.AddVirtualLoss(*node);
   }
+  selectTimer.Stop();
 
   if (root->Parent() == root) {
 #ifndef NDEBUG
@@ -875,8 +1067,16 @@ UctValueType UctSearch::StartDeepUCTSearchThread(UctValueType maxGames, double m
     logger_stream.open(mpi_synchronizer->ToNodeFilename(log_file_name).c_str());
     logger_stream << "PreStartSearch maxGames=" << maxGames << '\n';
   }
+  {
+    boost::mutex::scoped_lock lock(snapshot_mutex);
+    snapshot = UctSearchSnapshot();
+    snapshot.searching = true;
+  }
+  searching = true;
   max_games = maxGames;
   max_time = maxTime;
+  next_progress_time = progress_interval;
+  next_snapshot_time = SNAPSHOT_INTERVAL;
   early_abort_param.reset(0);
   if (earlyAbort != 0)
     early_abort_param.reset(new UctEarlyAbortParam(*earlyAbort));
@@ -890,8 +1090,10 @@ UctValueType UctSearch::StartDeepUCTSearchThread(UctValueType maxGames, double m
   PreStartSearch(rootFilter, initTree, syncState);
 
 #ifdef USE_NNEVALTHREAD
-  if (eval_thread == nullptr)
+  if (eval_thread == nullptr) {
     eval_thread.reset(new NetworkEvalThread(*this));
+    ApplyTraceSettings();
+  }
   if (!check_point.empty()) {
     eval_thread->UpdateCheckPoint(check_point);
     check_point = "";
@@ -933,12 +1135,18 @@ UctValueType UctSearch::StartDeepUCTSearchThread(UctValueType maxGames, double m
   }
 #ifdef USE_NNEVALTHREAD
   eval_thread->Stop();
+  search_stat.eval_batches = eval_thread->NuBatches();
+  search_stat.eval_positions = eval_thread->NuPositions();
+  for (size_t i = 0; i < search_threads.size(); ++i)
+    search_stat.eval_wait_time += ThreadState(i).eval_wait_time;
 #endif
 
   EndSearch();
   search_stat.time_elapsed = search_timer.GetTime();
   if (search_stat.time_elapsed > numeric_limits<double>::epsilon())
     search_stat.searches_per_second = GamesPlayed() / search_stat.time_elapsed;
+  UpdateSnapshot(false);
+  searching = false;
   if (log_games)
     logger_stream.close();
   // UctNode* node = DeepUCTSelectBestChild(tau, policy_);
@@ -985,6 +1193,22 @@ void UctSearch::DeepUCTSearchLoop(UctThreadState& state, GlobalRecursiveLock* lo
       search_aborted = true;
       break;
     }
+    mpi_synchronizer->OnSearchIteration(*this, num_games, state.thread_id, state.game_info);
+    if (mpi_synchronizer->CheckAbort() || ForceAbort()) {
+      search_aborted = true;
+      break;
+    }
+    if (state.thread_id == 0) {
+      const double time = search_timer.GetTime();
+      if (time >= next_snapshot_time) {
+        UpdateSnapshot(true);
+        next_snapshot_time = time + SNAPSHOT_INTERVAL;
+      }
+      if (progress_callback && time >= next_progress_time) {
+        progress_callback(*this);
+        next_progress_time = search_timer.GetTime() + progress_interval;
+      }
+    }
     if (tree_exceeds_mem_limit) {
       SgDebug() << "tree limit exceeded" << "\n";
       break;
@@ -1199,6 +1423,8 @@ void UctSearch::PreStartSearch(const vector<GoMove>& rootFilter, UctSearchTree*
 #endif
   }
   search_stat.Clear();
+  for (size_t i = 0; i < search_threads.size(); ++i)
+    ThreadState(i).eval_wait_time = 0;
   search_aborted = false;
   early_aborted = false;
   if (!SgDeterministic::IsDeterministicMode())
@@ -1300,4 +1526,117 @@ void UctSearch::WriteStatistics(std::ostream& out) const {
       << SgWriteLabel("Nodes") << search_tree.NuNodes() << '\n';
   search_stat.Write(out);
   mpi_synchronizer->WriteStatistics(out);
+}
+
+void UctSearch::SetTracePhases(bool enable) {
+  trace_phases = enable;
+  ApplyTraceSettings();
+}
+
+void UctSearch::SetTraceEvents(bool enable) {
+  trace_events = enable;
+  ApplyTraceSettings();
+}
+
+void UctSearch::ApplyTraceSettings() {
+  for (size_t i = 0; i < search_threads.size(); ++i) {
+    ThreadState(i).phase_tracer.SetEnabled(trace_phases);
+    ThreadState(i).phase_tracer.SetRecordEvents(trace_events);
+  }
+#ifdef USE_NNEVALTHREAD
+  if (eval_thread) {
+    eval_thread->tracer.SetEnabled(trace_phases);
+    eval_thread->tracer.SetRecordEvents(trace_events);
+  }
+#endif
+}
+
+std::vector<const UctPhaseTracer*> UctSearch::PhaseTracers() const {
+  std::vector<const UctPhaseTracer*> tracers;
+  for (size_t i = 0; i < search_threads.size(); ++i)
+    tracers.push_back(&ThreadState(i).phase_tracer);
+#ifdef USE_NNEVALTHREAD
+  if (eval_thread)
+    tracers.push_back(&eval_thread->tracer);
+#endif
+  return tracers;
+}
+
+void UctSearch::WritePhaseStatistics(std::ostream& out) const {
+  UctPhaseTraceUtil::WriteStatistics(out, PhaseTracers());
+}
+
+void UctSearch::WritePhaseTrace(std::ostream& out) const {
+  std::vector<std::string> names;
+  for (size_t i = 0; i < search_threads.size(); ++i)
+    names.push_back("search " + std::to_string(i));
+#ifdef USE_NNEVALTHREAD
+  if (eval_thread)
+    names.push_back("network");
+#endif
+  UctPhaseTraceUtil::WriteChromeTrace(out, PhaseTracers(), names);
+}
+
+void UctSearch::ClearPhaseStatistics() {
+  for (size_t i = 0; i < search_threads.size(); ++i)
+    ThreadState(i).phase_tracer.Clear();
+#ifdef USE_NNEVALTHREAD
+  if (eval_thread)
+    eval_thread->tracer.Clear();
+#endif
+}
+
+UctMemoryUsage UctSearch::MemoryUsage() const {
+  UctMemoryUsage usage;
+  usage.tree_reserved = search_tree.MemoryReserved() + tmp_search_tree.MemoryReserved();
+  usage.tree_used = search_tree.MemoryUsed() + tmp_search_tree.MemoryUsed();
+#ifdef USE_NNEVALTHREAD
+  if (eval_thread)
+    usage.eval_buffers = sizeof(EvalBuffer);
+#endif
+  return usage;
+}
+
+std::size_t UctSearch::MemoryForNodes(std::size_t maxNodes) {
+  size_t memory = 2 * maxNodes * sizeof(UctNode);
+#ifdef USE_NNEVALTHREAD
+  memory += sizeof(EvalBuffer);
+#endif
+  return memory;
+}
+
+std::size_t UctSearch::NodesForMemory(std::size_t memory) {
+  const size_t fixed = MemoryForNodes(0);
+  if (memory <= fixed)
+    return 0;
+  return (memory - fixed) / (2 * sizeof(UctNode));
+}
+
+void UctSearch::SetProgressCallback(const UctProgressCallback& callback,
+                                    double interval) {
+  DBG_ASSERT(interval > 0);
+  progress_callback = callback;
+  progress_interval = interval;
+}
+
+UctSearchSnapshot UctSearch::Snapshot() const {
+  boost::mutex::scoped_lock lock(snapshot_mutex);
+  return snapshot;
+}
+
+void UctSearch::UpdateSnapshot(bool isSearching) {
+  UctSearchSnapshot current;
+  current.searching = isSearching;
+  current.time = search_timer.GetTime();
+  current.games_played = GamesPlayed();
+  const UctNode& root = search_tree.Root();
+  current.root_count = root.MoveCount();
+  current.root_mean = root.HasMean() ? root.Mean() : UctValueType(0);
+  current.nodes = search_tree.NuNodes();
+  std::vector<GoMove> sequence;
+  FindBestSequence(sequence);
+  for (size_t i = 0; i < sequence.size(); ++i)
+    current.sequence += (i == 0 ? "" : " ") + MoveString(sequence[i]);
+  boost::mutex::scoped_lock lock(snapshot_mutex);
+  snapshot = current;
 }
\ No newline at end of file
@@ -2,8 +2,10 @@
 #ifndef SG_UCTSEARCH_H
 #define SG_UCTSEARCH_H
 
+#include <atomic>
 #include <fstream>
 #include <vector>
+#include <boost/function.hpp>
 #include <boost/scoped_array.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/barrier.hpp>
@@ -19,6 +21,7 @@
 #include "board/GoBlackWhite.h"
 #include "board/GoBWArray.h"
 #include "platform/SgTimer.h"
+#include "UctPhaseTrace.h"
 #include "UctSearchTree.h"
 #include "UctValue.h"
 #include "MpiSynchronizer.h"
@@ -62,6 +65,8 @@ struct EvalMsg {
   bool thread_exited;
   bool state_ready;
   bool state_evaluated;
+  /** The evaluator failed, the buffers do not hold an evaluation. */
+  bool eval_failed;
   boost::condition condition_variable;
   boost::mutex mutex;
 
@@ -84,6 +89,9 @@ class UctThreadState {
   std::vector<GoMove> excluded_moves;
   int randomize_rave_cnt;
   int randomize_bias_cnt;
+  /** Seconds this thread waited for network evaluations in the search. */
+  double eval_wait_time;
+  UctPhaseTracer phase_tracer;
 
   explicit UctThreadState(unsigned int threadId, int moveRange = 0);
   virtual ~UctThreadState();
@@ -117,6 +125,9 @@ class UctThreadState {
 
 
 class UctSearch;
+/** Reports the progress of a running deep search, see
+    UctSearch::SetProgressCallback(). */
+typedef boost::function<void(const UctSearch &search)> UctProgressCallback;
 class UctThreadStateFactory {
  public:
   virtual ~UctThreadStateFactory();
@@ -162,6 +173,11 @@ struct UctSearchStat {
   SgStatisticsExt<UctValueType, UctValueType> game_length;
   SgStatisticsExt<UctValueType, UctValueType> moves_in_tree;
   UctStatistics search_aborted;
+  /** Batches of the network evaluation thread that had positions in them,
+      the positions evaluated and the seconds all search threads waited. */
+  std::size_t eval_batches;
+  std::size_t eval_positions;
+  double eval_wait_time;
 
   UctSearchStat();
   void Clear();
@@ -169,6 +185,42 @@ struct UctSearchStat {
 };
 
 
+/** Bytes of a search and its player. Reserved memory is allocated up front
+    and bounds the memory of a search; used memory is the part in use. */
+struct UctMemoryUsage {
+  /** Node arenas of the search tree and of the temporary tree for pruning
+      and tree reuse. */
+  std::size_t tree_reserved;
+  std::size_t tree_used;
+  /** Policy blocks and nodes of the game record of UctDeepPlayer. */
+  std::size_t policy_reserved;
+  std::size_t policy_used;
+  /** Feature and output buffers of the network evaluation thread. */
+  std::size_t eval_buffers;
+
+  UctMemoryUsage();
+  std::size_t Reserved() const;
+  std::size_t Used() const;
+  void Write(std::ostream &out) const;
+};
+
+/** Progress of a deep search, copied so that other threads can read it
+    while the search runs, see UctSearch::Snapshot(). */
+struct UctSearchSnapshot {
+  bool searching;
+  double time;
+  UctValueType games_played;
+  UctValueType root_count;
+  UctValueType root_mean;
+  std::size_t nodes;
+  /** Best sequence from the root. */
+  std::string sequence;
+
+  UctSearchSnapshot();
+  void Write(std::ostream &out) const;
+};
+
+
 struct UctEarlyAbortParam {
   UctValueType abort_threshold;
   UctValueType min_searches_to_abort;
@@ -236,6 +288,9 @@ class UctSearch {
   UctValueType EstimateGameScore();
   void UpdateCheckPoint(const std::string &checkpoint);
   const std::string &getCheckPoint();
+  /** Evaluate with a model of the UctInferenceServer server instead of the
+      network of DlConfig. Before the first deep search. */
+  void SetInferenceServer(const std::string &server, int model);
   void printTransformedFeatures(char feature[][BD_SIZE][BD_SIZE]);
 
   const UctNode *FindBestChild(const UctNode &node, const std::vector<GoMove> *excludeMoves = nullptr) const;
@@ -313,6 +368,34 @@ class UctSearch {
   const MpiSynchronizerHandle GetMpiSynchronizer() const;
   const UctSearchStat &Statistics() const;
   void WriteStatistics(std::ostream &out) const;
+  bool TracePhases() const;
+  /** Time the phases of the search iterations in all threads. */
+  void SetTracePhases(bool enable);
+  bool TraceEvents() const;
+  /** Also keep every timed phase, for WritePhaseTrace(). */
+  void SetTraceEvents(bool enable);
+  /** Phase times since the last ClearPhaseStatistics(), over all searches. */
+  void WritePhaseStatistics(std::ostream &out) const;
+  /** Timed phases as a Chrome trace. */
+  void WritePhaseTrace(std::ostream &out) const;
+  void ClearPhaseStatistics();
+  /** Call callback from the first search thread about every interval
+      seconds of the following deep searches. The other threads keep
+      searching, so callback only gets a snapshot of a changing tree. An
+      empty callback disables it. */
+  void SetProgressCallback(const UctProgressCallback &callback,
+                           double interval);
+  /** A deep search is running. Can be called from any thread. */
+  bool IsSearching() const;
+  /** Progress of the running deep search, updated by the first search
+      thread about every 0.1 seconds, or of the last one. Can be called from
+      any thread. */
+  UctSearchSnapshot Snapshot() const;
+  UctMemoryUsage MemoryUsage() const;
+  /** Bytes a search with maxNodes nodes per tree reserves. */
+  static std::size_t MemoryForNodes(std::size_t maxNodes);
+  /** Largest number of nodes per tree within memory bytes, 0 if none. */
+  static std::size_t NodesForMemory(std::size_t memory);
   UctThreadState &ThreadState(int i) const;
   bool ThreadsCreated() const;
   void CreateThreads();
@@ -363,7 +446,11 @@ class UctSearch {
     bool TryLoadNeuralNetwork();
     void OnSearchThreadExit(size_t threadID);
     const std::string &getCheckPoint();
+    /** Since Start(). */
+    std::size_t NuBatches() const;
+    std::size_t NuPositions() const;
     EvalBuffer eval_buf;
+    UctPhaseTracer tracer;
 
    private:
     class Function {
@@ -376,17 +463,37 @@ class UctSearch {
     };
     friend class Function;
     EvalMsg* thread_msg[128];
-    bool neural_initialized;
-    UctBoardEvaluator evaluator;
+    std::atomic<bool> neural_initialized;
+    /** Evaluator of the search, only used by the evaluation thread. */
+    std::unique_ptr<UctBoardEvaluator> evaluator;
+    /** Second evaluator, which loads the next checkpoint in load_thread
+        while the search goes on. The evaluation thread swaps it with
+        evaluator between two batches once standby_ready is set. */
+    std::unique_ptr<UctBoardEvaluator> standby;
+    std::atomic<bool> standby_ready;
+    std::atomic<std::size_t> nu_batches;
+    std::atomic<std::size_t> nu_positions;
     UctSearch& searcher;
     bool to_quit;
     bool paused;
+    /** Checkpoint to load inline, before the first batch. */
     std::string new_checkpoint;
+    /** Last checkpoint passed to UpdateCheckPoint. */
+    std::string requested_checkpoint;
+    /** Whether load_thread runs, and the checkpoint that it loads next;
+        both under swap_mutex. */
+    bool loading;
+    std::string pending_checkpoint;
+    boost::mutex swap_mutex;
+    boost::thread load_thread;
     boost::barrier thread_ready_barrier;
     boost::thread sys_thread;
     boost::mutex wait_mutex;
     boost::condition wait_cv;
     void operator()();
+    void LoadStandby(std::string checkpoint);
+    bool LoadAndWarmUp(const std::string &checkpoint);
+    void SwapStandby();
   };
 
   std::unique_ptr<UctThreadStateFactory> th_state_factory;
@@ -435,6 +542,15 @@ class UctSearch {
   double max_time;
   bool use_virtual_loss;
   bool select_with_dirichlet;
+  bool trace_phases;
+  bool trace_events;
+  UctProgressCallback progress_callback;
+  double progress_interval;
+  double next_progress_time;
+  std::atomic<bool> searching;
+  double next_snapshot_time;
+  mutable boost::mutex snapshot_mutex;
+  UctSearchSnapshot snapshot;
   std::string log_file_name;
   SgTimer search_timer;
   UctSearchTree search_tree;
@@ -448,6 +564,8 @@ class UctSearch {
   SgRandom rand_generator;
   std::vector<boost::shared_ptr<Thread> > search_threads;
   std::string check_point;
+  std::string inference_server;
+  int inference_model;
 
 #ifdef USE_NNEVALTHREAD
   std::unique_ptr<NetworkEvalThread> eval_thread;
@@ -460,12 +578,15 @@ class UctSearch {
   bool sync_state;
   boost::shared_ptr<MpiSynchronizer> mpi_synchronizer;
 
+  UctBoardEvaluator *NewEvaluator() const;
   bool CheckAbortForDeepSearch(UctThreadState &state);
   bool CheckEarlyAbort() const;
   bool CheckCountAbort(UctThreadState &state,
                        UctValueType remainingGames) const;
   void Debug(const UctThreadState &state, const std::string &textLine);
   void DeleteThreads();
+  void ApplyTraceSettings();
+  std::vector<const UctPhaseTracer *> PhaseTracers() const;
   UctValueType GetBound(bool useRave, bool useBiasTerm,
                       UctValueType logPosCount,
                       const UctNode &child) const;
@@ -478,6 +599,7 @@ class UctSearch {
   UctNode *DeepUCTSelectBestChild(float* policy = 0);
   void PrintSearchProgress(double currTime) const;
   std::string SummaryLine(const UctGameInfo &info) const;
+  void UpdateSnapshot(bool isSearching);
   void UpdateCheckTimeInterval(double time);
   void UpdatePrior(const UctNode& node, UctValueType* policies);
   void UpdateStatistics(const UctGameInfo &info);
@@ -497,7 +619,7 @@ inline UctValueType UctSearch::ExpandThreshold() const {
 }
 
 inline UctBoardEvaluator &UctSearch::NetworkEvalThread::GetEvaluator() {
-  return evaluator;
+  return *evaluator;
 }
 
 inline int UctSearch::BiasTermFrequency() const {
@@ -545,6 +667,18 @@ inline bool UctSearch::LogGames() const {
   return log_games;
 }
 
+inline bool UctSearch::TracePhases() const {
+  return trace_phases;
+}
+
+inline bool UctSearch::TraceEvents() const {
+  return trace_events;
+}
+
+inline bool UctSearch::IsSearching() const {
+  return searching;
+}
+
 inline std::size_t UctSearch::MaxGameLength() const {
   return max_move_length;
 }
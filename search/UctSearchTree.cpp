@@ -316,6 +316,17 @@ std::size_t UctSearchTree::NuNodes() const {
   return nuNodes;
 }
 
+std::size_t UctSearchTree::MemoryReserved() const {
+  size_t nuNodes = 0;
+  for (size_t i = 0; i < NuAllocators(); ++i)
+    nuNodes += Allocator(i).MaxNodes();
+  return nuNodes * sizeof(UctNode);
+}
+
+std::size_t UctSearchTree::MemoryUsed() const {
+  return (NuNodes() - 1) * sizeof(UctNode);
+}
+
 void UctSearchTree::SetMaxNodes(std::size_t maxNodes) {
   Clear();
   size_t nuAllocators = NuAllocators();
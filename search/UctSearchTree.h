@@ -114,6 +114,8 @@ class UctNode {
   UctValueType getTotalActionValue() const;
   UctValueType MeanActionValue() const;
   void AddValue(UctValueType value);
+  /** Add count results with the sum valueSum at once. */
+  void AddValues(UctValueType count, UctValueType valueSum);
 #endif
 
   UctValueType getPrior() const;
@@ -364,6 +366,13 @@ inline void UctNode::AddValue(UctValueType value)
   uct_w += value;
   uct_Q = uct_w / visit_count;
 }
+
+inline void UctNode::AddValues(UctValueType count, UctValueType valueSum)
+{
+  visit_count += static_cast<int>(count);
+  uct_w += valueSum;
+  uct_Q = visit_count > 0 ? uct_w / visit_count : 0;
+}
 #else
 inline void UctNode::AddGameResult(UctValueType eval) {
   uct_stats.Add(eval);
@@ -609,6 +618,9 @@ class UctSearchTree {
 
   void Prune(std::size_t allocatorId, const UctNode &node, UctNode *exception);
   void Expand(std::size_t allocatorId, const UctNode &leafNode, const std::vector<UctMoveInfo> &moves);
+  /** Make an expanded node a leaf again, the children stay unused in the
+      allocator. */
+  void RemoveChildren(const UctNode &node);
 
   void ExtractSubtree(UctSearchTree &target, const UctNode &node,
                       bool warnTruncate,
@@ -623,6 +635,10 @@ class UctSearchTree {
   std::size_t NuAllocators() const;
   std::size_t NuNodes() const;
   std::size_t NuNodes(std::size_t allocatorId) const;
+  /** Bytes of the node arenas, which are allocated up front. */
+  std::size_t MemoryReserved() const;
+  /** Bytes of the nodes in the arenas. */
+  std::size_t MemoryUsed() const;
 
   void ApplyFilter(const UctSearchTree &tree, std::size_t allocatorId, const UctNode &parent,
                    const std::vector<GoMove> &rootFilter);
@@ -690,6 +706,12 @@ UctSearchTree::Expand(std::size_t allocatorId, const UctNode &leafNode, const st
   nonConstLeaf.SetNumChildren(nuChildren);
 }
 
+inline void UctSearchTree::RemoveChildren(const UctNode &node) {
+  DBG_ASSERT(Contains(node));
+  const_cast<UctNode &>(node).SetNumChildren(0);
+  SgSynchronizeThreadMemory();
+}
+
 inline void UctSearchTree::AddVirtualLoss(const UctNode &node) {
   const_cast<UctNode &>(node).AddVirtualLoss();
 }
@@ -0,0 +1,499 @@
+
+#include "platform/SgSystem.h"
+#include "ZmqMpiSynchronizer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <boost/format.hpp>
+#include "platform/SgDebug.h"
+#include "platform/SgException.h"
+#include "board/SgWrite.h"
+#include "UctSearchTree.h"
+
+using namespace std;
+
+namespace {
+
+enum MessageType {
+  MSG_HELLO,
+  MSG_WELCOME,
+  /** Results of the current search since the last delta. */
+  MSG_DELTA,
+  /** The last delta of a process for the current search. */
+  MSG_FINAL,
+  /** The root process ended the search. */
+  MSG_ABORT,
+  /** A value of the root process. */
+  MSG_SYNC
+};
+
+enum SyncKind {
+  SYNC_USER_ABORT,
+  SYNC_PASS_WINS,
+  SYNC_EARLY_PASS,
+  SYNC_MOVE,
+  SYNC_VALUE,
+  SYNC_SEARCH_STATUS
+};
+
+struct MessageHeader {
+  int32_t m_type;
+  int32_t m_rank;
+  uint32_t m_searchId;
+  int32_t m_kind;
+  int32_t m_count;
+};
+
+struct StatEntry {
+  int32_t m_move;
+  int32_t m_unused;
+  double m_count;
+  double m_sum;
+};
+
+/** Time the root process waits for the last results of the others. */
+const long FINAL_TIMEOUT = 5000;
+
+/** Time a process waits for a value of the root process. */
+const long SYNC_TIMEOUT = 60000;
+
+bool Readable(zmq::socket_t &socket, long timeout) {
+  zmq::pollitem_t item = {(void *) socket, 0, ZMQ_POLLIN, 0};
+  return zmq::poll(&item, 1, timeout) > 0 && (item.revents & ZMQ_POLLIN);
+}
+
+bool ParseHeader(const string &message, MessageHeader &header) {
+  if (message.size() < sizeof(header))
+    return false;
+  memcpy(&header, message.data(), sizeof(header));
+  return true;
+}
+
+}
+
+ZmqMpiSynchronizer::Stat::Stat() :
+    m_count(0),
+    m_sum(0) {}
+
+ZmqMpiSynchronizer::ZmqMpiSynchronizer(const string &endpoint, int rank,
+                                       int size, int timeout) :
+    m_rank(rank),
+    m_size(size),
+    m_context(1),
+    m_socket(m_context, rank == 0 ? ZMQ_ROUTER : ZMQ_DEALER),
+    m_searchId(0),
+    m_abort(false),
+    m_interval(0.05),
+    m_lastExchange(0) {
+  if (rank < 0 || rank >= size)
+    throw SgException(boost::format("ZmqMpiSynchronizer: rank %1% of %2%") % rank % size);
+  m_socket.setsockopt(ZMQ_LINGER, 0);
+  Connect(endpoint, timeout);
+}
+
+ZmqMpiSynchronizer::~ZmqMpiSynchronizer() {}
+
+MpiSynchronizerHandle ZmqMpiSynchronizer::Create(const string &endpoint,
+                                                 int rank, int size) {
+  return MpiSynchronizerHandle(new ZmqMpiSynchronizer(endpoint, rank, size));
+}
+
+void ZmqMpiSynchronizer::Connect(const string &endpoint, int timeout) {
+  SgTimer timer;
+  if (m_rank == 0) {
+    m_socket.bind(endpoint);
+    m_peers.assign(m_size, "");
+    int connected = 1;
+    while (connected < m_size && timer.GetTime() < timeout) {
+      string message;
+      int rank;
+      Receive(message, rank, 1000);
+      connected = 1;
+      for (int i = 1; i < m_size; ++i)
+        if (!m_peers[i].empty())
+          ++connected;
+    }
+    if (connected < m_size)
+      throw SgException(boost::format("ZmqMpiSynchronizer: %1% of %2% processes connected")
+                            % connected % m_size);
+  } else {
+    m_socket.connect(endpoint);
+    Send(0, MSG_HELLO, Stats());
+    string message;
+    int rank;
+    MessageHeader header;
+    while (timer.GetTime() < timeout)
+      if (Receive(message, rank, 1000) && ParseHeader(message, header)
+          && header.m_type == MSG_WELCOME) {
+        SgDebug() << "ZmqMpiSynchronizer: process " << m_rank << " of "
+                  << m_size << " connected to " << endpoint << '\n';
+        return;
+      }
+    throw SgException(boost::format("ZmqMpiSynchronizer: no answer from %1%")
+                          % endpoint);
+  }
+  SgDebug() << "ZmqMpiSynchronizer: " << m_size << " processes at "
+            << endpoint << '\n';
+}
+
+void ZmqMpiSynchronizer::SetExchangeInterval(double seconds) {
+  m_interval = seconds;
+}
+
+void ZmqMpiSynchronizer::Send(int rank, int type, const Stats &stats) {
+  MessageHeader header = {type, m_rank, m_searchId, 0, (int32_t) stats.size()};
+  zmq::message_t payload(sizeof(header) + stats.size() * sizeof(StatEntry));
+  char *data = (char *) payload.data();
+  memcpy(data, &header, sizeof(header));
+  data += sizeof(header);
+  for (const auto &stat : stats) {
+    const StatEntry entry = {stat.first, 0, stat.second.m_count, stat.second.m_sum};
+    memcpy(data, &entry, sizeof(entry));
+    data += sizeof(entry);
+  }
+  if (m_rank == 0) {
+    zmq::message_t identity(m_peers[rank].data(), m_peers[rank].size());
+    m_socket.send(identity, ZMQ_SNDMORE);
+  }
+  m_socket.send(payload);
+}
+
+void ZmqMpiSynchronizer::Send(int rank, int kind, const vector<double> &values) {
+  MessageHeader header = {MSG_SYNC, m_rank, m_searchId, kind, (int32_t) values.size()};
+  zmq::message_t payload(sizeof(header) + values.size() * sizeof(double));
+  memcpy(payload.data(), &header, sizeof(header));
+  if (!values.empty())
+    memcpy((char *) payload.data() + sizeof(header), &values[0],
+           values.size() * sizeof(double));
+  zmq::message_t identity(m_peers[rank].data(), m_peers[rank].size());
+  m_socket.send(identity, ZMQ_SNDMORE);
+  m_socket.send(payload);
+}
+
+/** Answers the greetings of new processes itself. */
+bool ZmqMpiSynchronizer::Receive(string &message, int &rank, long timeout) {
+  if (!Readable(m_socket, timeout))
+    return false;
+  zmq::message_t identity;
+  zmq::message_t payload;
+  if (m_rank == 0) {
+    m_socket.recv(&identity);
+    if (!identity.more())
+      return false;
+  }
+  m_socket.recv(&payload);
+  message.assign((const char *) payload.data(), payload.size());
+  MessageHeader header;
+  if (!ParseHeader(message, header))
+    return false;
+  rank = header.m_rank;
+  if (m_rank == 0 && header.m_type == MSG_HELLO && rank > 0 && rank < m_size) {
+    m_peers[rank].assign((const char *) identity.data(), identity.size());
+    Send(rank, MSG_WELCOME, Stats());
+  }
+  return true;
+}
+
+void ZmqMpiSynchronizer::Process(UctSearchTree &tree, const string &message) {
+  MessageHeader header;
+  if (!ParseHeader(message, header) || header.m_rank < 0 || header.m_rank >= m_size)
+    return;
+  const int rank = header.m_rank;
+  if (header.m_type == MSG_SYNC || header.m_searchId > m_searchId) {
+    m_backlog.push_back(message);
+    return;
+  }
+  if (header.m_searchId != m_searchId)
+    return;
+  if (header.m_type == MSG_ABORT) {
+    m_abort = true;
+    return;
+  }
+  if (header.m_type != MSG_DELTA && header.m_type != MSG_FINAL)
+    return;
+  if (message.size() != sizeof(header) + header.m_count * sizeof(StatEntry))
+    return;
+  Stats stats;
+  const char *data = message.data() + sizeof(header);
+  for (int i = 0; i < header.m_count; ++i, data += sizeof(StatEntry)) {
+    StatEntry entry;
+    memcpy(&entry, data, sizeof(entry));
+    Stat &stat = stats[entry.m_move];
+    stat.m_count = entry.m_count;
+    stat.m_sum = entry.m_sum;
+  }
+  Add(tree, stats);
+  if (m_rank != 0)
+    return;
+  if (header.m_type == MSG_FINAL)
+    m_finished[rank] = true;
+  for (int i = 1; i < m_size; ++i)
+    if (i != rank && !m_finished[i])
+      for (const auto &stat : stats) {
+        Stat &outgoing = m_outgoing[i][stat.first];
+        outgoing.m_count += stat.second.m_count;
+        outgoing.m_sum += stat.second.m_sum;
+      }
+}
+
+void ZmqMpiSynchronizer::Add(UctSearchTree &tree, const Stats &stats) {
+  for (const auto &stat : stats) {
+    Stat &pending = m_pending[stat.first];
+    pending.m_count += stat.second.m_count;
+    pending.m_sum += stat.second.m_sum;
+  }
+  Apply(tree);
+}
+
+/** Add the pending results of other processes to the children of the root
+    that exist. */
+void ZmqMpiSynchronizer::Apply(UctSearchTree &tree) {
+  auto &root = const_cast<UctNode &>(tree.Root());
+  if (m_pending.empty() || !root.HasChildren())
+    return;
+  for (UctChildNodeIterator it(tree, root); it; ++it) {
+    auto pending = m_pending.find((*it).Move());
+    if (pending == m_pending.end())
+      continue;
+    const Stat &stat = pending->second;
+    const_cast<UctNode &>(*it).AddValues(stat.m_count, stat.m_sum);
+    root.AddValues(stat.m_count, UctValueUtil::MinusInverseValue(stat.m_sum));
+    Stat &remote = m_remote[pending->first];
+    remote.m_count += stat.m_count;
+    remote.m_sum += stat.m_sum;
+    m_pending.erase(pending);
+  }
+}
+
+/** Results of this process since the last call. */
+ZmqMpiSynchronizer::Stats ZmqMpiSynchronizer::LocalDelta(const UctSearchTree &tree) {
+  Stats delta;
+  const UctNode &root = tree.Root();
+  if (!root.HasChildren())
+    return delta;
+  for (UctChildNodeIterator it(tree, root); it; ++it) {
+    const GoMove move = (*it).Move();
+    const Stat &base = m_base[move];
+    const Stat &remote = m_remote[move];
+    Stat &sent = m_sent[move];
+    const UctValueType count = (*it).MoveCount() - base.m_count - remote.m_count - sent.m_count;
+    const UctValueType sum = (*it).getTotalActionValue() - base.m_sum - remote.m_sum - sent.m_sum;
+    if (count <= 0)
+      continue;
+    delta[move].m_count = count;
+    delta[move].m_sum = sum;
+    sent.m_count += count;
+    sent.m_sum += sum;
+  }
+  return delta;
+}
+
+void ZmqMpiSynchronizer::StartSearch(UctSearchTree &tree) {
+  ++m_searchId;
+  m_abort = false;
+  m_base.clear();
+  m_sent.clear();
+  m_remote.clear();
+  m_pending.clear();
+  m_outgoing.assign(m_size, Stats());
+  m_finished.assign(m_size, false);
+  m_finished[0] = true;
+  const UctNode &root = tree.Root();
+  if (root.HasChildren())
+    for (UctChildNodeIterator it(tree, root); it; ++it) {
+      Stat &base = m_base[(*it).Move()];
+      base.m_count = (*it).MoveCount();
+      base.m_sum = (*it).getTotalActionValue();
+    }
+  m_timer.Start();
+  m_lastExchange = 0;
+}
+
+void ZmqMpiSynchronizer::Exchange(UctSearchTree &tree) {
+  m_lastExchange = m_timer.GetTime();
+  std::deque<string> backlog;
+  backlog.swap(m_backlog);
+  for (const string &message : backlog)
+    Process(tree, message);
+  string message;
+  int rank;
+  while (Receive(message, rank, 0))
+    Process(tree, message);
+  Apply(tree);
+  const Stats delta = LocalDelta(tree);
+  if (m_rank != 0) {
+    if (!delta.empty())
+      Send(0, MSG_DELTA, delta);
+    return;
+  }
+  for (int i = 1; i < m_size; ++i) {
+    if (m_finished[i])
+      continue;
+    Stats &outgoing = m_outgoing[i];
+    for (const auto &stat : delta) {
+      outgoing[stat.first].m_count += stat.second.m_count;
+      outgoing[stat.first].m_sum += stat.second.m_sum;
+    }
+    if (!outgoing.empty())
+      Send(i, MSG_DELTA, outgoing);
+    outgoing.clear();
+  }
+}
+
+void ZmqMpiSynchronizer::EndSearch(UctSearchTree &tree) {
+  if (m_rank != 0) {
+    Send(0, MSG_FINAL, LocalDelta(tree));
+    return;
+  }
+  for (int i = 1; i < m_size; ++i)
+    if (!m_finished[i])
+      Send(i, MSG_ABORT, Stats());
+  SgTimer timer;
+  while (count(m_finished.begin(), m_finished.end(), false) > 0
+         && timer.GetTime() * 1000 < FINAL_TIMEOUT) {
+    string message;
+    int rank;
+    if (Receive(message, rank, 100))
+      Process(tree, message);
+  }
+  if (count(m_finished.begin(), m_finished.end(), false) > 0)
+    SgDebug() << "ZmqMpiSynchronizer: not all processes sent their results\n";
+}
+
+/** Use the values of the root process. */
+void ZmqMpiSynchronizer::Synchronize(int kind, vector<double> &values) {
+  if (m_rank == 0) {
+    for (int i = 1; i < m_size; ++i)
+      Send(i, kind, values);
+    return;
+  }
+  SgTimer timer;
+  while (timer.GetTime() * 1000 < SYNC_TIMEOUT) {
+    string message;
+    int rank;
+    auto it = m_backlog.begin();
+    MessageHeader header;
+    for (; it != m_backlog.end(); ++it)
+      if (ParseHeader(*it, header) && header.m_type == MSG_SYNC)
+        break;
+    if (it != m_backlog.end()) {
+      message = *it;
+      m_backlog.erase(it);
+    } else if (!Receive(message, rank, 1000) || !ParseHeader(message, header))
+      continue;
+    else if (header.m_type != MSG_SYNC) {
+      if (header.m_searchId > m_searchId)
+        m_backlog.push_back(message);
+      continue;
+    }
+    if (header.m_kind != kind
+        || message.size() != sizeof(header) + values.size() * sizeof(double)) {
+      SgDebug() << "ZmqMpiSynchronizer: expected value " << kind << ", got "
+                << header.m_kind << '\n';
+      continue;
+    }
+    if (!values.empty())
+      memcpy(&values[0], message.data() + sizeof(header),
+             values.size() * sizeof(double));
+    return;
+  }
+  SgDebug() << "ZmqMpiSynchronizer: no value " << kind << " from the root process\n";
+}
+
+string ZmqMpiSynchronizer::ToNodeFilename(const string &filename) const {
+  if (m_rank == 0)
+    return filename;
+  return filename + "." + to_string(m_rank);
+}
+
+bool ZmqMpiSynchronizer::IsRootProcess() const {
+  return m_rank == 0;
+}
+
+void ZmqMpiSynchronizer::OnStartSearch(UctSearch &search) {
+  StartSearch(const_cast<UctSearchTree &>(search.Tree()));
+}
+
+void ZmqMpiSynchronizer::OnEndSearch(UctSearch &search) {
+  EndSearch(const_cast<UctSearchTree &>(search.Tree()));
+}
+
+void ZmqMpiSynchronizer::OnThreadStartSearch(UctSearch &search,
+                                             UctThreadState &state) {
+  SuppressUnused(search);
+  SuppressUnused(state);
+}
+
+void ZmqMpiSynchronizer::OnThreadEndSearch(UctSearch &search,
+                                           UctThreadState &state) {
+  SuppressUnused(search);
+  SuppressUnused(state);
+}
+
+/** Thread 0 exchanges the results; the socket is not shared by threads. */
+void ZmqMpiSynchronizer::OnSearchIteration(UctSearch &search,
+                                           UctValueType gameNumber,
+                                           std::size_t threadId,
+                                           const UctGameInfo &info) {
+  SuppressUnused(gameNumber);
+  SuppressUnused(info);
+  if (threadId == 0 && m_timer.GetTime() - m_lastExchange >= m_interval)
+    Exchange(const_cast<UctSearchTree &>(search.Tree()));
+}
+
+void ZmqMpiSynchronizer::OnStartPonder() {}
+
+void ZmqMpiSynchronizer::OnEndPonder() {}
+
+void ZmqMpiSynchronizer::WriteStatistics(ostream &out) const {
+  UctValueType remote = 0;
+  for (const auto &stat : m_remote)
+    remote += stat.second.m_count;
+  out << SgWriteLabel("Processes") << m_size << '\n'
+      << SgWriteLabel("RemoteGames") << remote << '\n';
+}
+
+void ZmqMpiSynchronizer::SynchronizeUserAbort(bool &flag) {
+  vector<double> values(1, flag);
+  Synchronize(SYNC_USER_ABORT, values);
+  flag = values[0] != 0;
+}
+
+void ZmqMpiSynchronizer::SynchronizePassWins(bool &flag) {
+  vector<double> values(1, flag);
+  Synchronize(SYNC_PASS_WINS, values);
+  flag = values[0] != 0;
+}
+
+void ZmqMpiSynchronizer::SynchronizeEarlyPassPossible(bool &flag) {
+  vector<double> values(1, flag);
+  Synchronize(SYNC_EARLY_PASS, values);
+  flag = values[0] != 0;
+}
+
+void ZmqMpiSynchronizer::SynchronizeMove(GoMove &move) {
+  vector<double> values(1, move);
+  Synchronize(SYNC_MOVE, values);
+  move = (GoMove) values[0];
+}
+
+void ZmqMpiSynchronizer::SynchronizeValue(UctValueType &value) {
+  vector<double> values(1, value);
+  Synchronize(SYNC_VALUE, values);
+  value = values[0];
+}
+
+void ZmqMpiSynchronizer::SynchronizeSearchStatus(UctValueType &value,
+                                                 bool &earlyAbort,
+                                                 UctValueType &rootMoveCount) {
+  vector<double> values = {value, (double) earlyAbort, rootMoveCount};
+  Synchronize(SYNC_SEARCH_STATUS, values);
+  value = values[0];
+  earlyAbort = values[1] != 0;
+  rootMoveCount = values[2];
+}
+
+bool ZmqMpiSynchronizer::CheckAbort() {
+  return m_abort;
+}
@@ -0,0 +1,131 @@
+
+#ifndef SG_ZMQMPISYNCHRONIZER_H
+#define SG_ZMQMPISYNCHRONIZER_H
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <zmq.hpp>
+#include "MpiSynchronizer.h"
+#include "platform/SgTimer.h"
+
+class UctSearchTree;
+
+/** Root-parallel search over several processes, which may run on several
+    hosts.
+    Every process runs the same GTP commands and searches its own tree. While
+    searching, the visit counts and value sums that each process adds to the
+    children of the root are exchanged as deltas, so all processes select at
+    the root with the statistics of all searches. Process 0, the root
+    process, ends the search for everyone; its move and value are the ones
+    all processes use.
+    The processes are connected in a star: rank 0 binds a ZMQ ROUTER socket
+    to the endpoint, the others connect to it. All processes must have the
+    same architecture. */
+class ZmqMpiSynchronizer : public MpiSynchronizer {
+ public:
+  /** Connect all processes. The root process waits until the others are
+      connected.
+      @param endpoint For example "tcp://host:5570" or "ipc:///tmp/name"
+      @param rank 0 for the root process, 1 to size - 1 for the others
+      @param size Number of processes
+      @throw SgException if not all processes connect within timeout seconds */
+  ZmqMpiSynchronizer(const std::string &endpoint, int rank, int size,
+                     int timeout = 60);
+  virtual ~ZmqMpiSynchronizer();
+  static MpiSynchronizerHandle Create(const std::string &endpoint, int rank,
+                                      int size);
+
+  /** Minimum time between two exchanges of a search. */
+  void SetExchangeInterval(double seconds);
+
+  int Rank() const;
+  int Size() const;
+
+  /** The parts of OnStartSearch(), OnSearchIteration() and OnEndSearch()
+      that work on the root of the tree. Exchange() ignores the interval. */
+  void StartSearch(UctSearchTree &tree);
+  void Exchange(UctSearchTree &tree);
+  void EndSearch(UctSearchTree &tree);
+
+  virtual std::string ToNodeFilename(const std::string &filename) const;
+  virtual bool IsRootProcess() const;
+  virtual void OnStartSearch(UctSearch &search);
+  virtual void OnEndSearch(UctSearch &search);
+  virtual void OnThreadStartSearch(UctSearch &search,
+                                   UctThreadState &state);
+  virtual void OnThreadEndSearch(UctSearch &search,
+                                 UctThreadState &state);
+  virtual void OnSearchIteration(UctSearch &search, UctValueType gameNumber,
+                                 std::size_t threadId, const UctGameInfo &info);
+  virtual void OnStartPonder();
+  virtual void OnEndPonder();
+  virtual void WriteStatistics(std::ostream &out) const;
+  virtual void SynchronizeUserAbort(bool &flag);
+  virtual void SynchronizePassWins(bool &flag);
+  virtual void SynchronizeEarlyPassPossible(bool &flag);
+  virtual void SynchronizeMove(GoMove &move);
+  virtual void SynchronizeValue(UctValueType &value);
+  virtual void SynchronizeSearchStatus(UctValueType &value, bool &earlyAbort,
+                                       UctValueType &rootMoveCount);
+  virtual bool CheckAbort();
+
+ private:
+  /** Visits and value sum of a child of the root. */
+  struct Stat {
+    Stat();
+    UctValueType m_count;
+    UctValueType m_sum;
+  };
+
+  typedef std::map<GoMove, Stat> Stats;
+
+  int m_rank;
+  int m_size;
+  zmq::context_t m_context;
+  zmq::socket_t m_socket;
+  /** ZMQ identities of the other processes, by rank; root process only. */
+  std::vector<std::string> m_peers;
+  /** Numbers the searches, which are the same in all processes. */
+  unsigned int m_searchId;
+  std::atomic<bool> m_abort;
+  double m_interval;
+  SgTimer m_timer;
+  double m_lastExchange;
+  /** Counts at the start of the search, from a reused subtree. */
+  Stats m_base;
+  /** Results of this process already sent. */
+  Stats m_sent;
+  /** Results of other processes added to the tree. */
+  Stats m_remote;
+  /** Results of other processes for children not in the tree yet. */
+  Stats m_pending;
+  /** Results to send to each process; root process only. */
+  std::vector<Stats> m_outgoing;
+  /** Processes that sent their last results of this search. */
+  std::vector<bool> m_finished;
+  /** Messages of the next search, received while waiting for a value. */
+  std::deque<std::string> m_backlog;
+
+  void Connect(const std::string &endpoint, int timeout);
+  void Send(int rank, int type, const Stats &stats);
+  void Send(int rank, int type, const std::vector<double> &values);
+  bool Receive(std::string &message, int &rank, long timeout);
+  void Process(UctSearchTree &tree, const std::string &message);
+  void Add(UctSearchTree &tree, const Stats &stats);
+  void Apply(UctSearchTree &tree);
+  Stats LocalDelta(const UctSearchTree &tree);
+  void Synchronize(int kind, std::vector<double> &values);
+};
+
+inline int ZmqMpiSynchronizer::Rank() const {
+  return m_rank;
+}
+
+inline int ZmqMpiSynchronizer::Size() const {
+  return m_size;
+}
+
+#endif
@@ -0,0 +1,149 @@
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+
+#include "platform/SgSystem.h"
+#include "lib/SgConcurrentHashTable.h"
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "SgABSearch.h"
+#include "SgDfpnSearch.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+typedef SgConcurrentHashTable<SgSearchHashData, 4> SearchTable;
+
+typedef SgConcurrentHashTable<DfpnData, 4> DfpnTable;
+
+BOOST_AUTO_TEST_CASE(SgConcurrentHashTableTest_StoreLookup) {
+  SearchTable table(1000);
+  SgSearchHashData data;
+  const SgHashCode code(1);
+  BOOST_CHECK(!table.Lookup(code, &data));
+  table.Store(code, SgSearchHashData(3, 10, 7));
+  BOOST_REQUIRE(table.Lookup(code, &data));
+  BOOST_CHECK_EQUAL(data.Depth(), 3);
+  BOOST_CHECK_EQUAL(data.Value(), 10);
+  BOOST_CHECK_EQUAL(data.BestMove(), 7);
+  table.Store(code, SgSearchHashData(5, -20, 8, true));
+  BOOST_REQUIRE(table.Lookup(code, &data));
+  BOOST_CHECK_EQUAL(data.Depth(), 5);
+  BOOST_CHECK_EQUAL(data.Value(), -20);
+  BOOST_CHECK(data.IsOnlyUpperBound());
+  table.Age();
+  BOOST_REQUIRE(table.Lookup(code, &data));
+  BOOST_CHECK_EQUAL(data.Depth(), 0);
+  BOOST_CHECK_EQUAL(data.Value(), -20);
+  BOOST_CHECK_EQUAL(table.NuStores(), 2u);
+  BOOST_CHECK_EQUAL(table.NuLookups(), 4u);
+  BOOST_CHECK_EQUAL(table.NuFound(), 3u);
+  table.Clear();
+  BOOST_CHECK(!table.Lookup(code, &data));
+}
+
+/** Entries of a full block are replaced by the least valuable one. */
+BOOST_AUTO_TEST_CASE(SgConcurrentHashTableTest_Replace) {
+  const int maxHash = 16;
+  SearchTable table(maxHash);
+  vector<SgHashCode> codes;
+  for (unsigned int i = 0; codes.size() < 5; ++i) {
+    SgHashCode code(i);
+    if (code.Hash(maxHash) == 0)
+      codes.push_back(code);
+  }
+  for (int i = 0; i < 4; ++i)
+    table.Store(codes[i], SgSearchHashData(10 - i, 0, i));
+  table.Store(codes[4], SgSearchHashData(1, 0, 4));
+  BOOST_CHECK_EQUAL(table.NuCollisions(), 1u);
+  SgSearchHashData data;
+  BOOST_CHECK(!table.Lookup(codes[3], &data));
+  for (int i = 0; i < 3; ++i)
+    BOOST_CHECK(table.Lookup(codes[i], &data));
+  BOOST_CHECK(table.Lookup(codes[4], &data));
+}
+
+DfpnData DataOf(unsigned int i) {
+  return DfpnData(DfpnBounds(i, i + 1), GoMove(i % 400), i * 3);
+}
+
+void StoreAndCheck(DfpnTable *table, unsigned int first, int nuKeys,
+                   int *nuBad) {
+  for (int n = 0; n < 20; ++n)
+    for (int i = 0; i < nuKeys; ++i) {
+      const unsigned int key = (first + i) % (unsigned int)nuKeys;
+      table->Store(SgHashCode(key), DataOf(key));
+      DfpnData data;
+      const unsigned int other = (key * 7 + 3) % (unsigned int)nuKeys;
+      if (table->Lookup(SgHashCode(other), &data)) {
+        const DfpnData expected = DataOf(other);
+        if (data.m_bounds.phi != expected.m_bounds.phi
+            || data.m_bounds.delta != expected.m_bounds.delta
+            || data.m_bestMove != expected.m_bestMove
+            || data.m_work != expected.m_work)
+          ++*nuBad;
+      }
+    }
+}
+
+/** Threads writing different data to the same small table never read a
+    torn entry. The table is larger than 2 MB, so it is allocated with
+    SgPlatform::AllocateLarge. */
+BOOST_AUTO_TEST_CASE(SgConcurrentHashTableTest_Threads) {
+  const int nuThreads = 4;
+  const int nuKeys = 5000;
+  DfpnTable table(1 << 16);
+  vector<int> nuBad(nuThreads, 0);
+  boost::thread_group threads;
+  for (int i = 0; i < nuThreads; ++i)
+    threads.create_thread(boost::bind(&StoreAndCheck, &table,
+                                      i * nuKeys / nuThreads, nuKeys,
+                                      &nuBad[i]));
+  threads.join_all();
+  for (int i = 0; i < nuThreads; ++i)
+    BOOST_CHECK_EQUAL(nuBad[i], 0);
+  BOOST_CHECK_EQUAL(table.NuStores(), size_t(nuThreads * 20 * nuKeys));
+  BOOST_CHECK_EQUAL(table.NuLookups(), size_t(nuThreads * 20 * nuKeys));
+}
+
+void Store100(DfpnTable *table, unsigned int first) {
+  for (unsigned int i = 0; i < 100; ++i)
+    table->Store(SgHashCode(first + i), DataOf(first + i));
+}
+
+void GetThreadIndex(int *index) {
+  *index = SgConcurrentHashTableUtil::ThreadIndex();
+}
+
+/** More threads than statistics slots do not lose counts. */
+BOOST_AUTO_TEST_CASE(SgConcurrentHashTableTest_ManyThreads) {
+  const int nuThreads = 2 * SgConcurrentHashTableUtil::MAX_THREADS + 8;
+  DfpnTable table(1 << 16);
+  boost::thread_group threads;
+  for (int i = 0; i < nuThreads; ++i)
+    threads.create_thread(boost::bind(&Store100, &table, 100 * i));
+  threads.join_all();
+  BOOST_CHECK_EQUAL(table.NuStores(), size_t(100 * nuThreads));
+}
+
+/** The slot of an exited thread is used again. */
+BOOST_AUTO_TEST_CASE(SgConcurrentHashTableTest_ThreadSlotRecycled) {
+  SgConcurrentHashTableUtil::ThreadIndex();
+  int first = -1;
+  boost::thread(boost::bind(&GetThreadIndex, &first)).join();
+  for (int i = 0; i < 2 * SgConcurrentHashTableUtil::MAX_THREADS; ++i) {
+    int index = -1;
+    boost::thread(boost::bind(&GetThreadIndex, &index)).join();
+    BOOST_CHECK_EQUAL(index, first);
+  }
+}
+
+}
+
+//----------------------------------------------------------------------------
@@ -0,0 +1,167 @@
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+
+#include "platform/SgSystem.h"
+#include "SgDfpnSearch.h"
+
+#include <vector>
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+/** Nim: take any number of stones from one pile, the player who cannot
+    move loses. The player to move wins iff the xor of the piles is not
+    zero. */
+class NimSolver
+    : public DfpnSolver {
+ public:
+  NimSolver(const vector<int> &piles, SgBlackWhite toPlay);
+
+  void GenerateChildren(vector<GoMove> &children) const;
+  void PlayMove(GoMove move);
+  void UndoMove();
+  bool TerminalState(SgBoardColor colorToPlay, SgEmptyBlackWhite &winner);
+  SgBoardColor GetColorToMove() const;
+  SgHashCode Hash() const;
+  void WriteMoveSequence(ostream &stream,
+                         const PointSequence &sequence) const;
+  DfpnSolver *Clone() const;
+
+ private:
+  static const int MAX_PILE = 16;
+  vector<int> m_piles;
+  SgBlackWhite m_toPlay;
+  vector<GoMove> m_moves;
+};
+
+NimSolver::NimSolver(const vector<int> &piles, SgBlackWhite toPlay)
+    : m_piles(piles),
+      m_toPlay(toPlay) {}
+
+DfpnSolver *NimSolver::Clone() const {
+  NimSolver *solver = new NimSolver(m_piles, m_toPlay);
+  solver->m_moves = m_moves;
+  return solver;
+}
+
+void NimSolver::GenerateChildren(vector<GoMove> &children) const {
+  children.clear();
+  for (size_t i = 0; i < m_piles.size(); ++i)
+    for (int n = m_piles[i]; n >= 1; --n)
+      children.push_back(static_cast<GoMove>(i) * MAX_PILE + n);
+}
+
+SgBoardColor NimSolver::GetColorToMove() const {
+  return m_toPlay;
+}
+
+SgHashCode NimSolver::Hash() const {
+  unsigned int key = m_toPlay;
+  for (size_t i = 0; i < m_piles.size(); ++i)
+    key = key * MAX_PILE + m_piles[i];
+  return SgHashCode(key);
+}
+
+void NimSolver::PlayMove(GoMove move) {
+  m_piles[move / MAX_PILE] -= move % MAX_PILE;
+  DBG_ASSERT(m_piles[move / MAX_PILE] >= 0);
+  m_moves.push_back(move);
+  m_toPlay = SgOppBW(m_toPlay);
+}
+
+bool NimSolver::TerminalState(SgBoardColor colorToPlay,
+                              SgEmptyBlackWhite &winner) {
+  for (size_t i = 0; i < m_piles.size(); ++i)
+    if (m_piles[i] > 0)
+      return false;
+  winner = SgOppBW(colorToPlay);
+  return true;
+}
+
+void NimSolver::UndoMove() {
+  const GoMove move = m_moves.back();
+  m_moves.pop_back();
+  m_piles[move / MAX_PILE] += move % MAX_PILE;
+  m_toPlay = SgOppBW(m_toPlay);
+}
+
+void NimSolver::WriteMoveSequence(ostream &stream,
+                                  const PointSequence &sequence) const {
+  for (size_t i = 0; i < sequence.size(); ++i)
+    stream << sequence[i] / MAX_PILE << ':' << sequence[i] % MAX_PILE << ' ';
+}
+
+SgEmptyBlackWhite NimWinner(const vector<int> &piles) {
+  int sum = 0;
+  for (size_t i = 0; i < piles.size(); ++i)
+    sum ^= piles[i];
+  return sum != 0 ? SG_BLACK : SG_WHITE;
+}
+
+vector<int> Piles(int a, int b, int c, int d) {
+  vector<int> piles;
+  piles.push_back(a);
+  piles.push_back(b);
+  piles.push_back(c);
+  piles.push_back(d);
+  return piles;
+}
+
+BOOST_AUTO_TEST_CASE(SgDfpnSearchTest_Nim) {
+  const vector<int> piles[] = {Piles(1, 2, 3, 0), Piles(3, 4, 5, 1),
+                               Piles(2, 5, 7, 3), Piles(4, 4, 6, 6)};
+  for (size_t i = 0; i < sizeof(piles) / sizeof(piles[0]); ++i) {
+    NimSolver solver(piles[i], SG_BLACK);
+    DfpnHashTable hashTable(1 << 16);
+    PointSequence pv;
+    BOOST_CHECK_EQUAL(solver.StartSearch(hashTable, pv),
+                      NimWinner(piles[i]));
+    BOOST_CHECK(!pv.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SgDfpnSearchTest_SharedHashTable) {
+  DfpnSharedHashTable hashTable(1 << 10);
+  const SgHashCode code(12345);
+  DfpnData data;
+  BOOST_CHECK(!hashTable.Lookup(code, &data));
+  hashTable.Store(code, DfpnData(DfpnBounds(3, 7), 42, 100));
+  BOOST_REQUIRE(hashTable.Lookup(code, &data));
+  BOOST_CHECK_EQUAL(data.m_bounds.phi, 3u);
+  BOOST_CHECK_EQUAL(data.m_bounds.delta, 7u);
+  BOOST_CHECK_EQUAL(data.m_bestMove, 42);
+  BOOST_CHECK_EQUAL(data.m_work, 100u);
+  DfpnBounds win;
+  DfpnBounds::SetToWinning(win);
+  hashTable.Store(code, DfpnData(win, GO_NULLMOVE, 5));
+  BOOST_REQUIRE(hashTable.Lookup(code, &data));
+  BOOST_CHECK(data.m_bounds.IsWinning());
+  BOOST_CHECK_EQUAL(data.m_bestMove, GO_NULLMOVE);
+  BOOST_CHECK_EQUAL(hashTable.NuStores(), 2u);
+  hashTable.Clear();
+  BOOST_CHECK(!hashTable.Lookup(code, &data));
+}
+
+BOOST_AUTO_TEST_CASE(SgDfpnSearchTest_Parallel) {
+  const vector<int> piles[] = {Piles(3, 4, 5, 1), Piles(2, 5, 7, 3),
+                               Piles(4, 4, 6, 6), Piles(5, 6, 7, 2)};
+  for (int numThreads = 1; numThreads <= 4; numThreads *= 2)
+    for (size_t i = 0; i < sizeof(piles) / sizeof(piles[0]); ++i) {
+      NimSolver solver(piles[i], SG_BLACK);
+      solver.SetNumThreads(numThreads);
+      DfpnSharedHashTable hashTable(1 << 16);
+      PointSequence pv;
+      BOOST_CHECK_EQUAL(solver.StartSearch(hashTable, pv),
+                        NimWinner(piles[i]));
+      BOOST_CHECK(!pv.empty());
+    }
+}
+
+}
+
+//----------------------------------------------------------------------------
@@ -8,6 +8,7 @@
 #include <vector>
 #include <boost/test/auto_unit_test.hpp>
 #include "platform/SgDebug.h"
+#include "lib/SgConcurrentHashTable.h"
 #include "lib/SgHashTable.h"
 #include "SgABSearch.h"
 #include "SgSearchControl.h"
@@ -31,6 +32,7 @@ class TestSearch
   ~TestSearch();
 
   void AddNode(size_t father, GoMove move, int eval);
+  size_t NumNodes() const;
   bool CheckDepthLimitReached() const;
   void Generate(SgVector<GoMove> *moves, int depth);
   int Evaluate(bool *isExact, int depth);
@@ -43,6 +45,7 @@ class TestSearch
   void SetToPlay(SgBlackWhite toPlay);
   SgHashCode GetHashCode() const;
   bool EndOfGame() const;
+  SgABSearch *Clone() const;
 
  private:
 
@@ -151,6 +154,10 @@ bool TestSearch::Execute(GoMove move, int *delta, int depth) {
   return false;
 }
 
+inline size_t TestSearch::NumNodes() const {
+  return m_nodes.size();
+}
+
 inline size_t TestSearch::LastEvaluated() const {
   return m_lastEvaluated;
 }
@@ -195,6 +202,26 @@ void TestSearch::SetToPlay(SgBlackWhite toPlay) {
   m_toPlay = toPlay;
 }
 
+SgABSearch *TestSearch::Clone() const {
+  TestSearch *search = new TestSearch();
+  search->m_currentNode = m_currentNode;
+  search->m_toPlay = m_toPlay;
+  search->m_nodes = m_nodes;
+  return search;
+}
+
+/** Add a uniform tree with pseudo-random evaluations below node father. */
+void AddTree(TestSearch &search, size_t father, int depth, int width,
+             unsigned int &seed) {
+  for (int i = 0; i < width; ++i) {
+    seed = seed * 1103515245 + 12345;
+    const size_t child = search.NumNodes();
+    search.AddNode(father, i + 1, int(seed >> 16) % 100 - 50);
+    if (depth > 1)
+      AddTree(search, child, depth - 1, width, seed);
+  }
+}
+
 } // namespace
 
 //----------------------------------------------------------------------------
@@ -271,6 +298,32 @@ BOOST_AUTO_TEST_CASE(SgSearchTest_NewBestInIncompleteIteration) {
   delete control;
 }
 
+/** Helper threads do not change the value and sequence of the main
+    thread. */
+BOOST_AUTO_TEST_CASE(SgSearchTest_Parallel) {
+  TestSearch search;
+  search.AddNode(TestSearch::NO_NODE, GO_NULLMOVE, 0);
+  unsigned int seed = 1;
+  AddTree(search, 0, 5, 4, seed);
+  SgVector<GoMove> expectedSequence;
+  const int expectedValue =
+      search.IteratedSearch(1, 10, -1000, 1000, &expectedSequence, true, 0);
+  for (int numThreads = 1; numThreads <= 4; ++numThreads) {
+    SgSearchSharedHashTable hashTable(1 << 12);
+    search.SetSharedHashTable(&hashTable);
+    search.SetNumThreads(numThreads);
+    SgVector<GoMove> sequence;
+    const int value =
+        search.IteratedSearch(1, 10, -1000, 1000, &sequence, true, 0);
+    BOOST_CHECK_EQUAL(value, expectedValue);
+    BOOST_CHECK_EQUAL(sequence.Length(), expectedSequence.Length());
+    BOOST_CHECK_EQUAL(sequence[0], expectedSequence[0]);
+    if (numThreads == 1)
+      BOOST_CHECK_EQUAL(search.HelperStatistics().NumNodes(), 0);
+    search.SetSharedHashTable(0);
+  }
+}
+
 } // namespace
 
 //----------------------------------------------------------------------------
@@ -0,0 +1,158 @@
+//----------------------------------------------------------------------------
+/** @file SgSgfCorpusTest.cpp
+    Unit tests for SgSgfCorpus. SgGameReader is used as the reference. */
+//----------------------------------------------------------------------------
+
+#include "platform/SgSystem.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include "SgGameReader.h"
+#include "SgNode.h"
+#include "SgSgfCorpus.h"
+
+using namespace std;
+using GoPointUtil::Pt;
+
+namespace {
+
+const char* NO_WARNINGS_GAME =
+    "(;FF[4]CA[ISO8859_1]GN[no-warnings]SZ[9]KM[6.5]RE[W+R]"
+    ";B[ee];W[ce];B[ec];W[dg];B[fg];W[gc];B[gb];W[fb];B[fc];W[hb]"
+    ";B[gd];W[hc];B[hd];W[dh];B[cd];W[bd];B[de];W[cf];B[eh];W[cc]"
+    ";B[eb];W[ga];B[dd];W[eg];B[fh];W[id];B[gf];W[if];B[ef];W[ei]"
+    ";B[fi];W[di];B[hg];W[ea];B[da];W[ia];B[ig];W[fa];B[cb];W[bc]"
+    ";B[hf];W[ie];B[he];W[ic];B[bb];W[ab];B[ba];W[dc];B[db];W[ac]"
+    ";B[aa];W[ae];B[df];W[cg];B[tt];W[tt])";
+
+/** Check the main lines of all games in text against SgGameReader. */
+void CheckAgainstGameReader(const string& text, const SgSgfCorpus& corpus) {
+  istringstream in(text);
+  SgGameReader reader(in);
+  SgVectorOf<SgNode> roots;
+  reader.ReadGames(&roots);
+  BOOST_REQUIRE_EQUAL(size_t(roots.Length()), corpus.NuGames());
+  for (int i = 0; i < roots.Length(); ++i) {
+    const SgSgfCorpusGame& game = corpus.Game(i);
+    const SgSgfCorpusMove* moves = corpus.Moves(game);
+    int nuMoves = 0;
+    for (SgNode* node = roots[i]; node; node = node->LeftMostSon()) {
+      if (!node->HasProp(SG_PROP_MOVE))
+        continue;
+      const SgPropMove* prop =
+          static_cast<SgPropMove*>(node->Get(SG_PROP_MOVE));
+      BOOST_REQUIRE_LT(nuMoves, game.m_nuMoves);
+      BOOST_CHECK_EQUAL(moves[nuMoves].m_point, prop->Value());
+      BOOST_CHECK_EQUAL(moves[nuMoves].m_color, prop->Player());
+      ++nuMoves;
+    }
+    BOOST_CHECK_EQUAL(nuMoves, game.m_nuMoves);
+    roots[i]->DeleteTree();
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_MainLine) {
+  SgSgfCorpus corpus;
+  BOOST_CHECK_EQUAL(corpus.Parse(NO_WARNINGS_GAME, strlen(NO_WARNINGS_GAME)),
+                    1u);
+  BOOST_REQUIRE_EQUAL(corpus.NuGames(), 1u);
+  const SgSgfCorpusGame& game = corpus.Game(0);
+  BOOST_CHECK_EQUAL(game.m_boardSize, 9);
+  BOOST_CHECK_EQUAL(game.m_komi, 6.5f);
+  BOOST_CHECK_EQUAL(game.m_winner, SG_WHITE);
+  BOOST_CHECK_EQUAL(game.m_nuSetup, 0);
+  BOOST_CHECK_EQUAL(game.m_nuMoves, 56);
+  BOOST_CHECK_EQUAL(corpus.Moves(game)[0].m_point, Pt(5, 5));
+  BOOST_CHECK_EQUAL(corpus.Moves(game)[0].m_color, SG_BLACK);
+  BOOST_CHECK_EQUAL(corpus.Moves(game)[55].m_point, GO_PASS);
+  BOOST_CHECK_EQUAL(corpus.Moves(game)[55].m_color, SG_WHITE);
+  CheckAgainstGameReader(NO_WARNINGS_GAME, corpus);
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_Collection) {
+  const string text =
+      "Header text\n"
+      "(;SZ[9]C[comment with ( and \\] ;B[zz]];B[aa]"
+      "(;W[bb];B[cc](;W[dd])(;W[ee]))(;W[ff]))\n"
+      "(;GM[1]SZ[19]\n;B[pd]\n;W\n[dp];B[]PL[W])";
+  SgSgfCorpus corpus;
+  BOOST_CHECK_EQUAL(corpus.Parse(text.c_str(), text.size()), 2u);
+  BOOST_CHECK_EQUAL(corpus.NuErrors(), 0u);
+  BOOST_CHECK_EQUAL(corpus.Game(0).m_nuMoves, 4);
+  BOOST_CHECK_EQUAL(corpus.Game(1).m_nuMoves, 3);
+  BOOST_CHECK_EQUAL(corpus.Game(1).m_boardSize, 19);
+  CheckAgainstGameReader(text, corpus);
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_SizeAfterPoints) {
+  const string text = "(;AB[aa][ab]HA[2]SZ[9];W[cc])";
+  SgSgfCorpus corpus;
+  BOOST_REQUIRE_EQUAL(corpus.Parse(text.c_str(), text.size()), 1u);
+  const SgSgfCorpusGame& game = corpus.Game(0);
+  BOOST_CHECK_EQUAL(game.m_handicap, 2);
+  BOOST_REQUIRE_EQUAL(game.m_nuSetup, 2);
+  BOOST_CHECK_EQUAL(corpus.Setup(game)[0].m_point, Pt(1, 9));
+  BOOST_CHECK_EQUAL(corpus.Setup(game)[1].m_point, Pt(1, 8));
+  BOOST_CHECK_EQUAL(corpus.Setup(game)[1].m_color, SG_BLACK);
+  BOOST_REQUIRE_EQUAL(game.m_nuMoves, 1);
+  BOOST_CHECK_EQUAL(corpus.Moves(game)[0].m_point, Pt(3, 7));
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_Errors) {
+  const string text =
+      "(;FF[4]SZ[999];B[aa])"
+      "(;GM[2]SZ[9];B[aa])"
+      "(;SZ[9];B[jj])"
+      "(;SZ[9];B[aa])";
+  SgSgfCorpus corpus;
+  BOOST_CHECK_EQUAL(corpus.Parse(text.c_str(), text.size()), 1u);
+  BOOST_CHECK_EQUAL(corpus.NuErrors(), 3u);
+  BOOST_CHECK_EQUAL(corpus.Game(0).m_nuMoves, 1);
+  BOOST_CHECK_EQUAL(corpus.Moves(corpus.Game(0))[0].m_point, Pt(1, 9));
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_Threads) {
+  ostringstream text;
+  for (int i = 0; i < 50; ++i)
+    text << (i % 7 == 0 ? "(;SZ[9];B[zz])" : NO_WARNINGS_GAME) << '\n';
+  SgSgfCorpus single;
+  single.Parse(text.str().c_str(), text.str().size(), 1);
+  for (int numThreads = 2; numThreads <= 4; ++numThreads) {
+    SgSgfCorpus corpus;
+    corpus.Parse(text.str().c_str(), text.str().size(), numThreads);
+    BOOST_CHECK_EQUAL(corpus.NuErrors(), 8u);
+    BOOST_REQUIRE_EQUAL(corpus.NuGames(), single.NuGames());
+    for (size_t i = 0; i < corpus.NuGames(); ++i) {
+      const SgSgfCorpusGame& game = corpus.Game(i);
+      BOOST_REQUIRE_EQUAL(game.m_nuMoves, single.Game(i).m_nuMoves);
+      for (int j = 0; j < game.m_nuMoves; ++j)
+        BOOST_CHECK_EQUAL(corpus.Moves(game)[j].m_point,
+                          single.Moves(single.Game(i))[j].m_point);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SgSgfCorpusTest_LoadFiles) {
+  const boost::filesystem::path path =
+      boost::filesystem::temp_directory_path()
+      / boost::filesystem::unique_path("%%%%%%%%.sgf");
+  {
+    ofstream out(path.string().c_str());
+    out << NO_WARNINGS_GAME << '\n' << NO_WARNINGS_GAME << '\n';
+  }
+  vector<string> files;
+  files.push_back(path.string());
+  files.push_back(path.string() + ".missing");
+  SgSgfCorpus corpus;
+  BOOST_CHECK_EQUAL(corpus.LoadFiles(files, 2), 2u);
+  BOOST_CHECK_EQUAL(corpus.Game(1).m_nuMoves, 56);
+  boost::filesystem::remove(path);
+}
+
+}
+
+//----------------------------------------------------------------------------
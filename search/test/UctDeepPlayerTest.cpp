@@ -0,0 +1,37 @@
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+
+#include "platform/SgSystem.h"
+
+#include <string>
+#include <boost/test/auto_unit_test.hpp>
+#include "funcapproximator/DlConfig.h"
+#include "GoGame.h"
+#include "UctDeepPlayer.h"
+
+//----------------------------------------------------------------------------
+
+namespace {
+
+/** The memory that the player reserves, and that uct_max_memory reports,
+    stays within max_memory. */
+BOOST_AUTO_TEST_CASE(UctDeepPlayerTest_MaxMemory) {
+  DlConfig &config = DlConfig::GetInstance();
+  const std::string saved = config.get("max_memory", "0");
+  const std::size_t maxMemory = 64 * 1024 * 1024;
+  config.set("max_memory", std::to_string(maxMemory));
+  GoGame game(9);
+  GoRules rules;
+  UctDeepPlayer player(game, rules);
+  const UctMemoryUsage usage = player.MemoryUsage();
+  BOOST_CHECK_LE(usage.Reserved(), maxMemory);
+  BOOST_CHECK_LE(UctSearch::MemoryForNodes(player.Search().MaxNodes())
+                 + usage.policy_reserved, maxMemory);
+  BOOST_CHECK_GT(player.Search().MaxNodes(), 0u);
+  config.set("max_memory", saved);
+}
+
+} // namespace
+
+//----------------------------------------------------------------------------
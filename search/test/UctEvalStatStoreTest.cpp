@@ -0,0 +1,82 @@
+
+
+#include "platform/SgSystem.h"
+#include "UctEvalStatStore.h"
+
+#include <cstdio>
+#include <string>
+#include <boost/test/auto_unit_test.hpp>
+#include "msg/ZmqUtil.h"
+
+namespace {
+
+BOOST_AUTO_TEST_CASE(UctEvalStatStoreTest_Add) {
+  UctEvalStatStore store;
+  BOOST_CHECK(!store.IsModified());
+  store.Add("a", "b", true);
+  store.Add("a", "b", false);
+  UctEvalStatStore::Result result = store.Add("a", "b", true);
+  BOOST_CHECK_EQUAL(result.m_bestWins, 2);
+  BOOST_CHECK_EQUAL(result.m_total, 3);
+  store.Add("a", "c", false);
+  BOOST_CHECK_EQUAL(store.NuPairs(), 2u);
+  BOOST_CHECK_EQUAL(store.Get("a", "c").m_bestWins, 0);
+  BOOST_CHECK_EQUAL(store.Get("a", "c").m_total, 1);
+  BOOST_CHECK_EQUAL(store.Get("b", "a").m_total, 0);
+  store.Erase("a", "b");
+  BOOST_CHECK_EQUAL(store.NuPairs(), 1u);
+  BOOST_CHECK_EQUAL(store.Get("a", "b").m_total, 0);
+  BOOST_CHECK(store.IsModified());
+}
+
+BOOST_AUTO_TEST_CASE(UctEvalStatStoreTest_SaveLoad) {
+  const std::string fileName = "UctEvalStatStoreTest.snapshot";
+  UctEvalStatStore store;
+  store.Add("a", "b", true);
+  store.Add("a", "b", false);
+  store.Add("c", "d", true);
+  BOOST_REQUIRE(store.Save(fileName));
+  BOOST_CHECK(!store.IsModified());
+  UctEvalStatStore loaded;
+  loaded.Add("x", "y", true);
+  BOOST_REQUIRE(loaded.Load(fileName));
+  std::remove(fileName.c_str());
+  BOOST_CHECK_EQUAL(loaded.NuPairs(), 2u);
+  BOOST_CHECK_EQUAL(loaded.Get("a", "b").m_bestWins, 1);
+  BOOST_CHECK_EQUAL(loaded.Get("a", "b").m_total, 2);
+  BOOST_CHECK_EQUAL(loaded.Get("c", "d").m_bestWins, 1);
+  BOOST_CHECK_EQUAL(loaded.Get("x", "y").m_total, 0);
+  BOOST_CHECK(!loaded.Load(fileName));
+}
+
+BOOST_AUTO_TEST_CASE(UctEvalStatStoreTest_ParseRequest) {
+  UnrealGo::Command command;
+  command.set_type(ZmqUtil::CMD_EVAL_RESULT);
+  command.mutable_eval_result()->mutable_best()->set_sha1("s1");
+  command.mutable_eval_result()->mutable_latest()->set_sha1("s2");
+  command.mutable_eval_result()->mutable_latest()->set_name("ckpt-2");
+  command.mutable_eval_result()->set_best_won(true);
+  std::string buffer;
+  command.SerializeToString(&buffer);
+  UnrealGo::EvalResult result;
+  BOOST_REQUIRE(UctEvalStatUtil::ParseRequest(buffer.data(), buffer.size(),
+                                              result));
+  BOOST_CHECK_EQUAL(result.best().sha1(), "s1");
+  BOOST_CHECK_EQUAL(result.latest().name(), "ckpt-2");
+  BOOST_CHECK(result.best_won());
+
+  const std::string legacy = "s1/ckpt-1:s2/ckpt-2:0";
+  result.Clear();
+  BOOST_REQUIRE(UctEvalStatUtil::ParseRequest(legacy.data(), legacy.size(),
+                                              result));
+  BOOST_CHECK_EQUAL(result.best().sha1(), "s1");
+  BOOST_CHECK_EQUAL(result.best().name(), "ckpt-1");
+  BOOST_CHECK_EQUAL(result.latest().sha1(), "s2");
+  BOOST_CHECK(!result.best_won());
+
+  const std::string invalid = "s1/ckpt-1:s2/ckpt-2";
+  BOOST_CHECK(!UctEvalStatUtil::ParseRequest(invalid.data(), invalid.size(),
+                                             result));
+}
+
+}
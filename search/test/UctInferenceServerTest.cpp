@@ -0,0 +1,170 @@
+
+#include "platform/SgSystem.h"
+#include "UctInferenceServer.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <boost/bind.hpp>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+/** Answers value = first feature byte and policy[j] = value + j, so a client
+    can tell that it got the answer to its own positions. */
+struct FakeNetwork {
+  FakeNetwork() : m_maxRows(0), m_delay(0) {}
+
+  void Evaluate(char feature[][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE],
+                UctValueType actions_[][GO_MAX_MOVES], UctValueType value_[],
+                int numBatches) {
+    if (m_delay > 0)
+      boost::this_thread::sleep(boost::posix_time::milliseconds(m_delay.exchange(0)));
+    m_maxRows = std::max<int>(m_maxRows, numBatches);
+    for (int i = 0; i < numBatches; ++i) {
+      value_[i] = feature[i][0][0][0];
+      for (int j = 0; j < GO_MAX_MOVES; ++j)
+        actions_[i][j] = value_[i] + j;
+    }
+  }
+
+  void UpdateCheckPoint(const std::string &checkpoint) {
+    m_checkpoint = checkpoint;
+  }
+
+  std::atomic<int> m_maxRows;
+  std::atomic<int> m_delay;
+  std::string m_checkpoint;
+};
+
+struct Batch {
+  char m_feature[MAX_BATCHES][NUM_MAPS][GO_MAX_SIZE][GO_MAX_SIZE];
+  UctValueType m_policy[MAX_BATCHES][GO_MAX_MOVES];
+  UctValueType m_value[MAX_BATCHES];
+};
+
+bool EvaluateAndCheck(UctInferenceClient &client, int first, int count) {
+  std::unique_ptr<Batch> batch(new Batch());
+  for (int i = 0; i < count; ++i)
+    batch->m_feature[i][0][0][0] = (char) (first + i);
+  if (!client.Evaluate(batch->m_feature, batch->m_policy, batch->m_value, count))
+    return false;
+  for (int i = 0; i < count; ++i)
+    if (batch->m_value[i] != first + i
+        || batch->m_policy[i][GO_MAX_MOVES - 1] != first + i + GO_MAX_MOVES - 1)
+      return false;
+  return true;
+}
+
+void EvaluateInThread(const std::string &name, int first, std::atomic<int> *nuOk,
+                      int model = 0) {
+  UctInferenceClient client(name, model);
+  if (EvaluateAndCheck(client, first, 2))
+    ++*nuOk;
+}
+
+class ServerFixture {
+ public:
+  explicit ServerFixture(const std::string &name) :
+      m_server(name,
+               boost::bind(&FakeNetwork::Evaluate, &m_network, _1, _2, _3, _4),
+               boost::bind(&FakeNetwork::UpdateCheckPoint, &m_network, _1)),
+      m_thread(&UctInferenceServer::Run, &m_server) {}
+
+  ~ServerFixture() {
+    Stop();
+  }
+
+  void Stop() {
+    m_server.Stop();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  FakeNetwork m_network;
+  UctInferenceServer m_server;
+  boost::thread m_thread;
+};
+
+std::string TestName(const std::string &name) {
+  return name + "-" + std::to_string(getpid());
+}
+
+BOOST_AUTO_TEST_CASE(UctInferenceServerTest_SharedMemory) {
+  const std::string name = TestName("test-shm");
+  ServerFixture fixture(name);
+  BOOST_REQUIRE(fixture.m_server.HasSharedMemory());
+  UctInferenceClient client(name);
+  BOOST_CHECK(client.UsesSharedMemory());
+  BOOST_CHECK(EvaluateAndCheck(client, 10, 3));
+  BOOST_CHECK(EvaluateAndCheck(client, 20, MAX_BATCHES));
+  fixture.Stop();
+  BOOST_CHECK_EQUAL(fixture.m_server.NuPositions(), 3u + MAX_BATCHES);
+}
+
+BOOST_AUTO_TEST_CASE(UctInferenceServerTest_Zmq) {
+  const std::string name = "ipc:///tmp/unrealgo-infer-" + TestName("test-zmq") + ".ipc";
+  ServerFixture fixture(name);
+  BOOST_CHECK(!fixture.m_server.HasSharedMemory());
+  UctInferenceClient client(name);
+  BOOST_CHECK(!client.UsesSharedMemory());
+  BOOST_CHECK(client.UpdateCheckPoint("ckpt-1"));
+  BOOST_CHECK(EvaluateAndCheck(client, 30, 5));
+  fixture.Stop();
+  BOOST_CHECK_EQUAL(fixture.m_network.m_checkpoint, "ckpt-1");
+  BOOST_CHECK_EQUAL(fixture.m_server.NuBatches(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(UctInferenceServerTest_MergeClients) {
+  const std::string name = TestName("test-merge");
+  ServerFixture fixture(name);
+  // The first batch keeps the network busy while the other clients send
+  // their requests, which then go into one batch
+  fixture.m_network.m_delay = 200;
+  std::atomic<int> nuOk(0);
+  boost::thread_group clients;
+  for (int i = 0; i < 4; ++i)
+    clients.create_thread(boost::bind(&EvaluateInThread, name, 10 * i, &nuOk, 0));
+  clients.join_all();
+  fixture.Stop();
+  BOOST_CHECK_EQUAL(nuOk, 4);
+  BOOST_CHECK_EQUAL(fixture.m_server.NuPositions(), 8u);
+  BOOST_CHECK_GT(fixture.m_network.m_maxRows, 2);
+}
+
+BOOST_AUTO_TEST_CASE(UctInferenceServerTest_Models) {
+  const std::string name = TestName("test-models");
+  ServerFixture fixture(name);
+  FakeNetwork other;
+  BOOST_CHECK_EQUAL(fixture.m_server.AddModel(
+      boost::bind(&FakeNetwork::Evaluate, &other, _1, _2, _3, _4),
+      boost::bind(&FakeNetwork::UpdateCheckPoint, &other, _1)), 1);
+  UctInferenceClient client(name, 1);
+  BOOST_CHECK(client.UpdateCheckPoint("ckpt-2"));
+  fixture.m_network.m_delay = 200;
+  std::atomic<int> nuOk(0);
+  boost::thread_group clients;
+  for (int i = 0; i < 6; ++i)
+    clients.create_thread(boost::bind(&EvaluateInThread, name, 10 * i, &nuOk, i % 2));
+  clients.join_all();
+  BOOST_CHECK(EvaluateAndCheck(client, 70, 1));
+  fixture.Stop();
+  BOOST_CHECK_EQUAL(nuOk, 6);
+  BOOST_CHECK_EQUAL(fixture.m_server.NuPositions(), 13u);
+  // Both models evaluated positions, only model 1 loaded the checkpoint
+  BOOST_CHECK_GT(fixture.m_network.m_maxRows, 0);
+  BOOST_CHECK_GT(other.m_maxRows, 0);
+  BOOST_CHECK_EQUAL(other.m_checkpoint, "ckpt-2");
+  BOOST_CHECK(fixture.m_network.m_checkpoint.empty());
+}
+
+BOOST_AUTO_TEST_CASE(UctInferenceServerTest_NoServer) {
+  BOOST_CHECK(UctInferenceUtil::SharedMemoryName("tcp://host:5555").empty());
+  BOOST_CHECK_EQUAL(UctInferenceUtil::SharedMemoryName("a/b"), "/unrealgo-infer-a_b");
+  UctInferenceClient client(TestName("test-none"));
+  BOOST_CHECK(!client.UsesSharedMemory());
+}
+
+}
@@ -0,0 +1,103 @@
+
+#include "platform/SgSystem.h"
+#include "UctPhaseTrace.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/test/auto_unit_test.hpp>
+
+namespace {
+
+BOOST_AUTO_TEST_CASE(UctPhaseTraceTest_Histogram) {
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(0), 0);
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(1), 0);
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(2), 1);
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(1023), 9);
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(1024), 10);
+  BOOST_CHECK_EQUAL(UctPhaseHistogram::Bucket(~0ull),
+                    UctPhaseHistogram::NU_BUCKETS - 1);
+  UctPhaseHistogram histogram;
+  BOOST_CHECK_EQUAL(histogram.PercentileNs(0.5), 0u);
+  for (int i = 0; i < 90; ++i)
+    histogram.Add(1000);
+  for (int i = 0; i < 10; ++i)
+    histogram.Add(100000);
+  BOOST_CHECK_EQUAL(histogram.Count(), 100u);
+  BOOST_CHECK_EQUAL(histogram.Count(9), 90u);
+  BOOST_CHECK_EQUAL(histogram.TotalNs(), 90u * 1000u + 10u * 100000u);
+  BOOST_CHECK_EQUAL(histogram.MaxNs(), 100000u);
+  BOOST_CHECK_EQUAL(histogram.PercentileNs(0.5), 1023u);
+  BOOST_CHECK_EQUAL(histogram.PercentileNs(0.9), 1023u);
+  BOOST_CHECK_EQUAL(histogram.PercentileNs(0.99), 100000u);
+  UctPhaseHistogram sum;
+  sum.Add(histogram);
+  sum.Add(histogram);
+  BOOST_CHECK_EQUAL(sum.Count(), 200u);
+  BOOST_CHECK_EQUAL(sum.MaxNs(), 100000u);
+  sum.Clear();
+  BOOST_CHECK_EQUAL(sum.Count(), 0u);
+  BOOST_CHECK_EQUAL(sum.TotalNs(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(UctPhaseTraceTest_Tracer) {
+  UctPhaseTracer tracer;
+  {
+    UctPhaseTimer timer(tracer, UCT_PHASE_SELECT);
+  }
+  BOOST_CHECK_EQUAL(tracer.Histogram(UCT_PHASE_SELECT).Count(), 0u);
+
+  tracer.SetEnabled(true);
+  {
+    UctPhaseTimer timer(tracer, UCT_PHASE_SELECT);
+    UctPhaseTimer stopped(tracer, UCT_PHASE_WAIT);
+    stopped.Stop();
+  }
+  BOOST_CHECK_EQUAL(tracer.Histogram(UCT_PHASE_SELECT).Count(), 1u);
+  BOOST_CHECK_EQUAL(tracer.Histogram(UCT_PHASE_WAIT).Count(), 1u);
+  BOOST_CHECK(tracer.Events().empty());
+
+  tracer.SetRecordEvents(true);
+  const UctPhaseTracer::Clock::time_point start = UctPhaseTracer::Clock::now();
+  tracer.Add(UCT_PHASE_EVALUATE, start, start + std::chrono::microseconds(5));
+  BOOST_REQUIRE_EQUAL(tracer.Events().size(), 1u);
+  BOOST_CHECK_EQUAL(tracer.Events()[0].m_phase, UCT_PHASE_EVALUATE);
+  BOOST_CHECK_EQUAL(tracer.Events()[0].m_durationNs, 5000);
+  tracer.Clear();
+  BOOST_CHECK_EQUAL(tracer.Histogram(UCT_PHASE_SELECT).Count(), 0u);
+  BOOST_CHECK(tracer.Events().empty());
+}
+
+BOOST_AUTO_TEST_CASE(UctPhaseTraceTest_Write) {
+  UctPhaseTracer search;
+  UctPhaseTracer network;
+  search.SetEnabled(true);
+  search.SetRecordEvents(true);
+  network.SetEnabled(true);
+  const UctPhaseTracer::Clock::time_point start = UctPhaseTracer::Clock::now();
+  search.Add(UCT_PHASE_BACKUP, start, start + std::chrono::microseconds(3));
+  network.Add(UCT_PHASE_EVALUATE, start, start + std::chrono::microseconds(1));
+  std::vector<const UctPhaseTracer *> tracers;
+  tracers.push_back(&search);
+  tracers.push_back(&network);
+
+  std::ostringstream statistics;
+  UctPhaseTraceUtil::WriteStatistics(statistics, tracers);
+  BOOST_CHECK_NE(statistics.str().find("backup"), std::string::npos);
+  BOOST_CHECK_NE(statistics.str().find("evaluate"), std::string::npos);
+
+  std::vector<std::string> names;
+  names.push_back("search \"0\"");
+  names.push_back("network");
+  std::ostringstream trace;
+  UctPhaseTraceUtil::WriteChromeTrace(trace, tracers, names);
+  const std::string json = trace.str();
+  BOOST_CHECK_EQUAL(json.find("{\"traceEvents\":["), 0u);
+  BOOST_CHECK_NE(json.find("\"name\":\"search \\\"0\\\"\""), std::string::npos);
+  BOOST_CHECK_NE(json.find("\"name\":\"backup\""), std::string::npos);
+  BOOST_CHECK_NE(json.find("\"dur\":3.000"), std::string::npos);
+  // The network tracer does not record events
+  BOOST_CHECK_EQUAL(json.find("\"name\":\"evaluate\""), std::string::npos);
+}
+
+}
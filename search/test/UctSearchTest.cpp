@@ -526,6 +526,17 @@ BOOST_AUTO_TEST_CASE(SgUctSearchTest_Knowledge) {
     BOOST_CHECK_EQUAL(PROVEN_WIN, tree.Root().ProvenType());
   }
 }
+
+BOOST_AUTO_TEST_CASE(UctSearchTest_MemoryForNodes) {
+  const size_t fixed = UctSearch::MemoryForNodes(0);
+  BOOST_CHECK_EQUAL(UctSearch::NodesForMemory(fixed), 0u);
+  BOOST_CHECK_EQUAL(UctSearch::MemoryForNodes(1000) - fixed, 2000 * sizeof(UctNode));
+  for (size_t memory = fixed; memory < fixed + 10 * sizeof(UctNode); memory += 7) {
+    const size_t nodes = UctSearch::NodesForMemory(memory);
+    BOOST_CHECK_LE(UctSearch::MemoryForNodes(nodes), memory);
+    BOOST_CHECK_GT(UctSearch::MemoryForNodes(nodes + 1), memory);
+  }
+}
 }
 
 //----------------------------------------------------------------------------
@@ -164,6 +164,41 @@ BOOST_AUTO_TEST_CASE(SgUctTreeIteratorTest_TreeSwap) {
   BOOST_CHECK_EQUAL(treeRight.Root().GetColor(), SG_BLACK);
 }
 
+BOOST_AUTO_TEST_CASE(UctTreeTest_Memory) {
+  UctSearchTree tree;
+  BOOST_CHECK_EQUAL(tree.MemoryReserved(), 0u);
+  tree.CreateAllocators(2);
+  tree.SetMaxNodes(10);
+  BOOST_CHECK_EQUAL(tree.MemoryReserved(), 10 * sizeof(UctNode));
+  BOOST_CHECK_EQUAL(tree.MemoryUsed(), 0u);
+  vector<UctMoveInfo> moves;
+  moves.push_back(UctMoveInfo(10));
+  moves.push_back(UctMoveInfo(20));
+  tree.CreateChildren(1, tree.Root(), moves);
+  BOOST_CHECK_EQUAL(tree.MemoryUsed(), 2 * sizeof(UctNode));
+  tree.Clear();
+  BOOST_CHECK_EQUAL(tree.MemoryUsed(), 0u);
+  BOOST_CHECK_EQUAL(tree.MemoryReserved(), 10 * sizeof(UctNode));
+}
+
+BOOST_AUTO_TEST_CASE(UctTreeTest_RemoveChildren) {
+  UctSearchTree tree;
+  tree.CreateAllocators(1);
+  tree.SetMaxNodes(10);
+  vector<UctMoveInfo> moves;
+  moves.push_back(UctMoveInfo(10));
+  moves.push_back(UctMoveInfo(20));
+  tree.Expand(0, tree.Root(), moves);
+  tree.RemoveChildren(tree.Root());
+  BOOST_CHECK(!tree.Root().HasChildren());
+  // A copy of the tree does not have the removed children
+  UctSearchTree copy;
+  copy.CreateAllocators(1);
+  copy.SetMaxNodes(10);
+  tree.ExtractSubtree(copy, tree.Root(), false);
+  BOOST_CHECK_EQUAL(copy.NuNodes(), 1u);
+}
+
 } // namespace
 
 //----------------------------------------------------------------------------
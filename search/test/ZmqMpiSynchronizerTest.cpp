@@ -0,0 +1,106 @@
+
+#include "platform/SgSystem.h"
+#include "ZmqMpiSynchronizer.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <boost/test/auto_unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include "UctSearchTree.h"
+#include "UctTreeUtil.h"
+
+using std::vector;
+using UctTreeUtil::FindChildWithMove;
+
+namespace {
+
+void CreateRoot(UctSearchTree &tree) {
+  tree.CreateAllocators(1);
+  tree.SetMaxNodes(10);
+  vector<UctMoveInfo> moves;
+  moves.push_back(UctMoveInfo(10));
+  moves.push_back(UctMoveInfo(20));
+  moves.push_back(UctMoveInfo(30));
+  tree.CreateChildren(0, tree.Root(), moves);
+}
+
+UctNode &Child(UctSearchTree &tree, GoMove move) {
+  return const_cast<UctNode &>(*FindChildWithMove(tree, tree.Root(), move));
+}
+
+/** Process 1: searches move 20 until process 0 ends the search, then checks
+    that it got the results of process 0 and plays its move. */
+int RunWorker(const std::string &endpoint) {
+  try {
+    ZmqMpiSynchronizer synchronizer(endpoint, 1, 2, 10);
+    UctSearchTree tree;
+    CreateRoot(tree);
+    synchronizer.StartSearch(tree);
+    for (int i = 0; i < 5; ++i)
+      Child(tree, 20).AddValue(0.5);
+    for (int i = 0; i < 1000 && !synchronizer.CheckAbort(); ++i) {
+      synchronizer.Exchange(tree);
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    synchronizer.EndSearch(tree);
+    GoMove move = GO_NULLMOVE;
+    synchronizer.SynchronizeMove(move);
+    if (!synchronizer.CheckAbort() || move != 10
+        || Child(tree, 10).MoveCount() != 3)
+      return 1;
+    return 0;
+  }
+  catch (...) {
+    return 2;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ZmqMpiSynchronizerTest_RootParallel) {
+  const std::string endpoint = "ipc:///tmp/unrealgo-dist-test-"
+                               + std::to_string(getpid()) + ".ipc";
+  // Buffered output would be written by both processes
+  std::cout.flush();
+  pid_t pid = fork();
+  BOOST_REQUIRE(pid >= 0);
+  if (pid == 0)
+    _exit(RunWorker(endpoint));
+
+  ZmqMpiSynchronizer synchronizer(endpoint, 0, 2, 10);
+  BOOST_CHECK(synchronizer.IsRootProcess());
+  UctSearchTree tree;
+  CreateRoot(tree);
+  synchronizer.StartSearch(tree);
+  for (int i = 0; i < 3; ++i)
+    Child(tree, 10).AddValue(-0.25);
+  for (int i = 0; i < 1000 && Child(tree, 20).MoveCount() < 5; ++i) {
+    synchronizer.Exchange(tree);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  // One more exchange so process 1 gets the results of process 0
+  synchronizer.Exchange(tree);
+  synchronizer.EndSearch(tree);
+  BOOST_CHECK_EQUAL(Child(tree, 20).MoveCount(), 5);
+  BOOST_CHECK_CLOSE(Child(tree, 20).Mean(), 0.5, 1e-6);
+  BOOST_CHECK_EQUAL(Child(tree, 10).MoveCount(), 3);
+  BOOST_CHECK_EQUAL(tree.Root().MoveCount(), 5);
+  GoMove move = 10;
+  synchronizer.SynchronizeMove(move);
+
+  int status = -1;
+  BOOST_REQUIRE_EQUAL(waitpid(pid, &status, 0), pid);
+  BOOST_CHECK(WIFEXITED(status));
+  BOOST_CHECK_EQUAL(WEXITSTATUS(status), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ZmqMpiSynchronizerTest_NodeFilename) {
+  const std::string endpoint = "ipc:///tmp/unrealgo-dist-test-"
+                               + std::to_string(getpid()) + "-single.ipc";
+  ZmqMpiSynchronizer synchronizer(endpoint, 0, 1);
+  BOOST_CHECK_EQUAL(synchronizer.ToNodeFilename("log"), "log");
+  BOOST_CHECK(!synchronizer.CheckAbort());
+}
+
+}